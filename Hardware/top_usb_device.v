@@ -5,15 +5,27 @@
 // Version：V1.0
 // Created by Zeba-Xie @github
 // 
+// Parameters (defaults in usbf_cfg_defs.v):
+//  ITF_ICB         : 0: AHB slave interface, 1: ICB slave interface
+//  BASE_ADDR_31_12 : base address of the registers, ICB only
+//  REG_FIFO        : 1: FIFOs use regs, 0: GENERIC_MEM or FPGA
+//  FIFO_ADDR_W     : each EP FIFO has 2^FIFO_ADDR_W bytes
+//  EP_NUM          : number of endpoints
+// The ports of the unused bus interface can be left unconnected.
 //=================================================================
 
 `include "usbf_cfg_defs.v"
 
-module top_usb_device(
+module top_usb_device #(
+    parameter ITF_ICB           = `USB_ITF_ICB_DEFAULT,
+    parameter BASE_ADDR_31_12   = `USB_BASE_ADDR_31_12,
+    parameter REG_FIFO          = `USB_REG_FIFO_DEFAULT,
+    parameter FIFO_ADDR_W       = `USB_FIFO_ADDR_W,
+    parameter EP_NUM            = `USB_EP_NUM
+)(
      input              hclk_i
     ,input              hrstn_i
 
-    `ifdef USB_ITF_AHB
     ////// AHB slave interface
     ,input              hsel_i
     ,input              hwrite_i
@@ -26,9 +38,7 @@ module top_usb_device(
     ,output             hready_o
     ,output [1:0]       hresp_o
     ,output [31:0]      hrdata_o
-    `endif
 
-    `ifdef USB_ITF_ICB
     ////// ICB slave interface
     ,input              icb_cmd_valid_i
     ,output             icb_cmd_ready_o
@@ -38,7 +48,6 @@ module top_usb_device(
     ,output             icb_rsp_valid_o
     ,input              icb_rsp_ready_i
     ,output [32-1:0]    icb_rsp_rdata_o
-    `endif
 
     ,input              ulpi_clk60_i
     ,input  [7:0]       ulpi_data_i
@@ -68,12 +77,17 @@ wire                utmi_termselect ;
 wire                utmi_dppulldown ;    
 wire                utmi_dmpulldown ;          
          
-usbf_device u_usbf_device(
+usbf_device #(
+    .ITF_ICB                (ITF_ICB            ),
+    .BASE_ADDR_31_12        (BASE_ADDR_31_12    ),
+    .REG_FIFO               (REG_FIFO           ),
+    .FIFO_ADDR_W            (FIFO_ADDR_W        ),
+    .EP_NUM                 (EP_NUM             )
+) u_usbf_device(
     .hclk_i                 (hclk_i             ),         
     .phy_clk_i              (ulpi_clk60_i       ),  
     .hrstn_i                (hrstn_i            ),  
 
-    `ifdef USB_ITF_AHB
     ////// AHB slave interface
     .hsel_i                 (hsel_i             ),
     .hwrite_i               (hwrite_i           ),
@@ -86,9 +100,7 @@ usbf_device u_usbf_device(
     .hready_o               (hready_o           ),   
     .hresp_o                (hresp_o            ),   
     .hrdata_o               (hrdata_o           ), 
-    `endif
 
-    `ifdef USB_ITF_ICB
     ////// ICB slave interface
     .icb_cmd_valid_i        (icb_cmd_valid_i    ),
     .icb_cmd_ready_o        (icb_cmd_ready_o    ),
@@ -98,7 +110,6 @@ usbf_device u_usbf_device(
     .icb_rsp_valid_o        (icb_rsp_valid_o    ),
     .icb_rsp_ready_i        (icb_rsp_ready_i    ),
     .icb_rsp_rdata_o        (icb_rsp_rdata_o    ),
-    `endif
 
     .utmi_data_in_i         (utmi_data_in       ),   
     .utmi_txready_i         (utmi_txready       ),   
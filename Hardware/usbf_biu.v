@@ -8,15 +8,25 @@
 // 
 // Modified in 2023.8.4:
 //  Optimize the AHB interface.
+//
+// Modified:
+//  Pipelined AHB transfers, zero wait state for registers.
+//  Multiple outstanding ICB commands with in-order responses.
+//
+// Modified:
+//  The bus interface is selected by parameter ITF_ICB, the ports
+//  of the other interface are unused.
 //=================================================================
 
 `include "usbf_cfg_defs.v"
 
-module usbf_biu(
+module usbf_biu #(
+    parameter ITF_ICB           = `USB_ITF_ICB_DEFAULT, // 0: AHB, 1: ICB
+    parameter BASE_ADDR_31_12   = `USB_BASE_ADDR_31_12  // ICB only
+)(
      input                      hclk_i
     ,input                      hrstn_i
 
-    `ifdef USB_ITF_AHB
     ////// AHB slave interface
     ,input                      hsel_i
     ,input                      hwrite_i
@@ -29,9 +39,7 @@ module usbf_biu(
     ,output                     hready_o
     ,output [1:0]               hresp_o
     ,output [31:0]              hrdata_o
-    `endif
 
-    `ifdef USB_ITF_ICB
     ////// ICB slave interface
     // CMD
     ,input                      icb_cmd_valid_i
@@ -43,7 +51,6 @@ module usbf_biu(
     ,output                     icb_rsp_valid_o
     ,input                      icb_rsp_ready_i
     ,output [32-1:0]            icb_rsp_rdata_o
-    `endif
 
     ////// CSR interface
     ,output                     wt_en_o
@@ -58,81 +65,106 @@ module usbf_biu(
 
 );
 
+generate
 //===================================================================================
-`ifdef USB_ITF_AHB
+if (ITF_ICB == 0) begin : ahb
 
 //-----------------------------------------------------------------
-// write and read enable
+// address phase
 //-----------------------------------------------------------------
-wire wt_en = hsel_i & hready_i &  hwrite_i & (htrans_i == 2'b10 | htrans_i == 2'b11);
-wire rd_en = hsel_i & hready_i & !hwrite_i & (htrans_i == 2'b10 | htrans_i == 2'b11);
+wire trans_w = hsel_i & hready_i & (htrans_i == 2'b10 | htrans_i == 2'b11);
 
-wire wt_en_r;
-wire wt_en_next = wt_en;
-usbf_gnrl_dffr #(1) wt_en_diffr(
-    wt_en_next, wt_en_r,
+//-----------------------------------------------------------------
+// data phase
+// The transfer sampled in the address phase is done in the data 
+// phase, so the address phase of the next transfer overlaps it.
+// Registers answer in the first cycle of the data phase (zero wait
+// state), FIFO accesses insert wait states until the CDC finished.
+//-----------------------------------------------------------------
+wire dp_wt_r;
+wire dp_wt_next = trans_w & hwrite_i;
+usbf_gnrl_dfflrd #(1, 1'b0) 
+    dp_wt_difflrd(
+        hready_i,dp_wt_next,
+        dp_wt_r,
+        hclk_i,hrstn_i
+    );
+
+wire dp_rd_r;
+wire dp_rd_next = trans_w & (~hwrite_i);
+usbf_gnrl_dfflrd #(1, 1'b0) 
+    dp_rd_difflrd(
+        hready_i,dp_rd_next,
+        dp_rd_r,
+        hclk_i,hrstn_i
+    );
+
+// first cycle of the data phase
+wire dp_first_r;
+wire dp_first_next = trans_w;
+usbf_gnrl_dffr #(1) dp_first_diffr(
+    dp_first_next, dp_first_r,
     hclk_i,hrstn_i
 );
 
-assign wt_en_o = wt_en_r;
+wire [32-1:0] addr_r;
+wire [32-1:0] addr_next = haddr_i;
+usbf_gnrl_dfflrd #(32, 32'b0)
+    addr_dfflrd(
+        trans_w, addr_next,
+        addr_r,
+        hclk_i,hrstn_i
+    );
+
+//-----------------------------------------------------------------
+// write and read enable
+//-----------------------------------------------------------------
+wire wt_en = dp_first_r & dp_wt_r;
+wire rd_en = dp_first_r & dp_rd_r;
+
+assign wt_en_o = wt_en;
 assign rd_en_o = rd_en;
 
 //-----------------------------------------------------------------
 // hready and hresp
 //-----------------------------------------------------------------
-wire wt_ready_r; // default 1
-wire wt_ready_set = wt_ready_i; // write finished
-wire wt_ready_clr = wt_en; // write start
-wire wt_ready_ena  = wt_ready_set | wt_ready_clr;
-wire wt_ready_next = wt_ready_set | (~wt_ready_clr);
-usbf_gnrl_dfflrd #(1, 1'b1) 
-    wt_ready_difflrd(
-        wt_ready_ena,wt_ready_next,
-        wt_ready_r,
-        hclk_i,hrstn_i
-    );
+wire ack_w = wt_ready_i | rd_ready_i; // access finished
 
-wire rd_ready_r; // default 1
-wire rd_ready_set = rd_ready_i; // read finished
-wire rd_ready_clr = rd_en; // read start
-wire rd_ready_ena  = rd_ready_set | rd_ready_clr;
-wire rd_ready_next = rd_ready_set | (~rd_ready_clr);
-usbf_gnrl_dfflrd #(1, 1'b1) 
-    rd_ready_difflrd(
-        rd_ready_ena,rd_ready_next,
-        rd_ready_r,
+wire wait_r; // default 0
+wire wait_set = (wt_en | rd_en) & (~ack_w); // FIFO access start
+wire wait_clr = ack_w;
+wire wait_ena  = wait_set | wait_clr;
+wire wait_next = wait_set | (~wait_clr);
+usbf_gnrl_dfflrd #(1, 1'b0) 
+    wait_difflrd(
+        wait_ena,wait_next,
+        wait_r,
         hclk_i,hrstn_i
     );
 
-assign hready_o = wt_ready_r & rd_ready_r;
+assign hready_o = ~(wait_set | (wait_r & (~ack_w)));
 assign hresp_o = 2'b0;
 
 //-----------------------------------------------------------------
 // data and addr
 //-----------------------------------------------------------------
-// reg addr
-wire addr_ena = wt_en | rd_en;
-wire [32-1:0] addr_next = haddr_i;
-wire [32-1:0] addr_r;
-usbf_gnrl_dfflrd #(32, 32'b0)
-    addr_dfflrd(
-        addr_ena, addr_next,
-        addr_r,
-        hclk_i,hrstn_i
-    );
-
-assign addr_o = (wt_en | rd_en) ? haddr_i : addr_r;
+assign addr_o = addr_r;
 assign wdata_o = hwdata_i;
 assign hrdata_o = rdata_i;
 
 //-----------------------------------------------------------------
 // enable_o 
 //-----------------------------------------------------------------
-assign enable_o = hsel_i;
-`endif // USB_ITF_AHB
+assign enable_o = dp_wt_r | dp_rd_r;
+
+// ICB unused
+assign icb_cmd_ready_o = 1'b0;
+assign icb_rsp_valid_o = 1'b0;
+assign icb_rsp_rdata_o = 32'b0;
+end // ahb
 
 //===================================================================================
-`ifdef USB_ITF_ICB
+else begin : icb
 //-----------------------------------------------------------------
 // write and read enable
 //-----------------------------------------------------------------
@@ -145,33 +177,77 @@ assign rd_en_o = rd_en;
 
 //-----------------------------------------------------------------
 // handshake
+// Commands are accepted back-to-back while the response buffer has
+// space, responses return in order. A FIFO access holds the next 
+// command until the CDC finished.
 //-----------------------------------------------------------------
-wire wt_ready_r; // default 0
-wire wt_ready_set = wt_ready_i; // write finished
-wire wt_ready_clr = icb_rsp_ready_i; // RSP finished
-wire wt_ready_ena  = wt_ready_set | wt_ready_clr;
-wire wt_ready_next = wt_ready_set | (~wt_ready_clr);
+wire ack_w = wt_ready_i | rd_ready_i; // access finished
+
+wire wait_r; // default 0
+wire wait_set = (wt_en | rd_en) & (~ack_w); // FIFO access start
+wire wait_clr = ack_w;
+wire wait_ena  = wait_set | wait_clr;
+wire wait_next = wait_set | (~wait_clr);
 usbf_gnrl_dfflrd #(1, 1'b0) 
-    wt_ready_difflrd(
-        wt_ready_ena,wt_ready_next,
-        wt_ready_r,
+    wait_difflrd(
+        wait_ena,wait_next,
+        wait_r,
+        hclk_i,hrstn_i
+    );
+
+//-----------------------------------------------------------------
+// response buffer, 2 entries
+//-----------------------------------------------------------------
+wire rsp_push = ack_w;
+wire rsp_pop  = icb_rsp_valid_o & icb_rsp_ready_i;
+
+wire [1:0] rsp_cnt_r;
+wire rsp_cnt_ena = rsp_push ^ rsp_pop;
+wire [1:0] rsp_cnt_next = rsp_push ? (rsp_cnt_r + 2'd1) : (rsp_cnt_r - 2'd1);
+usbf_gnrl_dfflrd #(2, 2'b0) 
+    rsp_cnt_difflrd(
+        rsp_cnt_ena,rsp_cnt_next,
+        rsp_cnt_r,
         hclk_i,hrstn_i
     );
 
-wire rd_ready_r; // default 0
-wire rd_ready_set = rd_ready_i; // read finished
-wire rd_ready_clr = icb_rsp_ready_i; // RSP finished
-wire rd_ready_ena  = rd_ready_set | rd_ready_clr;
-wire rd_ready_next = rd_ready_set | (~rd_ready_clr);
+wire rsp_wptr_r;
+wire rsp_wptr_next = ~rsp_wptr_r;
 usbf_gnrl_dfflrd #(1, 1'b0) 
-    rd_ready_difflrd(
-        rd_ready_ena,rd_ready_next,
-        rd_ready_r,
+    rsp_wptr_difflrd(
+        rsp_push,rsp_wptr_next,
+        rsp_wptr_r,
         hclk_i,hrstn_i
     );
-assign icb_cmd_ready_o = icb_cmd_valid_i;
-assign icb_rsp_valid_o = wt_ready_r | rd_ready_r;
-// assign icb_rsp_valid_o = icb_rsp_ready_i;
+
+wire rsp_rptr_r;
+wire rsp_rptr_next = ~rsp_rptr_r;
+usbf_gnrl_dfflrd #(1, 1'b0) 
+    rsp_rptr_difflrd(
+        rsp_pop,rsp_rptr_next,
+        rsp_rptr_r,
+        hclk_i,hrstn_i
+    );
+
+wire [32-1:0] rsp_data0_r;
+usbf_gnrl_dfflrd #(32, 32'b0) 
+    rsp_data0_difflrd(
+        rsp_push & (~rsp_wptr_r),rdata_i,
+        rsp_data0_r,
+        hclk_i,hrstn_i
+    );
+
+wire [32-1:0] rsp_data1_r;
+usbf_gnrl_dfflrd #(32, 32'b0) 
+    rsp_data1_difflrd(
+        rsp_push & rsp_wptr_r,rdata_i,
+        rsp_data1_r,
+        hclk_i,hrstn_i
+    );
+
+assign icb_cmd_ready_o = (~wait_r) & (rsp_cnt_r != 2'd2);
+assign icb_rsp_valid_o = (rsp_cnt_r != 2'd0);
+assign icb_rsp_rdata_o = rsp_rptr_r ? rsp_data1_r : rsp_data0_r;
 
 //-----------------------------------------------------------------
 // data and addr
@@ -198,12 +274,17 @@ usbf_gnrl_dfflrd #(32, 32'b0)
 
 assign addr_o = icb_cmd_hsked ? icb_cmd_addr_i : addr_r;
 assign wdata_o = icb_cmd_hsked ? icb_cmd_wdata_i : wdata_r;
-assign icb_rsp_rdata_o = rdata_i;
 
 //-----------------------------------------------------------------
 // enable_o 
 //-----------------------------------------------------------------
-assign enable_o = addr_o[31:12] == `USB_BASE_ADDR_31_12;
-`endif // USB_ITF_ICB
+assign enable_o = addr_o[31:12] == BASE_ADDR_31_12;
+
+// AHB unused
+assign hready_o = 1'b1;
+assign hresp_o  = 2'b0;
+assign hrdata_o = 32'b0;
+end // icb
+endgenerate
 
 endmodule
\ No newline at end of file
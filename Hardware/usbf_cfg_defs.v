@@ -14,12 +14,19 @@
 // .Added defines
 //=================================================================
 
+//-----------------------------------------------------------------
+// The defines below are the default values of the parameters of
+// top_usb_device (ITF_ICB, BASE_ADDR_31_12, REG_FIFO, FIFO_ADDR_W,
+// EP_NUM). Each instance can override them, so controllers with 
+// different configurations can be integrated in one SoC.
+//-----------------------------------------------------------------
+
 //-----------------------------------------------------------------
 // USB_ITF_AHB
 // define  : AHB slave interface
 // undefine: Others
 // warning : USB_ITF_AHB or USB_ITF_ICB must define one.
-// Do not surpport burst transfer and back-to-back
+// Pipelined transfers, zero wait state except the endpoint DATA FIFOs
 //-----------------------------------------------------------------
 `define USB_ITF_AHB
 
@@ -31,11 +38,16 @@
 //-----------------------------------------------------------------
 // `define USB_ITF_ICB
 
+// default of parameter ITF_ICB, 0: AHB, 1: ICB
 `ifdef USB_ITF_ICB
-    // must define USB BASE ADDR
-    `define USB_BASE_ADDR_31_12 20'h10042 
+    `define USB_ITF_ICB_DEFAULT 1
+`else
+    `define USB_ITF_ICB_DEFAULT 0
 `endif
 
+// USB BASE ADDR, only used by ICB
+`define USB_BASE_ADDR_31_12 20'h10042 
+
 //-----------------------------------------------------------------
 // USB_REG_FIFO
 // define  : usbf_fifo uses ram by reg
@@ -43,6 +55,19 @@
 //-----------------------------------------------------------------
 `define USB_REG_FIFO
 
+// default of parameter REG_FIFO
+`ifdef USB_REG_FIFO
+    `define USB_REG_FIFO_DEFAULT 1
+`else
+    `define USB_REG_FIFO_DEFAULT 0
+`endif
+
+//-----------------------------------------------------------------
+// USB_FIFO_ADDR_W: each EP FIFO has 2^USB_FIFO_ADDR_W bytes; above
+// 10 the 11-bit levels of USB_EPi_LEVEL saturate at 2047
+//-----------------------------------------------------------------
+`define USB_FIFO_ADDR_W 6
+
 //-----------------------------------------------------------------
 // USB_EP_NUM: number of endpoints
 //-----------------------------------------------------------------
@@ -54,11 +79,30 @@
 //-----------------------------------------------------------------
 `define USB_EP_STRIDE  'h20
 
+//-----------------------------------------------------------------
+// USB_TRACE
+// define  : on-chip protocol trace buffer at 0x300
+// undefine: no trace logic at all
+//-----------------------------------------------------------------
+// `define USB_TRACE
+
+`ifdef USB_TRACE
+    // trace buffer depth is 2^USB_TRACE_DEPTH_W records
+    `define USB_TRACE_DEPTH_W 6
+`endif
+
 //-----------------------------------------------------------------
 //                             GLOBAL
 //-----------------------------------------------------------------
 `define USB_FUNC_CTRL    8'h0
 
+    `define USB_FUNC_CTRL_INT_EN_PRESOF      10
+    `define USB_FUNC_CTRL_INT_EN_PRESOF_DEFAULT    0
+    `define USB_FUNC_CTRL_INT_EN_PRESOF_B          10
+    `define USB_FUNC_CTRL_INT_EN_PRESOF_T          10
+    `define USB_FUNC_CTRL_INT_EN_PRESOF_W          1
+    `define USB_FUNC_CTRL_INT_EN_PRESOF_R          10:10
+
     `define USB_FUNC_CTRL_INT_EN_RST      9
     `define USB_FUNC_CTRL_INT_EN_RST_DEFAULT    0
     `define USB_FUNC_CTRL_INT_EN_RST_B          9
@@ -115,6 +159,20 @@
 
 `define USB_FUNC_STAT    8'h4
 
+    `define USB_FUNC_STAT_SOF_LOCK      16
+    `define USB_FUNC_STAT_SOF_LOCK_DEFAULT    0
+    `define USB_FUNC_STAT_SOF_LOCK_B          16
+    `define USB_FUNC_STAT_SOF_LOCK_T          16
+    `define USB_FUNC_STAT_SOF_LOCK_W          1
+    `define USB_FUNC_STAT_SOF_LOCK_R          16:16
+
+    `define USB_FUNC_STAT_PRESOF      15
+    `define USB_FUNC_STAT_PRESOF_DEFAULT    0
+    `define USB_FUNC_STAT_PRESOF_B          15
+    `define USB_FUNC_STAT_PRESOF_T          15
+    `define USB_FUNC_STAT_PRESOF_W          1
+    `define USB_FUNC_STAT_PRESOF_R          15:15
+
     `define USB_FUNC_STAT_SOF      14
     `define USB_FUNC_STAT_SOF_DEFAULT    0
     `define USB_FUNC_STAT_SOF_B          14
@@ -209,11 +267,180 @@
     `define USB_EP_INTSTS_EP3_TX_COMPLETE_W            1
     `define USB_EP_INTSTS_EP3_TX_COMPLETE_R            19:19
 
+//-----------------------------------------------------------------
+// USB_EP_NAKSTS
+//-----------------------------------------------------------------
+`define USB_EP_NAKSTS    8'h10
+
+    //--------------------------------------------------
+    // bit[15:0] -> IN_NAK EP 0-15
+    //--------------------------------------------------
+
+    `define USB_EP_NAKSTS_EP0_IN_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP0_IN_NAK_B          0
+    `define USB_EP_NAKSTS_EP0_IN_NAK_T          0
+    `define USB_EP_NAKSTS_EP0_IN_NAK_W          1
+    `define USB_EP_NAKSTS_EP0_IN_NAK_R          0:0
+
+    `define USB_EP_NAKSTS_EP1_IN_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP1_IN_NAK_B          1
+    `define USB_EP_NAKSTS_EP1_IN_NAK_T          1
+    `define USB_EP_NAKSTS_EP1_IN_NAK_W          1
+    `define USB_EP_NAKSTS_EP1_IN_NAK_R          1:1
+
+    `define USB_EP_NAKSTS_EP2_IN_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP2_IN_NAK_B          2
+    `define USB_EP_NAKSTS_EP2_IN_NAK_T          2
+    `define USB_EP_NAKSTS_EP2_IN_NAK_W          1
+    `define USB_EP_NAKSTS_EP2_IN_NAK_R          2:2
+
+    `define USB_EP_NAKSTS_EP3_IN_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP3_IN_NAK_B          3
+    `define USB_EP_NAKSTS_EP3_IN_NAK_T          3
+    `define USB_EP_NAKSTS_EP3_IN_NAK_W          1
+    `define USB_EP_NAKSTS_EP3_IN_NAK_R          3:3
+
+    //--------------------------------------------------
+    // bit[31:16] -> OUT_NAK: 16-31
+    //--------------------------------------------------
+    `define USB_EP_NAKSTS_EP0_OUT_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP0_OUT_NAK_B          16
+    `define USB_EP_NAKSTS_EP0_OUT_NAK_T          16
+    `define USB_EP_NAKSTS_EP0_OUT_NAK_W          1
+    `define USB_EP_NAKSTS_EP0_OUT_NAK_R          16:16
+
+    `define USB_EP_NAKSTS_EP1_OUT_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP1_OUT_NAK_B          17
+    `define USB_EP_NAKSTS_EP1_OUT_NAK_T          17
+    `define USB_EP_NAKSTS_EP1_OUT_NAK_W          1
+    `define USB_EP_NAKSTS_EP1_OUT_NAK_R          17:17
+
+    `define USB_EP_NAKSTS_EP2_OUT_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP2_OUT_NAK_B          18
+    `define USB_EP_NAKSTS_EP2_OUT_NAK_T          18
+    `define USB_EP_NAKSTS_EP2_OUT_NAK_W          1
+    `define USB_EP_NAKSTS_EP2_OUT_NAK_R          18:18
+
+    `define USB_EP_NAKSTS_EP3_OUT_NAK_DEFAULT    0
+    `define USB_EP_NAKSTS_EP3_OUT_NAK_B          19
+    `define USB_EP_NAKSTS_EP3_OUT_NAK_T          19
+    `define USB_EP_NAKSTS_EP3_OUT_NAK_W          1
+    `define USB_EP_NAKSTS_EP3_OUT_NAK_R          19:19
+
+//-----------------------------------------------------------------
+// USB_NAK_CTRL
+//-----------------------------------------------------------------
+`define USB_NAK_CTRL    8'h14
+
+    // NAK event hold-off time in phy clocks (100us @ 60MHz)
+    `define USB_NAK_CTRL_HOLDOFF_DEFAULT    16'd6000
+    `define USB_NAK_CTRL_HOLDOFF_B          0
+    `define USB_NAK_CTRL_HOLDOFF_T          15
+    `define USB_NAK_CTRL_HOLDOFF_W          16
+    `define USB_NAK_CTRL_HOLDOFF_R          15:0
+
+//-----------------------------------------------------------------
+// USB_SOF_CTRL
+//-----------------------------------------------------------------
+`define USB_SOF_CTRL    8'h18
+
+    // pre-SOF lead time in phy clocks
+    `define USB_SOF_CTRL_PRESOF_LEAD_DEFAULT    0
+    `define USB_SOF_CTRL_PRESOF_LEAD_B          16
+    `define USB_SOF_CTRL_PRESOF_LEAD_T          31
+    `define USB_SOF_CTRL_PRESOF_LEAD_W          16
+    `define USB_SOF_CTRL_PRESOF_LEAD_R          31:16
+
+    // average the SOF period over 2^MEAS_WIN frames
+    `define USB_SOF_CTRL_MEAS_WIN_DEFAULT    4'd3
+    `define USB_SOF_CTRL_MEAS_WIN_B          8
+    `define USB_SOF_CTRL_MEAS_WIN_T          11
+    `define USB_SOF_CTRL_MEAS_WIN_W          4
+    `define USB_SOF_CTRL_MEAS_WIN_R          11:8
+
+    // SOF interrupt every (SOF_DIV+1) frames
+    `define USB_SOF_CTRL_SOF_DIV_DEFAULT    0
+    `define USB_SOF_CTRL_SOF_DIV_B          0
+    `define USB_SOF_CTRL_SOF_DIV_T          7
+    `define USB_SOF_CTRL_SOF_DIV_W          8
+    `define USB_SOF_CTRL_SOF_DIV_R          7:0
+
+//-----------------------------------------------------------------
+// USB_SOF_PERIOD
+//-----------------------------------------------------------------
+`define USB_SOF_PERIOD    8'h1C
+
+    // average SOF period in phy clocks, 16.16 fixed point
+    `define USB_SOF_PERIOD_PERIOD_DEFAULT    0
+    `define USB_SOF_PERIOD_PERIOD_B          0
+    `define USB_SOF_PERIOD_PERIOD_T          31
+    `define USB_SOF_PERIOD_PERIOD_W          32
+    `define USB_SOF_PERIOD_PERIOD_R          31:0
+
 //-----------------------------------------------------------------
 //                              EP0
 //-----------------------------------------------------------------
 `define USB_EP0_CFG    8'h20
 
+    // fold the bytes read from DATA into USB_EP0_CRC
+    `define USB_EP0_CFG_CRC_EN      14
+    `define USB_EP0_CFG_CRC_EN_DEFAULT    0
+    `define USB_EP0_CFG_CRC_EN_B          14
+    `define USB_EP0_CFG_CRC_EN_T          14
+    `define USB_EP0_CFG_CRC_EN_W          1
+    `define USB_EP0_CFG_CRC_EN_R          14:14
+
+    // level interrupts, see USB_EP_LVLSTS
+    `define USB_EP0_CFG_INT_RX_LVL      13
+    `define USB_EP0_CFG_INT_RX_LVL_DEFAULT    0
+    `define USB_EP0_CFG_INT_RX_LVL_B          13
+    `define USB_EP0_CFG_INT_RX_LVL_T          13
+    `define USB_EP0_CFG_INT_RX_LVL_W          1
+    `define USB_EP0_CFG_INT_RX_LVL_R          13:13
+
+    `define USB_EP0_CFG_INT_TX_LVL      12
+    `define USB_EP0_CFG_INT_TX_LVL_DEFAULT    0
+    `define USB_EP0_CFG_INT_TX_LVL_B          12
+    `define USB_EP0_CFG_INT_TX_LVL_T          12
+    `define USB_EP0_CFG_INT_TX_LVL_W          1
+    `define USB_EP0_CFG_INT_TX_LVL_R          12:12
+
+    // loopback: OUT data of this EP is sent on IN EP LOOPBACK_EP
+    `define USB_EP0_CFG_LOOPBACK_EP_DEFAULT    0
+    `define USB_EP0_CFG_LOOPBACK_EP_B          8
+    `define USB_EP0_CFG_LOOPBACK_EP_T          11
+    `define USB_EP0_CFG_LOOPBACK_EP_W          4
+    `define USB_EP0_CFG_LOOPBACK_EP_R          11:8
+
+    // auto-accept: re-armed when RX_COUNT bytes are read
+    `define USB_EP0_CFG_AUTO_ACCEPT      7
+    `define USB_EP0_CFG_AUTO_ACCEPT_DEFAULT    0
+    `define USB_EP0_CFG_AUTO_ACCEPT_B          7
+    `define USB_EP0_CFG_AUTO_ACCEPT_T          7
+    `define USB_EP0_CFG_AUTO_ACCEPT_W          1
+    `define USB_EP0_CFG_AUTO_ACCEPT_R          7:7
+
+    `define USB_EP0_CFG_LOOPBACK_EN      6
+    `define USB_EP0_CFG_LOOPBACK_EN_DEFAULT    0
+    `define USB_EP0_CFG_LOOPBACK_EN_B          6
+    `define USB_EP0_CFG_LOOPBACK_EN_T          6
+    `define USB_EP0_CFG_LOOPBACK_EN_W          1
+    `define USB_EP0_CFG_LOOPBACK_EN_R          6:6
+
+    `define USB_EP0_CFG_INT_OUT_NAK      5
+    `define USB_EP0_CFG_INT_OUT_NAK_DEFAULT    0
+    `define USB_EP0_CFG_INT_OUT_NAK_B          5
+    `define USB_EP0_CFG_INT_OUT_NAK_T          5
+    `define USB_EP0_CFG_INT_OUT_NAK_W          1
+    `define USB_EP0_CFG_INT_OUT_NAK_R          5:5
+
+    `define USB_EP0_CFG_INT_IN_NAK      4
+    `define USB_EP0_CFG_INT_IN_NAK_DEFAULT    0
+    `define USB_EP0_CFG_INT_IN_NAK_B          4
+    `define USB_EP0_CFG_INT_IN_NAK_T          4
+    `define USB_EP0_CFG_INT_IN_NAK_W          1
+    `define USB_EP0_CFG_INT_IN_NAK_R          4:4
+
     `define USB_EP0_CFG_INT_RX      3
     `define USB_EP0_CFG_INT_RX_DEFAULT    0
     `define USB_EP0_CFG_INT_RX_B          3
@@ -244,6 +471,14 @@
 
 `define USB_EP0_TX_CTRL    8'h24
 
+    // IN tokens are NAKed until the TX FIFO holds min(TX_LEN, TX_MIN)
+    // bytes, 0 sends at once
+    `define USB_EP0_TX_CTRL_TX_MIN_DEFAULT    0
+    `define USB_EP0_TX_CTRL_TX_MIN_B          18
+    `define USB_EP0_TX_CTRL_TX_MIN_T          28
+    `define USB_EP0_TX_CTRL_TX_MIN_W          11
+    `define USB_EP0_TX_CTRL_TX_MIN_R          28:18
+
     `define USB_EP0_TX_CTRL_TX_FLUSH      17
     `define USB_EP0_TX_CTRL_TX_FLUSH_DEFAULT    0
     `define USB_EP0_TX_CTRL_TX_FLUSH_B          17
@@ -331,6 +566,46 @@
     `define USB_EP0_DATA_DATA_W          8
     `define USB_EP0_DATA_DATA_R          7:0
 
+`define USB_EP0_LEVEL    8'h34
+
+    // fill level of the FIFOs in bytes
+    `define USB_EP0_LEVEL_TX_LEVEL_DEFAULT    0
+    `define USB_EP0_LEVEL_TX_LEVEL_B          16
+    `define USB_EP0_LEVEL_TX_LEVEL_T          26
+    `define USB_EP0_LEVEL_TX_LEVEL_W          11
+    `define USB_EP0_LEVEL_TX_LEVEL_R          26:16
+
+    `define USB_EP0_LEVEL_RX_LEVEL_DEFAULT    0
+    `define USB_EP0_LEVEL_RX_LEVEL_B          0
+    `define USB_EP0_LEVEL_RX_LEVEL_T          10
+    `define USB_EP0_LEVEL_RX_LEVEL_W          11
+    `define USB_EP0_LEVEL_RX_LEVEL_R          10:0
+
+`define USB_EP0_THR    8'h38
+
+    // TX_LVL is set when TX_LEVEL falls below TX_THR
+    `define USB_EP0_THR_TX_THR_DEFAULT    0
+    `define USB_EP0_THR_TX_THR_B          16
+    `define USB_EP0_THR_TX_THR_T          26
+    `define USB_EP0_THR_TX_THR_W          11
+    `define USB_EP0_THR_TX_THR_R          26:16
+
+    // RX_LVL is set when RX_LEVEL rises above RX_THR
+    `define USB_EP0_THR_RX_THR_DEFAULT    0
+    `define USB_EP0_THR_RX_THR_B          0
+    `define USB_EP0_THR_RX_THR_T          10
+    `define USB_EP0_THR_RX_THR_W          11
+    `define USB_EP0_THR_RX_THR_R          10:0
+
+`define USB_EP0_CRC    8'h3c
+
+    // write: seed, read: current value, the CRC-32 result is ~CRC
+    `define USB_EP0_CRC_CRC_DEFAULT    32'hFFFFFFFF
+    `define USB_EP0_CRC_CRC_B          0
+    `define USB_EP0_CRC_CRC_T          31
+    `define USB_EP0_CRC_CRC_W          32
+    `define USB_EP0_CRC_CRC_R          31:0
+
 
 
 //-----------------------------------------------------------------
@@ -338,6 +613,65 @@
 //-----------------------------------------------------------------
 `define USB_EP1_CFG    8'h40
 
+    // fold the bytes read from DATA into USB_EP1_CRC
+    `define USB_EP1_CFG_CRC_EN      14
+    `define USB_EP1_CFG_CRC_EN_DEFAULT    0
+    `define USB_EP1_CFG_CRC_EN_B          14
+    `define USB_EP1_CFG_CRC_EN_T          14
+    `define USB_EP1_CFG_CRC_EN_W          1
+    `define USB_EP1_CFG_CRC_EN_R          14:14
+
+    // level interrupts, see USB_EP_LVLSTS
+    `define USB_EP1_CFG_INT_RX_LVL      13
+    `define USB_EP1_CFG_INT_RX_LVL_DEFAULT    0
+    `define USB_EP1_CFG_INT_RX_LVL_B          13
+    `define USB_EP1_CFG_INT_RX_LVL_T          13
+    `define USB_EP1_CFG_INT_RX_LVL_W          1
+    `define USB_EP1_CFG_INT_RX_LVL_R          13:13
+
+    `define USB_EP1_CFG_INT_TX_LVL      12
+    `define USB_EP1_CFG_INT_TX_LVL_DEFAULT    0
+    `define USB_EP1_CFG_INT_TX_LVL_B          12
+    `define USB_EP1_CFG_INT_TX_LVL_T          12
+    `define USB_EP1_CFG_INT_TX_LVL_W          1
+    `define USB_EP1_CFG_INT_TX_LVL_R          12:12
+
+    // loopback: OUT data of this EP is sent on IN EP LOOPBACK_EP
+    `define USB_EP1_CFG_LOOPBACK_EP_DEFAULT    0
+    `define USB_EP1_CFG_LOOPBACK_EP_B          8
+    `define USB_EP1_CFG_LOOPBACK_EP_T          11
+    `define USB_EP1_CFG_LOOPBACK_EP_W          4
+    `define USB_EP1_CFG_LOOPBACK_EP_R          11:8
+
+    // auto-accept: re-armed when RX_COUNT bytes are read
+    `define USB_EP1_CFG_AUTO_ACCEPT      7
+    `define USB_EP1_CFG_AUTO_ACCEPT_DEFAULT    0
+    `define USB_EP1_CFG_AUTO_ACCEPT_B          7
+    `define USB_EP1_CFG_AUTO_ACCEPT_T          7
+    `define USB_EP1_CFG_AUTO_ACCEPT_W          1
+    `define USB_EP1_CFG_AUTO_ACCEPT_R          7:7
+
+    `define USB_EP1_CFG_LOOPBACK_EN      6
+    `define USB_EP1_CFG_LOOPBACK_EN_DEFAULT    0
+    `define USB_EP1_CFG_LOOPBACK_EN_B          6
+    `define USB_EP1_CFG_LOOPBACK_EN_T          6
+    `define USB_EP1_CFG_LOOPBACK_EN_W          1
+    `define USB_EP1_CFG_LOOPBACK_EN_R          6:6
+
+    `define USB_EP1_CFG_INT_OUT_NAK      5
+    `define USB_EP1_CFG_INT_OUT_NAK_DEFAULT    0
+    `define USB_EP1_CFG_INT_OUT_NAK_B          5
+    `define USB_EP1_CFG_INT_OUT_NAK_T          5
+    `define USB_EP1_CFG_INT_OUT_NAK_W          1
+    `define USB_EP1_CFG_INT_OUT_NAK_R          5:5
+
+    `define USB_EP1_CFG_INT_IN_NAK      4
+    `define USB_EP1_CFG_INT_IN_NAK_DEFAULT    0
+    `define USB_EP1_CFG_INT_IN_NAK_B          4
+    `define USB_EP1_CFG_INT_IN_NAK_T          4
+    `define USB_EP1_CFG_INT_IN_NAK_W          1
+    `define USB_EP1_CFG_INT_IN_NAK_R          4:4
+
     `define USB_EP1_CFG_INT_RX      3
     `define USB_EP1_CFG_INT_RX_DEFAULT    0
     `define USB_EP1_CFG_INT_RX_B          3
@@ -368,6 +702,14 @@
 
 `define USB_EP1_TX_CTRL    8'h44
 
+    // IN tokens are NAKed until the TX FIFO holds min(TX_LEN, TX_MIN)
+    // bytes, 0 sends at once
+    `define USB_EP1_TX_CTRL_TX_MIN_DEFAULT    0
+    `define USB_EP1_TX_CTRL_TX_MIN_B          18
+    `define USB_EP1_TX_CTRL_TX_MIN_T          28
+    `define USB_EP1_TX_CTRL_TX_MIN_W          11
+    `define USB_EP1_TX_CTRL_TX_MIN_R          28:18
+
     `define USB_EP1_TX_CTRL_TX_FLUSH      17
     `define USB_EP1_TX_CTRL_TX_FLUSH_DEFAULT    0
     `define USB_EP1_TX_CTRL_TX_FLUSH_B          17
@@ -455,6 +797,46 @@
     `define USB_EP1_DATA_DATA_W          8
     `define USB_EP1_DATA_DATA_R          7:0
 
+`define USB_EP1_LEVEL    8'h54
+
+    // fill level of the FIFOs in bytes
+    `define USB_EP1_LEVEL_TX_LEVEL_DEFAULT    0
+    `define USB_EP1_LEVEL_TX_LEVEL_B          16
+    `define USB_EP1_LEVEL_TX_LEVEL_T          26
+    `define USB_EP1_LEVEL_TX_LEVEL_W          11
+    `define USB_EP1_LEVEL_TX_LEVEL_R          26:16
+
+    `define USB_EP1_LEVEL_RX_LEVEL_DEFAULT    0
+    `define USB_EP1_LEVEL_RX_LEVEL_B          0
+    `define USB_EP1_LEVEL_RX_LEVEL_T          10
+    `define USB_EP1_LEVEL_RX_LEVEL_W          11
+    `define USB_EP1_LEVEL_RX_LEVEL_R          10:0
+
+`define USB_EP1_THR    8'h58
+
+    // TX_LVL is set when TX_LEVEL falls below TX_THR
+    `define USB_EP1_THR_TX_THR_DEFAULT    0
+    `define USB_EP1_THR_TX_THR_B          16
+    `define USB_EP1_THR_TX_THR_T          26
+    `define USB_EP1_THR_TX_THR_W          11
+    `define USB_EP1_THR_TX_THR_R          26:16
+
+    // RX_LVL is set when RX_LEVEL rises above RX_THR
+    `define USB_EP1_THR_RX_THR_DEFAULT    0
+    `define USB_EP1_THR_RX_THR_B          0
+    `define USB_EP1_THR_RX_THR_T          10
+    `define USB_EP1_THR_RX_THR_W          11
+    `define USB_EP1_THR_RX_THR_R          10:0
+
+`define USB_EP1_CRC    8'h5c
+
+    // write: seed, read: current value, the CRC-32 result is ~CRC
+    `define USB_EP1_CRC_CRC_DEFAULT    32'hFFFFFFFF
+    `define USB_EP1_CRC_CRC_B          0
+    `define USB_EP1_CRC_CRC_T          31
+    `define USB_EP1_CRC_CRC_W          32
+    `define USB_EP1_CRC_CRC_R          31:0
+
 
 
 //-----------------------------------------------------------------
@@ -462,6 +844,65 @@
 //-----------------------------------------------------------------
 `define USB_EP2_CFG    8'h60
 
+    // fold the bytes read from DATA into USB_EP2_CRC
+    `define USB_EP2_CFG_CRC_EN      14
+    `define USB_EP2_CFG_CRC_EN_DEFAULT    0
+    `define USB_EP2_CFG_CRC_EN_B          14
+    `define USB_EP2_CFG_CRC_EN_T          14
+    `define USB_EP2_CFG_CRC_EN_W          1
+    `define USB_EP2_CFG_CRC_EN_R          14:14
+
+    // level interrupts, see USB_EP_LVLSTS
+    `define USB_EP2_CFG_INT_RX_LVL      13
+    `define USB_EP2_CFG_INT_RX_LVL_DEFAULT    0
+    `define USB_EP2_CFG_INT_RX_LVL_B          13
+    `define USB_EP2_CFG_INT_RX_LVL_T          13
+    `define USB_EP2_CFG_INT_RX_LVL_W          1
+    `define USB_EP2_CFG_INT_RX_LVL_R          13:13
+
+    `define USB_EP2_CFG_INT_TX_LVL      12
+    `define USB_EP2_CFG_INT_TX_LVL_DEFAULT    0
+    `define USB_EP2_CFG_INT_TX_LVL_B          12
+    `define USB_EP2_CFG_INT_TX_LVL_T          12
+    `define USB_EP2_CFG_INT_TX_LVL_W          1
+    `define USB_EP2_CFG_INT_TX_LVL_R          12:12
+
+    // loopback: OUT data of this EP is sent on IN EP LOOPBACK_EP
+    `define USB_EP2_CFG_LOOPBACK_EP_DEFAULT    0
+    `define USB_EP2_CFG_LOOPBACK_EP_B          8
+    `define USB_EP2_CFG_LOOPBACK_EP_T          11
+    `define USB_EP2_CFG_LOOPBACK_EP_W          4
+    `define USB_EP2_CFG_LOOPBACK_EP_R          11:8
+
+    // auto-accept: re-armed when RX_COUNT bytes are read
+    `define USB_EP2_CFG_AUTO_ACCEPT      7
+    `define USB_EP2_CFG_AUTO_ACCEPT_DEFAULT    0
+    `define USB_EP2_CFG_AUTO_ACCEPT_B          7
+    `define USB_EP2_CFG_AUTO_ACCEPT_T          7
+    `define USB_EP2_CFG_AUTO_ACCEPT_W          1
+    `define USB_EP2_CFG_AUTO_ACCEPT_R          7:7
+
+    `define USB_EP2_CFG_LOOPBACK_EN      6
+    `define USB_EP2_CFG_LOOPBACK_EN_DEFAULT    0
+    `define USB_EP2_CFG_LOOPBACK_EN_B          6
+    `define USB_EP2_CFG_LOOPBACK_EN_T          6
+    `define USB_EP2_CFG_LOOPBACK_EN_W          1
+    `define USB_EP2_CFG_LOOPBACK_EN_R          6:6
+
+    `define USB_EP2_CFG_INT_OUT_NAK      5
+    `define USB_EP2_CFG_INT_OUT_NAK_DEFAULT    0
+    `define USB_EP2_CFG_INT_OUT_NAK_B          5
+    `define USB_EP2_CFG_INT_OUT_NAK_T          5
+    `define USB_EP2_CFG_INT_OUT_NAK_W          1
+    `define USB_EP2_CFG_INT_OUT_NAK_R          5:5
+
+    `define USB_EP2_CFG_INT_IN_NAK      4
+    `define USB_EP2_CFG_INT_IN_NAK_DEFAULT    0
+    `define USB_EP2_CFG_INT_IN_NAK_B          4
+    `define USB_EP2_CFG_INT_IN_NAK_T          4
+    `define USB_EP2_CFG_INT_IN_NAK_W          1
+    `define USB_EP2_CFG_INT_IN_NAK_R          4:4
+
     `define USB_EP2_CFG_INT_RX      3
     `define USB_EP2_CFG_INT_RX_DEFAULT    0
     `define USB_EP2_CFG_INT_RX_B          3
@@ -492,6 +933,14 @@
 
 `define USB_EP2_TX_CTRL    8'h64
 
+    // IN tokens are NAKed until the TX FIFO holds min(TX_LEN, TX_MIN)
+    // bytes, 0 sends at once
+    `define USB_EP2_TX_CTRL_TX_MIN_DEFAULT    0
+    `define USB_EP2_TX_CTRL_TX_MIN_B          18
+    `define USB_EP2_TX_CTRL_TX_MIN_T          28
+    `define USB_EP2_TX_CTRL_TX_MIN_W          11
+    `define USB_EP2_TX_CTRL_TX_MIN_R          28:18
+
     `define USB_EP2_TX_CTRL_TX_FLUSH      17
     `define USB_EP2_TX_CTRL_TX_FLUSH_DEFAULT    0
     `define USB_EP2_TX_CTRL_TX_FLUSH_B          17
@@ -579,11 +1028,110 @@
     `define USB_EP2_DATA_DATA_W          8
     `define USB_EP2_DATA_DATA_R          7:0
 
+`define USB_EP2_LEVEL    8'h74
+
+    // fill level of the FIFOs in bytes
+    `define USB_EP2_LEVEL_TX_LEVEL_DEFAULT    0
+    `define USB_EP2_LEVEL_TX_LEVEL_B          16
+    `define USB_EP2_LEVEL_TX_LEVEL_T          26
+    `define USB_EP2_LEVEL_TX_LEVEL_W          11
+    `define USB_EP2_LEVEL_TX_LEVEL_R          26:16
+
+    `define USB_EP2_LEVEL_RX_LEVEL_DEFAULT    0
+    `define USB_EP2_LEVEL_RX_LEVEL_B          0
+    `define USB_EP2_LEVEL_RX_LEVEL_T          10
+    `define USB_EP2_LEVEL_RX_LEVEL_W          11
+    `define USB_EP2_LEVEL_RX_LEVEL_R          10:0
+
+`define USB_EP2_THR    8'h78
+
+    // TX_LVL is set when TX_LEVEL falls below TX_THR
+    `define USB_EP2_THR_TX_THR_DEFAULT    0
+    `define USB_EP2_THR_TX_THR_B          16
+    `define USB_EP2_THR_TX_THR_T          26
+    `define USB_EP2_THR_TX_THR_W          11
+    `define USB_EP2_THR_TX_THR_R          26:16
+
+    // RX_LVL is set when RX_LEVEL rises above RX_THR
+    `define USB_EP2_THR_RX_THR_DEFAULT    0
+    `define USB_EP2_THR_RX_THR_B          0
+    `define USB_EP2_THR_RX_THR_T          10
+    `define USB_EP2_THR_RX_THR_W          11
+    `define USB_EP2_THR_RX_THR_R          10:0
+
+`define USB_EP2_CRC    8'h7c
+
+    // write: seed, read: current value, the CRC-32 result is ~CRC
+    `define USB_EP2_CRC_CRC_DEFAULT    32'hFFFFFFFF
+    `define USB_EP2_CRC_CRC_B          0
+    `define USB_EP2_CRC_CRC_T          31
+    `define USB_EP2_CRC_CRC_W          32
+    `define USB_EP2_CRC_CRC_R          31:0
+
 //-----------------------------------------------------------------
 //                              EP3
 //-----------------------------------------------------------------
 `define USB_EP3_CFG    8'h80
 
+    // fold the bytes read from DATA into USB_EP3_CRC
+    `define USB_EP3_CFG_CRC_EN      14
+    `define USB_EP3_CFG_CRC_EN_DEFAULT    0
+    `define USB_EP3_CFG_CRC_EN_B          14
+    `define USB_EP3_CFG_CRC_EN_T          14
+    `define USB_EP3_CFG_CRC_EN_W          1
+    `define USB_EP3_CFG_CRC_EN_R          14:14
+
+    // level interrupts, see USB_EP_LVLSTS
+    `define USB_EP3_CFG_INT_RX_LVL      13
+    `define USB_EP3_CFG_INT_RX_LVL_DEFAULT    0
+    `define USB_EP3_CFG_INT_RX_LVL_B          13
+    `define USB_EP3_CFG_INT_RX_LVL_T          13
+    `define USB_EP3_CFG_INT_RX_LVL_W          1
+    `define USB_EP3_CFG_INT_RX_LVL_R          13:13
+
+    `define USB_EP3_CFG_INT_TX_LVL      12
+    `define USB_EP3_CFG_INT_TX_LVL_DEFAULT    0
+    `define USB_EP3_CFG_INT_TX_LVL_B          12
+    `define USB_EP3_CFG_INT_TX_LVL_T          12
+    `define USB_EP3_CFG_INT_TX_LVL_W          1
+    `define USB_EP3_CFG_INT_TX_LVL_R          12:12
+
+    // loopback: OUT data of this EP is sent on IN EP LOOPBACK_EP
+    `define USB_EP3_CFG_LOOPBACK_EP_DEFAULT    0
+    `define USB_EP3_CFG_LOOPBACK_EP_B          8
+    `define USB_EP3_CFG_LOOPBACK_EP_T          11
+    `define USB_EP3_CFG_LOOPBACK_EP_W          4
+    `define USB_EP3_CFG_LOOPBACK_EP_R          11:8
+
+    // auto-accept: re-armed when RX_COUNT bytes are read
+    `define USB_EP3_CFG_AUTO_ACCEPT      7
+    `define USB_EP3_CFG_AUTO_ACCEPT_DEFAULT    0
+    `define USB_EP3_CFG_AUTO_ACCEPT_B          7
+    `define USB_EP3_CFG_AUTO_ACCEPT_T          7
+    `define USB_EP3_CFG_AUTO_ACCEPT_W          1
+    `define USB_EP3_CFG_AUTO_ACCEPT_R          7:7
+
+    `define USB_EP3_CFG_LOOPBACK_EN      6
+    `define USB_EP3_CFG_LOOPBACK_EN_DEFAULT    0
+    `define USB_EP3_CFG_LOOPBACK_EN_B          6
+    `define USB_EP3_CFG_LOOPBACK_EN_T          6
+    `define USB_EP3_CFG_LOOPBACK_EN_W          1
+    `define USB_EP3_CFG_LOOPBACK_EN_R          6:6
+
+    `define USB_EP3_CFG_INT_OUT_NAK      5
+    `define USB_EP3_CFG_INT_OUT_NAK_DEFAULT    0
+    `define USB_EP3_CFG_INT_OUT_NAK_B          5
+    `define USB_EP3_CFG_INT_OUT_NAK_T          5
+    `define USB_EP3_CFG_INT_OUT_NAK_W          1
+    `define USB_EP3_CFG_INT_OUT_NAK_R          5:5
+
+    `define USB_EP3_CFG_INT_IN_NAK      4
+    `define USB_EP3_CFG_INT_IN_NAK_DEFAULT    0
+    `define USB_EP3_CFG_INT_IN_NAK_B          4
+    `define USB_EP3_CFG_INT_IN_NAK_T          4
+    `define USB_EP3_CFG_INT_IN_NAK_W          1
+    `define USB_EP3_CFG_INT_IN_NAK_R          4:4
+
     `define USB_EP3_CFG_INT_RX      3
     `define USB_EP3_CFG_INT_RX_DEFAULT    0
     `define USB_EP3_CFG_INT_RX_B          3
@@ -614,6 +1162,14 @@
 
 `define USB_EP3_TX_CTRL    8'h84
 
+    // IN tokens are NAKed until the TX FIFO holds min(TX_LEN, TX_MIN)
+    // bytes, 0 sends at once
+    `define USB_EP3_TX_CTRL_TX_MIN_DEFAULT    0
+    `define USB_EP3_TX_CTRL_TX_MIN_B          18
+    `define USB_EP3_TX_CTRL_TX_MIN_T          28
+    `define USB_EP3_TX_CTRL_TX_MIN_W          11
+    `define USB_EP3_TX_CTRL_TX_MIN_R          28:18
+
     `define USB_EP3_TX_CTRL_TX_FLUSH      17
     `define USB_EP3_TX_CTRL_TX_FLUSH_DEFAULT    0
     `define USB_EP3_TX_CTRL_TX_FLUSH_B          17
@@ -701,4 +1257,333 @@
     `define USB_EP3_DATA_DATA_W          8
     `define USB_EP3_DATA_DATA_R          7:0
 
+`define USB_EP3_LEVEL    8'h94
+
+    // fill level of the FIFOs in bytes
+    `define USB_EP3_LEVEL_TX_LEVEL_DEFAULT    0
+    `define USB_EP3_LEVEL_TX_LEVEL_B          16
+    `define USB_EP3_LEVEL_TX_LEVEL_T          26
+    `define USB_EP3_LEVEL_TX_LEVEL_W          11
+    `define USB_EP3_LEVEL_TX_LEVEL_R          26:16
+
+    `define USB_EP3_LEVEL_RX_LEVEL_DEFAULT    0
+    `define USB_EP3_LEVEL_RX_LEVEL_B          0
+    `define USB_EP3_LEVEL_RX_LEVEL_T          10
+    `define USB_EP3_LEVEL_RX_LEVEL_W          11
+    `define USB_EP3_LEVEL_RX_LEVEL_R          10:0
+
+`define USB_EP3_THR    8'h98
+
+    // TX_LVL is set when TX_LEVEL falls below TX_THR
+    `define USB_EP3_THR_TX_THR_DEFAULT    0
+    `define USB_EP3_THR_TX_THR_B          16
+    `define USB_EP3_THR_TX_THR_T          26
+    `define USB_EP3_THR_TX_THR_W          11
+    `define USB_EP3_THR_TX_THR_R          26:16
+
+    // RX_LVL is set when RX_LEVEL rises above RX_THR
+    `define USB_EP3_THR_RX_THR_DEFAULT    0
+    `define USB_EP3_THR_RX_THR_B          0
+    `define USB_EP3_THR_RX_THR_T          10
+    `define USB_EP3_THR_RX_THR_W          11
+    `define USB_EP3_THR_RX_THR_R          10:0
+
+`define USB_EP3_CRC    8'h9c
+
+    // write: seed, read: current value, the CRC-32 result is ~CRC
+    `define USB_EP3_CRC_CRC_DEFAULT    32'hFFFFFFFF
+    `define USB_EP3_CRC_CRC_B          0
+    `define USB_EP3_CRC_CRC_T          31
+    `define USB_EP3_CRC_CRC_W          32
+    `define USB_EP3_CRC_CRC_R          31:0
+
+//-----------------------------------------------------------------
+//                             MISC
+//-----------------------------------------------------------------
+`define USB_RST_CTRL    12'h240
+
+    // on USB reset: clear the device address
+    `define USB_RST_CTRL_CLR_ADDR      2
+    `define USB_RST_CTRL_CLR_ADDR_DEFAULT    1
+    `define USB_RST_CTRL_CLR_ADDR_B          2
+    `define USB_RST_CTRL_CLR_ADDR_T          2
+    `define USB_RST_CTRL_CLR_ADDR_W          1
+    `define USB_RST_CTRL_CLR_ADDR_R          2:2
+
+    // on USB reset: clear the stall of all EPs
+    `define USB_RST_CTRL_CLR_STALL      1
+    `define USB_RST_CTRL_CLR_STALL_DEFAULT    1
+    `define USB_RST_CTRL_CLR_STALL_B          1
+    `define USB_RST_CTRL_CLR_STALL_T          1
+    `define USB_RST_CTRL_CLR_STALL_W          1
+    `define USB_RST_CTRL_CLR_STALL_R          1:1
+
+    // on USB reset: flush all FIFOs, drop pending rx and tx
+    `define USB_RST_CTRL_FLUSH      0
+    `define USB_RST_CTRL_FLUSH_DEFAULT    1
+    `define USB_RST_CTRL_FLUSH_B          0
+    `define USB_RST_CTRL_FLUSH_T          0
+    `define USB_RST_CTRL_FLUSH_W          1
+    `define USB_RST_CTRL_FLUSH_R          0:0
+
+//-----------------------------------------------------------------
+// USB_EP_LVLSTS
+// set on a threshold crossing of USB_EPi_THR, write 1 to clear
+//-----------------------------------------------------------------
+`define USB_EP_LVLSTS    12'h244
+
+    //--------------------------------------------------
+    // bit[15:0] -> TX_LVL EP 0-15
+    //--------------------------------------------------
+    `define USB_EP_LVLSTS_EP0_TX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP0_TX_LVL_B          0
+    `define USB_EP_LVLSTS_EP0_TX_LVL_T          0
+    `define USB_EP_LVLSTS_EP0_TX_LVL_W          1
+    `define USB_EP_LVLSTS_EP0_TX_LVL_R          0:0
+
+    `define USB_EP_LVLSTS_EP1_TX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP1_TX_LVL_B          1
+    `define USB_EP_LVLSTS_EP1_TX_LVL_T          1
+    `define USB_EP_LVLSTS_EP1_TX_LVL_W          1
+    `define USB_EP_LVLSTS_EP1_TX_LVL_R          1:1
+
+    `define USB_EP_LVLSTS_EP2_TX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP2_TX_LVL_B          2
+    `define USB_EP_LVLSTS_EP2_TX_LVL_T          2
+    `define USB_EP_LVLSTS_EP2_TX_LVL_W          1
+    `define USB_EP_LVLSTS_EP2_TX_LVL_R          2:2
+
+    `define USB_EP_LVLSTS_EP3_TX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP3_TX_LVL_B          3
+    `define USB_EP_LVLSTS_EP3_TX_LVL_T          3
+    `define USB_EP_LVLSTS_EP3_TX_LVL_W          1
+    `define USB_EP_LVLSTS_EP3_TX_LVL_R          3:3
+
+    //--------------------------------------------------
+    // bit[31:16] -> RX_LVL: 16-31
+    //--------------------------------------------------
+    `define USB_EP_LVLSTS_EP0_RX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP0_RX_LVL_B          16
+    `define USB_EP_LVLSTS_EP0_RX_LVL_T          16
+    `define USB_EP_LVLSTS_EP0_RX_LVL_W          1
+    `define USB_EP_LVLSTS_EP0_RX_LVL_R          16:16
+
+    `define USB_EP_LVLSTS_EP1_RX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP1_RX_LVL_B          17
+    `define USB_EP_LVLSTS_EP1_RX_LVL_T          17
+    `define USB_EP_LVLSTS_EP1_RX_LVL_W          1
+    `define USB_EP_LVLSTS_EP1_RX_LVL_R          17:17
+
+    `define USB_EP_LVLSTS_EP2_RX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP2_RX_LVL_B          18
+    `define USB_EP_LVLSTS_EP2_RX_LVL_T          18
+    `define USB_EP_LVLSTS_EP2_RX_LVL_W          1
+    `define USB_EP_LVLSTS_EP2_RX_LVL_R          18:18
+
+    `define USB_EP_LVLSTS_EP3_RX_LVL_DEFAULT    0
+    `define USB_EP_LVLSTS_EP3_RX_LVL_B          19
+    `define USB_EP_LVLSTS_EP3_RX_LVL_T          19
+    `define USB_EP_LVLSTS_EP3_RX_LVL_W          1
+    `define USB_EP_LVLSTS_EP3_RX_LVL_R          19:19
+
+//-----------------------------------------------------------------
+//                           EP SUMMARY
+//-----------------------------------------------------------------
+// USB_EP_SUMMARY+4*n: status of EP 2n in bits[15:0] and EP 2n+1
+// in bits[31:16], with the bit fields below. 
+// 16 endpoints take 8 contiguous registers.
+`define USB_EP_SUMMARY    12'h280
+
+    `define USB_EP_SUMMARY_EP_W          16
+
+    `define USB_EP_SUMMARY_TX_ERR      15
+    `define USB_EP_SUMMARY_TX_ERR_DEFAULT    0
+    `define USB_EP_SUMMARY_TX_ERR_B          15
+    `define USB_EP_SUMMARY_TX_ERR_T          15
+    `define USB_EP_SUMMARY_TX_ERR_W          1
+    `define USB_EP_SUMMARY_TX_ERR_R          15:15
+
+    `define USB_EP_SUMMARY_TX_BUSY      14
+    `define USB_EP_SUMMARY_TX_BUSY_DEFAULT    0
+    `define USB_EP_SUMMARY_TX_BUSY_B          14
+    `define USB_EP_SUMMARY_TX_BUSY_T          14
+    `define USB_EP_SUMMARY_TX_BUSY_W          1
+    `define USB_EP_SUMMARY_TX_BUSY_R          14:14
+
+    `define USB_EP_SUMMARY_RX_ERR      13
+    `define USB_EP_SUMMARY_RX_ERR_DEFAULT    0
+    `define USB_EP_SUMMARY_RX_ERR_B          13
+    `define USB_EP_SUMMARY_RX_ERR_T          13
+    `define USB_EP_SUMMARY_RX_ERR_W          1
+    `define USB_EP_SUMMARY_RX_ERR_R          13:13
+
+    `define USB_EP_SUMMARY_RX_SETUP      12
+    `define USB_EP_SUMMARY_RX_SETUP_DEFAULT    0
+    `define USB_EP_SUMMARY_RX_SETUP_B          12
+    `define USB_EP_SUMMARY_RX_SETUP_T          12
+    `define USB_EP_SUMMARY_RX_SETUP_W          1
+    `define USB_EP_SUMMARY_RX_SETUP_R          12:12
+
+    `define USB_EP_SUMMARY_RX_READY      11
+    `define USB_EP_SUMMARY_RX_READY_DEFAULT    0
+    `define USB_EP_SUMMARY_RX_READY_B          11
+    `define USB_EP_SUMMARY_RX_READY_T          11
+    `define USB_EP_SUMMARY_RX_READY_W          1
+    `define USB_EP_SUMMARY_RX_READY_R          11:11
+
+    `define USB_EP_SUMMARY_RX_COUNT_DEFAULT    0
+    `define USB_EP_SUMMARY_RX_COUNT_B          0
+    `define USB_EP_SUMMARY_RX_COUNT_T          10
+    `define USB_EP_SUMMARY_RX_COUNT_W          11
+    `define USB_EP_SUMMARY_RX_COUNT_R          10:0
+
+//-----------------------------------------------------------------
+//                             TRACE
+//-----------------------------------------------------------------
+`define USB_TRACE_CTRL    12'h300
+
+    // stop after POST records following the trigger record
+    `define USB_TRACE_CTRL_POST_DEFAULT    0
+    `define USB_TRACE_CTRL_POST_B          16
+    `define USB_TRACE_CTRL_POST_T          23
+    `define USB_TRACE_CTRL_POST_W          8
+    `define USB_TRACE_CTRL_POST_R          23:16
+
+    // trigger on endpoint TRIG_EP only
+    `define USB_TRACE_CTRL_TRIG_EP_DEFAULT    0
+    `define USB_TRACE_CTRL_TRIG_EP_B          12
+    `define USB_TRACE_CTRL_TRIG_EP_T          15
+    `define USB_TRACE_CTRL_TRIG_EP_W          4
+    `define USB_TRACE_CTRL_TRIG_EP_R          15:12
+
+    `define USB_TRACE_CTRL_TRIG_EP_EN      11
+    `define USB_TRACE_CTRL_TRIG_EP_EN_DEFAULT    0
+    `define USB_TRACE_CTRL_TRIG_EP_EN_B          11
+    `define USB_TRACE_CTRL_TRIG_EP_EN_T          11
+    `define USB_TRACE_CTRL_TRIG_EP_EN_W          1
+    `define USB_TRACE_CTRL_TRIG_EP_EN_R          11:11
+
+    // trigger on PID TRIG_PID (PID[3:0])
+    `define USB_TRACE_CTRL_TRIG_PID_DEFAULT    0
+    `define USB_TRACE_CTRL_TRIG_PID_B          4
+    `define USB_TRACE_CTRL_TRIG_PID_T          7
+    `define USB_TRACE_CTRL_TRIG_PID_W          4
+    `define USB_TRACE_CTRL_TRIG_PID_R          7:4
+
+    `define USB_TRACE_CTRL_TRIG_EN      1
+    `define USB_TRACE_CTRL_TRIG_EN_DEFAULT    0
+    `define USB_TRACE_CTRL_TRIG_EN_B          1
+    `define USB_TRACE_CTRL_TRIG_EN_T          1
+    `define USB_TRACE_CTRL_TRIG_EN_W          1
+    `define USB_TRACE_CTRL_TRIG_EN_R          1:1
+
+    // 0->1: clear the buffer and start capture
+    `define USB_TRACE_CTRL_EN      0
+    `define USB_TRACE_CTRL_EN_DEFAULT    0
+    `define USB_TRACE_CTRL_EN_B          0
+    `define USB_TRACE_CTRL_EN_T          0
+    `define USB_TRACE_CTRL_EN_W          1
+    `define USB_TRACE_CTRL_EN_R          0:0
+
+`define USB_TRACE_FILT    12'h304
+
+    // record events of endpoint n when bit n is set
+    `define USB_TRACE_FILT_EP_MASK_DEFAULT    16'hFFFF
+    `define USB_TRACE_FILT_EP_MASK_B          16
+    `define USB_TRACE_FILT_EP_MASK_T          31
+    `define USB_TRACE_FILT_EP_MASK_W          16
+    `define USB_TRACE_FILT_EP_MASK_R          31:16
+
+    // record events of PID n when bit n is set (PID 0: bus reset)
+    `define USB_TRACE_FILT_PID_MASK_DEFAULT    16'hFFFF
+    `define USB_TRACE_FILT_PID_MASK_B          0
+    `define USB_TRACE_FILT_PID_MASK_T          15
+    `define USB_TRACE_FILT_PID_MASK_W          16
+    `define USB_TRACE_FILT_PID_MASK_R          15:0
+
+`define USB_TRACE_STS    12'h308
+
+    `define USB_TRACE_STS_STOPPED      18
+    `define USB_TRACE_STS_STOPPED_DEFAULT    0
+    `define USB_TRACE_STS_STOPPED_B          18
+    `define USB_TRACE_STS_STOPPED_T          18
+    `define USB_TRACE_STS_STOPPED_W          1
+    `define USB_TRACE_STS_STOPPED_R          18:18
+
+    `define USB_TRACE_STS_TRIGGERED      17
+    `define USB_TRACE_STS_TRIGGERED_DEFAULT    0
+    `define USB_TRACE_STS_TRIGGERED_B          17
+    `define USB_TRACE_STS_TRIGGERED_T          17
+    `define USB_TRACE_STS_TRIGGERED_W          1
+    `define USB_TRACE_STS_TRIGGERED_R          17:17
+
+    // the buffer has wrapped, the oldest record is at WPTR
+    `define USB_TRACE_STS_WRAP      16
+    `define USB_TRACE_STS_WRAP_DEFAULT    0
+    `define USB_TRACE_STS_WRAP_B          16
+    `define USB_TRACE_STS_WRAP_T          16
+    `define USB_TRACE_STS_WRAP_W          1
+    `define USB_TRACE_STS_WRAP_R          16:16
+
+    // next record is written here
+    `define USB_TRACE_STS_WPTR_DEFAULT    0
+    `define USB_TRACE_STS_WPTR_B          0
+    `define USB_TRACE_STS_WPTR_T          15
+    `define USB_TRACE_STS_WPTR_W          16
+    `define USB_TRACE_STS_WPTR_R          15:0
+
+`define USB_TRACE_IDX    12'h30C
+
+    `define USB_TRACE_IDX_IDX_DEFAULT    0
+    `define USB_TRACE_IDX_IDX_B          0
+    `define USB_TRACE_IDX_IDX_T          15
+    `define USB_TRACE_IDX_IDX_W          16
+    `define USB_TRACE_IDX_IDX_R          15:0
+
+`define USB_TRACE_DATA0    12'h310
+
+    // PID[3:0], 0 for bus reset
+    `define USB_TRACE_DATA0_PID_DEFAULT    0
+    `define USB_TRACE_DATA0_PID_B          28
+    `define USB_TRACE_DATA0_PID_T          31
+    `define USB_TRACE_DATA0_PID_W          4
+    `define USB_TRACE_DATA0_PID_R          31:28
+
+    // 1: device to host
+    `define USB_TRACE_DATA0_DIR      27
+    `define USB_TRACE_DATA0_DIR_DEFAULT    0
+    `define USB_TRACE_DATA0_DIR_B          27
+    `define USB_TRACE_DATA0_DIR_T          27
+    `define USB_TRACE_DATA0_DIR_W          1
+    `define USB_TRACE_DATA0_DIR_R          27:27
+
+    `define USB_TRACE_DATA0_CRC_ERR      26
+    `define USB_TRACE_DATA0_CRC_ERR_DEFAULT    0
+    `define USB_TRACE_DATA0_CRC_ERR_B          26
+    `define USB_TRACE_DATA0_CRC_ERR_T          26
+    `define USB_TRACE_DATA0_CRC_ERR_W          1
+    `define USB_TRACE_DATA0_CRC_ERR_R          26:26
+
+    `define USB_TRACE_DATA0_EP_DEFAULT    0
+    `define USB_TRACE_DATA0_EP_B          16
+    `define USB_TRACE_DATA0_EP_T          19
+    `define USB_TRACE_DATA0_EP_W          4
+    `define USB_TRACE_DATA0_EP_R          19:16
+
+    // data length, or frame number of SOF
+    `define USB_TRACE_DATA0_LEN_DEFAULT    0
+    `define USB_TRACE_DATA0_LEN_B          0
+    `define USB_TRACE_DATA0_LEN_T          10
+    `define USB_TRACE_DATA0_LEN_W          11
+    `define USB_TRACE_DATA0_LEN_R          10:0
+
+`define USB_TRACE_DATA1    12'h314
+
+    // phy clocks since capture start
+    `define USB_TRACE_DATA1_TIMESTAMP_DEFAULT    0
+    `define USB_TRACE_DATA1_TIMESTAMP_B          0
+    `define USB_TRACE_DATA1_TIMESTAMP_T          31
+    `define USB_TRACE_DATA1_TIMESTAMP_W          32
+    `define USB_TRACE_DATA1_TIMESTAMP_R          31:0
+
 
@@ -17,6 +17,9 @@
 //=================================================================
 `include "usbf_cfg_defs.v"
 module usbf_core
+#(
+    parameter EP_NUM = `USB_EP_NUM
+)
 (
  
      input                                  clk_i
@@ -41,16 +44,16 @@ module usbf_core
     ,output                                 rx_last_o
     ,output                                 rx_crc_err_o
     // EP Rx SIE Interface
-    ,output [`USB_EP_NUM-1:0]               ep_rx_setup_o
-    ,output [`USB_EP_NUM-1:0]               ep_rx_valid_o
-    ,input  [`USB_EP_NUM-1:0]               ep_rx_space_i
+    ,output [EP_NUM-1:0]                    ep_rx_setup_o
+    ,output [EP_NUM-1:0]                    ep_rx_valid_o
+    ,input  [EP_NUM-1:0]                    ep_rx_space_i
     // EP Tx SIE Interface
-    ,input  [`USB_EP_NUM-1:0]               ep_tx_ready_i
-    ,input  [`USB_EP_NUM-1:0]               ep_tx_data_valid_i
-    ,input  [`USB_EP_NUM-1:0]               ep_tx_data_strb_i
-    ,input  [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  ep_tx_data_i
-    ,input  [`USB_EP_NUM-1:0]               ep_tx_data_last_i
-    ,output [`USB_EP_NUM-1:0]               ep_tx_data_accept_o
+    ,input  [EP_NUM-1:0]                    ep_tx_ready_i
+    ,input  [EP_NUM-1:0]                    ep_tx_data_valid_i
+    ,input  [EP_NUM-1:0]                    ep_tx_data_strb_i
+    ,input  [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       ep_tx_data_i
+    ,input  [EP_NUM-1:0]                    ep_tx_data_last_i
+    ,output [EP_NUM-1:0]                    ep_tx_data_accept_o
     
     // CSR interface
     /////////////////////////////////////
@@ -59,16 +62,27 @@ module usbf_core
     // device address
     ,input  [  6:0]                         func_addr_dev_addr_i
     // EP config
-    ,input  [`USB_EP_NUM-1:0]               ep_stall_i
-    ,input  [`USB_EP_NUM-1:0]               ep_iso_i
+    ,input  [EP_NUM-1:0]                    ep_stall_i
+    ,input  [EP_NUM-1:0]                    ep_iso_i
+    // NAK event hold-off time
+    ,input  [`USB_NAK_CTRL_HOLDOFF_W-1:0]   nak_holdoff_i
     // status frame output
     ,output [ 10:0]                         func_stat_frame_o
     // intr set pulse
     ,output                                 rst_intr_set_o
     ,output                                 sof_intr_set_o 
-    ,output [`USB_EP_NUM-1:0]               ep_rx_ready_intr_set_o
-    ,output [`USB_EP_NUM-1:0]               ep_tx_complete_intr_set_o
+    ,output [EP_NUM-1:0]                    ep_rx_ready_intr_set_o
+    ,output [EP_NUM-1:0]                    ep_tx_complete_intr_set_o
+    ,output [EP_NUM-1:0]                    ep_in_nak_intr_set_o
+    ,output [EP_NUM-1:0]                    ep_out_nak_intr_set_o
      
+`ifdef USB_TRACE
+    // Trace interface
+    /////////////////////////////////////
+    ,output                                 trace_valid_o
+    ,output [ 31:0]                         trace_data_o
+`endif
+
     // Others
     /////////////////////////////////////
     // scaledown mode select
@@ -153,7 +167,7 @@ wire                    frame_valid_w;
 `define USB_DEV_W      7
 wire [`USB_DEV_W-1:0]   token_dev_w;
 
-wire [`USB_EP_NUM-1:0]  token_ep_w;
+wire [EP_NUM-1:0]       token_ep_w;
 
 `define USB_PID_W      8
 wire [`USB_PID_W-1:0]   token_pid_w;
@@ -186,7 +200,7 @@ reg                     ep_iso_r;
 reg                     rx_enable_q;
 reg                     rx_setup_q;
 
-reg [`USB_EP_NUM-1:0]   ep_data_bit_q;
+reg [EP_NUM-1:0]        ep_data_bit_q;
 
 wire                    status_stage_w;
 
@@ -231,7 +245,7 @@ generate //{
         tx_data_strb_r  = 1'b0;
         tx_data_r       = 8'b0;
         tx_data_last_r  = 1'b0;
-        for(j=0; j<`USB_EP_NUM; j=j+1) begin //{
+        for(j=0; j<EP_NUM; j=j+1) begin //{
             if (token_ep_w == j) begin
                 tx_data_valid_r = ep_tx_data_valid_i[j];
                 tx_data_strb_r  = ep_tx_data_strb_i[j];
@@ -243,7 +257,7 @@ generate //{
 endgenerate //}
 
 generate //{
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin
+    for(i=0; i<EP_NUM; i=i+1) begin
         assign ep_tx_data_accept_o[i] = (tx_data_accept_w & (token_ep_w == i));
     end
 endgenerate //}
@@ -256,7 +270,7 @@ generate //{
         ep_stall_r    =  1'b0;
         ep_iso_r      =  1'b0;
 
-        for(j=0; j<`USB_EP_NUM; j=j+1) begin //{
+        for(j=0; j<EP_NUM; j=j+1) begin //{
             if (token_ep_w ==j) begin
                 rx_space_r    = ep_rx_space_i[j];
                 tx_ready_r    = ep_tx_ready_i[j];
@@ -314,7 +328,7 @@ u_sie_rx
 );
 
 generate //{
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    for(i=0; i<EP_NUM; i=i+1) begin //{
         assign ep_rx_setup_o[i] = rx_setup_q & (token_ep_w == i);
         assign ep_rx_valid_o[i] = rx_enable_q & rx_data_valid_w & (token_ep_w == i);
     end //}
@@ -771,7 +785,7 @@ begin
 end
 
 generate //{
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin
+    for(i=0; i<EP_NUM; i=i+1) begin
         always @ (posedge clk_i or negedge rstn_i) begin
             if (!rstn_i)
                 ep_data_bit_q[i] <= 1'b0;
@@ -790,13 +804,157 @@ assign rst_intr_set_o = usb_rst_w;
 assign sof_intr_set_o = frame_valid_w;
 
 generate //{
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    for(i=0; i<EP_NUM; i=i+1) begin //{
         // TODO: the data type of i
         assign ep_rx_ready_intr_set_o[i] = (state_q == STATE_RX_DATA_READY) && rx_space_q && (token_ep_w == i);
         assign ep_tx_complete_intr_set_o[i] = (state_q == STATE_TX_DATA_COMPLETE) && (token_ep_w == i);
     end //}
 endgenerate //}
 
+//-----------------------------------------------------------------
+// NAK events set pulse
+// IN  NAKed: IN token and no data armed.
+// OUT NAKed: OUT data (or PING) and no rx space.
+// After an event, the same event of this EP is held off for 
+// nak_holdoff_i clocks, so a polling host can not storm the CPU.
+//-----------------------------------------------------------------
+wire in_nak_w  = (state_q == STATE_RX_IDLE) && token_valid_w && (token_pid_w == `PID_IN) &&
+                 !ep_stall_r && !tx_ready_r;
+
+wire ping_nak_w = (state_q == STATE_RX_IDLE) && token_valid_w && (token_pid_w == `PID_PING) &&
+                  !ep_stall_r && !rx_space_r;
+
+wire out_data_nak_w = (state_q == STATE_RX_DATA_READY) && rx_data_complete_w && 
+                      !rx_crc_err_o && !ep_iso_r && !ep_stall_r && !rx_space_q &&
+                      !((token_pid_w == `PID_DATA0 && ep_data_bit_r) ||
+                        (token_pid_w == `PID_DATA1 && !ep_data_bit_r));
+
+wire out_nak_w = ping_nak_w | out_data_nak_w;
+
+generate //{
+    for(i=0; i<EP_NUM; i=i+1) begin:nak_ep //{
+        reg [`USB_NAK_CTRL_HOLDOFF_W-1:0] in_holdoff_q;
+        reg [`USB_NAK_CTRL_HOLDOFF_W-1:0] out_holdoff_q;
+
+        assign ep_in_nak_intr_set_o[i]  = in_nak_w  && (token_ep_w == i) && (in_holdoff_q == 0);
+        assign ep_out_nak_intr_set_o[i] = out_nak_w && (token_ep_w == i) && (out_holdoff_q == 0);
+
+        always @ (posedge clk_i or negedge rstn_i)
+        if (!rstn_i)
+            in_holdoff_q <= {`USB_NAK_CTRL_HOLDOFF_W{1'b0}};
+        else if (usb_rst_w)
+            in_holdoff_q <= {`USB_NAK_CTRL_HOLDOFF_W{1'b0}};
+        else if (ep_in_nak_intr_set_o[i])
+            in_holdoff_q <= nak_holdoff_i;
+        else if (in_holdoff_q != 0)
+            in_holdoff_q <= in_holdoff_q - 1'b1;
+
+        always @ (posedge clk_i or negedge rstn_i)
+        if (!rstn_i)
+            out_holdoff_q <= {`USB_NAK_CTRL_HOLDOFF_W{1'b0}};
+        else if (usb_rst_w)
+            out_holdoff_q <= {`USB_NAK_CTRL_HOLDOFF_W{1'b0}};
+        else if (ep_out_nak_intr_set_o[i])
+            out_holdoff_q <= nak_holdoff_i;
+        else if (out_holdoff_q != 0)
+            out_holdoff_q <= out_holdoff_q - 1'b1;
+    end //}
+endgenerate //}
+
+`ifdef USB_TRACE
+//-----------------------------------------------------------------
+// Trace events, in USB_TRACE_DATA0 format
+// Bus reset, SOF, tokens, data packets (with length and CRC error)
+// and handshakes in both directions.
+//-----------------------------------------------------------------
+reg        trc_rst_q;
+reg [10:0] trc_rx_len_q;
+reg [10:0] trc_tx_len_q;
+reg [3:0]  trc_tx_pid_q;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    trc_rst_q <= 1'b0;
+else
+    trc_rst_q <= usb_rst_w;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    trc_rx_len_q <= 11'b0;
+else if (token_valid_w)
+    trc_rx_len_q <= 11'b0;
+else if (rx_data_valid_w && rx_strb_o)
+    trc_rx_len_q <= trc_rx_len_q + 11'd1;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    trc_tx_len_q <= 11'b0;
+else if (token_valid_w)
+    trc_tx_len_q <= 11'b0;
+else if (tx_data_valid_r && tx_data_strb_r && tx_data_accept_w)
+    trc_tx_len_q <= trc_tx_len_q + 11'd1;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    trc_tx_pid_q <= 4'b0;
+else if ((state_q == STATE_TX_DATA) && tx_valid_q && tx_accept_w)
+    trc_tx_pid_q <= tx_pid_q[3:0];
+
+reg        trc_valid_r;
+reg [3:0]  trc_pid_r;
+reg        trc_dir_r;
+reg        trc_crc_err_r;
+reg [10:0] trc_len_r;
+
+always @ *
+begin
+    trc_valid_r   = 1'b1;
+    trc_pid_r     = 4'b0;
+    trc_dir_r     = 1'b0;
+    trc_crc_err_r = 1'b0;
+    trc_len_r     = 11'b0;
+
+    // Bus reset
+    if (usb_rst_w && !trc_rst_q)
+        trc_pid_r     = 4'h0;
+    // SOF
+    else if (frame_valid_w)
+    begin
+        trc_pid_r     = token_pid_w[3:0];
+        trc_len_r     = func_stat_frame_o;
+    end
+    // Token or handshake received
+    else if (token_valid_w || rx_handshake_w)
+        trc_pid_r     = token_pid_w[3:0];
+    // Data packet received
+    else if ((state_q == STATE_RX_DATA_READY) && rx_data_complete_w)
+    begin
+        trc_pid_r     = token_pid_w[3:0];
+        trc_crc_err_r = rx_crc_err_o;
+        trc_len_r     = trc_rx_len_q;
+    end
+    // Handshake sent
+    else if ((state_q == STATE_TX_HANDSHAKE) && tx_valid_q && tx_accept_w)
+    begin
+        trc_pid_r     = tx_pid_q[3:0];
+        trc_dir_r     = 1'b1;
+    end
+    // Data packet sent
+    else if (state_q == STATE_TX_DATA_COMPLETE)
+    begin
+        trc_pid_r     = trc_tx_pid_q;
+        trc_dir_r     = 1'b1;
+        trc_len_r     = trc_tx_len_q;
+    end
+    else
+        trc_valid_r   = 1'b0;
+end
+
+wire [3:0] trc_ep_w = token_ep_w;
+
+assign trace_valid_o = trc_valid_r;
+assign trace_data_o  = {trc_pid_r, trc_dir_r, trc_crc_err_r, 6'b0, trc_ep_w, 5'b0, trc_len_r};
+`endif
 
 //-------------------------------------------------------------------
 // Debug
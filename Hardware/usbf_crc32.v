@@ -0,0 +1,38 @@
+//=================================================================
+//
+// CRC-32 (IEEE 802.3, reflected, polynomial 0xEDB88320)
+// One byte per clock, LSB first.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+module usbf_crc32
+(
+    // Inputs
+     input  [ 31:0]  crc_in_i
+    ,input  [  7:0]  din_i
+
+    // Outputs
+    ,output [ 31:0]  crc_out_o
+);
+
+
+
+//-----------------------------------------------------------------
+// Logic
+//-----------------------------------------------------------------
+reg [31:0] crc_r;
+integer    k;
+
+always @(*)
+begin
+    crc_r = crc_in_i ^ {24'b0, din_i};
+    for (k = 0; k < 8; k = k + 1)
+        crc_r = crc_r[0] ? ((crc_r >> 1) ^ 32'hEDB88320) : (crc_r >> 1);
+end
+
+assign crc_out_o = crc_r;
+
+
+endmodule
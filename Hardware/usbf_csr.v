@@ -14,7 +14,9 @@
 
 `include "usbf_cfg_defs.v"
 
-module usbf_csr(
+module usbf_csr #(
+    parameter EP_NUM = `USB_EP_NUM
+)(
      input                                          hclk_i
     ,input                                          rstn_i
 
@@ -32,34 +34,70 @@ module usbf_csr(
     ////// Device core interface
     ,output                                         func_ctrl_hs_chirp_en_o
     ,output [ `USB_FUNC_ADDR_DEV_ADDR_W-1:0]        func_addr_dev_addr_o
-    ,output [`USB_EP_NUM-1:0]                       ep_cfg_stall_ep_o
-    ,output [`USB_EP_NUM-1:0]                       ep_cfg_iso_o
+    ,output [EP_NUM-1:0]                            ep_cfg_stall_ep_o
+    ,output [EP_NUM-1:0]                            ep_cfg_iso_o
+    ,output [EP_NUM-1:0]                            ep_cfg_loopback_en_o
+    ,output [EP_NUM-1:0]                            ep_cfg_auto_accept_o
+    ,output [`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM-1:0] ep_cfg_loopback_ep_o
     ,input  [`USB_FUNC_STAT_FRAME_W-1:0]            func_stat_frame_i
     ,input                                          rst_intr_set_i
     ,input                                          sof_intr_set_i
-    ,input  [`USB_EP_NUM-1:0]                       ep_rx_ready_intr_set_i
-    ,input  [`USB_EP_NUM-1:0]                       ep_tx_complete_intr_set_i
+    ,input                                          presof_intr_set_i
+    ,input                                          func_stat_sof_lock_i
+    ,output [`USB_SOF_CTRL_SOF_DIV_W-1:0]           sof_ctrl_sof_div_o
+    ,output [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0]       sof_ctrl_presof_lead_o
+    ,output [`USB_SOF_CTRL_MEAS_WIN_W-1:0]          sof_ctrl_meas_win_o
+    ,input  [`USB_SOF_PERIOD_PERIOD_W-1:0]          sof_period_i
+    ,input  [EP_NUM-1:0]                            ep_rx_ready_intr_set_i
+    ,input  [EP_NUM-1:0]                            ep_tx_complete_intr_set_i
+    ,input  [EP_NUM-1:0]                            ep_in_nak_intr_set_i
+    ,input  [EP_NUM-1:0]                            ep_out_nak_intr_set_i
+    ,output [`USB_NAK_CTRL_HOLDOFF_W-1:0]           nak_ctrl_holdoff_o
+    ,output                                         rst_ctrl_flush_o
+
+`ifdef USB_TRACE
+    ////// Trace interface
+    ,output                                         trace_ctrl_en_o
+    ,output                                         trace_ctrl_trig_en_o
+    ,output [`USB_TRACE_CTRL_TRIG_PID_W-1:0]        trace_ctrl_trig_pid_o
+    ,output                                         trace_ctrl_trig_ep_en_o
+    ,output [`USB_TRACE_CTRL_TRIG_EP_W-1:0]         trace_ctrl_trig_ep_o
+    ,output [`USB_TRACE_CTRL_POST_W-1:0]            trace_ctrl_post_o
+    ,output [`USB_TRACE_FILT_PID_MASK_W-1:0]        trace_filt_pid_mask_o
+    ,output [`USB_TRACE_FILT_EP_MASK_W-1:0]         trace_filt_ep_mask_o
+    ,output [`USB_TRACE_DEPTH_W-1:0]                trace_idx_o
+    ,input  [`USB_TRACE_DEPTH_W-1:0]                trace_sts_wptr_i
+    ,input                                          trace_sts_wrap_i
+    ,input                                          trace_sts_triggered_i
+    ,input                                          trace_sts_stopped_i
+    ,input  [31:0]                                  trace_data0_i
+    ,input  [31:0]                                  trace_data1_i
+`endif
 
     ////// EPU(endpoint) interface
-    ,output [`USB_EP_NUM-1:0]                       ep_tx_ctrl_tx_start_o
-    ,output [`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM-1:0]   ep_tx_ctrl_tx_len_o     
-    ,output [`USB_EP_NUM-1:0]                       ep_rx_ctrl_rx_accept_o        
-    ,input  [`USB_EP_NUM-1:0]                       ep_sts_tx_err_i
-    ,input  [`USB_EP_NUM-1:0]                       ep_sts_tx_busy_i
-    ,input  [`USB_EP_NUM-1:0]                       ep_sts_rx_err_i 
-    ,input  [`USB_EP_NUM-1:0]                       ep_sts_rx_setup_i
-    ,input  [`USB_EP_NUM-1:0]                       ep_sts_rx_ready_i 
-    ,input  [`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0] ep_sts_rx_count_i
+    ,output [EP_NUM-1:0]                            ep_tx_ctrl_tx_start_o
+    ,output [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0]        ep_tx_ctrl_tx_len_o     
+    ,output [`USB_EP0_TX_CTRL_TX_MIN_W*EP_NUM-1:0]        ep_tx_ctrl_tx_min_o     
+    ,output [EP_NUM-1:0]                            ep_rx_ctrl_rx_accept_o        
+    ,input  [EP_NUM-1:0]                            ep_sts_tx_err_i
+    ,input  [EP_NUM-1:0]                            ep_sts_tx_busy_i
+    ,input  [EP_NUM-1:0]                            ep_sts_rx_err_i 
+    ,input  [EP_NUM-1:0]                            ep_sts_rx_setup_i
+    ,input  [EP_NUM-1:0]                            ep_sts_rx_ready_i 
+    ,input  [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0] ep_sts_rx_count_i
 
     ////// MEM(memory) interface
         // RX
-    ,output [`USB_EP_NUM-1:0]                       ep_rx_ctrl_rx_flush_o      
-    ,output [`USB_EP_NUM-1:0]                       ep_data_rd_req_o   
-    ,input  [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  ep_rx_data_i 
+    ,output [EP_NUM-1:0]                            ep_rx_ctrl_rx_flush_o      
+    ,output [EP_NUM-1:0]                            ep_data_rd_req_o   
+    ,input  [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       ep_rx_data_i 
         // TX
-    ,output [`USB_EP_NUM-1:0]                       ep_tx_ctrl_tx_flush_o
-    ,output [`USB_EP_NUM-1:0]                       ep_data_wt_req_o
-    ,output [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  ep_tx_data_o
+    ,output [EP_NUM-1:0]                            ep_tx_ctrl_tx_flush_o
+    ,output [EP_NUM-1:0]                            ep_data_wt_req_o
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       ep_tx_data_o
+        // FIFO fill level
+    ,input  [`USB_EP0_LEVEL_RX_LEVEL_W*EP_NUM-1:0]  ep_rx_level_i
+    ,input  [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  ep_tx_level_i
     
     ////// Device interface
     ,output                                         func_ctrl_phy_dmpulldown_o
@@ -82,7 +120,7 @@ module usbf_csr(
 // Register usb_func_ctrl
 //-----------------------------------------------------------------
 
-wire sel_func_ctrl = enable_i & (addr_i[7:0] == `USB_FUNC_CTRL);
+wire sel_func_ctrl = enable_i & (addr_i[11:0] == `USB_FUNC_CTRL);
 wire func_ctrl_wt_en = wt_en_i & sel_func_ctrl;
 wire func_ctrl_rd_en = rd_en_i & sel_func_ctrl;
 
@@ -183,12 +221,23 @@ usbf_gnrl_dfflrd #(`USB_FUNC_CTRL_INT_EN_RST_W, `USB_FUNC_CTRL_INT_EN_RST_DEFAUL
     );
 // assign func_ctrl_int_en_rst_o = func_ctrl_int_en_rst_r;
 
+// usb_func_ctrl_int_en_presof [internal]
+wire func_ctrl_int_en_presof_r;
+wire func_ctrl_int_en_presof_ena = func_ctrl_wt_en;
+wire func_ctrl_int_en_presof_next = wdata_i[`USB_FUNC_CTRL_INT_EN_PRESOF_R];
+usbf_gnrl_dfflrd #(`USB_FUNC_CTRL_INT_EN_PRESOF_W, `USB_FUNC_CTRL_INT_EN_PRESOF_DEFAULT) 
+    func_ctrl_int_en_presof_difflrd(
+        func_ctrl_int_en_presof_ena,func_ctrl_int_en_presof_next,
+        func_ctrl_int_en_presof_r,
+        hclk_i,rstn_i
+    );
+
 
 
 //-----------------------------------------------------------------
 // Register usb_func_stat
 //-----------------------------------------------------------------
-wire sel_func_stat = enable_i & (addr_i[7:0] == `USB_FUNC_STAT);
+wire sel_func_stat = enable_i & (addr_i[11:0] == `USB_FUNC_STAT);
 wire func_stat_wt_en = wt_en_i & sel_func_stat;
 wire func_stat_rd_en = rd_en_i & sel_func_stat;
 
@@ -235,18 +284,40 @@ usbf_gnrl_dfflrd #(`USB_FUNC_STAT_SOF_W, `USB_FUNC_STAT_SOF_DEFAULT)
     
 wire stat_sof_clr = func_stat_sof_r;
 
+// usb_func_stat_presof [auto_clr]: clear pre-sof interrupt, and it's a pulse singal
+wire func_stat_presof_r;
+wire func_stat_presof_set = func_stat_wt_en & wdata_i[`USB_FUNC_STAT_PRESOF_R];
+wire func_stat_presof_clr = func_stat_presof_r;
+wire func_stat_presof_ena = func_stat_presof_set | func_stat_presof_clr;
+wire func_stat_presof_next = func_stat_presof_set | (~func_stat_presof_clr);
+
+usbf_gnrl_dfflrd #(`USB_FUNC_STAT_PRESOF_W, `USB_FUNC_STAT_PRESOF_DEFAULT) 
+    func_stat_presof_difflrd(
+        func_stat_presof_ena,func_stat_presof_next,
+        func_stat_presof_r,
+        hclk_i,rstn_i
+    );
+    
+wire stat_presof_clr = func_stat_presof_r;
+
+
+// usb_rst_ctrl, used by usb_func_addr and usb_ep_cfg
+wire rst_ctrl_clr_addr_r;
+wire rst_ctrl_clr_stall_r;
 
 //-----------------------------------------------------------------
 // Register usb_func_addr
 //-----------------------------------------------------------------
-wire sel_func_addr = enable_i & (addr_i[7:0] == `USB_FUNC_ADDR);
+wire sel_func_addr = enable_i & (addr_i[11:0] == `USB_FUNC_ADDR);
 wire func_addr_wt_en = wt_en_i & sel_func_addr;
 wire func_addr_rd_en = rd_en_i & sel_func_addr;
 
 // usb_func_addr_dev_addr [internal]
 wire [ `USB_FUNC_ADDR_DEV_ADDR_W-1:0] func_addr_dev_addr_r;
-wire func_addr_dev_addr_ena = func_addr_wt_en;
-wire [ `USB_FUNC_ADDR_DEV_ADDR_W-1:0] func_addr_dev_addr_next = wdata_i[`USB_FUNC_ADDR_DEV_ADDR_R];
+wire func_addr_dev_addr_clr = rst_intr_set_i & rst_ctrl_clr_addr_r;
+wire func_addr_dev_addr_ena = func_addr_wt_en | func_addr_dev_addr_clr;
+wire [ `USB_FUNC_ADDR_DEV_ADDR_W-1:0] func_addr_dev_addr_next = func_addr_dev_addr_clr ? {`USB_FUNC_ADDR_DEV_ADDR_W{1'b0}} :
+                                                                wdata_i[`USB_FUNC_ADDR_DEV_ADDR_R];
 usbf_gnrl_dfflrd #(`USB_FUNC_ADDR_DEV_ADDR_W, `USB_FUNC_ADDR_DEV_ADDR_DEFAULT) 
     func_addr_dev_addr_difflrd(
         func_addr_dev_addr_ena,func_addr_dev_addr_next,
@@ -255,6 +326,258 @@ usbf_gnrl_dfflrd #(`USB_FUNC_ADDR_DEV_ADDR_W, `USB_FUNC_ADDR_DEV_ADDR_DEFAULT)
     );
 assign func_addr_dev_addr_o = func_addr_dev_addr_r;
 
+//-----------------------------------------------------------------
+// Register usb_nak_ctrl
+//-----------------------------------------------------------------
+wire sel_nak_ctrl = enable_i & (addr_i[11:0] == `USB_NAK_CTRL);
+wire nak_ctrl_wt_en = wt_en_i & sel_nak_ctrl;
+wire nak_ctrl_rd_en = rd_en_i & sel_nak_ctrl;
+
+// usb_nak_ctrl_holdoff [internal]
+wire [`USB_NAK_CTRL_HOLDOFF_W-1:0] nak_ctrl_holdoff_r;
+wire nak_ctrl_holdoff_ena = nak_ctrl_wt_en;
+wire [`USB_NAK_CTRL_HOLDOFF_W-1:0] nak_ctrl_holdoff_next = wdata_i[`USB_NAK_CTRL_HOLDOFF_R];
+usbf_gnrl_dfflrd #(`USB_NAK_CTRL_HOLDOFF_W, `USB_NAK_CTRL_HOLDOFF_DEFAULT) 
+    nak_ctrl_holdoff_difflrd(
+        nak_ctrl_holdoff_ena,nak_ctrl_holdoff_next,
+        nak_ctrl_holdoff_r,
+        hclk_i,rstn_i
+    );
+assign nak_ctrl_holdoff_o = nak_ctrl_holdoff_r;
+
+//-----------------------------------------------------------------
+// Register usb_sof_ctrl
+//-----------------------------------------------------------------
+wire sel_sof_ctrl = enable_i & (addr_i[11:0] == `USB_SOF_CTRL);
+wire sof_ctrl_wt_en = wt_en_i & sel_sof_ctrl;
+wire sof_ctrl_rd_en = rd_en_i & sel_sof_ctrl;
+
+// usb_sof_ctrl_sof_div [internal]
+wire [`USB_SOF_CTRL_SOF_DIV_W-1:0] sof_ctrl_sof_div_r;
+wire sof_ctrl_sof_div_ena = sof_ctrl_wt_en;
+wire [`USB_SOF_CTRL_SOF_DIV_W-1:0] sof_ctrl_sof_div_next = wdata_i[`USB_SOF_CTRL_SOF_DIV_R];
+usbf_gnrl_dfflrd #(`USB_SOF_CTRL_SOF_DIV_W, `USB_SOF_CTRL_SOF_DIV_DEFAULT) 
+    sof_ctrl_sof_div_difflrd(
+        sof_ctrl_sof_div_ena,sof_ctrl_sof_div_next,
+        sof_ctrl_sof_div_r,
+        hclk_i,rstn_i
+    );
+assign sof_ctrl_sof_div_o = sof_ctrl_sof_div_r;
+
+// usb_sof_ctrl_presof_lead [internal]
+wire [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0] sof_ctrl_presof_lead_r;
+wire sof_ctrl_presof_lead_ena = sof_ctrl_wt_en;
+wire [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0] sof_ctrl_presof_lead_next = wdata_i[`USB_SOF_CTRL_PRESOF_LEAD_R];
+usbf_gnrl_dfflrd #(`USB_SOF_CTRL_PRESOF_LEAD_W, `USB_SOF_CTRL_PRESOF_LEAD_DEFAULT) 
+    sof_ctrl_presof_lead_difflrd(
+        sof_ctrl_presof_lead_ena,sof_ctrl_presof_lead_next,
+        sof_ctrl_presof_lead_r,
+        hclk_i,rstn_i
+    );
+assign sof_ctrl_presof_lead_o = sof_ctrl_presof_lead_r;
+
+// usb_sof_ctrl_meas_win [internal]
+wire [`USB_SOF_CTRL_MEAS_WIN_W-1:0] sof_ctrl_meas_win_r;
+wire sof_ctrl_meas_win_ena = sof_ctrl_wt_en;
+wire [`USB_SOF_CTRL_MEAS_WIN_W-1:0] sof_ctrl_meas_win_next = wdata_i[`USB_SOF_CTRL_MEAS_WIN_R];
+usbf_gnrl_dfflrd #(`USB_SOF_CTRL_MEAS_WIN_W, `USB_SOF_CTRL_MEAS_WIN_DEFAULT) 
+    sof_ctrl_meas_win_difflrd(
+        sof_ctrl_meas_win_ena,sof_ctrl_meas_win_next,
+        sof_ctrl_meas_win_r,
+        hclk_i,rstn_i
+    );
+assign sof_ctrl_meas_win_o = sof_ctrl_meas_win_r;
+
+//-----------------------------------------------------------------
+// Register usb_sof_period
+//-----------------------------------------------------------------
+wire sel_sof_period = enable_i & (addr_i[11:0] == `USB_SOF_PERIOD);
+wire sof_period_rd_en = rd_en_i & sel_sof_period;
+
+//-----------------------------------------------------------------
+// Register usb_rst_ctrl
+//-----------------------------------------------------------------
+wire sel_rst_ctrl = enable_i & (addr_i[11:0] == `USB_RST_CTRL);
+wire rst_ctrl_wt_en = wt_en_i & sel_rst_ctrl;
+wire rst_ctrl_rd_en = rd_en_i & sel_rst_ctrl;
+
+// usb_rst_ctrl_clr_addr [internal]
+// wire rst_ctrl_clr_addr_r; // define ahead
+wire rst_ctrl_clr_addr_ena = rst_ctrl_wt_en;
+wire rst_ctrl_clr_addr_next = wdata_i[`USB_RST_CTRL_CLR_ADDR_R];
+usbf_gnrl_dfflrd #(`USB_RST_CTRL_CLR_ADDR_W, `USB_RST_CTRL_CLR_ADDR_DEFAULT) 
+    rst_ctrl_clr_addr_difflrd(
+        rst_ctrl_clr_addr_ena,rst_ctrl_clr_addr_next,
+        rst_ctrl_clr_addr_r,
+        hclk_i,rstn_i
+    );
+
+// usb_rst_ctrl_clr_stall [internal]
+// wire rst_ctrl_clr_stall_r; // define ahead
+wire rst_ctrl_clr_stall_ena = rst_ctrl_wt_en;
+wire rst_ctrl_clr_stall_next = wdata_i[`USB_RST_CTRL_CLR_STALL_R];
+usbf_gnrl_dfflrd #(`USB_RST_CTRL_CLR_STALL_W, `USB_RST_CTRL_CLR_STALL_DEFAULT) 
+    rst_ctrl_clr_stall_difflrd(
+        rst_ctrl_clr_stall_ena,rst_ctrl_clr_stall_next,
+        rst_ctrl_clr_stall_r,
+        hclk_i,rstn_i
+    );
+
+// usb_rst_ctrl_flush [internal]
+wire rst_ctrl_flush_r;
+wire rst_ctrl_flush_ena = rst_ctrl_wt_en;
+wire rst_ctrl_flush_next = wdata_i[`USB_RST_CTRL_FLUSH_R];
+usbf_gnrl_dfflrd #(`USB_RST_CTRL_FLUSH_W, `USB_RST_CTRL_FLUSH_DEFAULT) 
+    rst_ctrl_flush_difflrd(
+        rst_ctrl_flush_ena,rst_ctrl_flush_next,
+        rst_ctrl_flush_r,
+        hclk_i,rstn_i
+    );
+assign rst_ctrl_flush_o = rst_ctrl_flush_r;
+
+`ifdef USB_TRACE
+//-----------------------------------------------------------------
+// Register usb_trace_ctrl
+//-----------------------------------------------------------------
+wire sel_trace_ctrl = enable_i & (addr_i[11:0] == `USB_TRACE_CTRL);
+wire trace_ctrl_wt_en = wt_en_i & sel_trace_ctrl;
+wire trace_ctrl_rd_en = rd_en_i & sel_trace_ctrl;
+
+// usb_trace_ctrl_en [internal]
+wire trace_ctrl_en_r;
+wire trace_ctrl_en_ena = trace_ctrl_wt_en;
+wire trace_ctrl_en_next = wdata_i[`USB_TRACE_CTRL_EN_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_CTRL_EN_W, `USB_TRACE_CTRL_EN_DEFAULT) 
+    trace_ctrl_en_difflrd(
+        trace_ctrl_en_ena,trace_ctrl_en_next,
+        trace_ctrl_en_r,
+        hclk_i,rstn_i
+    );
+assign trace_ctrl_en_o = trace_ctrl_en_r;
+
+// usb_trace_ctrl_trig_en [internal]
+wire trace_ctrl_trig_en_r;
+wire trace_ctrl_trig_en_ena = trace_ctrl_wt_en;
+wire trace_ctrl_trig_en_next = wdata_i[`USB_TRACE_CTRL_TRIG_EN_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_CTRL_TRIG_EN_W, `USB_TRACE_CTRL_TRIG_EN_DEFAULT) 
+    trace_ctrl_trig_en_difflrd(
+        trace_ctrl_trig_en_ena,trace_ctrl_trig_en_next,
+        trace_ctrl_trig_en_r,
+        hclk_i,rstn_i
+    );
+assign trace_ctrl_trig_en_o = trace_ctrl_trig_en_r;
+
+// usb_trace_ctrl_trig_pid [internal]
+wire [`USB_TRACE_CTRL_TRIG_PID_W-1:0] trace_ctrl_trig_pid_r;
+wire trace_ctrl_trig_pid_ena = trace_ctrl_wt_en;
+wire [`USB_TRACE_CTRL_TRIG_PID_W-1:0] trace_ctrl_trig_pid_next = wdata_i[`USB_TRACE_CTRL_TRIG_PID_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_CTRL_TRIG_PID_W, `USB_TRACE_CTRL_TRIG_PID_DEFAULT) 
+    trace_ctrl_trig_pid_difflrd(
+        trace_ctrl_trig_pid_ena,trace_ctrl_trig_pid_next,
+        trace_ctrl_trig_pid_r,
+        hclk_i,rstn_i
+    );
+assign trace_ctrl_trig_pid_o = trace_ctrl_trig_pid_r;
+
+// usb_trace_ctrl_trig_ep_en [internal]
+wire trace_ctrl_trig_ep_en_r;
+wire trace_ctrl_trig_ep_en_ena = trace_ctrl_wt_en;
+wire trace_ctrl_trig_ep_en_next = wdata_i[`USB_TRACE_CTRL_TRIG_EP_EN_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_CTRL_TRIG_EP_EN_W, `USB_TRACE_CTRL_TRIG_EP_EN_DEFAULT) 
+    trace_ctrl_trig_ep_en_difflrd(
+        trace_ctrl_trig_ep_en_ena,trace_ctrl_trig_ep_en_next,
+        trace_ctrl_trig_ep_en_r,
+        hclk_i,rstn_i
+    );
+assign trace_ctrl_trig_ep_en_o = trace_ctrl_trig_ep_en_r;
+
+// usb_trace_ctrl_trig_ep [internal]
+wire [`USB_TRACE_CTRL_TRIG_EP_W-1:0] trace_ctrl_trig_ep_r;
+wire trace_ctrl_trig_ep_ena = trace_ctrl_wt_en;
+wire [`USB_TRACE_CTRL_TRIG_EP_W-1:0] trace_ctrl_trig_ep_next = wdata_i[`USB_TRACE_CTRL_TRIG_EP_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_CTRL_TRIG_EP_W, `USB_TRACE_CTRL_TRIG_EP_DEFAULT) 
+    trace_ctrl_trig_ep_difflrd(
+        trace_ctrl_trig_ep_ena,trace_ctrl_trig_ep_next,
+        trace_ctrl_trig_ep_r,
+        hclk_i,rstn_i
+    );
+assign trace_ctrl_trig_ep_o = trace_ctrl_trig_ep_r;
+
+// usb_trace_ctrl_post [internal]
+wire [`USB_TRACE_CTRL_POST_W-1:0] trace_ctrl_post_r;
+wire trace_ctrl_post_ena = trace_ctrl_wt_en;
+wire [`USB_TRACE_CTRL_POST_W-1:0] trace_ctrl_post_next = wdata_i[`USB_TRACE_CTRL_POST_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_CTRL_POST_W, `USB_TRACE_CTRL_POST_DEFAULT) 
+    trace_ctrl_post_difflrd(
+        trace_ctrl_post_ena,trace_ctrl_post_next,
+        trace_ctrl_post_r,
+        hclk_i,rstn_i
+    );
+assign trace_ctrl_post_o = trace_ctrl_post_r;
+
+//-----------------------------------------------------------------
+// Register usb_trace_filt
+//-----------------------------------------------------------------
+wire sel_trace_filt = enable_i & (addr_i[11:0] == `USB_TRACE_FILT);
+wire trace_filt_wt_en = wt_en_i & sel_trace_filt;
+wire trace_filt_rd_en = rd_en_i & sel_trace_filt;
+
+// usb_trace_filt_pid_mask [internal]
+wire [`USB_TRACE_FILT_PID_MASK_W-1:0] trace_filt_pid_mask_r;
+wire trace_filt_pid_mask_ena = trace_filt_wt_en;
+wire [`USB_TRACE_FILT_PID_MASK_W-1:0] trace_filt_pid_mask_next = wdata_i[`USB_TRACE_FILT_PID_MASK_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_FILT_PID_MASK_W, `USB_TRACE_FILT_PID_MASK_DEFAULT) 
+    trace_filt_pid_mask_difflrd(
+        trace_filt_pid_mask_ena,trace_filt_pid_mask_next,
+        trace_filt_pid_mask_r,
+        hclk_i,rstn_i
+    );
+assign trace_filt_pid_mask_o = trace_filt_pid_mask_r;
+
+// usb_trace_filt_ep_mask [internal]
+wire [`USB_TRACE_FILT_EP_MASK_W-1:0] trace_filt_ep_mask_r;
+wire trace_filt_ep_mask_ena = trace_filt_wt_en;
+wire [`USB_TRACE_FILT_EP_MASK_W-1:0] trace_filt_ep_mask_next = wdata_i[`USB_TRACE_FILT_EP_MASK_R];
+usbf_gnrl_dfflrd #(`USB_TRACE_FILT_EP_MASK_W, `USB_TRACE_FILT_EP_MASK_DEFAULT) 
+    trace_filt_ep_mask_difflrd(
+        trace_filt_ep_mask_ena,trace_filt_ep_mask_next,
+        trace_filt_ep_mask_r,
+        hclk_i,rstn_i
+    );
+assign trace_filt_ep_mask_o = trace_filt_ep_mask_r;
+
+//-----------------------------------------------------------------
+// Register usb_trace_sts
+//-----------------------------------------------------------------
+wire sel_trace_sts = enable_i & (addr_i[11:0] == `USB_TRACE_STS);
+wire trace_sts_rd_en = rd_en_i & sel_trace_sts;
+
+//-----------------------------------------------------------------
+// Register usb_trace_idx
+//-----------------------------------------------------------------
+wire sel_trace_idx = enable_i & (addr_i[11:0] == `USB_TRACE_IDX);
+wire trace_idx_wt_en = wt_en_i & sel_trace_idx;
+wire trace_idx_rd_en = rd_en_i & sel_trace_idx;
+
+// usb_trace_idx [internal]
+wire [`USB_TRACE_DEPTH_W-1:0] trace_idx_r;
+wire trace_idx_ena = trace_idx_wt_en;
+wire [`USB_TRACE_DEPTH_W-1:0] trace_idx_next = wdata_i[`USB_TRACE_IDX_IDX_B +: `USB_TRACE_DEPTH_W];
+usbf_gnrl_dfflrd #(`USB_TRACE_DEPTH_W, {`USB_TRACE_DEPTH_W{1'b0}}) 
+    trace_idx_difflrd(
+        trace_idx_ena,trace_idx_next,
+        trace_idx_r,
+        hclk_i,rstn_i
+    );
+assign trace_idx_o = trace_idx_r;
+
+//-----------------------------------------------------------------
+// Register usb_trace_data0/1
+//-----------------------------------------------------------------
+wire sel_trace_data0 = enable_i & (addr_i[11:0] == `USB_TRACE_DATA0);
+wire sel_trace_data1 = enable_i & (addr_i[11:0] == `USB_TRACE_DATA1);
+`endif
+
 //==========================================================================================
 //==========================================================================================
 genvar i;
@@ -263,84 +586,150 @@ genvar i;
 //// and the configuration of bit fields is the same
 generate //{
     //// USB_EPx_CFG
-    wire sel_ep_cfg[`USB_EP_NUM-1:0];
-    wire ep_cfg_wt_en[`USB_EP_NUM-1:0];
-    wire ep_cfg_rd_en[`USB_EP_NUM-1:0];
+    wire sel_ep_cfg[EP_NUM-1:0];
+    wire ep_cfg_wt_en[EP_NUM-1:0];
+    wire ep_cfg_rd_en[EP_NUM-1:0];
+
+    wire ep_cfg_int_rx_r[EP_NUM-1:0];
+    wire ep_cfg_int_rx_ena[EP_NUM-1:0];
+    wire ep_cfg_int_rx_next[EP_NUM-1:0];
+
+    wire ep_cfg_int_tx_r[EP_NUM-1:0];
+    wire ep_cfg_int_tx_ena[EP_NUM-1:0];
+    wire ep_cfg_int_tx_next[EP_NUM-1:0];
+
+    wire ep_cfg_int_in_nak_r[EP_NUM-1:0];
+    wire ep_cfg_int_in_nak_ena[EP_NUM-1:0];
+    wire ep_cfg_int_in_nak_next[EP_NUM-1:0];
+
+    wire ep_cfg_int_out_nak_r[EP_NUM-1:0];
+    wire ep_cfg_int_out_nak_ena[EP_NUM-1:0];
+    wire ep_cfg_int_out_nak_next[EP_NUM-1:0];
+
+    wire ep_cfg_stall_ep_ack[EP_NUM-1:0];
+    wire ep_cfg_stall_ep_r[EP_NUM-1:0];
+    wire ep_cfg_stall_ep_set[EP_NUM-1:0];
+    wire ep_cfg_stall_ep_clr[EP_NUM-1:0];
+    wire ep_cfg_stall_ep_ena[EP_NUM-1:0];
+    wire ep_cfg_stall_ep_next[EP_NUM-1:0];
 
-    wire ep_cfg_int_rx_r[`USB_EP_NUM-1:0];
-    wire ep_cfg_int_rx_ena[`USB_EP_NUM-1:0];
-    wire ep_cfg_int_rx_next[`USB_EP_NUM-1:0];
+    wire ep_cfg_iso_r[EP_NUM-1:0];
+    wire ep_cfg_iso_ena[EP_NUM-1:0];
+    wire ep_cfg_iso_next[EP_NUM-1:0];
 
-    wire ep_cfg_int_tx_r[`USB_EP_NUM-1:0];
-    wire ep_cfg_int_tx_ena[`USB_EP_NUM-1:0];
-    wire ep_cfg_int_tx_next[`USB_EP_NUM-1:0];
+    wire ep_cfg_loopback_en_r[EP_NUM-1:0];
+    wire ep_cfg_loopback_en_ena[EP_NUM-1:0];
+    wire ep_cfg_loopback_en_next[EP_NUM-1:0];
 
-    wire ep_cfg_stall_ep_ack[`USB_EP_NUM-1:0];
-    wire ep_cfg_stall_ep_r[`USB_EP_NUM-1:0];
-    wire ep_cfg_stall_ep_set[`USB_EP_NUM-1:0];
-    wire ep_cfg_stall_ep_clr[`USB_EP_NUM-1:0];
-    wire ep_cfg_stall_ep_ena[`USB_EP_NUM-1:0];
-    wire ep_cfg_stall_ep_next[`USB_EP_NUM-1:0];
+    wire ep_cfg_auto_accept_r[EP_NUM-1:0];
+    wire ep_cfg_auto_accept_ena[EP_NUM-1:0];
+    wire ep_cfg_auto_accept_next[EP_NUM-1:0];
 
-    wire ep_cfg_iso_r[`USB_EP_NUM-1:0];
-    wire ep_cfg_iso_ena[`USB_EP_NUM-1:0];
-    wire ep_cfg_iso_next[`USB_EP_NUM-1:0];
+    wire [`USB_EP0_CFG_LOOPBACK_EP_W-1:0] ep_cfg_loopback_ep_r[EP_NUM-1:0];
+    wire ep_cfg_loopback_ep_ena[EP_NUM-1:0];
+    wire [`USB_EP0_CFG_LOOPBACK_EP_W-1:0] ep_cfg_loopback_ep_next[EP_NUM-1:0];
+
+    wire ep_cfg_int_rx_lvl_r[EP_NUM-1:0];
+    wire ep_cfg_int_rx_lvl_ena[EP_NUM-1:0];
+    wire ep_cfg_int_rx_lvl_next[EP_NUM-1:0];
+
+    wire ep_cfg_int_tx_lvl_r[EP_NUM-1:0];
+    wire ep_cfg_int_tx_lvl_ena[EP_NUM-1:0];
+    wire ep_cfg_int_tx_lvl_next[EP_NUM-1:0];
+
+    wire ep_cfg_crc_en_r[EP_NUM-1:0];
+    wire ep_cfg_crc_en_ena[EP_NUM-1:0];
+    wire ep_cfg_crc_en_next[EP_NUM-1:0];
 
     //// USB_EPx_TX_CTRL
-    wire sel_ep_tx_ctrl[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_wt_en[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_rd_en[`USB_EP_NUM-1:0];
-
-    wire ep_tx_ctrl_tx_flush_r[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_flush_set[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_flush_clr[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_flush_ena[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_flush_next[`USB_EP_NUM-1:0];
-
-    wire ep_tx_ctrl_tx_start_r[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_start_set[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_start_clr[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_start_ena[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_start_next[`USB_EP_NUM-1:0];
-
-    wire [`USB_EP0_TX_CTRL_TX_LEN_W-1:0] ep_tx_ctrl_tx_len_r[`USB_EP_NUM-1:0];
-    wire ep_tx_ctrl_tx_len_ena[`USB_EP_NUM-1:0];
-    wire [`USB_EP0_TX_CTRL_TX_LEN_W-1:0] ep_tx_ctrl_tx_len_next[`USB_EP_NUM-1:0];
+    wire sel_ep_tx_ctrl[EP_NUM-1:0];
+    wire ep_tx_ctrl_wt_en[EP_NUM-1:0];
+    wire ep_tx_ctrl_rd_en[EP_NUM-1:0];
+
+    wire ep_tx_ctrl_tx_flush_r[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_flush_set[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_flush_clr[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_flush_ena[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_flush_next[EP_NUM-1:0];
+
+    wire ep_tx_ctrl_tx_start_r[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_start_set[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_start_clr[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_start_ena[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_start_next[EP_NUM-1:0];
+
+    wire [`USB_EP0_TX_CTRL_TX_LEN_W-1:0] ep_tx_ctrl_tx_len_r[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_len_ena[EP_NUM-1:0];
+    wire [`USB_EP0_TX_CTRL_TX_LEN_W-1:0] ep_tx_ctrl_tx_len_next[EP_NUM-1:0];
+
+    wire [`USB_EP0_TX_CTRL_TX_MIN_W-1:0] ep_tx_ctrl_tx_min_r[EP_NUM-1:0];
+    wire ep_tx_ctrl_tx_min_ena[EP_NUM-1:0];
+    wire [`USB_EP0_TX_CTRL_TX_MIN_W-1:0] ep_tx_ctrl_tx_min_next[EP_NUM-1:0];
 
     //// USB_EPx_RX_CTRL
-    wire sel_ep_rx_ctrl[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_wt_en[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rd_en[`USB_EP_NUM-1:0];
-
-    wire ep_rx_ctrl_rx_flush_r[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_flush_set[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_flush_clr[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_flush_ena[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_flush_next[`USB_EP_NUM-1:0];
-
-    wire ep_rx_ctrl_rx_accept_r[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_accept_set[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_accept_clr[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_accept_ena[`USB_EP_NUM-1:0];
-    wire ep_rx_ctrl_rx_accept_next[`USB_EP_NUM-1:0];
+    wire sel_ep_rx_ctrl[EP_NUM-1:0];
+    wire ep_rx_ctrl_wt_en[EP_NUM-1:0];
+    wire ep_rx_ctrl_rd_en[EP_NUM-1:0];
+
+    wire ep_rx_ctrl_rx_flush_r[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_flush_set[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_flush_clr[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_flush_ena[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_flush_next[EP_NUM-1:0];
+
+    wire ep_rx_ctrl_rx_accept_r[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_accept_set[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_accept_clr[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_accept_ena[EP_NUM-1:0];
+    wire ep_rx_ctrl_rx_accept_next[EP_NUM-1:0];
 
     //// USB_EPx_STS
-    wire sel_ep_sts[`USB_EP_NUM-1:0];
-    wire ep_sts_wt_en[`USB_EP_NUM-1:0];
-    wire ep_sts_rd_en[`USB_EP_NUM-1:0];
+    wire sel_ep_sts[EP_NUM-1:0];
+    wire ep_sts_wt_en[EP_NUM-1:0];
+    wire ep_sts_rd_en[EP_NUM-1:0];
+
+    //// USB_EP_SUMMARY
+    wire sel_ep_summary[EP_NUM-1:0];
+
+    //// USB_EPx_LEVEL
+    wire sel_ep_level[EP_NUM-1:0];
+
+    //// USB_EPx_THR
+    wire sel_ep_thr[EP_NUM-1:0];
+    wire ep_thr_wt_en[EP_NUM-1:0];
+    wire ep_thr_rd_en[EP_NUM-1:0];
+
+    wire [`USB_EP0_THR_RX_THR_W-1:0] ep_thr_rx_thr_r[EP_NUM-1:0];
+    wire ep_thr_rx_thr_ena[EP_NUM-1:0];
+    wire [`USB_EP0_THR_RX_THR_W-1:0] ep_thr_rx_thr_next[EP_NUM-1:0];
+
+    wire [`USB_EP0_THR_TX_THR_W-1:0] ep_thr_tx_thr_r[EP_NUM-1:0];
+    wire ep_thr_tx_thr_ena[EP_NUM-1:0];
+    wire [`USB_EP0_THR_TX_THR_W-1:0] ep_thr_tx_thr_next[EP_NUM-1:0];
+
+    //// USB_EPx_CRC
+    wire sel_ep_crc[EP_NUM-1:0];
+    wire ep_crc_wt_en[EP_NUM-1:0];
+    wire ep_crc_rd_en[EP_NUM-1:0];
+
+    wire [`USB_EP0_CRC_CRC_W-1:0] ep_crc_crc_r[EP_NUM-1:0];
+    wire ep_crc_crc_upd[EP_NUM-1:0];
+    wire ep_crc_crc_ena[EP_NUM-1:0];
+    wire [`USB_EP0_CRC_CRC_W-1:0] ep_crc_crc_fold[EP_NUM-1:0];
+    wire [`USB_EP0_CRC_CRC_W-1:0] ep_crc_crc_next[EP_NUM-1:0];
 
     //// USB_EPx_DATA
-    wire sel_ep_data[`USB_EP_NUM-1:0];
-    wire ep_data_wt_en[`USB_EP_NUM-1:0];
-    wire ep_data_rd_en[`USB_EP_NUM-1:0];
+    wire sel_ep_data[EP_NUM-1:0];
+    wire ep_data_wt_en[EP_NUM-1:0];
+    wire ep_data_rd_en[EP_NUM-1:0];
 
-    wire [`USB_EP0_DATA_DATA_W-1:0] ep_tx_data[`USB_EP_NUM-1:0];
+    wire [`USB_EP0_DATA_DATA_W-1:0] ep_tx_data[EP_NUM-1:0];
 
-    for(i=0; i<`USB_EP_NUM; i=i+1)begin:regs_ep
+    for(i=0; i<EP_NUM; i=i+1)begin:regs_ep
         //-----------------------------------------------------------------
         // Register usb_ep_cfg
         //-----------------------------------------------------------------
-        assign sel_ep_cfg[i] = enable_i & (addr_i[7:0] == (`USB_EP0_CFG + i*`USB_EP_STRIDE));
+        assign sel_ep_cfg[i] = enable_i & (addr_i[11:0] == (`USB_EP0_CFG + i*`USB_EP_STRIDE));
         assign ep_cfg_wt_en[i] = wt_en_i & sel_ep_cfg[i];
         assign ep_cfg_rd_en[i] = rd_en_i & sel_ep_cfg[i];
 
@@ -366,10 +755,30 @@ generate //{
             );
         // assign ep_cfg_int_tx_o[i] = ep_cfg_int_tx_r[i];
 
+        // usb_ep_cfg_int_in_nak [internal]
+        assign ep_cfg_int_in_nak_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_int_in_nak_next[i] = wdata_i[`USB_EP0_CFG_INT_IN_NAK_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_INT_IN_NAK_W, `USB_EP0_CFG_INT_IN_NAK_DEFAULT) 
+            ep_cfg_int_in_nak_difflrd(
+                ep_cfg_int_in_nak_ena[i],ep_cfg_int_in_nak_next[i],
+                ep_cfg_int_in_nak_r[i],
+                hclk_i,rstn_i
+            );
+
+        // usb_ep_cfg_int_out_nak [internal]
+        assign ep_cfg_int_out_nak_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_int_out_nak_next[i] = wdata_i[`USB_EP0_CFG_INT_OUT_NAK_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_INT_OUT_NAK_W, `USB_EP0_CFG_INT_OUT_NAK_DEFAULT) 
+            ep_cfg_int_out_nak_difflrd(
+                ep_cfg_int_out_nak_ena[i],ep_cfg_int_out_nak_next[i],
+                ep_cfg_int_out_nak_r[i],
+                hclk_i,rstn_i
+            );
+
         // usb_ep_cfg_stall_ep [clearable]
         assign ep_cfg_stall_ep_ack[i] = ep_sts_rx_setup_i[i];
         assign ep_cfg_stall_ep_set[i] = ep_cfg_wt_en[i] & wdata_i[`USB_EP0_CFG_STALL_EP_R];
-        assign ep_cfg_stall_ep_clr[i] = ep_cfg_stall_ep_ack[i];
+        assign ep_cfg_stall_ep_clr[i] = ep_cfg_stall_ep_ack[i] | (rst_intr_set_i & rst_ctrl_clr_stall_r);
         assign ep_cfg_stall_ep_ena[i] = ep_cfg_stall_ep_set[i] | ep_cfg_stall_ep_clr[i];
         assign ep_cfg_stall_ep_next[i] = ep_cfg_stall_ep_set[i] | (~ep_cfg_stall_ep_clr[i]);
         usbf_gnrl_dfflrd #(`USB_EP0_CFG_STALL_EP_W, `USB_EP0_CFG_STALL_EP_DEFAULT) 
@@ -391,10 +800,73 @@ generate //{
             );
         assign ep_cfg_iso_o[i] = ep_cfg_iso_r[i];
 
+        // usb_ep_cfg_loopback_en [internal]
+        assign ep_cfg_loopback_en_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_loopback_en_next[i] = wdata_i[`USB_EP0_CFG_LOOPBACK_EN_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_LOOPBACK_EN_W, `USB_EP0_CFG_LOOPBACK_EN_DEFAULT) 
+            ep_cfg_loopback_en_difflrd(
+                ep_cfg_loopback_en_ena[i],ep_cfg_loopback_en_next[i],
+                ep_cfg_loopback_en_r[i],
+                hclk_i,rstn_i
+            );
+        assign ep_cfg_loopback_en_o[i] = ep_cfg_loopback_en_r[i];
+
+        // usb_ep_cfg_auto_accept [internal]
+        assign ep_cfg_auto_accept_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_auto_accept_next[i] = wdata_i[`USB_EP0_CFG_AUTO_ACCEPT_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_AUTO_ACCEPT_W, `USB_EP0_CFG_AUTO_ACCEPT_DEFAULT) 
+            ep_cfg_auto_accept_difflrd(
+                ep_cfg_auto_accept_ena[i],ep_cfg_auto_accept_next[i],
+                ep_cfg_auto_accept_r[i],
+                hclk_i,rstn_i
+            );
+        assign ep_cfg_auto_accept_o[i] = ep_cfg_auto_accept_r[i];
+
+        // usb_ep_cfg_loopback_ep [internal]
+        assign ep_cfg_loopback_ep_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_loopback_ep_next[i] = wdata_i[`USB_EP0_CFG_LOOPBACK_EP_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_LOOPBACK_EP_W, `USB_EP0_CFG_LOOPBACK_EP_DEFAULT) 
+            ep_cfg_loopback_ep_difflrd(
+                ep_cfg_loopback_ep_ena[i],ep_cfg_loopback_ep_next[i],
+                ep_cfg_loopback_ep_r[i],
+                hclk_i,rstn_i
+            );
+        assign ep_cfg_loopback_ep_o[i*`USB_EP0_CFG_LOOPBACK_EP_W +: `USB_EP0_CFG_LOOPBACK_EP_W] = ep_cfg_loopback_ep_r[i];
+
+        // usb_ep_cfg_int_rx_lvl [internal]
+        assign ep_cfg_int_rx_lvl_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_int_rx_lvl_next[i] = wdata_i[`USB_EP0_CFG_INT_RX_LVL_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_INT_RX_LVL_W, `USB_EP0_CFG_INT_RX_LVL_DEFAULT) 
+            ep_cfg_int_rx_lvl_difflrd(
+                ep_cfg_int_rx_lvl_ena[i],ep_cfg_int_rx_lvl_next[i],
+                ep_cfg_int_rx_lvl_r[i],
+                hclk_i,rstn_i
+            );
+
+        // usb_ep_cfg_int_tx_lvl [internal]
+        assign ep_cfg_int_tx_lvl_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_int_tx_lvl_next[i] = wdata_i[`USB_EP0_CFG_INT_TX_LVL_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_INT_TX_LVL_W, `USB_EP0_CFG_INT_TX_LVL_DEFAULT) 
+            ep_cfg_int_tx_lvl_difflrd(
+                ep_cfg_int_tx_lvl_ena[i],ep_cfg_int_tx_lvl_next[i],
+                ep_cfg_int_tx_lvl_r[i],
+                hclk_i,rstn_i
+            );
+
+        // usb_ep_cfg_crc_en [internal]
+        assign ep_cfg_crc_en_ena[i] = ep_cfg_wt_en[i];
+        assign ep_cfg_crc_en_next[i] = wdata_i[`USB_EP0_CFG_CRC_EN_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_CFG_CRC_EN_W, `USB_EP0_CFG_CRC_EN_DEFAULT) 
+            ep_cfg_crc_en_difflrd(
+                ep_cfg_crc_en_ena[i],ep_cfg_crc_en_next[i],
+                ep_cfg_crc_en_r[i],
+                hclk_i,rstn_i
+            );
+
         //-----------------------------------------------------------------
         // Register usb_ep_tx_ctrl
         //-----------------------------------------------------------------
-        assign sel_ep_tx_ctrl[i] = enable_i & (addr_i[7:0] == (`USB_EP0_TX_CTRL + i*`USB_EP_STRIDE));
+        assign sel_ep_tx_ctrl[i] = enable_i & (addr_i[11:0] == (`USB_EP0_TX_CTRL + i*`USB_EP_STRIDE));
         assign ep_tx_ctrl_wt_en[i] = wt_en_i & sel_ep_tx_ctrl[i];
         assign ep_tx_ctrl_rd_en[i] = rd_en_i & sel_ep_tx_ctrl[i];
 
@@ -435,10 +907,21 @@ generate //{
             );
         assign ep_tx_ctrl_tx_len_o[i*`USB_EP0_TX_CTRL_TX_LEN_W +: `USB_EP0_TX_CTRL_TX_LEN_W] = ep_tx_ctrl_tx_len_r[i];
 
+        // usb_ep_tx_ctrl_tx_min [internal]
+        assign ep_tx_ctrl_tx_min_ena[i] = ep_tx_ctrl_wt_en[i];
+        assign ep_tx_ctrl_tx_min_next[i] = wdata_i[`USB_EP0_TX_CTRL_TX_MIN_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_TX_CTRL_TX_MIN_W, `USB_EP0_TX_CTRL_TX_MIN_DEFAULT) 
+            ep_tx_ctrl_tx_min_difflrd(
+                ep_tx_ctrl_tx_min_ena[i],ep_tx_ctrl_tx_min_next[i],
+                ep_tx_ctrl_tx_min_r[i],
+                hclk_i,rstn_i
+            );
+        assign ep_tx_ctrl_tx_min_o[i*`USB_EP0_TX_CTRL_TX_MIN_W +: `USB_EP0_TX_CTRL_TX_MIN_W] = ep_tx_ctrl_tx_min_r[i];
+
         //-----------------------------------------------------------------
         // Register usb_ep_rx_ctrl
         //-----------------------------------------------------------------
-        assign sel_ep_rx_ctrl[i] = enable_i & (addr_i[7:0] == (`USB_EP0_RX_CTRL + i*`USB_EP_STRIDE));
+        assign sel_ep_rx_ctrl[i] = enable_i & (addr_i[11:0] == (`USB_EP0_RX_CTRL + i*`USB_EP_STRIDE));
         assign ep_rx_ctrl_wt_en[i] = wt_en_i & sel_ep_rx_ctrl[i];
         assign ep_rx_ctrl_rd_en[i] = rd_en_i & sel_ep_rx_ctrl[i];
 
@@ -471,14 +954,75 @@ generate //{
         //-----------------------------------------------------------------
         // Register usb_ep_sts
         //-----------------------------------------------------------------
-        assign sel_ep_sts[i] = enable_i & (addr_i[7:0] == (`USB_EP0_STS + i*`USB_EP_STRIDE));
+        assign sel_ep_sts[i] = enable_i & (addr_i[11:0] == (`USB_EP0_STS + i*`USB_EP_STRIDE));
         assign ep_sts_wt_en[i] = wt_en_i & sel_ep_sts[i];
         assign ep_sts_rd_en[i] = rd_en_i & sel_ep_sts[i];
 
+        //-----------------------------------------------------------------
+        // Register usb_ep_summary, two endpoints per register
+        //-----------------------------------------------------------------
+        assign sel_ep_summary[i] = enable_i & (addr_i[11:0] == (`USB_EP_SUMMARY + (i/2)*4));
+
+        //-----------------------------------------------------------------
+        // Register usb_ep_level
+        //-----------------------------------------------------------------
+        assign sel_ep_level[i] = enable_i & (addr_i[11:0] == (`USB_EP0_LEVEL + i*`USB_EP_STRIDE));
+
+        //-----------------------------------------------------------------
+        // Register usb_ep_thr
+        //-----------------------------------------------------------------
+        assign sel_ep_thr[i] = enable_i & (addr_i[11:0] == (`USB_EP0_THR + i*`USB_EP_STRIDE));
+        assign ep_thr_wt_en[i] = wt_en_i & sel_ep_thr[i];
+        assign ep_thr_rd_en[i] = rd_en_i & sel_ep_thr[i];
+
+        // usb_ep_thr_rx_thr [internal]
+        assign ep_thr_rx_thr_ena[i] = ep_thr_wt_en[i];
+        assign ep_thr_rx_thr_next[i] = wdata_i[`USB_EP0_THR_RX_THR_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_THR_RX_THR_W, `USB_EP0_THR_RX_THR_DEFAULT) 
+            ep_thr_rx_thr_difflrd(
+                ep_thr_rx_thr_ena[i],ep_thr_rx_thr_next[i],
+                ep_thr_rx_thr_r[i],
+                hclk_i,rstn_i
+            );
+
+        // usb_ep_thr_tx_thr [internal]
+        assign ep_thr_tx_thr_ena[i] = ep_thr_wt_en[i];
+        assign ep_thr_tx_thr_next[i] = wdata_i[`USB_EP0_THR_TX_THR_R];
+        usbf_gnrl_dfflrd #(`USB_EP0_THR_TX_THR_W, `USB_EP0_THR_TX_THR_DEFAULT) 
+            ep_thr_tx_thr_difflrd(
+                ep_thr_tx_thr_ena[i],ep_thr_tx_thr_next[i],
+                ep_thr_tx_thr_r[i],
+                hclk_i,rstn_i
+            );
+
+        //-----------------------------------------------------------------
+        // Register usb_ep_crc
+        //-----------------------------------------------------------------
+        assign sel_ep_crc[i] = enable_i & (addr_i[11:0] == (`USB_EP0_CRC + i*`USB_EP_STRIDE));
+        assign ep_crc_wt_en[i] = wt_en_i & sel_ep_crc[i];
+        assign ep_crc_rd_en[i] = rd_en_i & sel_ep_crc[i];
+
+        // usb_ep_crc_crc [internal]
+        // write: seed, a byte read from usb_ep_data finished: fold in
+        assign ep_crc_crc_upd[i] = ep_cfg_crc_en_r[i] & sel_ep_data[i] & mem_rd_ready_i;
+        assign ep_crc_crc_ena[i] = ep_crc_wt_en[i] | ep_crc_crc_upd[i];
+        assign ep_crc_crc_next[i] = ep_crc_wt_en[i] ? wdata_i[`USB_EP0_CRC_CRC_R] : ep_crc_crc_fold[i];
+        usbf_crc32 u_crc32(
+            .crc_in_i(ep_crc_crc_r[i]),
+            .din_i(ep_rx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
+            .crc_out_o(ep_crc_crc_fold[i])
+        );
+        usbf_gnrl_dfflrd #(`USB_EP0_CRC_CRC_W, `USB_EP0_CRC_CRC_DEFAULT) 
+            ep_crc_crc_difflrd(
+                ep_crc_crc_ena[i],ep_crc_crc_next[i],
+                ep_crc_crc_r[i],
+                hclk_i,rstn_i
+            );
+
         //-----------------------------------------------------------------
         // Register usb_ep_data
         //-----------------------------------------------------------------
-        assign sel_ep_data[i]= enable_i & (addr_i[7:0] == (`USB_EP0_DATA + i*`USB_EP_STRIDE));
+        assign sel_ep_data[i]= enable_i & (addr_i[11:0] == (`USB_EP0_DATA + i*`USB_EP_STRIDE));
         assign ep_data_wt_en[i] = wt_en_i & sel_ep_data[i];
         assign ep_data_rd_en[i] = rd_en_i & sel_ep_data[i];
 
@@ -497,24 +1041,24 @@ endgenerate //}
 //-----------------------------------------------------------------
 // Register USB_EP_INTSTS
 //-----------------------------------------------------------------
-wire sel_ep_intsts = enable_i & (addr_i[7:0] == `USB_EP_INTSTS);
+wire sel_ep_intsts = enable_i & (addr_i[11:0] == `USB_EP_INTSTS);
 wire ep_intsts_wt_en = wt_en_i & sel_ep_intsts;
 wire ep_intsts_rd_en = rd_en_i & sel_ep_intsts;
 
 generate
-    wire [`USB_EP_NUM-1:0]  ep_intsts_rx_ready_r;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_rx_ready_set;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_rx_ready_clr;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_rx_ready_ena;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_rx_ready_next;
+    wire [EP_NUM-1:0]       ep_intsts_rx_ready_r;
+    wire [EP_NUM-1:0]       ep_intsts_rx_ready_set;
+    wire [EP_NUM-1:0]       ep_intsts_rx_ready_clr;
+    wire [EP_NUM-1:0]       ep_intsts_rx_ready_ena;
+    wire [EP_NUM-1:0]       ep_intsts_rx_ready_next;
     
-    wire [`USB_EP_NUM-1:0]  ep_intsts_tx_complete_r;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_tx_complete_set;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_tx_complete_clr;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_tx_complete_ena;
-    wire [`USB_EP_NUM-1:0]  ep_intsts_tx_complete_next;
+    wire [EP_NUM-1:0]       ep_intsts_tx_complete_r;
+    wire [EP_NUM-1:0]       ep_intsts_tx_complete_set;
+    wire [EP_NUM-1:0]       ep_intsts_tx_complete_clr;
+    wire [EP_NUM-1:0]       ep_intsts_tx_complete_ena;
+    wire [EP_NUM-1:0]       ep_intsts_tx_complete_next;
 
-    for(i=0; i<`USB_EP_NUM; i=i+1)begin
+    for(i=0; i<EP_NUM; i=i+1)begin
         // rx-ready [auto_clr]
         assign ep_intsts_rx_ready_set[i] = ep_intsts_wt_en & wdata_i[(`USB_EP_INTSTS_EP0_RX_READY_B+i) +: `USB_EP_INTSTS_EP0_RX_READY_W];
         assign ep_intsts_rx_ready_clr[i] = ep_intsts_rx_ready_r[i];
@@ -541,9 +1085,157 @@ generate
     end
 endgenerate
 
+//-----------------------------------------------------------------
+// Register USB_EP_NAKSTS
+//-----------------------------------------------------------------
+wire sel_ep_naksts = enable_i & (addr_i[11:0] == `USB_EP_NAKSTS);
+wire ep_naksts_wt_en = wt_en_i & sel_ep_naksts;
+wire ep_naksts_rd_en = rd_en_i & sel_ep_naksts;
+
+generate
+    wire [EP_NUM-1:0]       ep_naksts_in_nak_r;
+    wire [EP_NUM-1:0]       ep_naksts_in_nak_set;
+    wire [EP_NUM-1:0]       ep_naksts_in_nak_clr;
+    wire [EP_NUM-1:0]       ep_naksts_in_nak_ena;
+    wire [EP_NUM-1:0]       ep_naksts_in_nak_next;
+    
+    wire [EP_NUM-1:0]       ep_naksts_out_nak_r;
+    wire [EP_NUM-1:0]       ep_naksts_out_nak_set;
+    wire [EP_NUM-1:0]       ep_naksts_out_nak_clr;
+    wire [EP_NUM-1:0]       ep_naksts_out_nak_ena;
+    wire [EP_NUM-1:0]       ep_naksts_out_nak_next;
+
+    for(i=0; i<EP_NUM; i=i+1)begin
+        // in-nak [auto_clr]
+        assign ep_naksts_in_nak_set[i] = ep_naksts_wt_en & wdata_i[(`USB_EP_NAKSTS_EP0_IN_NAK_B+i) +: `USB_EP_NAKSTS_EP0_IN_NAK_W];
+        assign ep_naksts_in_nak_clr[i] = ep_naksts_in_nak_r[i];
+        assign ep_naksts_in_nak_ena[i] = ep_naksts_in_nak_set[i] | ep_naksts_in_nak_clr[i];
+        assign ep_naksts_in_nak_next[i] = ep_naksts_in_nak_set[i] | (~ep_naksts_in_nak_clr[i]);
+        usbf_gnrl_dfflrd #(`USB_EP_NAKSTS_EP0_IN_NAK_W, `USB_EP_NAKSTS_EP0_IN_NAK_DEFAULT) 
+            ep_naksts_in_nak_difflrd(
+                ep_naksts_in_nak_ena[i],ep_naksts_in_nak_next[i],
+                ep_naksts_in_nak_r[i],
+                hclk_i,rstn_i
+            );
+
+        // out-nak [auto_clr]
+        assign ep_naksts_out_nak_set[i] = ep_naksts_wt_en & wdata_i[(`USB_EP_NAKSTS_EP0_OUT_NAK_B+i) +: `USB_EP_NAKSTS_EP0_OUT_NAK_W];
+        assign ep_naksts_out_nak_clr[i] = ep_naksts_out_nak_r[i];
+        assign ep_naksts_out_nak_ena[i] = ep_naksts_out_nak_set[i] | ep_naksts_out_nak_clr[i];
+        assign ep_naksts_out_nak_next[i] = ep_naksts_out_nak_set[i] | (~ep_naksts_out_nak_clr[i]);
+        usbf_gnrl_dfflrd #(`USB_EP_NAKSTS_EP0_OUT_NAK_W, `USB_EP_NAKSTS_EP0_OUT_NAK_DEFAULT) 
+            ep_naksts_out_nak_difflrd(
+                ep_naksts_out_nak_ena[i],ep_naksts_out_nak_next[i],
+                ep_naksts_out_nak_r[i],
+                hclk_i,rstn_i
+            );
+    end
+endgenerate
+
+//-----------------------------------------------------------------
+// Register USB_EP_LVLSTS
+// A status bit is set when the FIFO fill level crosses its threshold
+// and stays set until written 1, so one crossing is one interrupt.
+//-----------------------------------------------------------------
+wire sel_ep_lvlsts = enable_i & (addr_i[11:0] == `USB_EP_LVLSTS);
+wire ep_lvlsts_wt_en = wt_en_i & sel_ep_lvlsts;
+
+generate
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_cond;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_cond_q;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_cond;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_cond_q;
+
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_clr_r;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_clr_set;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_clr_clr;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_clr_ena;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_clr_next;
+
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_clr_r;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_clr_set;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_clr_clr;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_clr_ena;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_clr_next;
+
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_lvl;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_lvl_set;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_lvl_clr;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_lvl_ena;
+    wire [EP_NUM-1:0]       ep_lvlsts_rx_lvl_next;
+
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_lvl;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_lvl_set;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_lvl_clr;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_lvl_ena;
+    wire [EP_NUM-1:0]       ep_lvlsts_tx_lvl_next;
+
+    for(i=0; i<EP_NUM; i=i+1)begin
+        // threshold conditions and their last value
+        assign ep_lvlsts_rx_cond[i] = ep_rx_level_i[i*`USB_EP0_LEVEL_RX_LEVEL_W +: `USB_EP0_LEVEL_RX_LEVEL_W] > ep_thr_rx_thr_r[i];
+        assign ep_lvlsts_tx_cond[i] = ep_tx_level_i[i*`USB_EP0_LEVEL_TX_LEVEL_W +: `USB_EP0_LEVEL_TX_LEVEL_W] < ep_thr_tx_thr_r[i];
+        usbf_gnrl_dffr #(1) ep_lvlsts_rx_cond_diffr(
+            ep_lvlsts_rx_cond[i], ep_lvlsts_rx_cond_q[i],
+            hclk_i,rstn_i
+        );
+        usbf_gnrl_dffr #(1) ep_lvlsts_tx_cond_diffr(
+            ep_lvlsts_tx_cond[i], ep_lvlsts_tx_cond_q[i],
+            hclk_i,rstn_i
+        );
+
+        // rx-lvl clear [auto_clr]
+        assign ep_lvlsts_rx_clr_set[i] = ep_lvlsts_wt_en & wdata_i[(`USB_EP_LVLSTS_EP0_RX_LVL_B+i) +: `USB_EP_LVLSTS_EP0_RX_LVL_W];
+        assign ep_lvlsts_rx_clr_clr[i] = ep_lvlsts_rx_clr_r[i];
+        assign ep_lvlsts_rx_clr_ena[i] = ep_lvlsts_rx_clr_set[i] | ep_lvlsts_rx_clr_clr[i];
+        assign ep_lvlsts_rx_clr_next[i] = ep_lvlsts_rx_clr_set[i] | (~ep_lvlsts_rx_clr_clr[i]);
+        usbf_gnrl_dfflrd #(`USB_EP_LVLSTS_EP0_RX_LVL_W, `USB_EP_LVLSTS_EP0_RX_LVL_DEFAULT) 
+            ep_lvlsts_rx_clr_difflrd(
+                ep_lvlsts_rx_clr_ena[i],ep_lvlsts_rx_clr_next[i],
+                ep_lvlsts_rx_clr_r[i],
+                hclk_i,rstn_i
+            );
+
+        // tx-lvl clear [auto_clr]
+        assign ep_lvlsts_tx_clr_set[i] = ep_lvlsts_wt_en & wdata_i[(`USB_EP_LVLSTS_EP0_TX_LVL_B+i) +: `USB_EP_LVLSTS_EP0_TX_LVL_W];
+        assign ep_lvlsts_tx_clr_clr[i] = ep_lvlsts_tx_clr_r[i];
+        assign ep_lvlsts_tx_clr_ena[i] = ep_lvlsts_tx_clr_set[i] | ep_lvlsts_tx_clr_clr[i];
+        assign ep_lvlsts_tx_clr_next[i] = ep_lvlsts_tx_clr_set[i] | (~ep_lvlsts_tx_clr_clr[i]);
+        usbf_gnrl_dfflrd #(`USB_EP_LVLSTS_EP0_TX_LVL_W, `USB_EP_LVLSTS_EP0_TX_LVL_DEFAULT) 
+            ep_lvlsts_tx_clr_difflrd(
+                ep_lvlsts_tx_clr_ena[i],ep_lvlsts_tx_clr_next[i],
+                ep_lvlsts_tx_clr_r[i],
+                hclk_i,rstn_i
+            );
+
+        // rx-lvl: set on the crossing, cleared by the write
+        assign ep_lvlsts_rx_lvl_set[i] = (~ep_lvlsts_rx_lvl[i]) & ep_lvlsts_rx_cond[i] & (~ep_lvlsts_rx_cond_q[i]);
+        assign ep_lvlsts_rx_lvl_clr[i] = ep_lvlsts_rx_lvl[i] & ep_lvlsts_rx_clr_r[i];
+        assign ep_lvlsts_rx_lvl_ena[i] = ep_lvlsts_rx_lvl_set[i] | ep_lvlsts_rx_lvl_clr[i];
+        assign ep_lvlsts_rx_lvl_next[i] = ep_lvlsts_rx_lvl_set[i] | (~ep_lvlsts_rx_lvl_clr[i]);
+        usbf_gnrl_dfflrd #(1, 1'b0) 
+            ep_lvlsts_rx_lvl_difflrd(
+                ep_lvlsts_rx_lvl_ena[i],ep_lvlsts_rx_lvl_next[i],
+                ep_lvlsts_rx_lvl[i],
+                hclk_i,rstn_i
+            );
+
+        // tx-lvl: set on the crossing, cleared by the write
+        assign ep_lvlsts_tx_lvl_set[i] = (~ep_lvlsts_tx_lvl[i]) & ep_lvlsts_tx_cond[i] & (~ep_lvlsts_tx_cond_q[i]);
+        assign ep_lvlsts_tx_lvl_clr[i] = ep_lvlsts_tx_lvl[i] & ep_lvlsts_tx_clr_r[i];
+        assign ep_lvlsts_tx_lvl_ena[i] = ep_lvlsts_tx_lvl_set[i] | ep_lvlsts_tx_lvl_clr[i];
+        assign ep_lvlsts_tx_lvl_next[i] = ep_lvlsts_tx_lvl_set[i] | (~ep_lvlsts_tx_lvl_clr[i]);
+        usbf_gnrl_dfflrd #(1, 1'b0) 
+            ep_lvlsts_tx_lvl_difflrd(
+                ep_lvlsts_tx_lvl_ena[i],ep_lvlsts_tx_lvl_next[i],
+                ep_lvlsts_tx_lvl[i],
+                hclk_i,rstn_i
+            );
+    end
+endgenerate
+
 //// 
-// wire [`USB_EP_NUM-1:0] ep_intsts_rx_ready_clr = ep_intsts_rx_ready_r;
-// wire [`USB_EP_NUM-1:0] ep_intsts_tx_complete_clr = ep_intsts_tx_complete_r;
+// wire [EP_NUM-1:0] ep_intsts_rx_ready_clr = ep_intsts_rx_ready_r;
+// wire [EP_NUM-1:0] ep_intsts_tx_complete_clr = ep_intsts_tx_complete_r;
 //==========================================================================================
 // Register Write }
 //==========================================================================================
@@ -554,9 +1246,12 @@ endgenerate
 //-----------------------------------------------------------------
 // Wire
 //-----------------------------------------------------------------
-wire intr_ep_rx_ready_r[`USB_EP_NUM-1:0];
-wire intr_ep_tx_complete_r[`USB_EP_NUM-1:0];
+wire intr_ep_rx_ready_r[EP_NUM-1:0];
+wire intr_ep_tx_complete_r[EP_NUM-1:0];
+wire intr_ep_in_nak_r[EP_NUM-1:0];
+wire intr_ep_out_nak_r[EP_NUM-1:0];
 wire intr_sof_r;
+wire intr_presof_r;
 wire intr_reset_r;
 
 //-----------------------------------------------------------------
@@ -574,6 +1269,7 @@ always @(*)begin
     func_ctrl_r[`USB_FUNC_CTRL_PHY_OPMODE_R] = func_ctrl_phy_opmode_r;
     func_ctrl_r[`USB_FUNC_CTRL_INT_EN_SOF_R] = func_ctrl_int_en_sof_r;
     func_ctrl_r[`USB_FUNC_CTRL_INT_EN_RST_R] = func_ctrl_int_en_rst_r;
+    func_ctrl_r[`USB_FUNC_CTRL_INT_EN_PRESOF_R] = func_ctrl_int_en_presof_r;
 end
 //-----------------------------------------------------------------
 // Register usb_func_stat
@@ -582,6 +1278,8 @@ reg [32-1:0] func_stat_r;
 always @(*)begin
     func_stat_r = 32'b0;
 
+    func_stat_r[`USB_FUNC_STAT_SOF_LOCK_R] = func_stat_sof_lock_i;
+    func_stat_r[`USB_FUNC_STAT_PRESOF_R] = intr_presof_r;
     func_stat_r[`USB_FUNC_STAT_SOF_R] = intr_sof_r;
     func_stat_r[`USB_FUNC_STAT_RST_R] = intr_reset_r;
     func_stat_r[`USB_FUNC_STAT_LINESTATE_R] = func_stat_linestate_i;
@@ -598,6 +1296,94 @@ always @(*)begin
     func_addr_r[`USB_FUNC_ADDR_DEV_ADDR_R] = func_addr_dev_addr_r;
 end
 
+//-----------------------------------------------------------------
+// Register usb_rst_ctrl
+//-----------------------------------------------------------------
+reg [32-1:0] rst_ctrl_r;
+always @(*)begin
+    rst_ctrl_r = 32'b0;
+
+    rst_ctrl_r[`USB_RST_CTRL_CLR_ADDR_R] = rst_ctrl_clr_addr_r;
+    rst_ctrl_r[`USB_RST_CTRL_CLR_STALL_R] = rst_ctrl_clr_stall_r;
+    rst_ctrl_r[`USB_RST_CTRL_FLUSH_R] = rst_ctrl_flush_r;
+end
+
+//-----------------------------------------------------------------
+// Register usb_nak_ctrl
+//-----------------------------------------------------------------
+reg [32-1:0] nak_ctrl_r;
+always @(*)begin
+    nak_ctrl_r = 32'b0;
+
+    nak_ctrl_r[`USB_NAK_CTRL_HOLDOFF_R] = nak_ctrl_holdoff_r;
+end
+
+//-----------------------------------------------------------------
+// Register usb_sof_ctrl
+//-----------------------------------------------------------------
+reg [32-1:0] sof_ctrl_r;
+always @(*)begin
+    sof_ctrl_r = 32'b0;
+
+    sof_ctrl_r[`USB_SOF_CTRL_SOF_DIV_R] = sof_ctrl_sof_div_r;
+    sof_ctrl_r[`USB_SOF_CTRL_PRESOF_LEAD_R] = sof_ctrl_presof_lead_r;
+    sof_ctrl_r[`USB_SOF_CTRL_MEAS_WIN_R] = sof_ctrl_meas_win_r;
+end
+
+//-----------------------------------------------------------------
+// Register usb_sof_period
+//-----------------------------------------------------------------
+reg [32-1:0] sof_period_r;
+always @(*)begin
+    sof_period_r = 32'b0;
+
+    sof_period_r[`USB_SOF_PERIOD_PERIOD_R] = sof_period_i;
+end
+
+//-----------------------------------------------------------------
+// Register usb_trace_*
+//-----------------------------------------------------------------
+wire [31:0] trace_rdata;
+
+`ifdef USB_TRACE
+reg [32-1:0] trace_ctrl_r;
+reg [32-1:0] trace_filt_r;
+reg [32-1:0] trace_sts_r;
+reg [32-1:0] trace_idx_rd_r;
+always @(*)begin
+    trace_ctrl_r = 32'b0;
+    trace_filt_r = 32'b0;
+    trace_sts_r = 32'b0;
+    trace_idx_rd_r = 32'b0;
+
+    trace_ctrl_r[`USB_TRACE_CTRL_EN_R] = trace_ctrl_en_r;
+    trace_ctrl_r[`USB_TRACE_CTRL_TRIG_EN_R] = trace_ctrl_trig_en_r;
+    trace_ctrl_r[`USB_TRACE_CTRL_TRIG_PID_R] = trace_ctrl_trig_pid_r;
+    trace_ctrl_r[`USB_TRACE_CTRL_TRIG_EP_EN_R] = trace_ctrl_trig_ep_en_r;
+    trace_ctrl_r[`USB_TRACE_CTRL_TRIG_EP_R] = trace_ctrl_trig_ep_r;
+    trace_ctrl_r[`USB_TRACE_CTRL_POST_R] = trace_ctrl_post_r;
+
+    trace_filt_r[`USB_TRACE_FILT_PID_MASK_R] = trace_filt_pid_mask_r;
+    trace_filt_r[`USB_TRACE_FILT_EP_MASK_R] = trace_filt_ep_mask_r;
+
+    trace_sts_r[`USB_TRACE_STS_STOPPED_R] = trace_sts_stopped_i;
+    trace_sts_r[`USB_TRACE_STS_TRIGGERED_R] = trace_sts_triggered_i;
+    trace_sts_r[`USB_TRACE_STS_WRAP_R] = trace_sts_wrap_i;
+    trace_sts_r[`USB_TRACE_STS_WPTR_B +: `USB_TRACE_DEPTH_W] = trace_sts_wptr_i;
+
+    trace_idx_rd_r[`USB_TRACE_IDX_IDX_B +: `USB_TRACE_DEPTH_W] = trace_idx_r;
+end
+
+assign trace_rdata = ({32{sel_trace_ctrl}} & trace_ctrl_r) |
+                     ({32{sel_trace_filt}} & trace_filt_r) |
+                     ({32{sel_trace_sts}} & trace_sts_r) |
+                     ({32{sel_trace_idx}} & trace_idx_rd_r) |
+                     ({32{sel_trace_data0}} & trace_data0_i) |
+                     ({32{sel_trace_data1}} & trace_data1_i);
+`else
+assign trace_rdata = 32'b0;
+`endif
+
 //-----------------------------------------------------------------
 // Register usb_ep_intsts
 //-----------------------------------------------------------------
@@ -606,7 +1392,7 @@ integer j;
 generate
     always @(*)begin
         ep_intsts_r = 32'b0;
-        for(j=0; j<`USB_EP_NUM; j=j+1)begin
+        for(j=0; j<EP_NUM; j=j+1)begin
             ep_intsts_r[(`USB_EP_INTSTS_EP0_RX_READY_B+j) +: `USB_EP_INTSTS_EP0_RX_READY_W] = intr_ep_rx_ready_r[j];
             ep_intsts_r[(`USB_EP_INTSTS_EP0_TX_COMPLETE_B+j) +: `USB_EP_INTSTS_EP0_TX_COMPLETE_W] = intr_ep_tx_complete_r[j];
 
@@ -614,45 +1400,110 @@ generate
     end
 endgenerate
 
-reg [32-1:0] ep_cfg_r[`USB_EP_NUM-1:0];
-reg [32-1:0] ep_tx_ctrl_r[`USB_EP_NUM-1:0]; 
-reg [32-1:0] ep_sts_r[`USB_EP_NUM-1:0]; 
+//-----------------------------------------------------------------
+// Register usb_ep_naksts
+//-----------------------------------------------------------------
+reg [32-1:0] ep_naksts_r;
+generate
+    always @(*)begin
+        ep_naksts_r = 32'b0;
+        for(j=0; j<EP_NUM; j=j+1)begin
+            ep_naksts_r[(`USB_EP_NAKSTS_EP0_IN_NAK_B+j) +: `USB_EP_NAKSTS_EP0_IN_NAK_W] = intr_ep_in_nak_r[j];
+            ep_naksts_r[(`USB_EP_NAKSTS_EP0_OUT_NAK_B+j) +: `USB_EP_NAKSTS_EP0_OUT_NAK_W] = intr_ep_out_nak_r[j];
+        end
+    end
+endgenerate
+
+//-----------------------------------------------------------------
+// Register usb_ep_lvlsts
+//-----------------------------------------------------------------
+reg [32-1:0] ep_lvlsts_r;
+generate
+    always @(*)begin
+        ep_lvlsts_r = 32'b0;
+        for(j=0; j<EP_NUM; j=j+1)begin
+            ep_lvlsts_r[(`USB_EP_LVLSTS_EP0_TX_LVL_B+j) +: `USB_EP_LVLSTS_EP0_TX_LVL_W] = ep_lvlsts_tx_lvl[j];
+            ep_lvlsts_r[(`USB_EP_LVLSTS_EP0_RX_LVL_B+j) +: `USB_EP_LVLSTS_EP0_RX_LVL_W] = ep_lvlsts_rx_lvl[j];
+        end
+    end
+endgenerate
+
+reg [32-1:0] ep_cfg_r[EP_NUM-1:0];
+reg [32-1:0] ep_tx_ctrl_r[EP_NUM-1:0]; 
+reg [32-1:0] ep_sts_r[EP_NUM-1:0]; 
+reg [`USB_EP_SUMMARY_EP_W-1:0] ep_summary_r[EP_NUM-1:0];
+reg [32-1:0] ep_level_r[EP_NUM-1:0];
+reg [32-1:0] ep_thr_r[EP_NUM-1:0];
 
-wire ep_data_ena[`USB_EP_NUM-1:0];
-wire [32-1:0] ep_data_next[`USB_EP_NUM-1:0];
-wire [32-1:0] ep_data_r[`USB_EP_NUM-1:0];
+wire ep_data_ena[EP_NUM-1:0];
+wire [32-1:0] ep_data_next[EP_NUM-1:0];
+wire [32-1:0] ep_data_r[EP_NUM-1:0];
 
 generate //{
     always @(*)begin
-        for(j=0; j<`USB_EP_NUM; j=j+1) begin //{
+        for(j=0; j<EP_NUM; j=j+1) begin //{
             ep_cfg_r[j] = 32'b0;
             ep_tx_ctrl_r[j] = 32'b0;
             ep_sts_r[j] = 32'b0;
+            ep_summary_r[j] = {`USB_EP_SUMMARY_EP_W{1'b0}};
+            ep_level_r[j] = 32'b0;
+            ep_thr_r[j] = 32'b0;
         end //}
 
-        for(j=0; j<`USB_EP_NUM; j=j+1) begin //{
+        for(j=0; j<EP_NUM; j=j+1) begin //{
             //-----------------------------------------------------------------
             // Register usb_ep_cfg
             //-----------------------------------------------------------------
             ep_cfg_r[j][`USB_EP0_CFG_INT_RX_R] = ep_cfg_int_rx_r[j];
             ep_cfg_r[j][`USB_EP0_CFG_INT_TX_R] = ep_cfg_int_tx_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_INT_IN_NAK_R] = ep_cfg_int_in_nak_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_INT_OUT_NAK_R] = ep_cfg_int_out_nak_r[j];
             ep_cfg_r[j][`USB_EP0_CFG_ISO_R] = ep_cfg_iso_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_LOOPBACK_EN_R] = ep_cfg_loopback_en_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_AUTO_ACCEPT_R] = ep_cfg_auto_accept_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_LOOPBACK_EP_R] = ep_cfg_loopback_ep_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_INT_RX_LVL_R] = ep_cfg_int_rx_lvl_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_INT_TX_LVL_R] = ep_cfg_int_tx_lvl_r[j];
+            ep_cfg_r[j][`USB_EP0_CFG_CRC_EN_R] = ep_cfg_crc_en_r[j];
 
             //-----------------------------------------------------------------
             // Register usb_ep_tx_ctrl
             //-----------------------------------------------------------------
+            ep_tx_ctrl_r[j][`USB_EP0_TX_CTRL_TX_MIN_R] = ep_tx_ctrl_tx_min_r[j];
             ep_tx_ctrl_r[j][`USB_EP0_TX_CTRL_TX_LEN_R] = ep_tx_ctrl_tx_len_r[j];
 
             //-----------------------------------------------------------------
             // Register usb_ep_sts
             //-----------------------------------------------------------------
-            ep_sts_r[j][`USB_EP0_STS_TX_ERR_R] = ep_sts_tx_err_i;
-            ep_sts_r[j][`USB_EP0_STS_TX_BUSY_R] = ep_sts_tx_busy_i;
-            ep_sts_r[j][`USB_EP0_STS_RX_ERR_R] = ep_sts_rx_err_i;
-            ep_sts_r[j][`USB_EP0_STS_RX_SETUP_R] = ep_sts_rx_setup_i;
-            ep_sts_r[j][`USB_EP0_STS_RX_READY_R] = ep_sts_rx_ready_i;
+            ep_sts_r[j][`USB_EP0_STS_TX_ERR_R] = ep_sts_tx_err_i[j];
+            ep_sts_r[j][`USB_EP0_STS_TX_BUSY_R] = ep_sts_tx_busy_i[j];
+            ep_sts_r[j][`USB_EP0_STS_RX_ERR_R] = ep_sts_rx_err_i[j];
+            ep_sts_r[j][`USB_EP0_STS_RX_SETUP_R] = ep_sts_rx_setup_i[j];
+            ep_sts_r[j][`USB_EP0_STS_RX_READY_R] = ep_sts_rx_ready_i[j];
             ep_sts_r[j][`USB_EP0_STS_RX_COUNT_R] = ep_sts_rx_count_i[j*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W];
 
+            //-----------------------------------------------------------------
+            // Register usb_ep_summary
+            //-----------------------------------------------------------------
+            ep_summary_r[j][`USB_EP_SUMMARY_TX_ERR_R] = ep_sts_tx_err_i[j];
+            ep_summary_r[j][`USB_EP_SUMMARY_TX_BUSY_R] = ep_sts_tx_busy_i[j];
+            ep_summary_r[j][`USB_EP_SUMMARY_RX_ERR_R] = ep_sts_rx_err_i[j];
+            ep_summary_r[j][`USB_EP_SUMMARY_RX_SETUP_R] = ep_sts_rx_setup_i[j];
+            ep_summary_r[j][`USB_EP_SUMMARY_RX_READY_R] = ep_sts_rx_ready_i[j];
+            ep_summary_r[j][`USB_EP_SUMMARY_RX_COUNT_R] = ep_sts_rx_count_i[j*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W];
+
+            //-----------------------------------------------------------------
+            // Register usb_ep_level
+            //-----------------------------------------------------------------
+            ep_level_r[j][`USB_EP0_LEVEL_TX_LEVEL_R] = ep_tx_level_i[j*`USB_EP0_LEVEL_TX_LEVEL_W +: `USB_EP0_LEVEL_TX_LEVEL_W];
+            ep_level_r[j][`USB_EP0_LEVEL_RX_LEVEL_R] = ep_rx_level_i[j*`USB_EP0_LEVEL_RX_LEVEL_W +: `USB_EP0_LEVEL_RX_LEVEL_W];
+
+            //-----------------------------------------------------------------
+            // Register usb_ep_thr
+            //-----------------------------------------------------------------
+            ep_thr_r[j][`USB_EP0_THR_TX_THR_R] = ep_thr_tx_thr_r[j];
+            ep_thr_r[j][`USB_EP0_THR_RX_THR_R] = ep_thr_rx_thr_r[j];
+
         end //}
 
     end
@@ -661,13 +1512,13 @@ generate //{
     // Register usb_ep_data
     //-----------------------------------------------------------------
     // `ifdef USB_ITF_ICB
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    for(i=0; i<EP_NUM; i=i+1) begin //{
         assign ep_data_r[i][7:0] = ep_rx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W];
         assign ep_data_r[i][31:8] = 24'b0;
     end //}
 
     // `else // ~USB_ITF_ICB
-    // for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    // for(i=0; i<EP_NUM; i=i+1) begin //{
     //     assign ep_data_ena[i] = ep_data_rd_en[i];
     //     assign ep_data_next[i][7:0] = ep_rx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W];
     //     assign ep_data_next[i][31:8] = 24'b0;
@@ -692,11 +1543,15 @@ generate //{
     always @(*)begin
         ep_rdata_r = 32'b0;
 
-        for(j=0; j<`USB_EP_NUM; j=j+1) begin //{
+        for(j=0; j<EP_NUM; j=j+1) begin //{
             ep_rdata_r =    ep_rdata_r |
                             ({32{sel_ep_cfg[j]}} & ep_cfg_r[j]) |
                             ({32{sel_ep_tx_ctrl[j]}} & ep_tx_ctrl_r[j]) |
                             ({32{sel_ep_sts[j]}} & ep_sts_r[j]) |
+                            ({32{sel_ep_level[j]}} & ep_level_r[j]) |
+                            ({32{sel_ep_thr[j]}} & ep_thr_r[j]) |
+                            ({32{sel_ep_crc[j]}} & ep_crc_crc_r[j]) |
+                            ({32{sel_ep_summary[j]}} & ({{(32-`USB_EP_SUMMARY_EP_W){1'b0}}, ep_summary_r[j]} << ((j%2)*`USB_EP_SUMMARY_EP_W))) |
                             ({32{sel_ep_data[j]}} & ep_data_r[j]);
         end //}
     end
@@ -705,6 +1560,13 @@ generate //{
                     ({32{sel_func_stat}} & func_stat_r) |
                     ({32{sel_func_addr}} & func_addr_r) |
                     ({32{sel_ep_intsts}} & ep_intsts_r) |
+                    ({32{sel_ep_naksts}} & ep_naksts_r) |
+                    ({32{sel_ep_lvlsts}} & ep_lvlsts_r) |
+                    ({32{sel_nak_ctrl}} & nak_ctrl_r) |
+                    ({32{sel_rst_ctrl}} & rst_ctrl_r) |
+                    ({32{sel_sof_ctrl}} & sof_ctrl_r) |
+                    ({32{sel_sof_period}} & sof_period_r) |
+                    trace_rdata |
                     ep_rdata_r;
 
     assign rdata_o = enable_i ? rdata : 32'b0;
@@ -717,7 +1579,7 @@ endgenerate //}
 // MEM Read and Write req
 //-----------------------------------------------------------------
 generate //{
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    for(i=0; i<EP_NUM; i=i+1) begin //{
         assign ep_data_rd_req_o[i] = ep_data_rd_en[i];
         assign ep_data_wt_req_o[i] = ep_data_wt_en[i];
     end //}
@@ -736,7 +1598,7 @@ generate //{
         mem_wt_access = 1'b0;
         mem_rd_access = 1'b0;
         mem_access    = 1'b0;
-        for(j=0; j<`USB_EP_NUM; j=j+1) begin //{
+        for(j=0; j<EP_NUM; j=j+1) begin //{
             mem_wt_access = mem_wt_access | ep_data_wt_en[j];
             mem_rd_access = mem_rd_access | ep_data_rd_en[j];
             mem_access    = mem_access    | sel_ep_data[j];
@@ -756,19 +1618,19 @@ assign rd_ready_o = mem_access ?    mem_rd_ready_i : rd_en_i;
 // EP rx ready and tx complete
 //-----------------------------------------------------------------
 generate //{
-    // wire intr_ep_rx_ready_r[`USB_EP_NUM-1:0]; // define ahead
-    wire intr_ep_rx_ready_set[`USB_EP_NUM-1:0];
-    wire intr_ep_rx_ready_clr[`USB_EP_NUM-1:0];
-    wire intr_ep_rx_ready_ena[`USB_EP_NUM-1:0];
-    wire intr_ep_rx_ready_next[`USB_EP_NUM-1:0];
-
-    // wire intr_ep_tx_complete_r[`USB_EP_NUM-1:0]; // define ahead
-    wire intr_ep_tx_complete_set[`USB_EP_NUM-1:0];
-    wire intr_ep_tx_complete_clr[`USB_EP_NUM-1:0];
-    wire intr_ep_tx_complete_ena[`USB_EP_NUM-1:0];
-    wire intr_ep_tx_complete_next[`USB_EP_NUM-1:0];     
-
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    // wire intr_ep_rx_ready_r[EP_NUM-1:0]; // define ahead
+    wire intr_ep_rx_ready_set[EP_NUM-1:0];
+    wire intr_ep_rx_ready_clr[EP_NUM-1:0];
+    wire intr_ep_rx_ready_ena[EP_NUM-1:0];
+    wire intr_ep_rx_ready_next[EP_NUM-1:0];
+
+    // wire intr_ep_tx_complete_r[EP_NUM-1:0]; // define ahead
+    wire intr_ep_tx_complete_set[EP_NUM-1:0];
+    wire intr_ep_tx_complete_clr[EP_NUM-1:0];
+    wire intr_ep_tx_complete_ena[EP_NUM-1:0];
+    wire intr_ep_tx_complete_next[EP_NUM-1:0];          
+
+    for(i=0; i<EP_NUM; i=i+1) begin //{
         assign intr_ep_rx_ready_set[i] = (~intr_ep_rx_ready_r[i]) & ep_rx_ready_intr_set_i[i];
         assign intr_ep_rx_ready_clr[i] = intr_ep_rx_ready_r[i] & ep_intsts_rx_ready_clr[i];
         assign intr_ep_rx_ready_ena[i] = intr_ep_rx_ready_set[i] | intr_ep_rx_ready_clr[i];
@@ -794,6 +1656,47 @@ generate //{
     end //}
 endgenerate //}
 
+//-----------------------------------------------------------------
+// EP in nak and out nak
+//-----------------------------------------------------------------
+generate //{
+    // wire intr_ep_in_nak_r[EP_NUM-1:0]; // define ahead
+    wire intr_ep_in_nak_set[EP_NUM-1:0];
+    wire intr_ep_in_nak_clr[EP_NUM-1:0];
+    wire intr_ep_in_nak_ena[EP_NUM-1:0];
+    wire intr_ep_in_nak_next[EP_NUM-1:0];
+
+    // wire intr_ep_out_nak_r[EP_NUM-1:0]; // define ahead
+    wire intr_ep_out_nak_set[EP_NUM-1:0];
+    wire intr_ep_out_nak_clr[EP_NUM-1:0];
+    wire intr_ep_out_nak_ena[EP_NUM-1:0];
+    wire intr_ep_out_nak_next[EP_NUM-1:0];
+
+    for(i=0; i<EP_NUM; i=i+1) begin //{
+        assign intr_ep_in_nak_set[i] = (~intr_ep_in_nak_r[i]) & ep_in_nak_intr_set_i[i];
+        assign intr_ep_in_nak_clr[i] = intr_ep_in_nak_r[i] & ep_naksts_in_nak_clr[i];
+        assign intr_ep_in_nak_ena[i] = intr_ep_in_nak_set[i] | intr_ep_in_nak_clr[i];
+        assign intr_ep_in_nak_next[i] = intr_ep_in_nak_set[i] | (~intr_ep_in_nak_clr[i]);
+        usbf_gnrl_dfflrd #(1, 1'b0) 
+            intr_ep_in_nak_difflrd(
+                intr_ep_in_nak_ena[i],intr_ep_in_nak_next[i],
+                intr_ep_in_nak_r[i],
+                hclk_i,rstn_i
+            );
+
+        assign intr_ep_out_nak_set[i] = (~intr_ep_out_nak_r[i]) & ep_out_nak_intr_set_i[i];
+        assign intr_ep_out_nak_clr[i] = intr_ep_out_nak_r[i] & ep_naksts_out_nak_clr[i];
+        assign intr_ep_out_nak_ena[i] = intr_ep_out_nak_set[i] | intr_ep_out_nak_clr[i];
+        assign intr_ep_out_nak_next[i] = intr_ep_out_nak_set[i] | (~intr_ep_out_nak_clr[i]);
+        usbf_gnrl_dfflrd #(1, 1'b0) 
+            intr_ep_out_nak_difflrd(
+                intr_ep_out_nak_ena[i],intr_ep_out_nak_next[i],
+                intr_ep_out_nak_r[i],
+                hclk_i,rstn_i
+            );
+    end //}
+endgenerate //}
+
 //-----------------------------------------------------------------
 // SOF
 //-----------------------------------------------------------------
@@ -809,6 +1712,21 @@ usbf_gnrl_dfflrd #(1, 1'b0)
         hclk_i,rstn_i
     );
 
+//-----------------------------------------------------------------
+// PRE-SOF
+//-----------------------------------------------------------------
+// wire intr_presof_r; // define ahead
+wire intr_presof_set = (~intr_presof_r) & presof_intr_set_i;
+wire intr_presof_clr = intr_presof_r & stat_presof_clr;
+wire intr_presof_ena = intr_presof_set | intr_presof_clr;
+wire intr_presof_next = intr_presof_set | (~intr_presof_clr);
+usbf_gnrl_dfflrd #(1, 1'b0) 
+    intr_presof_difflrd(
+        intr_presof_ena,intr_presof_next,
+        intr_presof_r,
+        hclk_i,rstn_i
+    );
+
 //-----------------------------------------------------------------
 // RESET
 //-----------------------------------------------------------------
@@ -825,24 +1743,36 @@ usbf_gnrl_dfflrd #(1, 1'b0)
     );
 
 //-----------------------------------------------------------------
-// EP rx ready and tx complete
+// EP rx ready, tx complete, in nak, out nak and fifo level
 //-----------------------------------------------------------------
-wire [`USB_EP_NUM-1:0] intr_ep;
-wire [`USB_EP_NUM-1:0] intr_ep_rx_ready;
-wire [`USB_EP_NUM-1:0] intr_ep_tx_complete;
+wire [EP_NUM-1:0] intr_ep;
+wire [EP_NUM-1:0] intr_ep_rx_ready;
+wire [EP_NUM-1:0] intr_ep_tx_complete;
+wire [EP_NUM-1:0] intr_ep_in_nak;
+wire [EP_NUM-1:0] intr_ep_out_nak;
+wire [EP_NUM-1:0] intr_ep_rx_lvl;
+wire [EP_NUM-1:0] intr_ep_tx_lvl;
 generate //{
-    for(i=0; i<`USB_EP_NUM; i=i+1) begin //{
+    for(i=0; i<EP_NUM; i=i+1) begin //{
         assign intr_ep_rx_ready[i] = intr_ep_rx_ready_r[i] & ep_cfg_int_rx_r[i];
         assign intr_ep_tx_complete[i] = intr_ep_tx_complete_r[i] & ep_cfg_int_tx_r[i];
-        assign intr_ep[i] = intr_ep_rx_ready[i] | intr_ep_tx_complete[i];
+        assign intr_ep_in_nak[i] = intr_ep_in_nak_r[i] & ep_cfg_int_in_nak_r[i];
+        assign intr_ep_out_nak[i] = intr_ep_out_nak_r[i] & ep_cfg_int_out_nak_r[i];
+        assign intr_ep_rx_lvl[i] = ep_lvlsts_rx_lvl[i] & ep_cfg_int_rx_lvl_r[i];
+        assign intr_ep_tx_lvl[i] = ep_lvlsts_tx_lvl[i] & ep_cfg_int_tx_lvl_r[i];
+        assign intr_ep[i] = intr_ep_rx_ready[i] | intr_ep_tx_complete[i] |
+                            intr_ep_in_nak[i] | intr_ep_out_nak[i] |
+                            intr_ep_rx_lvl[i] | intr_ep_tx_lvl[i];
     end //}
 endgenerate //}
 
-wire intr_sof   = func_ctrl_int_en_sof_r & intr_sof_r;
-wire intr_reset = func_ctrl_int_en_rst_r & intr_reset_r;
+wire intr_sof    = func_ctrl_int_en_sof_r & intr_sof_r;
+wire intr_presof = func_ctrl_int_en_presof_r & intr_presof_r;
+wire intr_reset  = func_ctrl_int_en_rst_r & intr_reset_r;
 
 assign intr_o = (|intr_ep)      |
                 intr_sof        |
+                intr_presof     |
                 intr_reset;
 
 
@@ -22,15 +22,22 @@
 //                       v
 //                    | BIU |
 // 
+// The configuration is set by parameters, see usbf_cfg_defs.v for
+// the defaults.
 //=================================================================
 
 `include "usbf_cfg_defs.v"
 
-module usbf_device(
+module usbf_device #(
+    parameter ITF_ICB           = `USB_ITF_ICB_DEFAULT, // 0: AHB, 1: ICB
+    parameter BASE_ADDR_31_12   = `USB_BASE_ADDR_31_12,
+    parameter REG_FIFO          = `USB_REG_FIFO_DEFAULT,
+    parameter FIFO_ADDR_W       = `USB_FIFO_ADDR_W,
+    parameter EP_NUM            = `USB_EP_NUM
+)(
      input                  hclk_i
     ,input                  hrstn_i
 
-    `ifdef USB_ITF_AHB
     ////// AHB slave interface
     ,input                  hsel_i
     ,input                  hwrite_i
@@ -43,9 +50,7 @@ module usbf_device(
     ,output                 hready_o
     ,output [1:0]           hresp_o
     ,output [31:0]          hrdata_o
-    `endif
 
-    `ifdef USB_ITF_ICB
     ////// ICB slave interface
     // CMD
     ,input                  icb_cmd_valid_i
@@ -57,7 +62,6 @@ module usbf_device(
     ,output                 icb_rsp_valid_o
     ,input                  icb_rsp_ready_i
     ,output [32-1:0]        icb_rsp_rdata_o
-    `endif
 
     ////// UTMI interface
     ,input                  phy_clk_i
@@ -102,58 +106,90 @@ wire                                            mem_rd_ready;
 ////// CSR<-->CORE
 wire                                            csr_func_ctrl_hs_chirp_en;
 wire    [`USB_FUNC_ADDR_DEV_ADDR_W-1:0]         csr_func_addr_dev_addr;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_cfg_stall_ep;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_cfg_iso;
+wire    [EP_NUM-1:0]                            csr_ep_cfg_stall_ep;
+wire    [EP_NUM-1:0]                            csr_ep_cfg_iso;
+wire    [EP_NUM-1:0]                            csr_ep_cfg_loopback_en;
+wire    [EP_NUM-1:0]                            csr_ep_cfg_auto_accept;
+wire    [`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM-1:0] csr_ep_cfg_loopback_ep;
 wire    [`USB_FUNC_STAT_FRAME_W-1:0]            csr_func_stat_frame;
 wire                                            csr_rst_intr_set;
 wire                                            csr_sof_intr_set;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_rx_ready_intr_set;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_tx_complete_intr_set;
+wire                                            csr_presof_intr_set;
+wire                                            csr_func_stat_sof_lock;
+wire    [`USB_SOF_CTRL_SOF_DIV_W-1:0]           csr_sof_ctrl_sof_div;
+wire    [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0]       csr_sof_ctrl_presof_lead;
+wire    [`USB_SOF_CTRL_MEAS_WIN_W-1:0]          csr_sof_ctrl_meas_win;
+wire    [`USB_SOF_PERIOD_PERIOD_W-1:0]          csr_sof_period;
+wire    [EP_NUM-1:0]                            csr_ep_rx_ready_intr_set;
+wire    [EP_NUM-1:0]                            csr_ep_tx_complete_intr_set;
+wire    [EP_NUM-1:0]                            csr_ep_in_nak_intr_set;
+wire    [EP_NUM-1:0]                            csr_ep_out_nak_intr_set;
+wire    [`USB_NAK_CTRL_HOLDOFF_W-1:0]           csr_nak_ctrl_holdoff;
+wire                                            csr_rst_ctrl_flush;
 
 wire                                            func_ctrl_hs_chirp_en;
 wire    [`USB_FUNC_ADDR_DEV_ADDR_W-1:0]         func_addr_dev_addr;
-wire    [`USB_EP_NUM-1:0]                       ep_cfg_stall_ep;
-wire    [`USB_EP_NUM-1:0]                       ep_cfg_iso;
+wire    [EP_NUM-1:0]                            ep_cfg_stall_ep;
+wire    [EP_NUM-1:0]                            ep_cfg_iso;
+wire    [EP_NUM-1:0]                            ep_cfg_loopback_en;
+wire    [EP_NUM-1:0]                            ep_cfg_auto_accept;
+wire    [`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM-1:0] ep_cfg_loopback_ep;
 wire    [`USB_FUNC_STAT_FRAME_W-1:0]            func_stat_frame;
 wire                                            rst_intr_set;
 wire                                            sof_intr_set;
-wire    [`USB_EP_NUM-1:0]                       ep_rx_ready_intr_set;
-wire    [`USB_EP_NUM-1:0]                       ep_tx_complete_intr_set;
+wire                                            presof_intr_set;
+wire                                            func_stat_sof_lock;
+wire    [`USB_SOF_CTRL_SOF_DIV_W-1:0]           sof_ctrl_sof_div;
+wire    [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0]       sof_ctrl_presof_lead;
+wire    [`USB_SOF_CTRL_MEAS_WIN_W-1:0]          sof_ctrl_meas_win;
+wire    [`USB_SOF_PERIOD_PERIOD_W-1:0]          sof_period;
+wire    [EP_NUM-1:0]                            ep_rx_ready_intr_set;
+wire    [EP_NUM-1:0]                            ep_tx_complete_intr_set;
+wire    [EP_NUM-1:0]                            ep_in_nak_intr_set;
+wire    [EP_NUM-1:0]                            ep_out_nak_intr_set;
+wire    [`USB_NAK_CTRL_HOLDOFF_W-1:0]           nak_ctrl_holdoff;
+wire                                            rst_ctrl_flush;
 
 ////// CSR<-->EPU
-wire    [`USB_EP_NUM-1:0]                       csr_ep_tx_ctrl_tx_start;
-wire    [`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM-1:0]   csr_ep_tx_ctrl_tx_len;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_rx_ctrl_rx_accept;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_sts_tx_err;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_sts_tx_busy;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_err;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_setup;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_ready;
-wire    [`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0] csr_ep_sts_rx_count;
-
-wire    [`USB_EP_NUM-1:0]                       ep_tx_ctrl_tx_start;
-wire    [`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM-1:0]   ep_tx_ctrl_tx_len;
-wire    [`USB_EP_NUM-1:0]                       ep_rx_ctrl_rx_accept;
-wire    [`USB_EP_NUM-1:0]                       ep_sts_tx_err;
-wire    [`USB_EP_NUM-1:0]                       ep_sts_tx_busy;
-wire    [`USB_EP_NUM-1:0]                       ep_sts_rx_err;
-wire    [`USB_EP_NUM-1:0]                       ep_sts_rx_setup;
-wire    [`USB_EP_NUM-1:0]                       ep_sts_rx_ready;
-wire    [`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0] ep_sts_rx_count;
+wire    [EP_NUM-1:0]                            csr_ep_tx_ctrl_tx_start;
+wire    [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0]        csr_ep_tx_ctrl_tx_len;
+wire    [`USB_EP0_TX_CTRL_TX_MIN_W*EP_NUM-1:0]        csr_ep_tx_ctrl_tx_min;
+wire    [EP_NUM-1:0]                            csr_ep_rx_ctrl_rx_accept;
+wire    [EP_NUM-1:0]                            csr_ep_sts_tx_err;
+wire    [EP_NUM-1:0]                            csr_ep_sts_tx_busy;
+wire    [EP_NUM-1:0]                            csr_ep_sts_rx_err;
+wire    [EP_NUM-1:0]                            csr_ep_sts_rx_setup;
+wire    [EP_NUM-1:0]                            csr_ep_sts_rx_ready;
+wire    [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0] csr_ep_sts_rx_count;
+
+wire    [EP_NUM-1:0]                            ep_tx_ctrl_tx_start;
+wire    [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0]        ep_tx_ctrl_tx_len;
+wire    [`USB_EP0_TX_CTRL_TX_MIN_W*EP_NUM-1:0]        ep_tx_ctrl_tx_min;
+wire    [EP_NUM-1:0]                            ep_rx_ctrl_rx_accept;
+wire    [EP_NUM-1:0]                            ep_sts_tx_err;
+wire    [EP_NUM-1:0]                            ep_sts_tx_busy;
+wire    [EP_NUM-1:0]                            ep_sts_rx_err;
+wire    [EP_NUM-1:0]                            ep_sts_rx_setup;
+wire    [EP_NUM-1:0]                            ep_sts_rx_ready;
+wire    [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0] ep_sts_rx_count;
 ////// CSR<-->MEM
-wire    [`USB_EP_NUM-1:0]                       csr_ep_rx_ctrl_rx_flush;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_data_wt_req;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  csr_ep_rx_data;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_tx_ctrl_tx_flush;
-wire    [`USB_EP_NUM-1:0]                       csr_ep_data_rd_req;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  csr_ep_tx_data;
-
-wire    [`USB_EP_NUM-1:0]                       ep_rx_ctrl_rx_flush;
-wire    [`USB_EP_NUM-1:0]                       ep_data_wt_req;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  ep_rx_data;
-wire    [`USB_EP_NUM-1:0]                       ep_tx_ctrl_tx_flush;
-wire    [`USB_EP_NUM-1:0]                       ep_data_rd_req;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  ep_tx_data;
+wire    [EP_NUM-1:0]                            csr_ep_rx_ctrl_rx_flush;
+wire    [EP_NUM-1:0]                            csr_ep_data_wt_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       csr_ep_rx_data;
+wire    [EP_NUM-1:0]                            csr_ep_tx_ctrl_tx_flush;
+wire    [EP_NUM-1:0]                            csr_ep_data_rd_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       csr_ep_tx_data;
+wire    [`USB_EP0_LEVEL_RX_LEVEL_W*EP_NUM-1:0]  csr_ep_rx_level;
+wire    [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  csr_ep_tx_level;
+
+wire    [EP_NUM-1:0]                            ep_rx_ctrl_rx_flush;
+wire    [EP_NUM-1:0]                            ep_data_wt_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       ep_rx_data;
+wire    [EP_NUM-1:0]                            ep_tx_ctrl_tx_flush;
+wire    [EP_NUM-1:0]                            ep_data_rd_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       ep_tx_data;
+wire    [`USB_EP0_LEVEL_RX_LEVEL_W*EP_NUM-1:0]  ep_rx_level;
+wire    [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  ep_tx_level;
 
 ////// CSR<-->SYNC
 wire                                            csr_utmi_dmpulldown;
@@ -163,36 +199,86 @@ wire    [1:0]                                   csr_utmi_xcvrselect;
 wire    [1:0]                                   csr_utmi_op_mode;
 wire    [1:0]                                   csr_utmi_linestate;
 
+////// SOF TIMER<-->CORE
+wire                                            core_sof_valid;
+
+`ifdef USB_TRACE
+////// CSR<-->SYNC<-->TRACE
+wire                                            csr_trace_ctrl_en;
+wire                                            csr_trace_ctrl_trig_en;
+wire    [`USB_TRACE_CTRL_TRIG_PID_W-1:0]        csr_trace_ctrl_trig_pid;
+wire                                            csr_trace_ctrl_trig_ep_en;
+wire    [`USB_TRACE_CTRL_TRIG_EP_W-1:0]         csr_trace_ctrl_trig_ep;
+wire    [`USB_TRACE_CTRL_POST_W-1:0]            csr_trace_ctrl_post;
+wire    [`USB_TRACE_FILT_PID_MASK_W-1:0]        csr_trace_filt_pid_mask;
+wire    [`USB_TRACE_FILT_EP_MASK_W-1:0]         csr_trace_filt_ep_mask;
+wire    [`USB_TRACE_DEPTH_W-1:0]                csr_trace_idx;
+wire    [`USB_TRACE_DEPTH_W-1:0]                csr_trace_sts_wptr;
+wire                                            csr_trace_sts_wrap;
+wire                                            csr_trace_sts_triggered;
+wire                                            csr_trace_sts_stopped;
+wire    [31:0]                                  csr_trace_data0;
+wire    [31:0]                                  csr_trace_data1;
+
+wire                                            trace_ctrl_en;
+wire                                            trace_ctrl_trig_en;
+wire    [`USB_TRACE_CTRL_TRIG_PID_W-1:0]        trace_ctrl_trig_pid;
+wire                                            trace_ctrl_trig_ep_en;
+wire    [`USB_TRACE_CTRL_TRIG_EP_W-1:0]         trace_ctrl_trig_ep;
+wire    [`USB_TRACE_CTRL_POST_W-1:0]            trace_ctrl_post;
+wire    [`USB_TRACE_FILT_PID_MASK_W-1:0]        trace_filt_pid_mask;
+wire    [`USB_TRACE_FILT_EP_MASK_W-1:0]         trace_filt_ep_mask;
+wire    [`USB_TRACE_DEPTH_W-1:0]                trace_idx;
+wire    [`USB_TRACE_DEPTH_W-1:0]                trace_sts_wptr;
+wire                                            trace_sts_wrap;
+wire                                            trace_sts_triggered;
+wire                                            trace_sts_stopped;
+wire    [31:0]                                  trace_data0;
+wire    [31:0]                                  trace_data1;
+
+////// TRACE<-->CORE
+wire                                            core_trace_valid;
+wire    [31:0]                                  core_trace_data;
+`endif
+
 ////// EPU<-->CORE
-wire    [`USB_EP_NUM-1:0]                       core_sie_rx_space;
-wire    [`USB_EP_NUM-1:0]                       core_sie_rx_valid;
-wire    [`USB_EP_NUM-1:0]                       core_sie_rx_setup;
+wire    [EP_NUM-1:0]                            core_sie_rx_space;
+wire    [EP_NUM-1:0]                            core_sie_rx_valid;
+wire    [EP_NUM-1:0]                            core_sie_rx_setup;
 wire                                            core_sie_rx_strb;
 wire    [  7:0]                                 core_sie_rx_data;
 wire                                            core_sie_rx_last;
 wire                                            core_sie_rx_crc_err;
-wire    [`USB_EP_NUM-1:0]                       core_sie_tx_ready;
-wire    [`USB_EP_NUM-1:0]                       core_sie_tx_valid;
-wire    [`USB_EP_NUM-1:0]                       core_sie_tx_strb;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  core_sie_tx_data;
-wire    [`USB_EP_NUM-1:0]                       core_sie_tx_last;
-wire    [`USB_EP_NUM-1:0]                       core_sie_tx_accept;
+wire    [EP_NUM-1:0]                            core_sie_tx_ready;
+wire    [EP_NUM-1:0]                            core_sie_tx_valid;
+wire    [EP_NUM-1:0]                            core_sie_tx_strb;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       core_sie_tx_data;
+wire    [EP_NUM-1:0]                            core_sie_tx_last;
+wire    [EP_NUM-1:0]                            core_sie_tx_accept;
 ////// EPU<-->MEM
-wire    [`USB_EP_NUM-1:0]                       mem_ep_data_wt_req;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  mem_ep_rx_data;
-wire    [`USB_EP_NUM-1:0]                       mem_ep_rx_full;
-wire    [`USB_EP_NUM-1:0]                       mem_ep_data_rd_req;
-wire    [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  mem_ep_tx_data;
-wire    [`USB_EP_NUM-1:0]                       mem_ep_tx_empty;
+wire    [EP_NUM-1:0]                            mem_ep_data_wt_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_rx_data;
+wire    [EP_NUM-1:0]                            mem_ep_rx_full;
+wire    [EP_NUM-1:0]                            mem_ep_data_rd_req;
+wire    [EP_NUM-1:0]                            mem_ep_lpb_rd_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_lpb_rx_data;
+wire    [EP_NUM-1:0]                            mem_ep_lpb_wt_req;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_lpb_tx_data;
+wire    [EP_NUM-1:0]                            mem_ep_rx_flush;
+wire    [EP_NUM-1:0]                            mem_ep_tx_flush;
+wire    [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_tx_data;
+wire    [EP_NUM-1:0]                            mem_ep_tx_empty;
 
 //-----------------------------------------------------------------
 // BIU
 //-----------------------------------------------------------------
-usbf_biu u_usbf_biu(
+usbf_biu #(
+    .ITF_ICB                            (ITF_ICB),
+    .BASE_ADDR_31_12                    (BASE_ADDR_31_12)
+) u_usbf_biu(
     .hclk_i                             (hclk_i),
     .hrstn_i                            (hrstn_i),
 
-    `ifdef USB_ITF_AHB
     ////// AHB slave interface
     .hsel_i                             (hsel_i),
     .hwrite_i                           (hwrite_i),
@@ -205,9 +291,7 @@ usbf_biu u_usbf_biu(
     .hready_o                           (hready_o),
     .hresp_o                            (hresp_o),
     .hrdata_o                           (hrdata_o),
-    `endif
 
-    `ifdef USB_ITF_ICB
     ////// ICB slave interface
     .icb_cmd_valid_i                    (icb_cmd_valid_i),
     .icb_cmd_ready_o                    (icb_cmd_ready_o),
@@ -217,7 +301,6 @@ usbf_biu u_usbf_biu(
     .icb_rsp_valid_o                    (icb_rsp_valid_o),
     .icb_rsp_ready_i                    (icb_rsp_ready_i),
     .icb_rsp_rdata_o                    (icb_rsp_rdata_o),
-    `endif
 
     ////// CSR interface
     .wt_en_o                            (wt_en),      
@@ -233,7 +316,9 @@ usbf_biu u_usbf_biu(
 //-----------------------------------------------------------------
 // CSR
 //-----------------------------------------------------------------
-usbf_csr u_usbf_csr(
+usbf_csr #(
+    .EP_NUM                             (EP_NUM)
+) u_usbf_csr(
     .hclk_i                             (hclk_i),                                         
     .rstn_i                             (hrstn_i),                                     
  
@@ -252,16 +337,30 @@ usbf_csr u_usbf_csr(
     .func_ctrl_hs_chirp_en_o            (csr_func_ctrl_hs_chirp_en ),                                                                          
     .func_addr_dev_addr_o               (csr_func_addr_dev_addr),                                                                            
     .ep_cfg_stall_ep_o                  (csr_ep_cfg_stall_ep),
+    .ep_cfg_loopback_en_o               (csr_ep_cfg_loopback_en),
+    .ep_cfg_auto_accept_o               (csr_ep_cfg_auto_accept),
+    .ep_cfg_loopback_ep_o               (csr_ep_cfg_loopback_ep),
     .ep_cfg_iso_o                       (csr_ep_cfg_iso),                                                                             
     .func_stat_frame_i                  (csr_func_stat_frame),  
     .rst_intr_set_i                     (csr_rst_intr_set),
     .sof_intr_set_i                     (csr_sof_intr_set), 
+    .presof_intr_set_i                  (csr_presof_intr_set),
+    .func_stat_sof_lock_i               (csr_func_stat_sof_lock),
+    .sof_ctrl_sof_div_o                 (csr_sof_ctrl_sof_div),
+    .sof_ctrl_presof_lead_o             (csr_sof_ctrl_presof_lead),
+    .sof_ctrl_meas_win_o                (csr_sof_ctrl_meas_win),
+    .sof_period_i                       (csr_sof_period),
     .ep_rx_ready_intr_set_i             (csr_ep_rx_ready_intr_set),     
     .ep_tx_complete_intr_set_i          (csr_ep_tx_complete_intr_set),                                                    
+    .ep_in_nak_intr_set_i               (csr_ep_in_nak_intr_set),
+    .ep_out_nak_intr_set_i              (csr_ep_out_nak_intr_set),
+    .nak_ctrl_holdoff_o                 (csr_nak_ctrl_holdoff),
+    .rst_ctrl_flush_o                   (csr_rst_ctrl_flush),
  
     ////// EPU(endpoint) interface                                                       
     .ep_tx_ctrl_tx_start_o              (csr_ep_tx_ctrl_tx_start),                                             
     .ep_tx_ctrl_tx_len_o                (csr_ep_tx_ctrl_tx_len),                                                
+    .ep_tx_ctrl_tx_min_o                (csr_ep_tx_ctrl_tx_min),
     .ep_rx_ctrl_rx_accept_o             (csr_ep_rx_ctrl_rx_accept),          
     .ep_sts_tx_err_i                    (csr_ep_sts_tx_err),                                             
     .ep_sts_tx_busy_i                   (csr_ep_sts_tx_busy),                                         
@@ -279,6 +378,8 @@ usbf_csr u_usbf_csr(
     .ep_tx_ctrl_tx_flush_o              (csr_ep_tx_ctrl_tx_flush),   
     .ep_data_wt_req_o                   (csr_ep_data_wt_req),                                                                                      
     .ep_tx_data_o                       (csr_ep_tx_data),                                             
+    .ep_rx_level_i                      (csr_ep_rx_level),
+    .ep_tx_level_i                      (csr_ep_tx_level),
       
     ////// Device interface 
     .func_ctrl_phy_dmpulldown_o         (csr_utmi_dmpulldown),                                                                         
@@ -288,6 +389,25 @@ usbf_csr u_usbf_csr(
     .func_ctrl_phy_opmode_o             (csr_utmi_op_mode),                                                                                                                                                        
     .func_stat_linestate_i              (csr_utmi_linestate),  
 
+`ifdef USB_TRACE
+    ////// Trace interface
+    .trace_ctrl_en_o                    (csr_trace_ctrl_en),
+    .trace_ctrl_trig_en_o               (csr_trace_ctrl_trig_en),
+    .trace_ctrl_trig_pid_o              (csr_trace_ctrl_trig_pid),
+    .trace_ctrl_trig_ep_en_o            (csr_trace_ctrl_trig_ep_en),
+    .trace_ctrl_trig_ep_o               (csr_trace_ctrl_trig_ep),
+    .trace_ctrl_post_o                  (csr_trace_ctrl_post),
+    .trace_filt_pid_mask_o              (csr_trace_filt_pid_mask),
+    .trace_filt_ep_mask_o               (csr_trace_filt_ep_mask),
+    .trace_idx_o                        (csr_trace_idx),
+    .trace_sts_wptr_i                   (csr_trace_sts_wptr),
+    .trace_sts_wrap_i                   (csr_trace_sts_wrap),
+    .trace_sts_triggered_i              (csr_trace_sts_triggered),
+    .trace_sts_stopped_i                (csr_trace_sts_stopped),
+    .trace_data0_i                      (csr_trace_data0),
+    .trace_data1_i                      (csr_trace_data1),
+`endif
+
     // interrupt req
     .intr_o                             (intr_o),
     .mem_wt_ready_i                     (mem_wt_ready),
@@ -297,7 +417,9 @@ usbf_csr u_usbf_csr(
 //-----------------------------------------------------------------
 // SYNC
 //-----------------------------------------------------------------
-usbf_sync u_usbf_sync(
+usbf_sync #(
+    .EP_NUM                             (EP_NUM)
+) u_usbf_sync(
     .phy_clk_i                          (phy_clk_i),
     .hclk_i                             (hclk_i),
     .rstn_i                             (hrstn_i),
@@ -306,15 +428,29 @@ usbf_sync u_usbf_sync(
     .func_ctrl_hs_chirp_en_i            (csr_func_ctrl_hs_chirp_en ), 
     .func_addr_dev_addr_i               (csr_func_addr_dev_addr),     
     .ep_cfg_stall_ep_i                  (csr_ep_cfg_stall_ep),
+    .ep_cfg_loopback_en_i               (csr_ep_cfg_loopback_en),
+    .ep_cfg_auto_accept_i               (csr_ep_cfg_auto_accept),
+    .ep_cfg_loopback_ep_i               (csr_ep_cfg_loopback_ep),
     .ep_cfg_iso_i                       (csr_ep_cfg_iso),             
     .func_stat_frame_o                  (csr_func_stat_frame),  
     .rst_intr_set_o                     (csr_rst_intr_set),
     .sof_intr_set_o                     (csr_sof_intr_set), 
+    .presof_intr_set_o                  (csr_presof_intr_set),
+    .func_stat_sof_lock_o               (csr_func_stat_sof_lock),
+    .sof_ctrl_sof_div_i                 (csr_sof_ctrl_sof_div),
+    .sof_ctrl_presof_lead_i             (csr_sof_ctrl_presof_lead),
+    .sof_ctrl_meas_win_i                (csr_sof_ctrl_meas_win),
+    .sof_period_o                       (csr_sof_period),
     .ep_rx_ready_intr_set_o             (csr_ep_rx_ready_intr_set),   
     .ep_tx_complete_intr_set_o          (csr_ep_tx_complete_intr_set),
+    .ep_in_nak_intr_set_o               (csr_ep_in_nak_intr_set),
+    .ep_out_nak_intr_set_o              (csr_ep_out_nak_intr_set),
+    .nak_ctrl_holdoff_i                 (csr_nak_ctrl_holdoff),
+    .rst_ctrl_flush_i                   (csr_rst_ctrl_flush),
 
     .ep_tx_ctrl_tx_start_i              (csr_ep_tx_ctrl_tx_start), 
     .ep_tx_ctrl_tx_len_i                (csr_ep_tx_ctrl_tx_len),   
+    .ep_tx_ctrl_tx_min_i                (csr_ep_tx_ctrl_tx_min),
     .ep_rx_ctrl_rx_accept_i             (csr_ep_rx_ctrl_rx_accept),
     .ep_sts_tx_err_o                    (csr_ep_sts_tx_err),       
     .ep_sts_tx_busy_o                   (csr_ep_sts_tx_busy),      
@@ -329,6 +465,8 @@ usbf_sync u_usbf_sync(
     .ep_tx_ctrl_tx_flush_i              (csr_ep_tx_ctrl_tx_flush), 
     .ep_data_wt_req_i                   (csr_ep_data_wt_req),      
     .ep_tx_data_i                       (csr_ep_tx_data),          
+    .ep_rx_level_o                      (csr_ep_rx_level),
+    .ep_tx_level_o                      (csr_ep_tx_level),
 
     .func_ctrl_phy_dmpulldown_i         (csr_utmi_dmpulldown),
     .func_ctrl_phy_dppulldown_i         (csr_utmi_dppulldown),
@@ -337,19 +475,51 @@ usbf_sync u_usbf_sync(
     .func_ctrl_phy_opmode_i             (csr_utmi_op_mode),   
     .func_stat_linestate_o              (csr_utmi_linestate), 
 
+`ifdef USB_TRACE
+    .trace_ctrl_en_i                    (csr_trace_ctrl_en),
+    .trace_ctrl_trig_en_i               (csr_trace_ctrl_trig_en),
+    .trace_ctrl_trig_pid_i              (csr_trace_ctrl_trig_pid),
+    .trace_ctrl_trig_ep_en_i            (csr_trace_ctrl_trig_ep_en),
+    .trace_ctrl_trig_ep_i               (csr_trace_ctrl_trig_ep),
+    .trace_ctrl_post_i                  (csr_trace_ctrl_post),
+    .trace_filt_pid_mask_i              (csr_trace_filt_pid_mask),
+    .trace_filt_ep_mask_i               (csr_trace_filt_ep_mask),
+    .trace_idx_i                        (csr_trace_idx),
+    .trace_sts_wptr_o                   (csr_trace_sts_wptr),
+    .trace_sts_wrap_o                   (csr_trace_sts_wrap),
+    .trace_sts_triggered_o              (csr_trace_sts_triggered),
+    .trace_sts_stopped_o                (csr_trace_sts_stopped),
+    .trace_data0_o                      (csr_trace_data0),
+    .trace_data1_o                      (csr_trace_data1),
+`endif
+
     // connect to phy domain modules
     .sh2pl_func_ctrl_hs_chirp_en_o      (func_ctrl_hs_chirp_en),
     .sh2pb_func_addr_dev_addr_o         (func_addr_dev_addr),
     .sh2pl_ep_cfg_stall_ep_o            (ep_cfg_stall_ep),
+    .sh2pl_ep_cfg_loopback_en_o         (ep_cfg_loopback_en),
+    .sh2pl_ep_cfg_auto_accept_o         (ep_cfg_auto_accept),
+    .sh2pb_ep_cfg_loopback_ep_o         (ep_cfg_loopback_ep),
     .sh2pl_ep_cfg_iso_o                 (ep_cfg_iso),
     .p2hb_func_stat_frame_i             (func_stat_frame),
     .p2ht_rst_intr_set_i                (rst_intr_set),
     .p2ht_sof_intr_set_i                (sof_intr_set),
+    .p2ht_presof_intr_set_i             (presof_intr_set),
+    .p2hl_func_stat_sof_lock_i          (func_stat_sof_lock),
+    .sh2pb_sof_ctrl_sof_div_o           (sof_ctrl_sof_div),
+    .sh2pb_sof_ctrl_presof_lead_o       (sof_ctrl_presof_lead),
+    .sh2pb_sof_ctrl_meas_win_o          (sof_ctrl_meas_win),
+    .p2hb_sof_period_i                  (sof_period),
     .p2ht_ep_rx_ready_intr_set_i        (ep_rx_ready_intr_set),
     .p2ht_ep_tx_complete_intr_set_i     (ep_tx_complete_intr_set),
+    .p2ht_ep_in_nak_intr_set_i          (ep_in_nak_intr_set),
+    .p2ht_ep_out_nak_intr_set_i         (ep_out_nak_intr_set),
+    .sh2pb_nak_ctrl_holdoff_o           (nak_ctrl_holdoff),
+    .sh2pl_rst_ctrl_flush_o             (rst_ctrl_flush),
     
     .sh2pt_ep_tx_ctrl_tx_start_o        (ep_tx_ctrl_tx_start),
     .sh2pb_ep_tx_ctrl_tx_len_o          (ep_tx_ctrl_tx_len),
+    .sh2pb_ep_tx_ctrl_tx_min_o          (ep_tx_ctrl_tx_min),
     .sh2pt_ep_rx_ctrl_rx_accept_o       (ep_rx_ctrl_rx_accept),
     .p2hl_ep_sts_tx_err_i               (ep_sts_tx_err),
     .p2hl_ep_sts_tx_busy_i              (ep_sts_tx_busy),
@@ -364,6 +534,8 @@ usbf_sync u_usbf_sync(
     .sh2pt_ep_tx_ctrl_tx_flush_o        (ep_tx_ctrl_tx_flush),
     .sh2pt_ep_data_wt_req_o             (ep_data_wt_req),
     .sh2pb_ep_tx_data_o                 (ep_tx_data),
+    .p2hb_ep_rx_level_i                 (ep_rx_level),
+    .p2hb_ep_tx_level_i                 (ep_tx_level),
     
     .sh2pl_func_ctrl_phy_dmpulldown_o   (utmi_dmpulldown_o),
     .sh2pl_func_ctrl_phy_dppulldown_o   (utmi_dppulldown_o),
@@ -372,6 +544,24 @@ usbf_sync u_usbf_sync(
     .sh2pb_func_ctrl_phy_opmode_o       (utmi_op_mode_o),
     .p2hb_func_stat_linestate_i         (utmi_linestate_i),
 
+`ifdef USB_TRACE
+    .sh2pl_trace_ctrl_en_o              (trace_ctrl_en),
+    .sh2pb_trace_ctrl_trig_en_o         (trace_ctrl_trig_en),
+    .sh2pb_trace_ctrl_trig_pid_o        (trace_ctrl_trig_pid),
+    .sh2pb_trace_ctrl_trig_ep_en_o      (trace_ctrl_trig_ep_en),
+    .sh2pb_trace_ctrl_trig_ep_o         (trace_ctrl_trig_ep),
+    .sh2pb_trace_ctrl_post_o            (trace_ctrl_post),
+    .sh2pb_trace_filt_pid_mask_o        (trace_filt_pid_mask),
+    .sh2pb_trace_filt_ep_mask_o         (trace_filt_ep_mask),
+    .sh2pb_trace_idx_o                  (trace_idx),
+    .p2hb_trace_sts_wptr_i              (trace_sts_wptr),
+    .p2hb_trace_sts_wrap_i              (trace_sts_wrap),
+    .p2hb_trace_sts_triggered_i         (trace_sts_triggered),
+    .p2hb_trace_sts_stopped_i           (trace_sts_stopped),
+    .p2hb_trace_data0_i                 (trace_data0),
+    .p2hb_trace_data1_i                 (trace_data1),
+`endif
+
     .mem_wt_ready_o                     (mem_wt_ready),
     .mem_rd_ready_o                     (mem_rd_ready)
 );
@@ -379,7 +569,9 @@ usbf_sync u_usbf_sync(
 //-----------------------------------------------------------------
 // EPU
 //-----------------------------------------------------------------
-usbf_epu u_usbf_epu(
+usbf_epu #(
+    .EP_NUM                             (EP_NUM)
+) u_usbf_epu(
     .phy_clk_i                          (phy_clk_i),   
     .rstn_i                             (hrstn_i),
 
@@ -400,6 +592,8 @@ usbf_epu u_usbf_epu(
     .core_sie_tx_data_o                 (core_sie_tx_data),                 
     .core_sie_tx_last_o                 (core_sie_tx_last),                 
     .core_sie_tx_accept_i               (core_sie_tx_accept),     
+        //  USB reset
+    .core_usb_rst_i                     (rst_intr_set),
  
     //////  MEM interface
         //  RX FIFO (Write)
@@ -410,6 +604,15 @@ usbf_epu u_usbf_epu(
     .mem_ep_data_rd_req_o               (mem_ep_data_rd_req),                        
     .mem_ep_tx_data_i                   (mem_ep_tx_data),                    
     .mem_ep_tx_empty_i                  (mem_ep_tx_empty),                    
+    .mem_ep_tx_level_i                  (ep_tx_level),
+        //  Loopback
+    .mem_ep_lpb_rd_req_o                (mem_ep_lpb_rd_req),
+    .mem_ep_lpb_rx_data_i               (mem_ep_lpb_rx_data),
+    .mem_ep_lpb_wt_req_o                (mem_ep_lpb_wt_req),
+    .mem_ep_lpb_tx_data_o               (mem_ep_lpb_tx_data),
+        //  Flush
+    .mem_ep_rx_flush_o                  (mem_ep_rx_flush),
+    .mem_ep_tx_flush_o                  (mem_ep_tx_flush),
 
     //////  CSR interface
         //  RX Reg
@@ -418,30 +621,45 @@ usbf_epu u_usbf_epu(
     .csr_ep_sts_rx_err_o                (ep_sts_rx_err),                             
     .csr_ep_sts_rx_setup_o              (ep_sts_rx_setup),                                 
     .csr_ep_sts_rx_ack_i                (ep_rx_ctrl_rx_accept),                             
+    .csr_ep_data_rd_req_i               (ep_data_rd_req),
         //  TX Reg
     .csr_ep_tx_ctrl_tx_flush_i          (ep_tx_ctrl_tx_flush),                                    
     .csr_ep_tx_ctrl_tx_length_i         (ep_tx_ctrl_tx_len),                                
+    .csr_ep_tx_ctrl_tx_min_i            (ep_tx_ctrl_tx_min),
     .csr_ep_tx_ctrl_tx_start_i          (ep_tx_ctrl_tx_start),                                
     .csr_ep_sts_tx_err_o                (ep_sts_tx_err),                        
-    .csr_ep_sts_tx_busy_o               (ep_sts_tx_busy)                           
+    .csr_ep_sts_tx_busy_o               (ep_sts_tx_busy),
+        //  CFG Reg
+    .csr_ep_rx_ctrl_rx_flush_i          (ep_rx_ctrl_rx_flush),
+    .csr_ep_cfg_loopback_en_i           (ep_cfg_loopback_en),
+    .csr_ep_cfg_loopback_ep_i           (ep_cfg_loopback_ep),
+    .csr_ep_cfg_auto_accept_i           (ep_cfg_auto_accept),
+    .csr_rst_ctrl_flush_i               (rst_ctrl_flush)
 );
 
 //-----------------------------------------------------------------
 // MEM
 //-----------------------------------------------------------------
-usbf_mem u_usbf_mem(
+usbf_mem #(
+    .EP_NUM                             (EP_NUM),
+    .REG_FIFO                           (REG_FIFO),
+    .FIFO_ADDR_W                        (FIFO_ADDR_W)
+) u_usbf_mem(
     .phy_clk_i                          (phy_clk_i),               
     .rstn_i                             (hrstn_i),                                   
 
     ////// CSR interface
     //// RX-FIFO Read
-    .csr_ep_rx_ctrl_rx_flush_i          (ep_rx_ctrl_rx_flush),                                                
+    .csr_ep_rx_ctrl_rx_flush_i          (mem_ep_rx_flush),                                                
     .csr_ep_data_rd_req_i               (ep_data_rd_req),                                           
     .csr_ep_rx_data_o                   (ep_rx_data),                                       
     //// TX-FIFO Write
-    .csr_ep_tx_ctrl_tx_flush_i          (ep_tx_ctrl_tx_flush),                                       
+    .csr_ep_tx_ctrl_tx_flush_i          (mem_ep_tx_flush),                                       
     .csr_ep_data_wt_req_i               (ep_data_wt_req),                                   
     .csr_ep_tx_data_i                   (ep_tx_data),                               
+    //// FIFO fill level
+    .csr_ep_rx_level_o                  (ep_rx_level),
+    .csr_ep_tx_level_o                  (ep_tx_level),
 
     ////// EPU interface 
     //// RX-FIFO Write 
@@ -451,14 +669,21 @@ usbf_mem u_usbf_mem(
     //// TX-FIFO Read
     .epu_ep_data_rd_req_i               (mem_ep_data_rd_req),                                                        
     .epu_ep_tx_empty_o                  (mem_ep_tx_empty),                                                   
-    .epu_ep_tx_data_o                   (mem_ep_tx_data)                                                 
+    .epu_ep_tx_data_o                   (mem_ep_tx_data),
+    //// Loopback
+    .epu_ep_lpb_rd_req_i                (mem_ep_lpb_rd_req),
+    .epu_ep_lpb_rx_data_o               (mem_ep_lpb_rx_data),
+    .epu_ep_lpb_wt_req_i                (mem_ep_lpb_wt_req),
+    .epu_ep_lpb_tx_data_i               (mem_ep_lpb_tx_data)
      
 );
 
 //-----------------------------------------------------------------
 // CORE
 //-----------------------------------------------------------------
-usbf_core u_usbf_core
+usbf_core #(
+    .EP_NUM                             (EP_NUM)
+) u_usbf_core
 (
     .clk_i                              (phy_clk_i),   
     .rstn_i                             (hrstn_i),   
@@ -499,11 +724,21 @@ usbf_core u_usbf_core
     .func_addr_dev_addr_i               (func_addr_dev_addr),
     .ep_stall_i                         (ep_cfg_stall_ep), 
     .ep_iso_i                           (ep_cfg_iso),                                                                                             
+    .nak_holdoff_i                      (nak_ctrl_holdoff),
     .func_stat_frame_o                  (func_stat_frame),
     .rst_intr_set_o                     (rst_intr_set),
-    .sof_intr_set_o                     (sof_intr_set),        
+    .sof_intr_set_o                     (core_sof_valid),        
     .ep_rx_ready_intr_set_o             (ep_rx_ready_intr_set),    
     .ep_tx_complete_intr_set_o          (ep_tx_complete_intr_set),        
+    .ep_in_nak_intr_set_o               (ep_in_nak_intr_set),
+    .ep_out_nak_intr_set_o              (ep_out_nak_intr_set),
+
+`ifdef USB_TRACE
+    // Trace interface
+    /////////////////////////////////////
+    .trace_valid_o                      (core_trace_valid),
+    .trace_data_o                       (core_trace_data),
+`endif
 
     // Others
     /////////////////////////////////////
@@ -512,4 +747,56 @@ usbf_core u_usbf_core
     
 );
 
+//-----------------------------------------------------------------
+// SOF TIMER
+//-----------------------------------------------------------------
+usbf_sof_timer u_usbf_sof_timer(
+    .clk_i                              (phy_clk_i),
+    .rstn_i                             (hrstn_i),
+
+    ////// CORE interface
+    .sof_i                              (core_sof_valid),
+    .usb_rst_i                          (rst_intr_set),
+
+    ////// CSR interface
+    .sof_div_i                          (sof_ctrl_sof_div),
+    .presof_lead_i                      (sof_ctrl_presof_lead),
+    .meas_win_i                         (sof_ctrl_meas_win),
+    .sof_intr_set_o                     (sof_intr_set),
+    .presof_intr_set_o                  (presof_intr_set),
+    .sof_lock_o                         (func_stat_sof_lock),
+    .period_o                           (sof_period)
+);
+
+`ifdef USB_TRACE
+//-----------------------------------------------------------------
+// TRACE
+//-----------------------------------------------------------------
+usbf_trace u_usbf_trace(
+    .clk_i                              (phy_clk_i),
+    .rstn_i                             (hrstn_i),
+
+    ////// CORE interface
+    .ev_valid_i                         (core_trace_valid),
+    .ev_data_i                          (core_trace_data),
+
+    ////// CSR interface
+    .en_i                               (trace_ctrl_en),
+    .trig_en_i                          (trace_ctrl_trig_en),
+    .trig_pid_i                         (trace_ctrl_trig_pid),
+    .trig_ep_en_i                       (trace_ctrl_trig_ep_en),
+    .trig_ep_i                          (trace_ctrl_trig_ep),
+    .post_i                             (trace_ctrl_post),
+    .pid_mask_i                         (trace_filt_pid_mask),
+    .ep_mask_i                          (trace_filt_ep_mask),
+    .wptr_o                             (trace_sts_wptr),
+    .wrap_o                             (trace_sts_wrap),
+    .triggered_o                        (trace_sts_triggered),
+    .stopped_o                          (trace_sts_stopped),
+    .rd_idx_i                           (trace_idx),
+    .rd_data0_o                         (trace_data0),
+    .rd_data1_o                         (trace_data1)
+);
+`endif
+
 endmodule
@@ -22,56 +22,240 @@
 
 `include "usbf_cfg_defs.v"
 
-module usbf_epu(
+module usbf_epu #(
+    parameter EP_NUM = `USB_EP_NUM
+)(
       input                                         phy_clk_i        
     , input                                         rstn_i
 
     //////  CORE interface
         //  RX SIE
-    ,output [`USB_EP_NUM-1:0]                       core_sie_rx_space_o
-    , input [`USB_EP_NUM-1:0]                       core_sie_rx_valid_i
-    , input [`USB_EP_NUM-1:0]                       core_sie_rx_setup_i
+    ,output [EP_NUM-1:0]                            core_sie_rx_space_o
+    , input [EP_NUM-1:0]                            core_sie_rx_valid_i
+    , input [EP_NUM-1:0]                            core_sie_rx_setup_i
             //  SIE shared
     , input                                         core_sie_rx_strb_i
     , input [  7:0]                                 core_sie_rx_data_i
     , input                                         core_sie_rx_last_i
     , input                                         core_sie_rx_crc_err_i 
         //  TX SIE
-    ,output [`USB_EP_NUM-1:0]                       core_sie_tx_ready_o    
-    ,output [`USB_EP_NUM-1:0]                       core_sie_tx_valid_o  
-    ,output [`USB_EP_NUM-1:0]                       core_sie_tx_strb_o  
-    ,output [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  core_sie_tx_data_o  
-    ,output [`USB_EP_NUM-1:0]                       core_sie_tx_last_o  
-    , input [`USB_EP_NUM-1:0]                       core_sie_tx_accept_i
+    ,output [EP_NUM-1:0]                            core_sie_tx_ready_o    
+    ,output [EP_NUM-1:0]                            core_sie_tx_valid_o  
+    ,output [EP_NUM-1:0]                            core_sie_tx_strb_o  
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       core_sie_tx_data_o  
+    ,output [EP_NUM-1:0]                            core_sie_tx_last_o  
+    , input [EP_NUM-1:0]                            core_sie_tx_accept_i
+        //  USB reset
+    , input                                         core_usb_rst_i
 
     //////  MEM interface
         //  RX FIFO (Write)
-    ,output [`USB_EP_NUM-1:0]                       mem_ep_data_wt_req_o
-    ,output [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  mem_ep_rx_data_o 
-    , input [`USB_EP_NUM-1:0]                       mem_ep_rx_full_i 
+    ,output [EP_NUM-1:0]                            mem_ep_data_wt_req_o
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_rx_data_o 
+    , input [EP_NUM-1:0]                            mem_ep_rx_full_i 
         //  TX FIFO (Read)
-    ,output [`USB_EP_NUM-1:0]                       mem_ep_data_rd_req_o
-    , input [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  mem_ep_tx_data_i
-    , input [`USB_EP_NUM-1:0]                       mem_ep_tx_empty_i 
+    ,output [EP_NUM-1:0]                            mem_ep_data_rd_req_o
+    , input [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_tx_data_i
+    , input [EP_NUM-1:0]                            mem_ep_tx_empty_i 
+    , input [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  mem_ep_tx_level_i
+        //  Loopback: RX FIFO (Read) and TX FIFO (Write)
+    ,output [EP_NUM-1:0]                            mem_ep_lpb_rd_req_o
+    , input [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_lpb_rx_data_i
+    ,output [EP_NUM-1:0]                            mem_ep_lpb_wt_req_o
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       mem_ep_lpb_tx_data_o
+        //  Flush
+    ,output [EP_NUM-1:0]                            mem_ep_rx_flush_o
+    ,output [EP_NUM-1:0]                            mem_ep_tx_flush_o
 
     //////  CSR interface
         //  RX Reg
-    ,output [`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0]  csr_ep_sts_rx_count_o
-    ,output [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_ready_o
-    ,output [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_err_o
-    ,output [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_setup_o
-    , input [`USB_EP_NUM-1:0]                       csr_ep_sts_rx_ack_i
+    ,output [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0]       csr_ep_sts_rx_count_o
+    ,output [EP_NUM-1:0]                            csr_ep_sts_rx_ready_o
+    ,output [EP_NUM-1:0]                            csr_ep_sts_rx_err_o
+    ,output [EP_NUM-1:0]                            csr_ep_sts_rx_setup_o
+    , input [EP_NUM-1:0]                            csr_ep_sts_rx_ack_i
+    , input [EP_NUM-1:0]                            csr_ep_data_rd_req_i
         //  TX Reg
-    , input [`USB_EP_NUM-1:0]                       csr_ep_tx_ctrl_tx_flush_i
-    , input [`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM-1:0] csr_ep_tx_ctrl_tx_length_i
-    , input [`USB_EP_NUM-1:0]                       csr_ep_tx_ctrl_tx_start_i
-    ,output [`USB_EP_NUM-1:0]                       csr_ep_sts_tx_err_o
-    ,output [`USB_EP_NUM-1:0]                       csr_ep_sts_tx_busy_o
+    , input [EP_NUM-1:0]                            csr_ep_tx_ctrl_tx_flush_i
+    , input [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0] csr_ep_tx_ctrl_tx_length_i
+    , input [`USB_EP0_TX_CTRL_TX_MIN_W*EP_NUM-1:0] csr_ep_tx_ctrl_tx_min_i
+    , input [EP_NUM-1:0]                            csr_ep_tx_ctrl_tx_start_i
+    ,output [EP_NUM-1:0]                            csr_ep_sts_tx_err_o
+    ,output [EP_NUM-1:0]                            csr_ep_sts_tx_busy_o
+        //  CFG Reg
+    , input [EP_NUM-1:0]                            csr_ep_rx_ctrl_rx_flush_i
+    , input [EP_NUM-1:0]                            csr_ep_cfg_loopback_en_i
+    , input [`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM-1:0] csr_ep_cfg_loopback_ep_i
+    , input [EP_NUM-1:0]                            csr_ep_cfg_auto_accept_i
+    , input                                         csr_rst_ctrl_flush_i
 );
 
+//-----------------------------------------------------------------
+// Flush
+// With USB_RST_CTRL.FLUSH, all FIFOs are flushed and the pending rx
+// and tx of all EPs are dropped during USB reset.
+//-----------------------------------------------------------------
+wire                                            rst_flush_w = core_usb_rst_i & csr_rst_ctrl_flush_i;
+wire [EP_NUM-1:0]                               rx_flush_w  = csr_ep_rx_ctrl_rx_flush_i | {EP_NUM{rst_flush_w}};
+wire [EP_NUM-1:0]                               tx_flush_w  = csr_ep_tx_ctrl_tx_flush_i | {EP_NUM{rst_flush_w}};
+
+assign mem_ep_rx_flush_o = rx_flush_w;
+assign mem_ep_tx_flush_o = tx_flush_w;
+
+//-----------------------------------------------------------------
+// Loopback
+// The OUT packet of a loopback EP is moved from its RX FIFO to the
+// TX FIFO of the IN EP selected by LOOPBACK_EP, then the IN EP is 
+// armed with the received length and the RX buffer is released.
+// Packets with CRC error or SETUP packets are dropped.
+//-----------------------------------------------------------------
+localparam LPB_IDLE  = 2'd0;
+localparam LPB_COPY  = 2'd1;
+localparam LPB_START = 2'd2;
+
+// source EP side
+wire [EP_NUM-1:0]                               lpb_rx_ack_w;
+wire [EP_NUM-1:0]                               lpb_start_w;
+wire [EP_NUM*EP_NUM-1:0]                        lpb_dst_w;   // one-hot destination EP
+wire [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0]       lpb_len_w;
+
+// destination EP side
+reg  [EP_NUM-1:0]                               lpb_tx_push_r;
+reg  [EP_NUM-1:0]                               lpb_tx_start_r;
+reg  [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]          lpb_tx_data_r;
+reg  [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0] lpb_tx_len_r;
+
 genvar i;
 generate
-    for(i=0; i<`USB_EP_NUM; i=i+1)begin
+    for(i=0; i<EP_NUM; i=i+1)begin: lpb_ep
+        reg  [1:0]  state_q;
+        reg         wait_q;     // RX FIFO data is valid one clock after a pop
+        reg         drop_q;
+        reg  [`USB_EP0_STS_RX_COUNT_W-1:0] len_q;
+        reg  [`USB_EP0_STS_RX_COUNT_W-1:0] remain_q;
+
+        wire [`USB_EP0_CFG_LOOPBACK_EP_W-1:0] dst_ep_w = 
+                csr_ep_cfg_loopback_ep_i[i*`USB_EP0_CFG_LOOPBACK_EP_W +: `USB_EP0_CFG_LOOPBACK_EP_W];
+        wire dst_valid_w = (dst_ep_w < EP_NUM);
+        wire dst_busy_w  = dst_valid_w & csr_ep_sts_tx_busy_o[dst_ep_w];
+        wire drop_w      = csr_ep_sts_rx_err_o[i] | csr_ep_sts_rx_setup_o[i] | ~dst_valid_w;
+
+        wire enable_w    = csr_ep_cfg_loopback_en_i[i] & ~rx_flush_w[i];
+        wire pop_w       = (state_q == LPB_COPY) & ~wait_q & (remain_q != 0);
+
+        always @ (posedge phy_clk_i or negedge rstn_i)
+        if (!rstn_i)
+        begin
+            state_q  <= LPB_IDLE;
+            wait_q   <= 1'b0;
+            drop_q   <= 1'b0;
+            len_q    <= {`USB_EP0_STS_RX_COUNT_W{1'b0}};
+            remain_q <= {`USB_EP0_STS_RX_COUNT_W{1'b0}};
+        end
+        else if (!enable_w)
+            state_q  <= LPB_IDLE;
+        else
+        begin
+            case (state_q)
+            LPB_IDLE :
+            begin
+                if (csr_ep_sts_rx_ready_o[i] && (drop_w || !dst_busy_w))
+                begin
+                    state_q  <= LPB_COPY;
+                    wait_q   <= 1'b1;
+                    drop_q   <= drop_w;
+                    len_q    <= csr_ep_sts_rx_count_o[i*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W];
+                    remain_q <= csr_ep_sts_rx_count_o[i*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W];
+                end
+            end
+            LPB_COPY :
+            begin
+                if (wait_q)
+                    wait_q   <= 1'b0;
+                else if (remain_q == 0)
+                    state_q  <= LPB_START;
+                else
+                begin
+                    wait_q   <= 1'b1;
+                    remain_q <= remain_q - 1'b1;
+                end
+            end
+            default :
+                state_q  <= LPB_IDLE;
+            endcase
+        end
+
+        assign mem_ep_lpb_rd_req_o[i] = pop_w;
+        assign lpb_rx_ack_w[i] = (state_q == LPB_START);
+        assign lpb_start_w[i]  = (state_q == LPB_START) & ~drop_q;
+        assign lpb_dst_w[i*EP_NUM +: EP_NUM] = 
+                (drop_q || (state_q != LPB_COPY && state_q != LPB_START)) ? {EP_NUM{1'b0}} :
+                ({{(EP_NUM-1){1'b0}}, 1'b1} << dst_ep_w);
+        assign lpb_len_w[i*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W] = len_q;
+    end
+endgenerate
+
+// route source EPs to destination EPs
+integer s, d;
+always @(*)begin
+    lpb_tx_push_r  = {EP_NUM{1'b0}};
+    lpb_tx_start_r = {EP_NUM{1'b0}};
+    lpb_tx_data_r  = {`USB_EP0_DATA_DATA_W*EP_NUM{1'b0}};
+    lpb_tx_len_r   = {`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM{1'b0}};
+
+    for(d=0; d<EP_NUM; d=d+1) begin
+        for(s=0; s<EP_NUM; s=s+1) begin
+            if (lpb_dst_w[s*EP_NUM + d])
+            begin
+                lpb_tx_push_r[d]  = lpb_tx_push_r[d] | mem_ep_lpb_rd_req_o[s];
+                lpb_tx_start_r[d] = lpb_tx_start_r[d] | lpb_start_w[s];
+                lpb_tx_data_r[d*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W] = 
+                        mem_ep_lpb_rx_data_i[s*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W];
+                lpb_tx_len_r[d*`USB_EP0_TX_CTRL_TX_LEN_W +: `USB_EP0_TX_CTRL_TX_LEN_W] = 
+                        lpb_len_w[s*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W];
+            end
+        end
+    end
+end
+
+assign mem_ep_lpb_wt_req_o  = lpb_tx_push_r;
+assign mem_ep_lpb_tx_data_o = lpb_tx_data_r;
+
+//-----------------------------------------------------------------
+// Auto-accept
+// The RX buffer is released on the pop of the last byte of the 
+// packet, without RX_ACCEPT from the software. Zero length packets
+// still need RX_ACCEPT, so the software sees them. 
+//-----------------------------------------------------------------
+wire [EP_NUM-1:0]                               auto_rx_ack_w;
+
+generate
+    for(i=0; i<EP_NUM; i=i+1)begin: auto_ep
+        reg  [`USB_EP0_STS_RX_COUNT_W-1:0] pop_cnt_q;
+
+        wire [`USB_EP0_STS_RX_COUNT_W-1:0] rx_len_w = 
+                csr_ep_sts_rx_count_o[i*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W];
+        wire enable_w = csr_ep_cfg_auto_accept_i[i] & ~csr_ep_cfg_loopback_en_i[i];
+        wire pop_w    = csr_ep_data_rd_req_i[i] & csr_ep_sts_rx_ready_o[i];
+
+        always @ (posedge phy_clk_i or negedge rstn_i)
+        if (!rstn_i)
+            pop_cnt_q <= {`USB_EP0_STS_RX_COUNT_W{1'b0}};
+        else if (!csr_ep_sts_rx_ready_o[i] || rx_flush_w[i])
+            pop_cnt_q <= {`USB_EP0_STS_RX_COUNT_W{1'b0}};
+        else if (pop_w)
+            pop_cnt_q <= pop_cnt_q + 1'b1;
+
+        assign auto_rx_ack_w[i] = enable_w & pop_w & (pop_cnt_q == rx_len_w - 1'b1) & (rx_len_w != 0);
+    end
+endgenerate
+
+//-----------------------------------------------------------------
+// SIE EPs
+//-----------------------------------------------------------------
+
+generate
+    for(i=0; i<EP_NUM; i=i+1)begin
         usbf_sie_ep u_ep
         (
         .clk_i(phy_clk_i), 
@@ -104,18 +288,23 @@ generate
         .tx_pop_o(mem_ep_data_rd_req_o[i]),
         .tx_data_i(mem_ep_tx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
         .tx_empty_i(mem_ep_tx_empty_i[i]),
+        .tx_level_i(mem_ep_tx_level_i[i*`USB_EP0_LEVEL_TX_LEVEL_W +: `USB_EP0_LEVEL_TX_LEVEL_W]),
 
         // Rx Register Interface
         .rx_length_o(csr_ep_sts_rx_count_o[i*`USB_EP0_STS_RX_COUNT_W +: `USB_EP0_STS_RX_COUNT_W]),
         .rx_ready_o(csr_ep_sts_rx_ready_o[i]),
         .rx_err_o(csr_ep_sts_rx_err_o[i]),
         .rx_setup_o(csr_ep_sts_rx_setup_o[i]),
-        .rx_ack_i(csr_ep_sts_rx_ack_i[i]),
+        .rx_ack_i(csr_ep_sts_rx_ack_i[i] | lpb_rx_ack_w[i] | auto_rx_ack_w[i] | rst_flush_w),
 
         // Tx Register Interface
-        .tx_flush_i(csr_ep_tx_ctrl_tx_flush_i[i]),
-        .tx_length_i(csr_ep_tx_ctrl_tx_length_i[i*`USB_EP0_TX_CTRL_TX_LEN_W +: `USB_EP0_TX_CTRL_TX_LEN_W]),
-        .tx_start_i(csr_ep_tx_ctrl_tx_start_i[i]),
+        .tx_flush_i(tx_flush_w[i]),
+        .tx_length_i(lpb_tx_start_r[i] ? lpb_tx_len_r[i*`USB_EP0_TX_CTRL_TX_LEN_W +: `USB_EP0_TX_CTRL_TX_LEN_W] :
+                                         csr_ep_tx_ctrl_tx_length_i[i*`USB_EP0_TX_CTRL_TX_LEN_W +: `USB_EP0_TX_CTRL_TX_LEN_W]),
+        // a loopback packet is in the FIFO before its start
+        .tx_min_i(lpb_tx_start_r[i] ? {`USB_EP0_TX_CTRL_TX_MIN_W{1'b0}} :
+                                      csr_ep_tx_ctrl_tx_min_i[i*`USB_EP0_TX_CTRL_TX_MIN_W +: `USB_EP0_TX_CTRL_TX_MIN_W]),
+        .tx_start_i(csr_ep_tx_ctrl_tx_start_i[i] | lpb_tx_start_r[i]),
         .tx_busy_o(csr_ep_sts_tx_busy_o[i]),
         .tx_err_o(csr_ep_sts_tx_err_o[i])
         );
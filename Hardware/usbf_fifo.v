@@ -10,12 +10,19 @@
 // Modified by Zeba-Xie @github:
 // .Added conditional compilation option(REGS or GENERIC_RAM or 
 // XILINX FPGA SPRAM)
+// .USB_REG_FIFO changed to parameter REG_FIFO
 //
 //=================================================================
 
 `include "usbf_cfg_defs.v"
 
 module usbf_fifo
+#(
+     parameter WIDTH    = 8
+    ,parameter DEPTH    = 4
+    ,parameter ADDR_W   = 2
+    ,parameter REG_FIFO = `USB_REG_FIFO_DEFAULT // 1: regs, 0: GENERIC_MEM or FPGA
+)
 (
     // Inputs
      input           clk_i
@@ -29,21 +36,19 @@ module usbf_fifo
     ,output          full_o
     ,output          empty_o
     ,output [  7:0]  data_o
+    ,output [ADDR_W:0] level_o
 );
 
-parameter WIDTH   = 8;
-parameter DEPTH   = 4;
-parameter ADDR_W  = 2;
-
 //-----------------------------------------------------------------
 // Local Params
 //-----------------------------------------------------------------
 localparam COUNT_W = ADDR_W + 1;
 
+generate
 //-----------------------------------------------------------------
-// USB_REG_FIFO
+// REG_FIFO
 //-----------------------------------------------------------------
-`ifdef USB_REG_FIFO
+if (REG_FIFO) begin : reg_fifo
 
     //-----------------------------------------------------------------
     // Registers
@@ -106,13 +111,16 @@ localparam COUNT_W = ADDR_W + 1;
     assign empty_o   = (count == 0);
     /* verilator lint_on WIDTH */
 
+    assign level_o   = count;
+
     assign data_o    = ram[rd_ptr];
 
 
+end
 //-----------------------------------------------------------------
 // FPGA or GENERIC_MEM
 //-----------------------------------------------------------------
-`else
+else begin : mem_fifo
     //-----------------------------------------------------------------
     // Registers
     //-----------------------------------------------------------------
@@ -172,6 +180,8 @@ localparam COUNT_W = ADDR_W + 1;
     assign empty_o   = (count == 0);
     /* verilator lint_on WIDTH */
 
+    assign level_o   = count;
+
 
     //-------------------------------------------------------------------
     // Combinatorial
@@ -241,8 +251,8 @@ localparam COUNT_W = ADDR_W + 1;
 
     `endif
 
-
-`endif
+end
+endgenerate
 
 endmodule
 
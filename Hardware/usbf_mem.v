@@ -9,46 +9,94 @@
 // EPU |       |       |       | CSR
 //     |--rd<--|TX-FIFO|<--wt--|
 // 
+// FIFO_ADDR_W sets the depth of all FIFOs of this instance.
 // TODO: FIFOs can be configured to different size for different EP
 //=================================================================
 
 `include "usbf_cfg_defs.v"
 
-module usbf_mem(
+module usbf_mem #(
+    parameter EP_NUM        = `USB_EP_NUM,
+    parameter REG_FIFO      = `USB_REG_FIFO_DEFAULT,
+    parameter FIFO_ADDR_W   = `USB_FIFO_ADDR_W
+)(
       input                                         phy_clk_i
     , input                                         rstn_i
 
     ////// CSR interface
     //// RX-FIFO Read
-    , input [`USB_EP_NUM-1:0]                       csr_ep_rx_ctrl_rx_flush_i 
-    , input [`USB_EP_NUM-1:0]                       csr_ep_data_rd_req_i
-    ,output [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  csr_ep_rx_data_o
+    , input [EP_NUM-1:0]                            csr_ep_rx_ctrl_rx_flush_i 
+    , input [EP_NUM-1:0]                            csr_ep_data_rd_req_i
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       csr_ep_rx_data_o
     //// TX-FIFO Write
-    , input [`USB_EP_NUM-1:0]                       csr_ep_tx_ctrl_tx_flush_i
-    , input [`USB_EP_NUM-1:0]                       csr_ep_data_wt_req_i 
-    , input [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  csr_ep_tx_data_i
+    , input [EP_NUM-1:0]                            csr_ep_tx_ctrl_tx_flush_i
+    , input [EP_NUM-1:0]                            csr_ep_data_wt_req_i 
+    , input [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       csr_ep_tx_data_i
+    //// FIFO fill level
+    ,output [`USB_EP0_LEVEL_RX_LEVEL_W*EP_NUM-1:0]  csr_ep_rx_level_o
+    ,output [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  csr_ep_tx_level_o
 
     ////// EPU interface 
     //// RX-FIFO Write 
-    , input [`USB_EP_NUM-1:0]                       epu_ep_data_wt_req_i 
-    ,output [`USB_EP_NUM-1:0]                       epu_ep_rx_full_o
-    , input [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  epu_ep_rx_data_i
+    , input [EP_NUM-1:0]                            epu_ep_data_wt_req_i 
+    ,output [EP_NUM-1:0]                            epu_ep_rx_full_o
+    , input [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       epu_ep_rx_data_i
     //// TX-FIFO Read
-    , input [`USB_EP_NUM-1:0]                       epu_ep_data_rd_req_i 
-    ,output [`USB_EP_NUM-1:0]                       epu_ep_tx_empty_o
-    ,output [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  epu_ep_tx_data_o
+    , input [EP_NUM-1:0]                            epu_ep_data_rd_req_i 
+    ,output [EP_NUM-1:0]                            epu_ep_tx_empty_o
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       epu_ep_tx_data_o
+    //// Loopback: RX-FIFO Read and TX-FIFO Write
+    , input [EP_NUM-1:0]                            epu_ep_lpb_rd_req_i
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       epu_ep_lpb_rx_data_o
+    , input [EP_NUM-1:0]                            epu_ep_lpb_wt_req_i
+    , input [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       epu_ep_lpb_tx_data_i
      
 );
 
+// In loopback mode, EPU takes the place of CSR on the RX-FIFO read
+// port and the TX-FIFO write port.
+wire [EP_NUM-1:0]                           rx_pop_w  = csr_ep_data_rd_req_i | epu_ep_lpb_rd_req_i;
+wire [EP_NUM-1:0]                           tx_push_w = csr_ep_data_wt_req_i | epu_ep_lpb_wt_req_i;
+wire [`USB_EP0_DATA_DATA_W*EP_NUM-1:0] rx_data_w;
+
+// The FIFO levels count 0..2^FIFO_ADDR_W, FIFO_ADDR_W+1 bits, into
+// the LEVEL_W bits of USB_EPi_LEVEL: zero padded when narrower,
+// saturated at the field maximum when a FIFO is deeper than the field
+// can count (FIFO_ADDR_W >= LEVEL_W).
+localparam LEVEL_W    = `USB_EP0_LEVEL_RX_LEVEL_W;
+localparam FIFO_LVL_W = FIFO_ADDR_W + 1;
+
+assign csr_ep_rx_data_o     = rx_data_w;
+assign epu_ep_lpb_rx_data_o = rx_data_w;
+
 genvar i;
 generate
-    for(i=0; i<`USB_EP_NUM; i=i+1)begin
+    for(i=0; i<EP_NUM; i=i+1)begin
+        wire [FIFO_ADDR_W:0] rx_level_w;
+        wire [FIFO_ADDR_W:0] tx_level_w;
+
+        if (FIFO_LVL_W < LEVEL_W) begin : g_lvl_pad
+            assign csr_ep_rx_level_o[i*LEVEL_W +: LEVEL_W] = 
+                    {{(LEVEL_W-FIFO_LVL_W){1'b0}}, rx_level_w};
+            assign csr_ep_tx_level_o[i*LEVEL_W +: LEVEL_W] = 
+                    {{(LEVEL_W-FIFO_LVL_W){1'b0}}, tx_level_w};
+        end else if (FIFO_LVL_W == LEVEL_W) begin : g_lvl_fit
+            assign csr_ep_rx_level_o[i*LEVEL_W +: LEVEL_W] = rx_level_w;
+            assign csr_ep_tx_level_o[i*LEVEL_W +: LEVEL_W] = tx_level_w;
+        end else begin : g_lvl_sat
+            assign csr_ep_rx_level_o[i*LEVEL_W +: LEVEL_W] = 
+                    (|rx_level_w[FIFO_LVL_W-1:LEVEL_W]) ? {LEVEL_W{1'b1}} : rx_level_w[LEVEL_W-1:0];
+            assign csr_ep_tx_level_o[i*LEVEL_W +: LEVEL_W] = 
+                    (|tx_level_w[FIFO_LVL_W-1:LEVEL_W]) ? {LEVEL_W{1'b1}} : tx_level_w[LEVEL_W-1:0];
+        end
+
         ////// RX FIFO
         usbf_fifo
         #(
             .WIDTH(8),
-            .DEPTH(64),
-            .ADDR_W(6)
+            .DEPTH(1 << FIFO_ADDR_W),
+            .ADDR_W(FIFO_ADDR_W),
+            .REG_FIFO(REG_FIFO)
         )
         u_fifo_rx
         (
@@ -57,23 +105,25 @@ generate
             
             // CSR read
             .flush_i(csr_ep_rx_ctrl_rx_flush_i[i]),
-            .pop_i(csr_ep_data_rd_req_i[i]),
-            .data_o(csr_ep_rx_data_o[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
+            .pop_i(rx_pop_w[i]),
+            .data_o(rx_data_w[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
 
             // EPU write
             .push_i(epu_ep_data_wt_req_i[i]),
             .full_o(epu_ep_rx_full_o[i]),
             .data_i(epu_ep_rx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
 
-            .empty_o()
+            .empty_o(),
+            .level_o(rx_level_w)
         );
 
         ////// TX FIFO
         usbf_fifo
         #(
             .WIDTH(8),
-            .DEPTH(64),
-            .ADDR_W(6)
+            .DEPTH(1 << FIFO_ADDR_W),
+            .ADDR_W(FIFO_ADDR_W),
+            .REG_FIFO(REG_FIFO)
         )
         u_fifo_tx
         (
@@ -82,16 +132,17 @@ generate
 
             // CSR write
             .flush_i(csr_ep_tx_ctrl_tx_flush_i[i]),
-            .push_i(csr_ep_data_wt_req_i[i]),            
-            .data_i(csr_ep_tx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
+            .push_i(tx_push_w[i]),            
+            .data_i(epu_ep_lpb_wt_req_i[i] ? epu_ep_lpb_tx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W] :
+                                             csr_ep_tx_data_i[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
 
             // EPU read
             .pop_i(epu_ep_data_rd_req_i[i]),
             .empty_o(epu_ep_tx_empty_o[i]),
             .data_o(epu_ep_tx_data_o[i*`USB_EP0_DATA_DATA_W +: `USB_EP0_DATA_DATA_W]),
 
-            .full_o()
-            
+            .full_o(),
+            .level_o(tx_level_w)
         );
     end
     
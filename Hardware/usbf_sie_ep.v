@@ -38,10 +38,12 @@ module usbf_sie_ep
     ,output          tx_pop_o
     ,input  [  7:0]  tx_data_i
     ,input           tx_empty_i
+    ,input  [ 10:0]  tx_level_i
     
     // Tx register interface 
     ,input           tx_flush_i
     ,input  [ 10:0]  tx_length_i
+    ,input  [ 10:0]  tx_min_i
     ,input           tx_start_i
     ,output          tx_busy_o
     ,output          tx_err_o
@@ -116,6 +118,8 @@ reg        tx_active_q;
 reg        tx_err_q;
 reg        tx_zlp_q;
 reg [10:0] tx_len_q;
+reg [10:0] tx_min_q;
+reg        tx_go_q;
 
 // Tx active
 always @ (posedge clk_i or negedge rstn_i)
@@ -128,7 +132,31 @@ else if (tx_start_i)
 else if (tx_data_valid_o && tx_data_last_o && tx_data_accept_i)
     tx_active_q <= 1'b0;
 
-assign tx_ready_o = tx_active_q;
+// Tx start threshold
+// The packet is held back, and IN tokens NAKed, until the FIFO holds 
+// min(TX_LEN, TX_MIN) bytes. Once it is sent, it is not held again 
+// as the FIFO drains.
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    tx_min_q <= 11'b0;
+else if (tx_flush_i)
+    tx_min_q <= 11'b0;
+else if (tx_start_i)
+    tx_min_q <= (tx_min_i < tx_length_i) ? tx_min_i : tx_length_i;
+
+wire tx_level_ok_w = (tx_level_i >= tx_min_q);
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    tx_go_q <= 1'b0;
+else if (tx_flush_i || tx_start_i)
+    tx_go_q <= 1'b0;
+else if (tx_data_valid_o && tx_data_last_o && tx_data_accept_i)
+    tx_go_q <= 1'b0;
+else if (tx_active_q && tx_level_ok_w)
+    tx_go_q <= 1'b1;
+
+assign tx_ready_o = tx_active_q & (tx_go_q | tx_level_ok_w);
 
 // Tx zero length packet
 always @ (posedge clk_i or negedge rstn_i)
@@ -164,7 +192,7 @@ else if (tx_flush_i)
     tx_err_q <= 1'b0;
 else if (tx_start_i)
     tx_err_q <= 1'b0;
-else if (!tx_zlp_q && tx_empty_i && tx_data_valid_o)
+else if (!tx_zlp_q && tx_empty_i && tx_ready_o)
     tx_err_q <= 1'b1;
 
 // Tx Register Interface
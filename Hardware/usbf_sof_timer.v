@@ -0,0 +1,181 @@
+//=================================================================
+//
+// SOF timer
+// A frame timer locked to the received SOFs. It provides the SOF
+// interrupt divider and the pre-SOF interrupt, which fires a
+// programmable number of phy clocks before the expected next SOF.
+// It also measures the average SOF period in phy clocks, which
+// tells the software how the local clock relates to the host
+// frame clock.
+// This module works in the PHY clock domain completely.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+
+`include "usbf_cfg_defs.v"
+
+module usbf_sof_timer(
+     input                                      clk_i
+    ,input                                      rstn_i
+
+    ////// CORE interface
+    ,input                                      sof_i       // SOF received, pulse
+    ,input                                      usb_rst_i   // USB bus reset
+
+    ////// CSR interface
+    ,input  [`USB_SOF_CTRL_SOF_DIV_W-1:0]       sof_div_i
+    ,input  [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0]   presof_lead_i
+    ,input  [`USB_SOF_CTRL_MEAS_WIN_W-1:0]      meas_win_i
+    ,output                                     sof_intr_set_o
+    ,output                                     presof_intr_set_o
+    ,output                                     sof_lock_o
+    ,output [`USB_SOF_PERIOD_PERIOD_W-1:0]      period_o
+);
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+localparam TIMER_W  = 16;
+localparam LOCK_TOL = 16'd64; // frame period tolerance when locked
+localparam WIN_MAX  = (1 << `USB_SOF_CTRL_MEAS_WIN_W) - 1;
+localparam SUM_W    = TIMER_W + WIN_MAX;
+
+//-----------------------------------------------------------------
+// Frame timer: phy clocks since the last SOF
+//-----------------------------------------------------------------
+reg  [TIMER_W-1:0] timer_q;
+wire [TIMER_W-1:0] frame_len_w = timer_q + 1'b1;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    timer_q <= {TIMER_W{1'b0}};
+else if (usb_rst_i || sof_i)
+    timer_q <= {TIMER_W{1'b0}};
+else if (timer_q != {TIMER_W{1'b1}})
+    timer_q <= frame_len_w;
+
+//-----------------------------------------------------------------
+// Frame period: length of the last frame
+//-----------------------------------------------------------------
+reg                sof_seen_q;
+reg  [TIMER_W-1:0] period_q;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    sof_seen_q <= 1'b0;
+else if (usb_rst_i)
+    sof_seen_q <= 1'b0;
+else if (sof_i)
+    sof_seen_q <= 1'b1;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    period_q <= {TIMER_W{1'b0}};
+else if (usb_rst_i)
+    period_q <= {TIMER_W{1'b0}};
+else if (sof_i && sof_seen_q)
+    period_q <= frame_len_w;
+
+//-----------------------------------------------------------------
+// Lock: two consecutive frames match within LOCK_TOL.
+// Lost on USB reset or when the expected SOF is missed.
+//-----------------------------------------------------------------
+reg lock_q;
+
+wire period_match_w = ({1'b0, frame_len_w} <= ({1'b0, period_q} + LOCK_TOL)) &&
+                      (({1'b0, frame_len_w} + LOCK_TOL) >= {1'b0, period_q});
+
+wire sof_missed_w   = ({1'b0, timer_q} > ({1'b0, period_q} + LOCK_TOL));
+
+// the frame just ended is a regular one
+wire frame_ok_w     = sof_seen_q && (period_q != {TIMER_W{1'b0}}) && period_match_w;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    lock_q <= 1'b0;
+else if (usb_rst_i)
+    lock_q <= 1'b0;
+else if (sof_i)
+    lock_q <= frame_ok_w;
+else if (sof_missed_w)
+    lock_q <= 1'b0;
+
+assign sof_lock_o = lock_q;
+
+//-----------------------------------------------------------------
+// Pre-SOF: presof_lead_i clocks before the expected next SOF
+//-----------------------------------------------------------------
+assign presof_intr_set_o = lock_q &&
+                           (({1'b0, timer_q} + presof_lead_i + 1'b1) == {1'b0, period_q});
+
+//-----------------------------------------------------------------
+// SOF divider: one SOF interrupt every (sof_div_i + 1) frames
+//-----------------------------------------------------------------
+reg [`USB_SOF_CTRL_SOF_DIV_W-1:0] sof_div_cnt_q;
+
+wire sof_div_hit_w = (sof_div_cnt_q >= sof_div_i);
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    sof_div_cnt_q <= {`USB_SOF_CTRL_SOF_DIV_W{1'b0}};
+else if (usb_rst_i)
+    sof_div_cnt_q <= {`USB_SOF_CTRL_SOF_DIV_W{1'b0}};
+else if (sof_i)
+    sof_div_cnt_q <= sof_div_hit_w ? {`USB_SOF_CTRL_SOF_DIV_W{1'b0}} : (sof_div_cnt_q + 1'b1);
+
+assign sof_intr_set_o = sof_i && sof_div_hit_w;
+
+//-----------------------------------------------------------------
+// Period measurement: regular frames are summed over a window of
+// 2^meas_win_i frames, the average is sum >> meas_win_i. It is 
+// reported in 16.16 fixed point, so the fraction keeps the bits
+// shifted out. An irregular frame (missed or corrupted SOF) 
+// restarts the window.
+//-----------------------------------------------------------------
+reg  [SUM_W-1:0]   meas_sum_q;
+reg  [WIN_MAX-1:0] meas_cnt_q;
+reg  [`USB_SOF_PERIOD_PERIOD_W-1:0] period_avg_q;
+reg  [`USB_SOF_CTRL_MEAS_WIN_W-1:0] meas_win_q;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    meas_win_q <= `USB_SOF_CTRL_MEAS_WIN_DEFAULT;
+else
+    meas_win_q <= meas_win_i;
+
+wire meas_win_change_w = (meas_win_q != meas_win_i);
+
+wire [SUM_W-1:0]    meas_sum_next_w = meas_sum_q + frame_len_w;
+wire                meas_last_w     = ({1'b0, meas_cnt_q} >= (({{WIN_MAX{1'b0}}, 1'b1} << meas_win_i) - 1'b1));
+wire [SUM_W+16-1:0] meas_avg_w     = {meas_sum_next_w, 16'b0} >> meas_win_i;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+begin
+    meas_sum_q <= {SUM_W{1'b0}};
+    meas_cnt_q <= {WIN_MAX{1'b0}};
+end
+else if (usb_rst_i || (sof_i && !frame_ok_w) || meas_win_change_w)
+begin
+    meas_sum_q <= {SUM_W{1'b0}};
+    meas_cnt_q <= {WIN_MAX{1'b0}};
+end
+else if (sof_i)
+begin
+    meas_sum_q <= meas_last_w ? {SUM_W{1'b0}}   : meas_sum_next_w;
+    meas_cnt_q <= meas_last_w ? {WIN_MAX{1'b0}} : (meas_cnt_q + 1'b1);
+end
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    period_avg_q <= {`USB_SOF_PERIOD_PERIOD_W{1'b0}};
+else if (usb_rst_i)
+    period_avg_q <= {`USB_SOF_PERIOD_PERIOD_W{1'b0}};
+else if (sof_i && frame_ok_w && meas_last_w && !meas_win_change_w)
+    period_avg_q <= meas_avg_w[`USB_SOF_PERIOD_PERIOD_W-1:0];
+
+assign period_o = period_avg_q;
+
+endmodule
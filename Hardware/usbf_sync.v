@@ -20,7 +20,9 @@
 
 `include "usbf_cfg_defs.v"
 
-module usbf_sync(
+module usbf_sync #(
+    parameter EP_NUM = `USB_EP_NUM
+)(
      input                                          phy_clk_i
     ,input                                          hclk_i
     ,input                                          rstn_i
@@ -29,35 +31,52 @@ module usbf_sync(
     ////// Device core interface
     ,input                                          func_ctrl_hs_chirp_en_i
     ,input [ `USB_FUNC_ADDR_DEV_ADDR_W-1:0]         func_addr_dev_addr_i
-    ,input [`USB_EP_NUM-1:0]                        ep_cfg_stall_ep_i
-    ,input [`USB_EP_NUM-1:0]                        ep_cfg_iso_i
+    ,input [EP_NUM-1:0]                             ep_cfg_stall_ep_i
+    ,input [EP_NUM-1:0]                             ep_cfg_iso_i
+    ,input [EP_NUM-1:0]                             ep_cfg_loopback_en_i
+    ,input [EP_NUM-1:0]                             ep_cfg_auto_accept_i
+    ,input [`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM-1:0] ep_cfg_loopback_ep_i
+    ,input [`USB_NAK_CTRL_HOLDOFF_W-1:0]            nak_ctrl_holdoff_i
+    ,input                                          rst_ctrl_flush_i
+    ,input [`USB_SOF_CTRL_SOF_DIV_W-1:0]            sof_ctrl_sof_div_i
+    ,input [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0]        sof_ctrl_presof_lead_i
+    ,input [`USB_SOF_CTRL_MEAS_WIN_W-1:0]           sof_ctrl_meas_win_i
     ,output  [`USB_FUNC_STAT_FRAME_W-1:0]           func_stat_frame_o
     ,output                                         rst_intr_set_o
     ,output                                         sof_intr_set_o
-    ,output  [`USB_EP_NUM-1:0]                      ep_rx_ready_intr_set_o
-    ,output  [`USB_EP_NUM-1:0]                      ep_tx_complete_intr_set_o
+    ,output                                         presof_intr_set_o
+    ,output                                         func_stat_sof_lock_o
+    ,output [`USB_SOF_PERIOD_PERIOD_W-1:0]          sof_period_o
+    ,output  [EP_NUM-1:0]                           ep_rx_ready_intr_set_o
+    ,output  [EP_NUM-1:0]                           ep_tx_complete_intr_set_o
+    ,output  [EP_NUM-1:0]                           ep_in_nak_intr_set_o
+    ,output  [EP_NUM-1:0]                           ep_out_nak_intr_set_o
 
     ////// EPU(endpoint) interface
-    ,input [`USB_EP_NUM-1:0]                        ep_tx_ctrl_tx_start_i
-    ,input [`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM-1:0] ep_tx_ctrl_tx_len_i     
-    ,input [`USB_EP_NUM-1:0]                        ep_rx_ctrl_rx_accept_i        
+    ,input [EP_NUM-1:0]                             ep_tx_ctrl_tx_start_i
+    ,input [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0] ep_tx_ctrl_tx_len_i          
+    ,input [`USB_EP0_TX_CTRL_TX_MIN_W*EP_NUM-1:0] ep_tx_ctrl_tx_min_i          
+    ,input [EP_NUM-1:0]                             ep_rx_ctrl_rx_accept_i        
     
-    ,output  [`USB_EP_NUM-1:0]                      ep_sts_tx_err_o
-    ,output  [`USB_EP_NUM-1:0]                      ep_sts_tx_busy_o
-    ,output  [`USB_EP_NUM-1:0]                      ep_sts_rx_err_o
-    ,output  [`USB_EP_NUM-1:0]                      ep_sts_rx_setup_o
-    ,output  [`USB_EP_NUM-1:0]                      ep_sts_rx_ready_o 
-    ,output  [`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0] ep_sts_rx_count_o
+    ,output  [EP_NUM-1:0]                           ep_sts_tx_err_o
+    ,output  [EP_NUM-1:0]                           ep_sts_tx_busy_o
+    ,output  [EP_NUM-1:0]                           ep_sts_rx_err_o
+    ,output  [EP_NUM-1:0]                           ep_sts_rx_setup_o
+    ,output  [EP_NUM-1:0]                           ep_sts_rx_ready_o 
+    ,output  [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0] ep_sts_rx_count_o
 
     ////// MEM(memory) interface
         // RX
-    ,input [`USB_EP_NUM-1:0]                        ep_rx_ctrl_rx_flush_i      
-    ,input [`USB_EP_NUM-1:0]                        ep_data_rd_req_i   
-    ,output  [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0] ep_rx_data_o 
+    ,input [EP_NUM-1:0]                             ep_rx_ctrl_rx_flush_i      
+    ,input [EP_NUM-1:0]                             ep_data_rd_req_i   
+    ,output  [`USB_EP0_DATA_DATA_W*EP_NUM-1:0] ep_rx_data_o 
         // TX
-    ,input [`USB_EP_NUM-1:0]                        ep_tx_ctrl_tx_flush_i
-    ,input [`USB_EP_NUM-1:0]                        ep_data_wt_req_i
-    ,input [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]   ep_tx_data_i
+    ,input [EP_NUM-1:0]                             ep_tx_ctrl_tx_flush_i
+    ,input [EP_NUM-1:0]                             ep_data_wt_req_i
+    ,input [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]        ep_tx_data_i
+        // FIFO fill level
+    ,output [`USB_EP0_LEVEL_RX_LEVEL_W*EP_NUM-1:0]  ep_rx_level_o
+    ,output [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  ep_tx_level_o
     
     ////// Device interface
     ,input                                          func_ctrl_phy_dmpulldown_i
@@ -67,40 +86,76 @@ module usbf_sync(
     ,input [1:0]                                    func_ctrl_phy_opmode_i
     ,output  [1:0]                                  func_stat_linestate_o
 
+`ifdef USB_TRACE
+    ////// Trace interface
+    ,input                                          trace_ctrl_en_i
+    ,input                                          trace_ctrl_trig_en_i
+    ,input  [`USB_TRACE_CTRL_TRIG_PID_W-1:0]        trace_ctrl_trig_pid_i
+    ,input                                          trace_ctrl_trig_ep_en_i
+    ,input  [`USB_TRACE_CTRL_TRIG_EP_W-1:0]         trace_ctrl_trig_ep_i
+    ,input  [`USB_TRACE_CTRL_POST_W-1:0]            trace_ctrl_post_i
+    ,input  [`USB_TRACE_FILT_PID_MASK_W-1:0]        trace_filt_pid_mask_i
+    ,input  [`USB_TRACE_FILT_EP_MASK_W-1:0]         trace_filt_ep_mask_i
+    ,input  [`USB_TRACE_DEPTH_W-1:0]                trace_idx_i
+    ,output [`USB_TRACE_DEPTH_W-1:0]                trace_sts_wptr_o
+    ,output                                         trace_sts_wrap_o
+    ,output                                         trace_sts_triggered_o
+    ,output                                         trace_sts_stopped_o
+    ,output [31:0]                                  trace_data0_o
+    ,output [31:0]                                  trace_data1_o
+`endif
+
     //-------------------------------phy domain, connect to phy domain modules
     ////// Device core interface
     ,output                                         sh2pl_func_ctrl_hs_chirp_en_o
     ,output [ `USB_FUNC_ADDR_DEV_ADDR_W-1:0]        sh2pb_func_addr_dev_addr_o 
-    ,output [`USB_EP_NUM-1:0]                       sh2pl_ep_cfg_stall_ep_o // TODO
-    ,output [`USB_EP_NUM-1:0]                       sh2pl_ep_cfg_iso_o
+    ,output [EP_NUM-1:0]                            sh2pl_ep_cfg_stall_ep_o // TODO
+    ,output [EP_NUM-1:0]                            sh2pl_ep_cfg_iso_o
+    ,output [EP_NUM-1:0]                            sh2pl_ep_cfg_loopback_en_o
+    ,output [EP_NUM-1:0]                            sh2pl_ep_cfg_auto_accept_o
+    ,output [`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM-1:0] sh2pb_ep_cfg_loopback_ep_o
+    ,output [`USB_NAK_CTRL_HOLDOFF_W-1:0]           sh2pb_nak_ctrl_holdoff_o
+    ,output                                         sh2pl_rst_ctrl_flush_o
+    ,output [`USB_SOF_CTRL_SOF_DIV_W-1:0]           sh2pb_sof_ctrl_sof_div_o
+    ,output [`USB_SOF_CTRL_PRESOF_LEAD_W-1:0]       sh2pb_sof_ctrl_presof_lead_o
+    ,output [`USB_SOF_CTRL_MEAS_WIN_W-1:0]          sh2pb_sof_ctrl_meas_win_o
     
     ,input  [`USB_FUNC_STAT_FRAME_W-1:0]            p2hb_func_stat_frame_i 
     ,input                                          p2ht_rst_intr_set_i
     ,input                                          p2ht_sof_intr_set_i
-    ,input  [`USB_EP_NUM-1:0]                       p2ht_ep_rx_ready_intr_set_i
-    ,input  [`USB_EP_NUM-1:0]                       p2ht_ep_tx_complete_intr_set_i
+    ,input                                          p2ht_presof_intr_set_i
+    ,input                                          p2hl_func_stat_sof_lock_i
+    ,input  [`USB_SOF_PERIOD_PERIOD_W-1:0]          p2hb_sof_period_i
+    ,input  [EP_NUM-1:0]                            p2ht_ep_rx_ready_intr_set_i
+    ,input  [EP_NUM-1:0]                            p2ht_ep_tx_complete_intr_set_i
+    ,input  [EP_NUM-1:0]                            p2ht_ep_in_nak_intr_set_i
+    ,input  [EP_NUM-1:0]                            p2ht_ep_out_nak_intr_set_i
 
     ////// EPU(endpoint) interface
-    ,output [`USB_EP_NUM-1:0]                       sh2pt_ep_tx_ctrl_tx_start_o
-    ,output [`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM-1:0] sh2pb_ep_tx_ctrl_tx_len_o     
-    ,output [`USB_EP_NUM-1:0]                       sh2pt_ep_rx_ctrl_rx_accept_o        
+    ,output [EP_NUM-1:0]                            sh2pt_ep_tx_ctrl_tx_start_o
+    ,output [`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM-1:0] sh2pb_ep_tx_ctrl_tx_len_o          
+    ,output [`USB_EP0_TX_CTRL_TX_MIN_W*EP_NUM-1:0] sh2pb_ep_tx_ctrl_tx_min_o          
+    ,output [EP_NUM-1:0]                            sh2pt_ep_rx_ctrl_rx_accept_o        
     
-    ,input  [`USB_EP_NUM-1:0]                       p2hl_ep_sts_tx_err_i
-    ,input  [`USB_EP_NUM-1:0]                       p2hl_ep_sts_tx_busy_i
-    ,input  [`USB_EP_NUM-1:0]                       p2hl_ep_sts_rx_err_i 
-    ,input  [`USB_EP_NUM-1:0]                       p2hl_ep_sts_rx_setup_i
-    ,input  [`USB_EP_NUM-1:0]                       p2hl_ep_sts_rx_ready_i 
-    ,input  [`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0] p2hb_ep_sts_rx_count_i
+    ,input  [EP_NUM-1:0]                            p2hl_ep_sts_tx_err_i
+    ,input  [EP_NUM-1:0]                            p2hl_ep_sts_tx_busy_i
+    ,input  [EP_NUM-1:0]                            p2hl_ep_sts_rx_err_i 
+    ,input  [EP_NUM-1:0]                            p2hl_ep_sts_rx_setup_i
+    ,input  [EP_NUM-1:0]                            p2hl_ep_sts_rx_ready_i 
+    ,input  [`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0] p2hb_ep_sts_rx_count_i
 
     ////// MEM(memory) interface
         // RX
-    ,output [`USB_EP_NUM-1:0]                       sh2pt_ep_rx_ctrl_rx_flush_o      
-    ,output [`USB_EP_NUM-1:0]                       sh2pt_ep_data_rd_req_o   
-    ,input  [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  p2hb_ep_rx_data_i 
+    ,output [EP_NUM-1:0]                            sh2pt_ep_rx_ctrl_rx_flush_o      
+    ,output [EP_NUM-1:0]                            sh2pt_ep_data_rd_req_o   
+    ,input  [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       p2hb_ep_rx_data_i 
         // TX
-    ,output [`USB_EP_NUM-1:0]                       sh2pt_ep_tx_ctrl_tx_flush_o
-    ,output [`USB_EP_NUM-1:0]                       sh2pt_ep_data_wt_req_o
-    ,output [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0]  sh2pb_ep_tx_data_o
+    ,output [EP_NUM-1:0]                            sh2pt_ep_tx_ctrl_tx_flush_o
+    ,output [EP_NUM-1:0]                            sh2pt_ep_data_wt_req_o
+    ,output [`USB_EP0_DATA_DATA_W*EP_NUM-1:0]       sh2pb_ep_tx_data_o
+        // FIFO fill level
+    ,input  [`USB_EP0_LEVEL_RX_LEVEL_W*EP_NUM-1:0]  p2hb_ep_rx_level_i
+    ,input  [`USB_EP0_LEVEL_TX_LEVEL_W*EP_NUM-1:0]  p2hb_ep_tx_level_i
     
     ////// Device interface
     ,output                                         sh2pl_func_ctrl_phy_dmpulldown_o
@@ -110,6 +165,25 @@ module usbf_sync(
     ,output [1:0]                                   sh2pb_func_ctrl_phy_opmode_o
     ,input  [1:0]                                   p2hb_func_stat_linestate_i
 
+`ifdef USB_TRACE
+    ////// Trace interface
+    ,output                                         sh2pl_trace_ctrl_en_o
+    ,output                                         sh2pb_trace_ctrl_trig_en_o
+    ,output [`USB_TRACE_CTRL_TRIG_PID_W-1:0]        sh2pb_trace_ctrl_trig_pid_o
+    ,output                                         sh2pb_trace_ctrl_trig_ep_en_o
+    ,output [`USB_TRACE_CTRL_TRIG_EP_W-1:0]         sh2pb_trace_ctrl_trig_ep_o
+    ,output [`USB_TRACE_CTRL_POST_W-1:0]            sh2pb_trace_ctrl_post_o
+    ,output [`USB_TRACE_FILT_PID_MASK_W-1:0]        sh2pb_trace_filt_pid_mask_o
+    ,output [`USB_TRACE_FILT_EP_MASK_W-1:0]         sh2pb_trace_filt_ep_mask_o
+    ,output [`USB_TRACE_DEPTH_W-1:0]                sh2pb_trace_idx_o
+    ,input  [`USB_TRACE_DEPTH_W-1:0]                p2hb_trace_sts_wptr_i
+    ,input                                          p2hb_trace_sts_wrap_i
+    ,input                                          p2hb_trace_sts_triggered_i
+    ,input                                          p2hb_trace_sts_stopped_i
+    ,input  [31:0]                                  p2hb_trace_data0_i
+    ,input  [31:0]                                  p2hb_trace_data1_i
+`endif
+
     ,output                                         mem_wt_ready_o // MEM fifos are in PHY clock domain
     ,output                                         mem_rd_ready_o // so writing/reading data to fifo needs waiting CDC
 
@@ -127,20 +201,42 @@ set_level_sync #(2, 1) func_ctrl_hs_chirp_en_sync(
     .dout(sh2pl_func_ctrl_hs_chirp_en_o)
 );
 
-set_level_sync #(2, `USB_EP_NUM) ep_cfg_stall_ep_sync(
+set_level_sync #(2, EP_NUM) ep_cfg_stall_ep_sync(
     .clk_d(phy_clk_i),
     .rst_n(rstn_i),
     .din(ep_cfg_stall_ep_i),
     .dout(sh2pl_ep_cfg_stall_ep_o)
 );
 
-set_level_sync #(2,`USB_EP_NUM) ep_cfg_iso_sync(
+set_level_sync #(2,EP_NUM) ep_cfg_iso_sync(
     .clk_d(phy_clk_i),
     .rst_n(rstn_i),
     .din(ep_cfg_iso_i),
     .dout(sh2pl_ep_cfg_iso_o)
 );
 
+set_level_sync #(2,EP_NUM) ep_cfg_loopback_en_sync(
+    .clk_d(phy_clk_i),
+    .rst_n(rstn_i),
+    .din(ep_cfg_loopback_en_i),
+    .dout(sh2pl_ep_cfg_loopback_en_o)
+);
+
+set_level_sync #(2,EP_NUM) ep_cfg_auto_accept_sync(
+    .clk_d(phy_clk_i),
+    .rst_n(rstn_i),
+    .din(ep_cfg_auto_accept_i),
+    .dout(sh2pl_ep_cfg_auto_accept_o)
+);
+
+bus_sync #(`USB_EP0_CFG_LOOPBACK_EP_W*EP_NUM) ep_cfg_loopback_ep_sync(
+    .clk_s(hclk_i),
+    .clk_d(phy_clk_i),
+    .rstn(rstn_i),
+    .din(ep_cfg_loopback_ep_i),
+    .dout(sh2pb_ep_cfg_loopback_ep_o)
+);
+
 bus_sync #(`USB_FUNC_ADDR_DEV_ADDR_W) func_addr_dev_addr_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
@@ -149,6 +245,36 @@ bus_sync #(`USB_FUNC_ADDR_DEV_ADDR_W) func_addr_dev_addr_sync(
     .dout(sh2pb_func_addr_dev_addr_o)
 );
 
+bus_sync #(`USB_NAK_CTRL_HOLDOFF_W) nak_ctrl_holdoff_sync(
+    .clk_s(hclk_i),
+    .clk_d(phy_clk_i),
+    .rstn(rstn_i),
+    .din(nak_ctrl_holdoff_i),
+    .dout(sh2pb_nak_ctrl_holdoff_o)
+);
+
+set_level_sync #(2, 1) rst_ctrl_flush_sync(
+    .clk_d(phy_clk_i),
+    .rst_n(rstn_i),
+    .din(rst_ctrl_flush_i),
+    .dout(sh2pl_rst_ctrl_flush_o)
+);
+
+wire [`USB_SOF_CTRL_SOF_DIV_W+`USB_SOF_CTRL_PRESOF_LEAD_W+`USB_SOF_CTRL_MEAS_WIN_W-1:0] sof_ctrl_in, sof_ctrl_out;
+assign sof_ctrl_in = {sof_ctrl_sof_div_i,
+                      sof_ctrl_presof_lead_i,
+                      sof_ctrl_meas_win_i};
+assign {sh2pb_sof_ctrl_sof_div_o,
+        sh2pb_sof_ctrl_presof_lead_o,
+        sh2pb_sof_ctrl_meas_win_o} = sof_ctrl_out;
+bus_sync #(`USB_SOF_CTRL_SOF_DIV_W+`USB_SOF_CTRL_PRESOF_LEAD_W+`USB_SOF_CTRL_MEAS_WIN_W) sof_ctrl_sync(
+    .clk_s(hclk_i),
+    .clk_d(phy_clk_i),
+    .rstn(rstn_i),
+    .din(sof_ctrl_in),
+    .dout(sof_ctrl_out)
+);
+
 // ======== phyclk -> hclk
 bus_sync #(`USB_FUNC_STAT_FRAME_W) func_stat_frame_sync(
     .clk_s(phy_clk_i),
@@ -174,7 +300,30 @@ set_pulse_sync #(1) sof_intr_set_sync(
     .dout(sof_intr_set_o)
 );
 
-set_pulse_sync #(`USB_EP_NUM) ep_rx_ready_intr_set_sync(
+set_pulse_sync #(1) presof_intr_set_sync(
+    .clk_s(phy_clk_i),
+    .clk_d(hclk_i),
+    .rstn(rstn_i),
+    .din(p2ht_presof_intr_set_i),
+    .dout(presof_intr_set_o)
+);
+
+set_level_sync #(2, 1) func_stat_sof_lock_sync(
+    .clk_d(hclk_i),
+    .rst_n(rstn_i),
+    .din(p2hl_func_stat_sof_lock_i),
+    .dout(func_stat_sof_lock_o)
+);
+
+bus_sync #(`USB_SOF_PERIOD_PERIOD_W) sof_period_sync(
+    .clk_s(phy_clk_i),
+    .clk_d(hclk_i),
+    .rstn(rstn_i),
+    .din(p2hb_sof_period_i),
+    .dout(sof_period_o)
+);
+
+set_pulse_sync #(EP_NUM) ep_rx_ready_intr_set_sync(
     .clk_s(phy_clk_i),
     .clk_d(hclk_i),
     .rstn(rstn_i),
@@ -182,7 +331,7 @@ set_pulse_sync #(`USB_EP_NUM) ep_rx_ready_intr_set_sync(
     .dout(ep_rx_ready_intr_set_o)
 );
 
-set_pulse_sync #(`USB_EP_NUM) ep_tx_complete_intr_set_sync(
+set_pulse_sync #(EP_NUM) ep_tx_complete_intr_set_sync(
     .clk_s(phy_clk_i),
     .clk_d(hclk_i),
     .rstn(rstn_i),
@@ -190,25 +339,41 @@ set_pulse_sync #(`USB_EP_NUM) ep_tx_complete_intr_set_sync(
     .dout(ep_tx_complete_intr_set_o)
 );
 
+set_pulse_sync #(EP_NUM) ep_in_nak_intr_set_sync(
+    .clk_s(phy_clk_i),
+    .clk_d(hclk_i),
+    .rstn(rstn_i),
+    .din(p2ht_ep_in_nak_intr_set_i),
+    .dout(ep_in_nak_intr_set_o)
+);
+
+set_pulse_sync #(EP_NUM) ep_out_nak_intr_set_sync(
+    .clk_s(phy_clk_i),
+    .clk_d(hclk_i),
+    .rstn(rstn_i),
+    .din(p2ht_ep_out_nak_intr_set_i),
+    .dout(ep_out_nak_intr_set_o)
+);
+
 //-----------------------------------------------------------------
 // EPU(endpoint) interface
 //-----------------------------------------------------------------
 // ======== hclk -> phyclk
-set_pulse_sync #(`USB_EP_NUM) ep_tx_ctrl_tx_star_sync(
+set_pulse_sync #(EP_NUM) ep_tx_ctrl_tx_star_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
     .rstn(rstn_i),
     .din(ep_tx_ctrl_tx_start_i),
     .dout(sh2pt_ep_tx_ctrl_tx_start_o)
 );
-set_pulse_sync #(`USB_EP_NUM) ep_rx_ctrl_rx_accept_sync(
+set_pulse_sync #(EP_NUM) ep_rx_ctrl_rx_accept_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
     .rstn(rstn_i),
     .din(ep_rx_ctrl_rx_accept_i),
     .dout(sh2pt_ep_rx_ctrl_rx_accept_o)
 );
-// bus_sync #(`USB_EP0_TX_CTRL_TX_LEN_W*`USB_EP_NUM) ep_tx_ctrl_tx_len_sync(
+// bus_sync #(`USB_EP0_TX_CTRL_TX_LEN_W*EP_NUM) ep_tx_ctrl_tx_len_sync(
 //     .clk_s(hclk_i),
 //     .clk_d(phy_clk_i),
 //     .rstn(rstn_i),
@@ -216,10 +381,12 @@ set_pulse_sync #(`USB_EP_NUM) ep_rx_ctrl_rx_accept_sync(
 //     .dout(sh2pb_ep_tx_ctrl_tx_len_o)
 // );
 assign sh2pb_ep_tx_ctrl_tx_len_o = ep_tx_ctrl_tx_len_i;
+// written with TX_START, so stable when the start pulse arrives, like TX_LEN
+assign sh2pb_ep_tx_ctrl_tx_min_o = ep_tx_ctrl_tx_min_i;
 
 // ======== phyclk -> hclk
-wire [`USB_EP_NUM*5+`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM-1:0] ep_sts_in, s_ep_sts_out;
-bus_sync #(`USB_EP_NUM*5+`USB_EP0_STS_RX_COUNT_W*`USB_EP_NUM) ep_sts_sync(
+wire [EP_NUM*5+`USB_EP0_STS_RX_COUNT_W*EP_NUM-1:0] ep_sts_in, s_ep_sts_out;
+bus_sync #(EP_NUM*5+`USB_EP0_STS_RX_COUNT_W*EP_NUM) ep_sts_sync(
     .clk_s(phy_clk_i),
     .clk_d(hclk_i),
     .rstn(rstn_i),
@@ -245,35 +412,35 @@ assign {ep_sts_tx_err_o,
 // MEM(memory) interface
 //-----------------------------------------------------------------
 // ======== hclk -> phyclk
-set_pulse_sync #(`USB_EP_NUM) ep_rx_ctrl_rx_flush_sync(
+set_pulse_sync #(EP_NUM) ep_rx_ctrl_rx_flush_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
     .rstn(rstn_i),
     .din(ep_rx_ctrl_rx_flush_i),
     .dout(sh2pt_ep_rx_ctrl_rx_flush_o)
 );
-set_pulse_sync #(`USB_EP_NUM) ep_data_rd_req_sync(
+set_pulse_sync #(EP_NUM) ep_data_rd_req_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
     .rstn(rstn_i),
     .din(ep_data_rd_req_i),
     .dout(sh2pt_ep_data_rd_req_o)
 );
-set_pulse_sync #(`USB_EP_NUM) ep_tx_ctrl_tx_flush_sync(
+set_pulse_sync #(EP_NUM) ep_tx_ctrl_tx_flush_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
     .rstn(rstn_i),
     .din(ep_tx_ctrl_tx_flush_i),
     .dout(sh2pt_ep_tx_ctrl_tx_flush_o)
 );
-set_pulse_sync #(`USB_EP_NUM) ep_data_wt_req_sync(
+set_pulse_sync #(EP_NUM) ep_data_wt_req_sync(
     .clk_s(hclk_i),
     .clk_d(phy_clk_i),
     .rstn(rstn_i),
     .din(ep_data_wt_req_i),
     .dout(sh2pt_ep_data_wt_req_o)
 );
-// bus_sync #(`USB_EP0_DATA_DATA_W*`USB_EP_NUM) ep_tx_data_sync(
+// bus_sync #(`USB_EP0_DATA_DATA_W*EP_NUM) ep_tx_data_sync(
 //     .clk_s(hclk_i),
 //     .clk_d(phy_clk_i),
 //     .rstn(rstn_i),
@@ -286,17 +453,17 @@ assign sh2pb_ep_tx_data_o = ep_tx_data_i;
 // ======== phyclk -> hclk
 // actual rx_data valid in sh2pt_ep_data_rd_req_o clk
 // so, register rx_data
-wire [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0] actual_rx_data_r;
+wire [`USB_EP0_DATA_DATA_W*EP_NUM-1:0] actual_rx_data_r;
 wire actual_rx_data_ena = |sh2pt_ep_data_rd_req_o;
-wire [`USB_EP0_DATA_DATA_W*`USB_EP_NUM-1:0] actual_rx_data_next = p2hb_ep_rx_data_i;
-usbf_gnrl_dfflrd #(`USB_EP0_DATA_DATA_W*`USB_EP_NUM, {`USB_EP0_DATA_DATA_W*`USB_EP_NUM{1'b0}}) 
+wire [`USB_EP0_DATA_DATA_W*EP_NUM-1:0] actual_rx_data_next = p2hb_ep_rx_data_i;
+usbf_gnrl_dfflrd #(`USB_EP0_DATA_DATA_W*EP_NUM, {`USB_EP0_DATA_DATA_W*EP_NUM{1'b0}}) 
                 actual_rx_data_difflrd(
                     actual_rx_data_ena,actual_rx_data_next,
                     actual_rx_data_r,
                     phy_clk_i,rstn_i
                 );
 
-// bus_sync #(`USB_EP0_DATA_DATA_W*`USB_EP_NUM) ep_rx_data_sync(
+// bus_sync #(`USB_EP0_DATA_DATA_W*EP_NUM) ep_rx_data_sync(
 //     .clk_s(phy_clk_i),
 //     .clk_d(hclk_i),
 //     .rstn(rstn_i),
@@ -305,11 +472,20 @@ usbf_gnrl_dfflrd #(`USB_EP0_DATA_DATA_W*`USB_EP_NUM, {`USB_EP0_DATA_DATA_W*`USB_
 // );
 assign ep_rx_data_o = actual_rx_data_r;
 
+// FIFO fill level, a snapshot that may lag a few hclk cycles
+bus_sync #((`USB_EP0_LEVEL_RX_LEVEL_W+`USB_EP0_LEVEL_TX_LEVEL_W)*EP_NUM) ep_level_sync(
+    .clk_s(phy_clk_i),
+    .clk_d(hclk_i),
+    .rstn(rstn_i),
+    .din({p2hb_ep_rx_level_i, p2hb_ep_tx_level_i}),
+    .dout({ep_rx_level_o, ep_tx_level_o})
+);
+
 // mem_wt_ready and mem rd ready pulse generate
 
 // sync sh2pt_ep_data_rd_req_o from phy to H clock
-wire [`USB_EP_NUM-1:0] mem_rd_ready;
-set_pulse_sync #(`USB_EP_NUM) sh2pt_ep_data_rd_req_sync(
+wire [EP_NUM-1:0] mem_rd_ready;
+set_pulse_sync #(EP_NUM) sh2pt_ep_data_rd_req_sync(
     .clk_s(phy_clk_i),
     .clk_d(hclk_i),
     .rstn(rstn_i),
@@ -318,8 +494,8 @@ set_pulse_sync #(`USB_EP_NUM) sh2pt_ep_data_rd_req_sync(
 );
 assign mem_rd_ready_o = |mem_rd_ready;
 
-wire [`USB_EP_NUM-1:0] mem_wt_ready;
-set_pulse_sync #(`USB_EP_NUM) sh2pt_ep_data_wt_req_sync(
+wire [EP_NUM-1:0] mem_wt_ready;
+set_pulse_sync #(EP_NUM) sh2pt_ep_data_wt_req_sync(
     .clk_s(phy_clk_i),
     .clk_d(hclk_i),
     .rstn(rstn_i),
@@ -361,4 +537,68 @@ bus_sync #(2) func_stat_linestate_sync(
     .dout(func_stat_linestate_o)
 );
 
+`ifdef USB_TRACE
+//-----------------------------------------------------------------
+// Trace interface
+//-----------------------------------------------------------------
+// ======== hclk -> phyclk
+// Software programs the configuration before setting the enable
+wire [1+`USB_TRACE_CTRL_TRIG_PID_W+1+`USB_TRACE_CTRL_TRIG_EP_W+`USB_TRACE_CTRL_POST_W+
+      `USB_TRACE_FILT_PID_MASK_W+`USB_TRACE_FILT_EP_MASK_W-1:0] trace_cfg_in, trace_cfg_out;
+assign trace_cfg_in = {trace_ctrl_trig_en_i,
+                       trace_ctrl_trig_pid_i,
+                       trace_ctrl_trig_ep_en_i,
+                       trace_ctrl_trig_ep_i,
+                       trace_ctrl_post_i,
+                       trace_filt_pid_mask_i,
+                       trace_filt_ep_mask_i};
+assign {sh2pb_trace_ctrl_trig_en_o,
+        sh2pb_trace_ctrl_trig_pid_o,
+        sh2pb_trace_ctrl_trig_ep_en_o,
+        sh2pb_trace_ctrl_trig_ep_o,
+        sh2pb_trace_ctrl_post_o,
+        sh2pb_trace_filt_pid_mask_o,
+        sh2pb_trace_filt_ep_mask_o} = trace_cfg_out;
+bus_sync #(1+`USB_TRACE_CTRL_TRIG_PID_W+1+`USB_TRACE_CTRL_TRIG_EP_W+`USB_TRACE_CTRL_POST_W+
+           `USB_TRACE_FILT_PID_MASK_W+`USB_TRACE_FILT_EP_MASK_W) trace_cfg_sync(
+    .clk_s(hclk_i),
+    .clk_d(phy_clk_i),
+    .rstn(rstn_i),
+    .din(trace_cfg_in),
+    .dout(trace_cfg_out)
+);
+
+set_level_sync #(2, 1) trace_ctrl_en_sync(
+    .clk_d(phy_clk_i),
+    .rst_n(rstn_i),
+    .din(trace_ctrl_en_i),
+    .dout(sh2pl_trace_ctrl_en_o)
+);
+
+// read index and data are quasi-static: the buffer is read when 
+// the capture is stopped
+assign sh2pb_trace_idx_o = trace_idx_i;
+
+// ======== phyclk -> hclk
+wire [`USB_TRACE_DEPTH_W+3-1:0] trace_sts_in, trace_sts_out;
+assign trace_sts_in = {p2hb_trace_sts_wptr_i,
+                       p2hb_trace_sts_wrap_i,
+                       p2hb_trace_sts_triggered_i,
+                       p2hb_trace_sts_stopped_i};
+assign {trace_sts_wptr_o,
+        trace_sts_wrap_o,
+        trace_sts_triggered_o,
+        trace_sts_stopped_o} = trace_sts_out;
+bus_sync #(`USB_TRACE_DEPTH_W+3) trace_sts_sync(
+    .clk_s(phy_clk_i),
+    .clk_d(hclk_i),
+    .rstn(rstn_i),
+    .din(trace_sts_in),
+    .dout(trace_sts_out)
+);
+
+assign trace_data0_o = p2hb_trace_data0_i;
+assign trace_data1_o = p2hb_trace_data1_i;
+`endif
+
 endmodule
\ No newline at end of file
@@ -0,0 +1,168 @@
+//=================================================================
+//
+// Protocol trace buffer
+// Records the trace events of the device core into a circular
+// buffer, with a timestamp for each record. Events can be filtered
+// by PID and endpoint, and capture can stop a programmable number
+// of records after a trigger event.
+// The buffer is read by CSR when the capture is stopped, so the
+// read index and data are quasi-static between clock domains.
+// This module works in the PHY clock domain completely.
+//
+// Only compiled with USB_TRACE.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+
+`include "usbf_cfg_defs.v"
+
+`ifdef USB_TRACE
+
+module usbf_trace(
+     input                                          clk_i
+    ,input                                          rstn_i
+
+    ////// CORE interface
+    ,input                                          ev_valid_i
+    ,input  [31:0]                                  ev_data_i   // USB_TRACE_DATA0 format
+
+    ////// CSR interface
+    ,input                                          en_i
+    ,input                                          trig_en_i
+    ,input  [`USB_TRACE_CTRL_TRIG_PID_W-1:0]        trig_pid_i
+    ,input                                          trig_ep_en_i
+    ,input  [`USB_TRACE_CTRL_TRIG_EP_W-1:0]         trig_ep_i
+    ,input  [`USB_TRACE_CTRL_POST_W-1:0]            post_i
+    ,input  [`USB_TRACE_FILT_PID_MASK_W-1:0]        pid_mask_i
+    ,input  [`USB_TRACE_FILT_EP_MASK_W-1:0]         ep_mask_i
+    ,output [`USB_TRACE_DEPTH_W-1:0]                wptr_o
+    ,output                                         wrap_o
+    ,output                                         triggered_o
+    ,output                                         stopped_o
+    ,input  [`USB_TRACE_DEPTH_W-1:0]                rd_idx_i
+    ,output [31:0]                                  rd_data0_o
+    ,output [31:0]                                  rd_data1_o
+);
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+localparam DEPTH = (1 << `USB_TRACE_DEPTH_W);
+
+//-----------------------------------------------------------------
+// Capture start: rising edge of en_i
+//-----------------------------------------------------------------
+reg en_q;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    en_q <= 1'b0;
+else
+    en_q <= en_i;
+
+wire start_w = en_i & ~en_q;
+
+//-----------------------------------------------------------------
+// Timestamp
+//-----------------------------------------------------------------
+reg [31:0] ts_q;
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+    ts_q <= 32'b0;
+else if (start_w)
+    ts_q <= 32'b0;
+else
+    ts_q <= ts_q + 1'b1;
+
+//-----------------------------------------------------------------
+// Filter and trigger
+//-----------------------------------------------------------------
+wire [`USB_TRACE_DATA0_PID_W-1:0] ev_pid_w = ev_data_i[`USB_TRACE_DATA0_PID_R];
+wire [`USB_TRACE_DATA0_EP_W-1:0]  ev_ep_w  = ev_data_i[`USB_TRACE_DATA0_EP_R];
+
+// bus reset and SOF are not endpoint events
+wire ev_no_ep_w = (ev_pid_w == 4'h0) || (ev_pid_w == 4'h5);
+
+wire pass_w = pid_mask_i[ev_pid_w] && (ev_no_ep_w || ep_mask_i[ev_ep_w]);
+
+reg                          triggered_q;
+reg                          stopped_q;
+reg [`USB_TRACE_CTRL_POST_W-1:0] post_cnt_q;
+
+wire wr_w = en_q && !stopped_q && ev_valid_i && pass_w;
+
+wire trig_hit_w = wr_w && trig_en_i && !triggered_q &&
+                  (ev_pid_w == trig_pid_i) && (!trig_ep_en_i || (ev_ep_w == trig_ep_i));
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+begin
+    triggered_q <= 1'b0;
+    stopped_q   <= 1'b0;
+    post_cnt_q  <= {`USB_TRACE_CTRL_POST_W{1'b0}};
+end
+else if (start_w)
+begin
+    triggered_q <= 1'b0;
+    stopped_q   <= 1'b0;
+    post_cnt_q  <= {`USB_TRACE_CTRL_POST_W{1'b0}};
+end
+else if (trig_hit_w)
+begin
+    triggered_q <= 1'b1;
+    stopped_q   <= (post_i == 0);
+    post_cnt_q  <= post_i;
+end
+else if (wr_w && triggered_q)
+begin
+    stopped_q   <= (post_cnt_q <= 1);
+    post_cnt_q  <= post_cnt_q - 1'b1;
+end
+
+//-----------------------------------------------------------------
+// Circular buffer
+//-----------------------------------------------------------------
+reg [31:0]                    ram0 [DEPTH-1:0];
+reg [31:0]                    ram1 [DEPTH-1:0];
+reg [`USB_TRACE_DEPTH_W-1:0]  wptr_q;
+reg                           wrap_q;
+
+always @ (posedge clk_i)
+if (wr_w)
+begin
+    ram0[wptr_q] <= ev_data_i;
+    ram1[wptr_q] <= ts_q;
+end
+
+always @ (posedge clk_i or negedge rstn_i)
+if (!rstn_i)
+begin
+    wptr_q <= {`USB_TRACE_DEPTH_W{1'b0}};
+    wrap_q <= 1'b0;
+end
+else if (start_w)
+begin
+    wptr_q <= {`USB_TRACE_DEPTH_W{1'b0}};
+    wrap_q <= 1'b0;
+end
+else if (wr_w)
+begin
+    wptr_q <= wptr_q + 1'b1;
+    if (&wptr_q)
+        wrap_q <= 1'b1;
+end
+
+assign wptr_o      = wptr_q;
+assign wrap_o      = wrap_q;
+assign triggered_o = triggered_q;
+assign stopped_o   = stopped_q | ~en_q;
+
+assign rd_data0_o  = ram0[rd_idx_i];
+assign rd_data1_o  = ram1[rd_idx_i];
+
+endmodule
+
+`endif
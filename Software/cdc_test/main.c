@@ -10,6 +10,7 @@
 #include <stdio.h>
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include "hbird_sdk_hal.h"
 
 #define DEBUG_MODE
@@ -18,100 +19,63 @@
 #include "openusb_regs.h"
 #include "openusb_common.h"
 #include "openusb_cdc.h"
+#include "openusb_stream.h"
+
+// EP1 OUT and EP2 IN rings, filled and drained in the interrupt
+uint8_t rx_ring_buf[256];
+uint8_t tx_ring_buf[256];
+
+//-----------------------------------------------------------------
+// cdc_echo: EP1 OUT ring -> EP2 IN ring, one copy per byte
+//-----------------------------------------------------------------
+void cdc_echo(){
+    uint8_t *src, *dst;
+    uint32_t len, space;
+
+    src = openusb_stream_rx_peek(CDC_ENDPOINT_BULK_OUT, &len);
+    if(len == 0)
+        return;
+
+    dst = openusb_stream_tx_reserve(CDC_ENDPOINT_BULK_IN, &space);
+    len = MIN(len, space);
+    if(len == 0)
+        return;
+
+    memcpy(dst, src, len);
+    openusb_stream_tx_commit(CDC_ENDPOINT_BULK_IN, len);
+    openusb_stream_rx_release(CDC_ENDPOINT_BULK_OUT, len);
+}
 
-uint8_t rx_packet_buf[64];
-uint8_t tx_packet_buf[64];
-uint8_t ep1_tx_suc=0;
-uint8_t ep2_tx_suc=0;
-uint8_t ep1_rx_suc=0;
-uint16_t ep1_rx_len=0;
-uint8_t enable_rst_intr=0;
-
-void my_usb_intr(){
-    printf("[USB INT]\n");
-    uint8_t endpoint_num;
-    int j;
-
-    OPEN_USB_EP_INTSTS_TypeDef ep_intsts;
-    OPEN_USB_FUNC_STAT_TypeDef func_stat;
-
-    func_stat.d32 = OPEN_USB_READ_REG(USB_FUNC_STAT);
-    ep_intsts.d32 = OPEN_USB_READ_REG(USB_EP_INTSTS);
-
-    openusb_service(func_stat, ep_intsts, enable_rst_intr);
-
-    if(ep_intsts.b.ep1_rx_ready){
-        endpoint_num = 1;
-
-        ep1_rx_len = openusb_get_rx_count(endpoint_num);
-
-        DEBUG_INFO("[%d USB_EP%1d_DATA]\n", ep1_rx_len, endpoint_num);
-
-        if(ep1_rx_len > 64){
-            ep1_rx_len = 64;
-        }
-
-        for(j=0; j<ep1_rx_len; j++){
-            rx_packet_buf[j] = openusb_get_rx_data_byte(endpoint_num);
-        }
-        openusb_clear_rx_ready_flag(endpoint_num);
-
-        ep1_rx_suc = 1;
-    }
-
-    if(ep_intsts.b.ep1_tx_complete){
-        ep1_tx_suc = 1;
-        DEBUG_INFO("[EP 1 SUC TX]\r\n");
-    }
-    
-    if(ep_intsts.b.ep2_tx_complete){
-        ep2_tx_suc = 1;
-        DEBUG_INFO("[EP 2 SUC TX]\r\n");
-    }
+//-----------------------------------------------------------------
+// Event handlers, called from openusb_poll_events in the main loop.
+// The interrupt only runs openusb_isr_top.
+//-----------------------------------------------------------------
+void on_rx_ready(OPEN_USB_EVENT_TypeDef *ev){
+    if(ev->ep != ENDPOINT_CONTROL)
+        DEBUG_INFO("[%d USB_EP%1d_DATA]\n", ev->len, ev->ep);
+}
 
-    // clear
-    OPEN_USB_WRITE_REG(USB_EP_INTSTS, ep_intsts.d32);
-    OPEN_USB_WRITE_REG(USB_FUNC_STAT, func_stat.d32);
+void on_tx_complete(OPEN_USB_EVENT_TypeDef *ev){
+    if(ev->ep != ENDPOINT_CONTROL)
+        DEBUG_INFO("[EP %d SUC TX]\r\n", ev->ep);
 }
 
 void enable_usb_int(){
-    int returnCode = PLIC_Register_IRQ(PLIC_USB_DEVICE_IRQn, 1, my_usb_intr); 
+    int returnCode = PLIC_Register_IRQ(PLIC_USB_DEVICE_IRQn, 1, openusb_isr_top); 
     __enable_irq();
 }
 
-
-void process_reset(){
-    OPEN_USB_FUNC_STAT_TypeDef func_stat;
-    OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
-    OPEN_USB_EPx_RX_CTRL_TypeDef ep_rx_ctrl;
-
-    uint8_t i;
-
-    func_stat.d32 = OPEN_USB_READ_REG(USB_FUNC_STAT);
-    if(func_stat.b.rst){
-        for(i=0; i<4; i++){
-            ep_tx_ctrl.d32 = OPEN_USB_READ_REG(USB_EP_TX_CTRL(i));
-            ep_rx_ctrl.d32 = OPEN_USB_READ_REG(USB_EP_RX_CTRL(i));
-
-            ep_tx_ctrl.b.tx_flush = 1;
-            ep_rx_ctrl.b.rx_flush = 1;
-
-            OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(i), ep_tx_ctrl.d32);
-            OPEN_USB_WRITE_REG(USB_EP_RX_CTRL(i), ep_rx_ctrl.d32);
-        }
-
-        OPEN_USB_WRITE_REG(USB_FUNC_STAT, func_stat.d32);
-        printf("USB: reset done\n");
-    }
-
-}
-
 int main(){
 
     printf("USB CDC test\r\n");
 
     openusb_attach(0);
-    usbf_init(USB_BASE, 0, usb_cdc_process_request);
+    usbf_init(USB_BASE, 0, 0);
+    usbf_register_class(&usb_cdc_driver, CDC_INTERFACE_COMM, USB_DESC_CDC_ACM_IFS, CDC_ENDPOINT_MASK);
+    openusb_set_event_handler(OPENUSB_EV_RX_READY, on_rx_ready);
+    openusb_set_event_handler(OPENUSB_EV_TX_COMPLETE, on_tx_complete);
+    openusb_stream_rx_open(CDC_ENDPOINT_BULK_OUT, rx_ring_buf, sizeof(rx_ring_buf));
+    openusb_stream_tx_open(CDC_ENDPOINT_BULK_IN, tx_ring_buf, sizeof(tx_ring_buf));
     enable_usb_int();
 
     openusb_delay_ms(500);
@@ -122,23 +86,15 @@ int main(){
     openusb_attach(1);
 
     openusb_enable_int(1,0); 
-    enable_rst_intr=1;
-
-    while(1){
-        process_reset();
 
-        if(ep1_rx_suc && ep1_rx_len!=0){ 
-            DEBUG_INFO("[EP1 RX]: ");
-            for(uint16_t k=0; k<ep1_rx_len; k+=1)
-                DEBUG_INFO("%x ", rx_packet_buf[k]);
-            DEBUG_INFO("\r\n");
-
-            openusb_tx_data(2, rx_packet_buf, ep1_rx_len); 
-
-            ep1_rx_suc = 0;
-            ep1_rx_len = 0;
-        }
+#ifdef HW_LOOPBACK
+    // EP1 OUT -> EP2 IN echoed by hardware, at line rate
+    openusb_set_loopback(1, 2, 1);
+#endif
 
+    while(1){
+        openusb_poll_events(8);
+        cdc_echo();
     }
 
     printf("Finish!\r\n");
@@ -12,6 +12,9 @@
 #define CDC_ENDPOINT_BULK_OUT           1
 #define CDC_ENDPOINT_BULK_IN            2
 #define CDC_ENDPOINT_INTR_IN            3
+#define CDC_ENDPOINT_MASK               ((1 << CDC_ENDPOINT_BULK_OUT) | (1 << CDC_ENDPOINT_BULK_IN) | \
+                                         (1 << CDC_ENDPOINT_INTR_IN))
+#define CDC_INTERFACE_COMM              0       // and CDC_INTERFACE_COMM + 1 data
 
 #define CDC_SEND_ENCAPSULATED_COMMAND   0x00
 #define CDC_GET_ENCAPSULATED_RESPONSE   0x01
@@ -20,11 +23,32 @@
 #define CDC_SET_CONTROL_LINE_STATE      0x22
 #define CDC_SEND_BREAK                  0x23
 
+// TX coalescing of usb_cdc_write: two buffers, one is filled while
+// the other is on the bus
+#ifndef CDC_TX_BUF_SIZE
+    #define CDC_TX_BUF_SIZE             512     // multiple of the max packet size
+#endif
+#ifndef CDC_TX_FLUSH_FRAMES
+    #define CDC_TX_FLUSH_FRAMES         2       // SOFs before a short packet is sent
+#endif
 
 
+// class driver, usbf_register_class(&usb_cdc_driver, CDC_INTERFACE_COMM,
+// USB_DESC_CDC_ACM_IFS, CDC_ENDPOINT_MASK)
+extern const USB_CLASS_DRIVER_TypeDef usb_cdc_driver;
+
 void usb_cdc_init( void );
 void usb_cdc_process_request(unsigned char req, unsigned short wValue, unsigned short WIndex, unsigned char *data, unsigned short wLength);
 
+// Coalesced output on CDC_ENDPOINT_BULK_IN (not with openusb_stream
+// on that endpoint). Writes are sent in full packets; the rest
+// follows on usb_cdc_flush or CDC_TX_FLUSH_FRAMES SOFs later (SOF
+// interrupt enabled). Without DTR the output is dropped.
+uint32_t usb_cdc_write(const uint8_t *buf, uint32_t len);
+void usb_cdc_flush(void);
+void usb_cdc_set_flush_frames(uint16_t frames);
+int usb_cdc_dtr(void);
+
 
 
 #endif
\ No newline at end of file
@@ -11,25 +11,101 @@
 //-----------------------------------------------------------------
 typedef void (*FUNC_PTR)(void);
 
+// USB event, marked pending by openusb_isr_top. Events of one type
+// and endpoint merge while pending, the fields are of the last one.
+typedef struct _OPEN_USB_EVENT_TypeDef
+{
+    uint8_t  type;      // OPENUSB_EV_*
+    uint8_t  ep;
+    uint8_t  setup;     // RX_READY: SETUP packet
+    uint8_t  seq;       // TX_COMPLETE: openusb_get_tx_seq at the interrupt
+    uint16_t len;       // RX_READY: rx count
+    uint16_t frame;     // frame number at the last interrupt
+} OPEN_USB_EVENT_TypeDef;
+
+typedef void (*OPEN_USB_EVENT_HANDLER)(OPEN_USB_EVENT_TypeDef *ev);
+
+// IN transfer of openusb_tx_begin / openusb_tx_data
+typedef struct _OPEN_USB_TX_XFER_TypeDef
+{
+    uint8_t    *buf;
+    uint32_t    len;
+    uint32_t    pos;        // bytes written to the FIFO
+    uint32_t    sent;       // bytes of the started packets
+    uint16_t    inflight;   // length of the last started packet
+    uint16_t    unseen;     // bytes of the last FIFO writes, maybe not in the level yet
+    uint8_t     zlp;
+    uint8_t     last;       // the last packet is started
+    uint8_t     active;
+} OPEN_USB_TX_XFER_TypeDef;
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+#define OPENUSB_EV_RESET        0
+#define OPENUSB_EV_SOF          1
+#define OPENUSB_EV_PRESOF       2
+#define OPENUSB_EV_TX_COMPLETE  3
+#define OPENUSB_EV_RX_READY     4
+#define OPENUSB_EV_IN_NAK       5
+#define OPENUSB_EV_OUT_NAK      6
+#define OPENUSB_EV_TX_LVL       7
+#define OPENUSB_EV_RX_LVL       8
+#define OPENUSB_EV_NUM          9
+
+// ISR and main loop run on one core, a compiler barrier orders them
+#ifndef OPENUSB_BARRIER
+    #define OPENUSB_BARRIER()           __asm__ volatile("" ::: "memory")
+#endif
+
 void openusb_delay_us(uint32_t i);
 void openusb_delay_ms(uint32_t i);
 
+void openusb_shadow_sync(void);
 void openusb_attach(uint32_t state);
-void openusb_init(unsigned int base, FUNC_PTR bus_reset, FUNC_PTR on_setup, FUNC_PTR on_out);
+void openusb_init(unsigned int base, FUNC_PTR bus_reset, FUNC_PTR on_setup, FUNC_PTR on_out, FUNC_PTR on_in);
 
 int openusb_is_rx_ready(uint8_t endpoint);
 int openusb_get_rx_count(uint8_t endpoint);
+OPEN_USB_EPx_STS_TypeDef openusb_get_ep_status(uint8_t endpoint);
+OPEN_USB_EPx_STS_TypeDef openusb_last_ep_status(uint8_t endpoint);
 uint8_t openusb_get_rx_data_byte(uint8_t endpoint);
 void openusb_clear_rx_ready_flag(uint8_t endpoint);
-void openusb_tx_data(uint8_t endpoint, uint8_t *tx_buffer, uint32_t tx_len);
+uint32_t openusb_tx_data(uint8_t endpoint, uint8_t *tx_buffer, uint32_t tx_len);
+int openusb_tx_begin(uint8_t endpoint, uint8_t *tx_buffer, uint32_t tx_len, uint8_t zlp);
+int openusb_tx_continue(uint8_t endpoint);
+void openusb_set_tx_min(uint8_t endpoint, uint16_t tx_min);
+void openusb_flush_tx(uint8_t endpoint);
+uint8_t openusb_get_tx_seq(uint8_t endpoint);
+uint16_t openusb_get_max_packet(uint8_t endpoint);
 
 void openusb_enable_int(uint8_t en_rst, uint8_t en_sof);
+void openusb_enable_nak_int(uint8_t endpoint, uint8_t en_in, uint8_t en_out);
+void openusb_set_nak_holdoff(uint16_t clocks);
+void openusb_set_fifo_thr(uint8_t endpoint, uint16_t tx_thr, uint16_t rx_thr, uint8_t en_tx, uint8_t en_rx);
+void openusb_rearm_fifo_thr(uint8_t endpoint, uint8_t en_tx, uint8_t en_rx);
+int openusb_get_tx_level(uint8_t endpoint);
+int openusb_get_rx_level(uint8_t endpoint);
+void openusb_crc_start(uint8_t endpoint, uint8_t en);
+uint32_t openusb_crc_result(uint8_t endpoint);
+void openusb_set_rst_ctrl(uint8_t flush, uint8_t clr_stall, uint8_t clr_addr);
+void openusb_set_sof_int(uint8_t sof_div, uint16_t presof_lead, uint8_t en_presof);
+void openusb_set_sof_meas_win(uint8_t win);
+uint32_t openusb_get_sof_period(void);
+void openusb_set_loopback(uint8_t out_ep, uint8_t in_ep, uint8_t en);
+void openusb_set_auto_accept(uint8_t endpoint, uint8_t en);
+void openusb_get_ep_summary(OPEN_USB_EP_SUMMARY_TypeDef *sum);
+void openusb_trace_start(uint16_t pid_mask, uint16_t ep_mask, uint8_t trig_en, uint8_t trig_pid, uint8_t post);
+int openusb_trace_count(void);
+uint32_t openusb_trace_read(uint16_t n, uint32_t *timestamp);
 int openusb_has_tx_space(uint8_t endpoint);
 void openusb_set_endpoint_stall(uint8_t endpoint);
 void openusb_control_endpoint_stall();
 void openusb_clear_endpoint_stall(uint8_t endpoint);
 uint8_t openusb_is_endpoint_stalled(uint8_t endpoint);
 uint32_t openusb_get_rx_data(uint8_t endpoint, uint8_t *rdata_buf, uint32_t max_len);
+uint32_t openusb_get_rx_packet(uint8_t endpoint, OPEN_USB_EPx_STS_TypeDef ep_sts, uint8_t *rdata_buf, uint32_t max_len);
+int openusb_control_endpoint_send(uint8_t *tx_buffer, uint32_t tx_len);
 void openusb_control_endpoint_send_status();
 
 void openusb_set_address(uint8_t addr);
@@ -40,6 +116,11 @@ void openusb_set_configured(int configured);
 
 void openusb_service(OPEN_USB_FUNC_STAT_TypeDef func_stat, OPEN_USB_EP_INTSTS_TypeDef ep_intsts, uint8_t is_process_rst);
 
+void openusb_isr_top(void);
+void openusb_set_event_handler(uint8_t type, OPEN_USB_EVENT_HANDLER handler);
+int openusb_poll_events(int max);
+uint32_t openusb_get_event_merged(void);
+
 void openusb_scaledown_enable(uint8_t mode);
 void openusb_ulpi_reset(uint32_t ms);
 
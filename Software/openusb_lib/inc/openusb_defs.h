@@ -49,10 +49,26 @@
 //-----------------------------------------------------------------
 #define USB_CTRL_TX_TIMEOUT     100
 
+#ifndef USB_TX_TIMEOUT
+    #define USB_TX_TIMEOUT      1000    // tx busy polls without progress
+#endif
+
+#ifndef USB_FIFO_DEPTH
+    #define USB_FIFO_DEPTH      64      // 2^USB_FIFO_ADDR_W of the hardware
+#endif
+
 #ifndef MAX_CTRL_DATA_LENGTH
     #define MAX_CTRL_DATA_LENGTH    64
 #endif
 
+#ifndef USB_MAX_INTERFACES
+    #define USB_MAX_INTERFACES      8       // interfaces of the class drivers
+#endif
+
+#ifndef USB_MAX_CLASS_DRIVERS
+    #define USB_MAX_CLASS_DRIVERS   4
+#endif
+
 
 
 
@@ -4,10 +4,167 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include "openusb_defs.h"
 
+//-----------------------------------------------------------------
+// Descriptor builder. Each macro expands to the bytes of one
+// descriptor, with its length filled in, so a configuration is a
+// list of macros in a const array:
+//
+//   #define MY_FUNCTIONS  USB_DESC_INTERFACE(0, 0, 2, ...),
+//                         USB_DESC_ENDPOINT(0x81, ...), ...  (one line or
+//                         continued with backslashes)
+//
+//   static const unsigned char _config_desc[] =
+//   {
+//       USB_DESC_CONFIG(USB_DESC_CONFIG_TOTAL(MY_FUNCTIONS), 1, 1, 0, 0x80, 50),
+//       MY_FUNCTIONS
+//   };
+//
+// wTotalLength is counted by the compiler, up to 65535 bytes.
+//-----------------------------------------------------------------
 
-unsigned char *usb_get_descriptor( unsigned char bDescriptorType, unsigned char bDescriptorIndex, unsigned short wLength, unsigned char *pSize );
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+#define DESC_IAD                0x0B
+#define DESC_CS_INTERFACE       0x24
+#define DESC_CS_ENDPOINT        0x25
+
+#define USB_DESC_DEVICE_LEN     18
+#define USB_DESC_CONFIG_LEN     9
+#define USB_DESC_INTERFACE_LEN  9
+#define USB_DESC_ENDPOINT_LEN   7
+#define USB_DESC_IAD_LEN        8
+
+#define USB_DESC_WORD(w)        LO_BYTE(w), HI_BYTE(w)
+
+// Length of a list of descriptors
+#define USB_DESC_SIZEOF(...)    sizeof((const unsigned char[]){ __VA_ARGS__ })
+
+// wTotalLength of a configuration holding the list
+#define USB_DESC_CONFIG_TOTAL(...) (USB_DESC_CONFIG_LEN + USB_DESC_SIZEOF(__VA_ARGS__))
+
+//-----------------------------------------------------------------
+// Standard descriptors
+//-----------------------------------------------------------------
+#define USB_DESC_DEVICE(bcd_usb, cls, sub_cls, proto, ep0_size, vid, pid, bcd_dev, \
+                        i_manufacturer, i_product, i_serial, num_configs) \
+    USB_DESC_DEVICE_LEN, DESC_DEVICE, USB_DESC_WORD(bcd_usb), \
+    cls, sub_cls, proto, ep0_size, \
+    USB_DESC_WORD(vid), USB_DESC_WORD(pid), USB_DESC_WORD(bcd_dev), \
+    i_manufacturer, i_product, i_serial, num_configs
+
+#define USB_DESC_CONFIG(total_len, num_ifs, config_value, i_config, attributes, max_power) \
+    USB_DESC_CONFIG_LEN, DESC_CONFIGURATION, USB_DESC_WORD(total_len), \
+    num_ifs, config_value, i_config, attributes, max_power
+
+// One per alternate setting, the endpoints of the setting follow it
+#define USB_DESC_INTERFACE(if_num, alt, num_eps, cls, sub_cls, proto, i_if) \
+    USB_DESC_INTERFACE_LEN, DESC_INTERFACE, if_num, alt, num_eps, \
+    cls, sub_cls, proto, i_if
+
+#define USB_DESC_ENDPOINT(ep_addr, attributes, max_packet, interval) \
+    USB_DESC_ENDPOINT_LEN, DESC_ENDPOINT, ep_addr, attributes, \
+    USB_DESC_WORD(max_packet), interval
+
+// Interface association, groups the interfaces of one function of a
+// composite device (device class 0xEF/0x02/0x01)
+#define USB_DESC_IAD(first_if, num_ifs, cls, sub_cls, proto, i_function) \
+    USB_DESC_IAD_LEN, DESC_IAD, first_if, num_ifs, cls, sub_cls, proto, i_function
+
+// String descriptor from a UTF-16 literal, USB_DESC_STRING(_str, u"Name").
+// bLength is the size of the literal (2 bytes per char + 2 for the
+// terminator, which takes the place of the header). The chars are in
+// CPU order, little endian as USB_BYTE_SWAP16.
+#define USB_DESC_STRING(name, str) \
+    static const struct \
+    { \
+        uint8_t  bLength; \
+        uint8_t  bDescriptorType; \
+        uint16_t wString[sizeof(str) / 2 - 1]; \
+    } name = { sizeof(str), DESC_STRING, str }
+
+//-----------------------------------------------------------------
+// CDC class specific descriptors (CDC 1.2 $5.2.3)
+//-----------------------------------------------------------------
+#define USB_DESC_CDC_HEADER(bcd_cdc) \
+    5, DESC_CS_INTERFACE, 0x00, USB_DESC_WORD(bcd_cdc)
+
+#define USB_DESC_CDC_CALL_MGMT(capabilities, data_if) \
+    5, DESC_CS_INTERFACE, 0x01, capabilities, data_if
+
+#define USB_DESC_CDC_ACM(capabilities) \
+    4, DESC_CS_INTERFACE, 0x02, capabilities
+
+#define USB_DESC_CDC_UNION(comm_if, data_if) \
+    5, DESC_CS_INTERFACE, 0x06, comm_if, data_if
+
+// A complete ACM function: the communication interface with its
+// notification endpoint and the data interface with the bulk pair
+#define USB_DESC_CDC_ACM_FUNCTION(comm_if, i_function, ep_notify, notify_size, notify_interval, \
+                                  ep_out, ep_in, bulk_size) \
+    USB_DESC_INTERFACE(comm_if, 0, 1, DEV_CLASS_COMMS, 0x02, 0x01, i_function), \
+    USB_DESC_CDC_HEADER(0x0110), \
+    USB_DESC_CDC_CALL_MGMT(0x03, (comm_if) + 1), \
+    USB_DESC_CDC_ACM(0x06), \
+    USB_DESC_CDC_UNION(comm_if, (comm_if) + 1), \
+    USB_DESC_ENDPOINT(ep_notify, ENDPOINT_TYPE_INTERRUPT, notify_size, notify_interval), \
+    USB_DESC_INTERFACE((comm_if) + 1, 0, 2, 0x0A, 0x00, 0x00, 0), \
+    USB_DESC_ENDPOINT(ep_out, ENDPOINT_TYPE_BULK, bulk_size, 0), \
+    USB_DESC_ENDPOINT(ep_in, ENDPOINT_TYPE_BULK, bulk_size, 0)
+
+// Interfaces of USB_DESC_CDC_ACM_FUNCTION
+#define USB_DESC_CDC_ACM_IFS    2
+
+// Ethernet networking, iMACAddress is the string of the 12 hex digits
+#define USB_DESC_CDC_ETHERNET(i_mac, max_segment) \
+    13, DESC_CS_INTERFACE, 0x0F, i_mac, 0, 0, 0, 0, USB_DESC_WORD(max_segment), \
+    USB_DESC_WORD(0), 0
+
+#define USB_DESC_CDC_NCM(capabilities) \
+    6, DESC_CS_INTERFACE, 0x1A, USB_DESC_WORD(0x0100), capabilities
+
+// A complete NCM function: the communication interface with its
+// notification endpoint, the data interface without endpoints in
+// alternate setting 0 and with the bulk pair in setting 1
+#define USB_DESC_CDC_NCM_FUNCTION(comm_if, i_function, i_mac, capabilities, ep_notify, notify_interval, \
+                                  ep_out, ep_in, bulk_size) \
+    USB_DESC_INTERFACE(comm_if, 0, 1, DEV_CLASS_COMMS, 0x0D, 0x00, i_function), \
+    USB_DESC_CDC_HEADER(0x0110), \
+    USB_DESC_CDC_UNION(comm_if, (comm_if) + 1), \
+    USB_DESC_CDC_ETHERNET(i_mac, 1514), \
+    USB_DESC_CDC_NCM(capabilities), \
+    USB_DESC_ENDPOINT(ep_notify, ENDPOINT_TYPE_INTERRUPT, 16, notify_interval), \
+    USB_DESC_INTERFACE((comm_if) + 1, 0, 0, 0x0A, 0x00, 0x01, 0), \
+    USB_DESC_INTERFACE((comm_if) + 1, 1, 2, 0x0A, 0x00, 0x01, 0), \
+    USB_DESC_ENDPOINT(ep_out, ENDPOINT_TYPE_BULK, bulk_size, 0), \
+    USB_DESC_ENDPOINT(ep_in, ENDPOINT_TYPE_BULK, bulk_size, 0)
+
+// Interfaces of USB_DESC_CDC_NCM_FUNCTION
+#define USB_DESC_CDC_NCM_IFS    2
+
+//-----------------------------------------------------------------
+// MSC function, Bulk-Only Transport / SCSI transparent
+//-----------------------------------------------------------------
+#define USB_DESC_MSC_FUNCTION(if_num, i_if, ep_out, ep_in, bulk_size) \
+    USB_DESC_INTERFACE(if_num, 0, 2, DEV_CLASS_STORAGE, 0x06, 0x50, i_if), \
+    USB_DESC_ENDPOINT(ep_out, ENDPOINT_TYPE_BULK, bulk_size, 0), \
+    USB_DESC_ENDPOINT(ep_in, ENDPOINT_TYPE_BULK, bulk_size, 0)
+
+//-----------------------------------------------------------------
+// Vendor specific function with a bulk pair, openusb_vendor.h
+//-----------------------------------------------------------------
+#define USB_DESC_VENDOR_FUNCTION(if_num, i_if, ep_out, ep_in, bulk_size) \
+    USB_DESC_INTERFACE(if_num, 0, 2, DEV_CLASS_VENDOR_CUSTOM, 0x00, 0x00, i_if), \
+    USB_DESC_ENDPOINT(ep_out, ENDPOINT_TYPE_BULK, bulk_size, 0), \
+    USB_DESC_ENDPOINT(ep_in, ENDPOINT_TYPE_BULK, bulk_size, 0)
+
+//-----------------------------------------------------------------
+// Descriptor source, the size is up to 65535 bytes
+//-----------------------------------------------------------------
+unsigned char *usb_get_descriptor( unsigned char bDescriptorType, unsigned char bDescriptorIndex, unsigned short wLength, unsigned short *pSize );
 int usb_is_bus_powered(void);
 
 
@@ -11,7 +11,47 @@
 typedef void (*FP_CLASS_REQUEST) (unsigned char req, unsigned short wValue, unsigned short WIndex, unsigned char *data, unsigned short wLength);
 typedef void (*FP_BUS_RESET)(void);
 
+struct _OPEN_USB_EVENT_TypeDef;
+
+// SETUP packet data format
+typedef struct _DEVICE_REQUEST_TypeDef
+{
+    uint8_t  bmRequestType;
+    uint8_t  bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} DEVICE_REQUEST_TypeDef;
+
+// Class driver of a function, registered for its interfaces and
+// endpoints with usbf_register_class. Any hook may be 0.
+//   init      : on registration and on each bus reset
+//   setup     : class / vendor request to an interface or endpoint of
+//               the driver, IN and no data requests at the SETUP
+//   data      : the same for a request with an OUT data stage, after
+//               the data (in data) is received, 0 if accepted, else
+//               -1 (STALL); the status stage follows it; setup if 0
+//   set_config: SET_CONFIGURATION, 0 when deconfigured
+//   set_interface: SET_INTERFACE of an interface of the driver, 0 if
+//               the alternate setting exists, else -1 (STALL); only
+//               the alternate setting 0 exists if 0
+//   ep_event  : openusb_poll_events event of an endpoint of the driver
+//   sof       : SOF event (openusb_enable_int en_sof), frame number
+typedef struct _USB_CLASS_DRIVER_TypeDef
+{
+    void (*init)(void);
+    void (*setup)(DEVICE_REQUEST_TypeDef *request, unsigned char *data);
+    int  (*data)(DEVICE_REQUEST_TypeDef *request, unsigned char *data);
+    void (*set_config)(unsigned char config);
+    int  (*set_interface)(uint8_t if_num, uint8_t alt);
+    void (*ep_event)(struct _OPEN_USB_EVENT_TypeDef *ev);
+    void (*sof)(uint16_t frame);
+} USB_CLASS_DRIVER_TypeDef;
+
 int usb_control_send(uint8_t *buf, int size, int requeseted_size);
 void usbf_init(unsigned int base, FP_BUS_RESET bus_reset, FP_CLASS_REQUEST class_request);
+int usbf_register_class(const USB_CLASS_DRIVER_TypeDef *driver, uint8_t first_if, uint8_t num_ifs, uint16_t ep_mask);
+void usbf_ep_event(struct _OPEN_USB_EVENT_TypeDef *ev);
+void usbf_sof(uint16_t frame);
 
 #endif
@@ -0,0 +1,59 @@
+#ifndef __OPENUSB_EP_H__
+#define __OPENUSB_EP_H__
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------
+// Transfer requests on the non-control endpoints. Requests are
+// queued per endpoint and direction (endpoint | ENDPOINT_DIR_IN for
+// IN) and advanced by openusb_poll_events on the tx complete and rx
+// ready events; the completion callback runs there too, it may queue
+// the next request.
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+// request status
+#define OPENUSB_REQ_PENDING     0
+#define OPENUSB_REQ_DONE        1
+#define OPENUSB_REQ_CANCELLED   2       // openusb_ep_dequeue
+#define OPENUSB_REQ_OVERFLOW    3       // OUT packet larger than the space left
+#define OPENUSB_REQ_RESET       4       // bus reset
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+struct _OPEN_USB_REQ_TypeDef;
+typedef void (*OPEN_USB_REQ_COMPLETE)(uint8_t ep_addr, struct _OPEN_USB_REQ_TypeDef *req);
+
+// A transfer, owned by the library from openusb_ep_queue until the
+// complete callback.
+// IN : len bytes from buf, a ZLP follows a full last packet if zlp
+// OUT: up to len bytes into buf, ends on a short packet or when full
+typedef struct _OPEN_USB_REQ_TypeDef
+{
+    uint8_t                *buf;
+    uint32_t                len;
+    uint8_t                 zlp;
+    uint8_t                 status;
+    uint32_t                actual;
+    OPEN_USB_REQ_COMPLETE   complete;
+    void                   *context;
+    struct _OPEN_USB_REQ_TypeDef *next;
+} OPEN_USB_REQ_TypeDef;
+
+//-----------------------------------------------------------------
+// Application
+//-----------------------------------------------------------------
+int openusb_ep_queue(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+int openusb_ep_dequeue(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+
+//-----------------------------------------------------------------
+// Library, called by openusb_poll_events
+//-----------------------------------------------------------------
+void openusb_ep_tx_complete(uint8_t endpoint, uint8_t seq);
+void openusb_ep_rx_ready(uint8_t endpoint);
+void openusb_ep_reset(void);
+
+#endif
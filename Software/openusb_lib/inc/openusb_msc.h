@@ -0,0 +1,79 @@
+#ifndef __OPENUSB_MSC_H__
+#define __OPENUSB_MSC_H__
+
+#include "openusb_common.h"
+#include "openusb_defs.h"
+#include "openusb_device.h"
+
+//-----------------------------------------------------------------
+// Mass storage class, Bulk-Only Transport with the SCSI transparent
+// command set, on one LUN. The CBW, data and CSW stages are transfer
+// requests of openusb_ep.h: the CSW is queued right behind the last
+// data packet and the next CBW behind the CSW. READ(10) / WRITE(10)
+// move the blocks between the bulk endpoints and the block device
+// in place (map) or through two block buffers that are filled and
+// sent in turn (read / write).
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#ifndef MSC_ENDPOINT_BULK_OUT
+    #define MSC_ENDPOINT_BULK_OUT       1
+#endif
+#ifndef MSC_ENDPOINT_BULK_IN
+    #define MSC_ENDPOINT_BULK_IN        2
+#endif
+#define MSC_ENDPOINT_MASK               ((1 << MSC_ENDPOINT_BULK_OUT) | (1 << MSC_ENDPOINT_BULK_IN))
+#define MSC_INTERFACE                   0
+
+#define MSC_BLOCK_SIZE                  512
+#ifndef MSC_BUF_BLOCKS
+    #define MSC_BUF_BLOCKS              2       // blocks per buffer without map
+#endif
+
+#define MSC_SUBCLASS_SCSI               0x06
+#define MSC_PROTOCOL_BOT                0x50
+
+// class requests
+#define MSC_REQ_GET_MAX_LUN             0xFE
+#define MSC_REQ_BOT_RESET               0xFF
+
+// SCSI commands
+#define SCSI_TEST_UNIT_READY            0x00
+#define SCSI_REQUEST_SENSE              0x03
+#define SCSI_INQUIRY                    0x12
+#define SCSI_MODE_SENSE6                0x1A
+#define SCSI_START_STOP_UNIT            0x1B
+#define SCSI_PREVENT_ALLOW_REMOVAL      0x1E
+#define SCSI_READ_FORMAT_CAPACITIES     0x23
+#define SCSI_READ_CAPACITY10            0x25
+#define SCSI_READ10                     0x28
+#define SCSI_WRITE10                    0x2A
+#define SCSI_VERIFY10                   0x2F
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+// Block device of MSC_BLOCK_SIZE blocks. A memory mapped media sets
+// map, which returns the first block of lba, the following blocks
+// of a transfer are behind it. Otherwise read / write copy blocks
+// from / to buf and return 0 on success.
+typedef struct _USB_MSC_BLOCKDEV_TypeDef
+{
+    uint32_t    block_count;
+    uint8_t    *(*map)(uint32_t lba);
+    int         (*read)(uint32_t lba, uint8_t *buf, uint32_t blocks);
+    int         (*write)(uint32_t lba, const uint8_t *buf, uint32_t blocks);
+} USB_MSC_BLOCKDEV_TypeDef;
+
+// class driver, usbf_register_class(&usb_msc_driver, MSC_INTERFACE, 1,
+// MSC_ENDPOINT_MASK)
+extern const USB_CLASS_DRIVER_TypeDef usb_msc_driver;
+
+void usb_msc_set_blockdev(const USB_MSC_BLOCKDEV_TypeDef *dev);
+
+// RAM disk of blocks blocks at mem, for testing
+const USB_MSC_BLOCKDEV_TypeDef *usb_msc_ramdisk(uint8_t *mem, uint32_t blocks);
+
+#endif
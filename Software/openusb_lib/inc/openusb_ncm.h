@@ -0,0 +1,86 @@
+#ifndef __OPENUSB_NCM_H__
+#define __OPENUSB_NCM_H__
+
+#include "openusb_common.h"
+#include "openusb_defs.h"
+#include "openusb_device.h"
+
+//-----------------------------------------------------------------
+// CDC Network Control Model, Ethernet frames in NTB16 transfer
+// blocks. usb_ncm_send packs the datagrams into the NTB being
+// filled, which is queued on the bulk IN endpoint at a flush point;
+// the next NTB is filled meanwhile. The datagrams of a received NTB
+// go to the rx callback. The data interface streams in its alternate
+// setting 1 only.
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#ifndef NCM_ENDPOINT_BULK_OUT
+    #define NCM_ENDPOINT_BULK_OUT       1
+#endif
+#ifndef NCM_ENDPOINT_BULK_IN
+    #define NCM_ENDPOINT_BULK_IN        2
+#endif
+#ifndef NCM_ENDPOINT_INTR_IN
+    #define NCM_ENDPOINT_INTR_IN        3
+#endif
+#define NCM_ENDPOINT_MASK               ((1 << NCM_ENDPOINT_BULK_OUT) | (1 << NCM_ENDPOINT_BULK_IN) | \
+                                         (1 << NCM_ENDPOINT_INTR_IN))
+#define NCM_INTERFACE_COMM              0       // and NCM_INTERFACE_COMM + 1 data
+
+// queue: NTB sizes and count of IN NTBs (one is filled, the others
+// are on the bus)
+#ifndef NCM_NTB_IN_SIZE
+    #define NCM_NTB_IN_SIZE             2048
+#endif
+#ifndef NCM_NTB_OUT_SIZE
+    #define NCM_NTB_OUT_SIZE            2048
+#endif
+#ifndef NCM_IN_NTBS
+    #define NCM_IN_NTBS                 2
+#endif
+#ifndef NCM_IN_MAX_DATAGRAMS
+    #define NCM_IN_MAX_DATAGRAMS        16      // per IN NTB
+#endif
+
+#define NCM_MAX_DATAGRAM                1514    // Ethernet frame without FCS
+
+// bmNetworkCapabilities: packet filter, max datagram size, 8 byte
+// NTB input size
+#define NCM_CAPABILITIES                0x29
+
+// class requests
+#define NCM_SET_ETHERNET_PACKET_FILTER  0x43
+#define NCM_GET_NTB_PARAMETERS          0x80
+#define NCM_GET_NTB_FORMAT              0x83
+#define NCM_SET_NTB_FORMAT              0x84
+#define NCM_GET_NTB_INPUT_SIZE          0x85
+#define NCM_SET_NTB_INPUT_SIZE          0x86
+#define NCM_GET_MAX_DATAGRAM_SIZE       0x87
+#define NCM_SET_MAX_DATAGRAM_SIZE       0x88
+
+#define NCM_NTB_PARAMETERS_LEN          28
+
+// notifications
+#define NCM_NOTIFY_NETWORK_CONNECTION   0x00
+#define NCM_NOTIFY_SPEED_CHANGE         0x2A
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+// a received Ethernet frame, valid during the call
+typedef void (*USB_NCM_RX)(const uint8_t *frame, uint16_t len);
+
+// class driver, usbf_register_class(&usb_ncm_driver, NCM_INTERFACE_COMM,
+// USB_DESC_CDC_NCM_IFS, NCM_ENDPOINT_MASK)
+extern const USB_CLASS_DRIVER_TypeDef usb_ncm_driver;
+
+void usb_ncm_set_rx(USB_NCM_RX rx);
+void usb_ncm_set_flush(uint32_t bytes, uint16_t datagrams, uint8_t idle);
+int  usb_ncm_send(const uint8_t *frame, uint16_t len);
+void usb_ncm_flush(void);
+int  usb_ncm_link_up(void);
+
+#endif
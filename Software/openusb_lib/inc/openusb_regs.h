@@ -2,30 +2,49 @@
 #define __OPENUSB_REGS_H__
 
 #include <stdio.h>
+#include <stdint.h>
 // #include "demosoc.h"
 
 //-----------------------------------------------------------------
 // define
+// Register access backend, selected at build time:
+// default    : memory mapped registers of the SoC
+// OPENUSB_SIM: register level simulator on the host (openusb_sim.c)
 //-----------------------------------------------------------------
-typedef volatile unsigned int reg32_t;
-#define OPEN_USB_READ_REG(addr) (*(reg32_t *)(addr))
-#define OPEN_USB_WRITE_REG(addr, wdata) (*(reg32_t *)(addr) = (wdata))
+#ifdef OPENUSB_SIM
+    #include "openusb_sim.h"
+    #define OPEN_USB_READ_REG(addr) openusb_sim_read((uint32_t)(addr))
+    #define OPEN_USB_WRITE_REG(addr, wdata) openusb_sim_write((uint32_t)(addr), (uint32_t)(wdata))
+#else
+    typedef volatile unsigned int reg32_t;
+    #define OPEN_USB_READ_REG(addr) (*(reg32_t *)(addr))
+    #define OPEN_USB_WRITE_REG(addr, wdata) (*(reg32_t *)(addr) = (wdata))
+#endif
 
 //-----------------------------------------------------------------
 // addr
 //-----------------------------------------------------------------
-#define  USB_BASE        (0x10042000)
+#ifndef USB_BASE
+    #define  USB_BASE    (0x10042000)
+#endif
 
 #define  USB_FUNC_CTRL   (USB_BASE | 0x00)
 #define  USB_FUNC_STAT   (USB_BASE | 0x04)
 #define  USB_FUNC_ADDR   (USB_BASE | 0x08)
 #define  USB_EP_INTSTS   (USB_BASE | 0x0C)
+#define  USB_EP_NAKSTS   (USB_BASE | 0x10)
+#define  USB_NAK_CTRL    (USB_BASE | 0x14)
+#define  USB_SOF_CTRL    (USB_BASE | 0x18)
+#define  USB_SOF_PERIOD  (USB_BASE | 0x1C)
 
 #define  USB_EP0_CFG     (USB_BASE | 0x20)
 #define  USB_EP0_TX_CTRL (USB_BASE | 0x24)
 #define  USB_EP0_RX_CTRL (USB_BASE | 0x28)
 #define  USB_EP0_STS     (USB_BASE | 0x2C)
 #define  USB_EP0_DATA    (USB_BASE | 0x30)
+#define  USB_EP0_LEVEL   (USB_BASE | 0x34)
+#define  USB_EP0_THR     (USB_BASE | 0x38)
+#define  USB_EP0_CRC     (USB_BASE | 0x3C)
 
 #define  USB_EP1_CFG     (USB_BASE | 0x40)
 #define  USB_EP1_TX_CTRL (USB_BASE | 0x44)
@@ -36,11 +55,37 @@ typedef volatile unsigned int reg32_t;
 
 #define  USB_EP_STRIDE   (0x20)
 
+// only with USB_TRACE in hardware
+#define  USB_TRACE_CTRL  (USB_BASE | 0x300)
+#define  USB_TRACE_FILT  (USB_BASE | 0x304)
+#define  USB_TRACE_STS   (USB_BASE | 0x308)
+#define  USB_TRACE_IDX   (USB_BASE | 0x30C)
+#define  USB_TRACE_DATA0 (USB_BASE | 0x310)
+#define  USB_TRACE_DATA1 (USB_BASE | 0x314)
+#define  USB_TRACE_DEPTH (64)    // 2^USB_TRACE_DEPTH_W
+
 #define  USB_EP_CFG(ep)         (USB_EP0_CFG     + (ep * USB_EP_STRIDE))
 #define  USB_EP_TX_CTRL(ep)     (USB_EP0_TX_CTRL + (ep * USB_EP_STRIDE))
 #define  USB_EP_RX_CTRL(ep)     (USB_EP0_RX_CTRL + (ep * USB_EP_STRIDE))
 #define  USB_EP_STS(ep)         (USB_EP0_STS     + (ep * USB_EP_STRIDE))
 #define  USB_EP_DATA(ep)        (USB_EP0_DATA    + (ep * USB_EP_STRIDE))
+#define  USB_EP_LEVEL(ep)       (USB_EP0_LEVEL   + (ep * USB_EP_STRIDE))
+#define  USB_EP_THR(ep)         (USB_EP0_THR     + (ep * USB_EP_STRIDE))
+#define  USB_EP_CRC(ep)         (USB_EP0_CRC     + (ep * USB_EP_STRIDE))
+
+#define  USB_RST_CTRL    (USB_BASE | 0x240)
+#define  USB_EP_LVLSTS   (USB_BASE | 0x244)
+
+// status of ep 2n and 2n+1
+#define  USB_EP_SUMMARY(n)      (USB_BASE | (0x280 + ((n) * 4)))
+
+// SoC registers outside the controller
+#ifndef SOC_DEV_CTRL0
+    #define  SOC_DEV_CTRL0      (0x10030000)    // [1:0] OTG_SCALEDOWN
+#endif
+#ifndef SOC_SFT_RESET
+    #define  SOC_SFT_RESET      (0x10000010)    // [3] ULPI_SW_RSTN
+#endif
 
 
 
@@ -68,8 +113,10 @@ typedef union _OPEN_USB_FUNC_CTRL_TypeDef
         1;
         uint32_t int_en_rst :
         1;
-        uint32_t reserved10_31 :
-        (32-10);
+        uint32_t int_en_presof :
+        1;
+        uint32_t reserved11_31 :
+        (32-11);
     }
     b;
     
@@ -90,8 +137,12 @@ typedef union _OPEN_USB_FUNC_STAT_TypeDef{
         1;
         uint32_t sof : // W1C
         1;
-        uint32_t reserved15_31 :
-        (32-15);
+        uint32_t presof : // W1C
+        1;
+        uint32_t sof_lock :
+        1;
+        uint32_t reserved17_31 :
+        (32-17);
     }
     b;
 } OPEN_USB_FUNC_STAT_TypeDef;
@@ -124,8 +175,24 @@ typedef union _OPEN_USB_EPx_CFG_TypeDef{
         1;
         uint32_t int_rx :
         1;
-        uint32_t reserved4_31 :
-        (32-4);
+        uint32_t int_in_nak :
+        1;
+        uint32_t int_out_nak :
+        1;
+        uint32_t loopback_en :
+        1;
+        uint32_t auto_accept :
+        1;
+        uint32_t loopback_ep :
+        4;
+        uint32_t int_tx_lvl :
+        1;
+        uint32_t int_rx_lvl :
+        1;
+        uint32_t crc_en :          // rx data read -> USB_EPx_CRC
+        1;
+        uint32_t reserved15_31 :
+        (32-15);
     }
     b;
 } OPEN_USB_EPx_CFG_TypeDef;
@@ -144,8 +211,10 @@ typedef union _OPEN_USB_EPx_TX_CTRL_TypeDef{
         1;
         uint32_t tx_flush :
         1;
-        uint32_t reserved18_31 :
-        (32-18);
+        uint32_t tx_min :
+        11;
+        uint32_t reserved29_31 :
+        (32-29);
     }
     b;
 } OPEN_USB_EPx_TX_CTRL_TypeDef;
@@ -192,6 +261,64 @@ typedef union _OPEN_USB_EPx_STS_TypeDef{
     b;
 } OPEN_USB_EPx_STS_TypeDef;
 
+//-----------------------------------------------------------------
+// USB_EPx_LEVEL
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_EPx_LEVEL_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t rx_level :        // bytes in rx fifo
+        11;
+        uint32_t reserved11_15 :
+        5;
+        uint32_t tx_level :        // bytes in tx fifo
+        11;
+        uint32_t reserved27_31 :
+        (32-27);
+    }
+    b;
+} OPEN_USB_EPx_LEVEL_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_EPx_THR
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_EPx_THR_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t rx_thr :          // rx_lvl while rx_level > rx_thr
+        11;
+        uint32_t reserved11_15 :
+        5;
+        uint32_t tx_thr :          // tx_lvl while tx_level < tx_thr
+        11;
+        uint32_t reserved27_31 :
+        (32-27);
+    }
+    b;
+} OPEN_USB_EPx_THR_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_EP_SUMMARY (one endpoint, half of the register)
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_EP_SUMMARY_TypeDef{
+    uint16_t d16;
+    struct {
+        uint16_t rx_count :
+        11;
+        uint16_t rx_ready :
+        1;
+        uint16_t rx_setup :
+        1;
+        uint16_t rx_err :
+        1;
+        uint16_t tx_busy :
+        1;
+        uint16_t tx_err :
+        1;
+    }
+    b;
+} OPEN_USB_EP_SUMMARY_TypeDef;
+
 //-----------------------------------------------------------------
 // USB_EP_INTSTS
 //-----------------------------------------------------------------
@@ -225,5 +352,221 @@ typedef union _OPEN_USB_EP_INTSTS_TypeDef{
     b;
 } OPEN_USB_EP_INTSTS_TypeDef;
 
+//-----------------------------------------------------------------
+// USB_EP_NAKSTS
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_EP_NAKSTS_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t ep0_in_nak :      // W1C
+        1;
+        uint32_t ep1_in_nak :      // W1C
+        1;
+        uint32_t ep2_in_nak :      // W1C
+        1;
+        uint32_t ep3_in_nak :      // W1C
+        1;
+        
+        uint32_t reserved4_15 :
+        (16-4);
+
+        uint32_t ep0_out_nak :     // W1C
+        1;
+        uint32_t ep1_out_nak :     // W1C
+        1;
+        uint32_t ep2_out_nak :     // W1C
+        1;
+        uint32_t ep3_out_nak :     // W1C
+        1;
+
+        uint32_t reserved20_31 :
+        (32-20);
+    }
+    b;
+} OPEN_USB_EP_NAKSTS_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_EP_LVLSTS
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_EP_LVLSTS_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t ep0_tx_lvl :      // RO, follows the level
+        1;
+        uint32_t ep1_tx_lvl :
+        1;
+        uint32_t ep2_tx_lvl :
+        1;
+        uint32_t ep3_tx_lvl :
+        1;
+        
+        uint32_t reserved4_15 :
+        (16-4);
+
+        uint32_t ep0_rx_lvl :      // RO, follows the level
+        1;
+        uint32_t ep1_rx_lvl :
+        1;
+        uint32_t ep2_rx_lvl :
+        1;
+        uint32_t ep3_rx_lvl :
+        1;
+
+        uint32_t reserved20_31 :
+        (32-20);
+    }
+    b;
+} OPEN_USB_EP_LVLSTS_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_NAK_CTRL
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_NAK_CTRL_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t holdoff :         // phy clocks
+        16;
+        uint32_t reserved16_31 :
+        (32-16);
+    }
+    b;
+} OPEN_USB_NAK_CTRL_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_SOF_CTRL
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_SOF_CTRL_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t sof_div :         // sof int every (sof_div+1) frames
+        8;
+        uint32_t meas_win :        // average over 2^meas_win frames
+        4;
+        uint32_t reserved12_15 :
+        4;
+        uint32_t presof_lead :     // phy clocks
+        16;
+    }
+    b;
+} OPEN_USB_SOF_CTRL_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_SOF_PERIOD
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_SOF_PERIOD_TypeDef{
+    uint32_t d32;                  // phy clocks, 16.16 fixed point
+    struct {
+        uint32_t frac :
+        16;
+        uint32_t integer :
+        16;
+    }
+    b;
+} OPEN_USB_SOF_PERIOD_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_RST_CTRL
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_RST_CTRL_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t flush :           // flush fifos, drop pending rx/tx
+        1;
+        uint32_t clr_stall :
+        1;
+        uint32_t clr_addr :
+        1;
+        uint32_t reserved3_31 :
+        (32-3);
+    }
+    b;
+} OPEN_USB_RST_CTRL_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_TRACE_CTRL
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_TRACE_CTRL_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t en :              // rising edge restarts the capture
+        1;
+        uint32_t trig_en :
+        1;
+        uint32_t reserved2_3 :
+        2;
+        uint32_t trig_pid :        // low nibble of the pid
+        4;
+        uint32_t reserved8_10 :
+        3;
+        uint32_t trig_ep_en :
+        1;
+        uint32_t trig_ep :
+        4;
+        uint32_t post :            // records kept after the trigger
+        8;
+        uint32_t reserved24_31 :
+        8;
+    }
+    b;
+} OPEN_USB_TRACE_CTRL_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_TRACE_FILT
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_TRACE_FILT_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t pid_mask :
+        16;
+        uint32_t ep_mask :
+        16;
+    }
+    b;
+} OPEN_USB_TRACE_FILT_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_TRACE_STS
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_TRACE_STS_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t wptr :
+        16;
+        uint32_t wrap :
+        1;
+        uint32_t triggered :
+        1;
+        uint32_t stopped :
+        1;
+        uint32_t reserved19_31 :
+        13;
+    }
+    b;
+} OPEN_USB_TRACE_STS_TypeDef;
+
+//-----------------------------------------------------------------
+// USB_TRACE_DATA0
+//-----------------------------------------------------------------
+typedef union _OPEN_USB_TRACE_DATA0_TypeDef{
+    uint32_t d32;
+    struct {
+        uint32_t len :             // frame number for SOF
+        11;
+        uint32_t reserved11_15 :
+        5;
+        uint32_t ep :
+        4;
+        uint32_t reserved20_25 :
+        6;
+        uint32_t crc_err :
+        1;
+        uint32_t dir :             // 1: sent by the device
+        1;
+        uint32_t pid :             // 0: usb reset
+        4;
+    }
+    b;
+} OPEN_USB_TRACE_DATA0_TypeDef;
+
 
 #endif
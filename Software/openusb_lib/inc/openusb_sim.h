@@ -0,0 +1,91 @@
+#ifndef __OPENUSB_SIM_H__
+#define __OPENUSB_SIM_H__
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------
+// Register level simulator of the controller, the register backend
+// of openusb_lib with OPENUSB_SIM. Each register access is one tick
+// of the simulated time, the scripted host runs its transactions and
+// the device interrupt is taken between the accesses.
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+// host transfer type
+#define SIM_XFER_RESET          0
+#define SIM_XFER_SETUP          1
+#define SIM_XFER_OUT            2
+#define SIM_XFER_IN             3
+
+// host transfer status
+#define SIM_XFER_PENDING        0
+#define SIM_XFER_DONE           1
+#define SIM_XFER_STALL          2
+#define SIM_XFER_TIMEOUT        3
+
+#ifndef SIM_HOST_GAP
+    #define SIM_HOST_GAP        4       // ticks between two host transactions
+#endif
+#ifndef SIM_SYNC_TICKS
+    #define SIM_SYNC_TICKS      2       // ticks of tx start to reach the SIE,
+                                        // and of tx busy to be read back
+#endif
+#ifndef SIM_HOST_NAK_LIMIT
+    #define SIM_HOST_NAK_LIMIT  100000  // NAKs before a transfer times out
+#endif
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+// A transfer of the host, split into max packet size transactions.
+// OUT: len bytes from buf, a ZLP if len is 0
+// IN : up to len bytes into buf, ends on a short packet
+typedef struct _OPEN_USB_SIM_XFER_TypeDef
+{
+    uint8_t     type;
+    uint8_t     ep;
+    uint16_t    len;
+    uint8_t    *buf;
+    uint16_t    actual;
+    uint8_t     status;
+    uint32_t    naks;
+    struct _OPEN_USB_SIM_XFER_TypeDef *next;
+} OPEN_USB_SIM_XFER_TypeDef;
+
+typedef struct _OPEN_USB_SIM_STATS_TypeDef
+{
+    uint32_t    ticks;
+    uint32_t    reads;
+    uint32_t    writes;
+    uint32_t    data_reads;
+    uint32_t    data_writes;
+    uint32_t    irqs;
+    uint32_t    naks;
+    uint32_t    packets;
+} OPEN_USB_SIM_STATS_TypeDef;
+
+//-----------------------------------------------------------------
+// Register backend
+//-----------------------------------------------------------------
+uint32_t openusb_sim_read(uint32_t addr);
+void openusb_sim_write(uint32_t addr, uint32_t wdata);
+void openusb_sim_delay_us(uint32_t us);
+
+//-----------------------------------------------------------------
+// Simulator
+//-----------------------------------------------------------------
+void openusb_sim_init(void);
+void openusb_sim_set_isr(void (*isr)(void));
+void openusb_sim_set_sof(uint32_t ticks);
+void openusb_sim_tick(void);
+void openusb_sim_get_stats(OPEN_USB_SIM_STATS_TypeDef *stats);
+
+//-----------------------------------------------------------------
+// Scripted host
+//-----------------------------------------------------------------
+void openusb_sim_host_submit(OPEN_USB_SIM_XFER_TypeDef *xfer, uint8_t type, uint8_t ep, uint8_t *buf, uint16_t len);
+int openusb_sim_host_idle(void);
+
+#endif
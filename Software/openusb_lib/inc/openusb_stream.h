@@ -0,0 +1,48 @@
+#ifndef __OPENUSB_STREAM_H__
+#define __OPENUSB_STREAM_H__
+
+#include <stdint.h>
+
+//-----------------------------------------------------------------
+// Ring buffer streaming on bulk endpoints. The interrupt top half
+// moves the packets between the endpoint FIFO and the ring, the
+// application reads and writes the ring in place:
+//   RX: openusb_stream_rx_peek / openusb_stream_rx_release
+//   TX: openusb_stream_tx_reserve / openusb_stream_tx_commit
+// An OUT packet is accepted only when the rx ring has space for it,
+// until then the hardware NAKs the host.
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+// Byte ring, size is a power of 2. head is written by the producer
+// only and tail by the consumer only, both run freely.
+typedef struct _OPEN_USB_RING_TypeDef
+{
+    uint8_t            *buf;
+    uint32_t            size;
+    volatile uint32_t   head;
+    volatile uint32_t   tail;
+} OPEN_USB_RING_TypeDef;
+
+//-----------------------------------------------------------------
+// Application
+//-----------------------------------------------------------------
+int openusb_stream_rx_open(uint8_t endpoint, uint8_t *buf, uint32_t size);
+int openusb_stream_tx_open(uint8_t endpoint, uint8_t *buf, uint32_t size);
+void openusb_stream_close(uint8_t endpoint);
+
+uint8_t *openusb_stream_rx_peek(uint8_t endpoint, uint32_t *len);
+void openusb_stream_rx_release(uint8_t endpoint, uint32_t len);
+uint8_t *openusb_stream_tx_reserve(uint8_t endpoint, uint32_t *len);
+void openusb_stream_tx_commit(uint8_t endpoint, uint32_t len);
+
+//-----------------------------------------------------------------
+// Library, called by openusb_isr_top and on bus reset
+//-----------------------------------------------------------------
+int openusb_stream_isr_rx(uint8_t endpoint, uint16_t len);
+int openusb_stream_isr_tx(uint8_t endpoint);
+void openusb_stream_reset(void);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef __OPENUSB_VENDOR_H__
+#define __OPENUSB_VENDOR_H__
+
+#include "openusb_common.h"
+#include "openusb_defs.h"
+#include "openusb_device.h"
+
+//-----------------------------------------------------------------
+// Vendor specific bulk streaming class (DEV_CLASS_VENDOR_CUSTOM),
+// one bulk IN and one bulk OUT pipe. Between START and STOP the IN
+// pipe streams the data of the produce callback in transfers of the
+// framing length, two requests in turn: one is refilled while the
+// other is on the bus. OUT transfers go to the consume callback.
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#ifndef VENDOR_ENDPOINT_BULK_OUT
+    #define VENDOR_ENDPOINT_BULK_OUT    1
+#endif
+#ifndef VENDOR_ENDPOINT_BULK_IN
+    #define VENDOR_ENDPOINT_BULK_IN     2
+#endif
+#define VENDOR_ENDPOINT_MASK            ((1 << VENDOR_ENDPOINT_BULK_OUT) | (1 << VENDOR_ENDPOINT_BULK_IN))
+#define VENDOR_INTERFACE                0
+
+// vendor requests to the interface
+#define VENDOR_REQ_START                0x01    // no data, clears the stats
+#define VENDOR_REQ_STOP                 0x02    // no data
+#define VENDOR_REQ_GET_STATS            0x03    // IN, USB_VENDOR_STATS_TypeDef (le32 fields)
+#define VENDOR_REQ_SET_FRAMING          0x04    // OUT, le32 transfer length + ZLP flag byte
+
+#define VENDOR_STATS_LEN                20
+#define VENDOR_FRAMING_LEN              5
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+// fills up to len bytes of buf, returns the count, 0 if no data now
+typedef uint32_t (*USB_VENDOR_PRODUCE)(uint8_t *buf, uint32_t len);
+// an OUT transfer of len bytes
+typedef void     (*USB_VENDOR_CONSUME)(uint8_t *buf, uint32_t len);
+
+typedef struct _USB_VENDOR_CONFIG_TypeDef
+{
+    uint8_t            *in_buf[2];      // IN transfers, used in turn
+    uint32_t            in_size;        // size of each in_buf
+    uint8_t            *out_buf;        // OUT transfers, 0 for no OUT
+    uint32_t            out_size;
+    USB_VENDOR_PRODUCE  produce;
+    USB_VENDOR_CONSUME  consume;
+} USB_VENDOR_CONFIG_TypeDef;
+
+typedef struct _USB_VENDOR_STATS_TypeDef
+{
+    uint32_t            in_bytes;
+    uint32_t            in_xfers;
+    uint32_t            out_bytes;
+    uint32_t            out_xfers;
+    uint32_t            underruns;      // produce had no data for a free buffer
+} USB_VENDOR_STATS_TypeDef;
+
+// class driver, usbf_register_class(&usb_vendor_driver, VENDOR_INTERFACE,
+// 1, VENDOR_ENDPOINT_MASK)
+extern const USB_CLASS_DRIVER_TypeDef usb_vendor_driver;
+
+void usb_vendor_config(const USB_VENDOR_CONFIG_TypeDef *cfg);
+void usb_vendor_set_framing(uint32_t xfer_len, uint8_t zlp);
+void usb_vendor_start(void);
+void usb_vendor_stop(void);
+void usb_vendor_kick(void);
+void usb_vendor_get_stats(USB_VENDOR_STATS_TypeDef *stats);
+
+#endif
@@ -1,11 +1,88 @@
 
 #include "openusb_cdc.h"
+#include "openusb_ep.h"
 
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define CDC_EP_IN               (CDC_ENDPOINT_BULK_IN | ENDPOINT_DIR_IN)
 
 //-----------------------------------------------------------------
 // Locals:
 //-----------------------------------------------------------------
 static unsigned char _line_coding[7];
+static uint8_t _dtr;                // terminal open
+
+// TX coalescing, _tx_fill is filled while the other is on the bus
+static uint8_t  _tx_buf[2][CDC_TX_BUF_SIZE];
+static OPEN_USB_REQ_TypeDef _req_tx[2];
+static uint8_t  _tx_fill;
+static uint32_t _tx_len;            // bytes in _tx_fill
+static uint8_t  _tx_busy;           // a transfer is on the bus
+static uint8_t  _tx_zlp;            // the last transfer ended with a full packet
+static uint8_t  _tx_flush;          // usb_cdc_flush while busy
+static uint16_t _tx_frames;         // SOFs with data waiting
+static uint16_t _sof_frame;         // frame number of the last SOF
+static uint16_t _flush_frames = CDC_TX_FLUSH_FRAMES;
+
+static void cdc_tx_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+
+//-----------------------------------------------------------------
+// cdc_tx_submit: queue the full packets of the fill buffer, or all
+// of it (a ZLP if nothing is left to end the host read). The rest
+// moves to the other buffer, which is filled next.
+//-----------------------------------------------------------------
+static void cdc_tx_submit(int all)
+{
+    OPEN_USB_REQ_TypeDef *req = &_req_tx[_tx_fill];
+    uint16_t max_packet = openusb_get_max_packet(CDC_ENDPOINT_BULK_IN);
+    uint32_t len = all ? _tx_len : _tx_len - _tx_len % max_packet;
+
+    if (_tx_busy || (!len && !(all && _tx_zlp)))
+        return;
+
+    req->buf = _tx_buf[_tx_fill];
+    req->len = len;
+    req->zlp = all;
+    req->complete = cdc_tx_done;
+
+    _tx_busy = 1;
+    _tx_zlp = !all;
+    _tx_flush = 0;
+    _tx_frames = 0;
+
+    memcpy(_tx_buf[_tx_fill ^ 1], &_tx_buf[_tx_fill][len], _tx_len - len);
+    _tx_len -= len;
+    _tx_fill ^= 1;
+
+    openusb_ep_queue(CDC_EP_IN, req);
+}
+//-----------------------------------------------------------------
+// cdc_tx_done: the transfer is on the host, send what gathered
+//-----------------------------------------------------------------
+static void cdc_tx_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    _tx_busy = 0;
+
+    if (req->status != OPENUSB_REQ_DONE)
+        return;
+
+    cdc_tx_submit(_tx_flush);
+}
+//-----------------------------------------------------------------
+// cdc_tx_abort: drop the output
+//-----------------------------------------------------------------
+static void cdc_tx_abort(void)
+{
+    openusb_ep_dequeue(CDC_EP_IN, &_req_tx[0]);
+    openusb_ep_dequeue(CDC_EP_IN, &_req_tx[1]);
+
+    _tx_busy = 0;
+    _tx_len = 0;
+    _tx_zlp = 0;
+    _tx_flush = 0;
+    _tx_frames = 0;
+}
 
 //-----------------------------------------------------------------
 // cdc_set_line_coding:
@@ -31,10 +108,15 @@ static void cdc_get_line_coding(unsigned short wLength)
 //-----------------------------------------------------------------
 // cdc_set_control_line_state:
 //-----------------------------------------------------------------
-static void cdc_set_control_line_state(void)
+static void cdc_set_control_line_state(unsigned short wValue)
 {
-    DEBUG_INFO("CDC: Set Control Line State\n");
+    DEBUG_INFO("CDC: Set Control Line State %x\n", wValue);
     openusb_control_endpoint_send_status();
+
+    // DTR, no terminal reads the output without it
+    _dtr = wValue & 0x01;
+    if (!_dtr)
+        cdc_tx_abort();
 }
 //-----------------------------------------------------------------
 // cdc_send_break:
@@ -85,7 +167,7 @@ void usb_cdc_process_request(unsigned char req, unsigned short wValue, unsigned
         break;
     case CDC_SET_CONTROL_LINE_STATE:
         DEBUG_INFO("CDC: Set line state\n");
-        cdc_set_control_line_state();
+        cdc_set_control_line_state(wValue);
         break;
     case CDC_SEND_BREAK:
         DEBUG_INFO("CDC: Send break\n");
@@ -98,6 +180,19 @@ void usb_cdc_process_request(unsigned char req, unsigned short wValue, unsigned
     }
 }
 //-----------------------------------------------------------------
+// cdc_setup: class requests of the CDC interfaces
+//-----------------------------------------------------------------
+static void cdc_setup(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
+{
+    if ( (request->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_CLASS_REQUEST )
+    {
+        openusb_control_endpoint_stall();
+        return;
+    }
+
+    usb_cdc_process_request(request->bRequest, request->wValue, request->wIndex, data, request->wLength);
+}
+//-----------------------------------------------------------------
 // usb_cdc_init:
 //-----------------------------------------------------------------
 void usb_cdc_init(void)
@@ -109,4 +204,100 @@ void usb_cdc_init(void)
     _line_coding[4] = 0;             // stop bit #2
     _line_coding[5] = 0;             // parity
     _line_coding[6] = 8;             // data bits
+
+    // the bus reset completed the requests
+    _dtr = 0;
+    _tx_busy = 0;
+    _tx_len = 0;
+    _tx_zlp = 0;
+    _tx_flush = 0;
+    _tx_frames = 0;
+}
+//-----------------------------------------------------------------
+// cdc_set_config:
+//-----------------------------------------------------------------
+static void cdc_set_config(unsigned char config)
+{
+    _dtr = 0;
+    cdc_tx_abort();
+}
+//-----------------------------------------------------------------
+// cdc_sof: send the data waiting for _flush_frames SOFs. SOF events
+// merge while pending, the frame number counts the ones missed.
+//-----------------------------------------------------------------
+static void cdc_sof(uint16_t frame)
+{
+    uint16_t n = (frame - _sof_frame) & 0x7FF;
+
+    _sof_frame = frame;
+
+    if ((_tx_len || _tx_zlp) && _flush_frames) {
+        _tx_frames += n ? n : 1;
+        if (_tx_frames >= _flush_frames)
+            usb_cdc_flush();
+    }
+}
+//-----------------------------------------------------------------
+// usb_cdc_driver: the data stage requests go to cdc_setup as well
+//-----------------------------------------------------------------
+const USB_CLASS_DRIVER_TypeDef usb_cdc_driver =
+{
+    usb_cdc_init,       // init
+    cdc_setup,          // setup
+    0,                  // data
+    cdc_set_config,     // set_config
+    0,                  // set_interface
+    0,                  // ep_event
+    cdc_sof             // sof
+};
+//-----------------------------------------------------------------
+// usb_cdc_write: bytes taken, less than len when both buffers are
+// in use. All is taken (and dropped) without DTR.
+//-----------------------------------------------------------------
+uint32_t usb_cdc_write(const uint8_t *buf, uint32_t len)
+{
+    uint32_t n, done = 0;
+
+    if (!_dtr || !openusb_is_configured())
+        return len;
+
+    while (done < len) {
+        n = MIN(len - done, CDC_TX_BUF_SIZE - _tx_len);
+        if (!n)
+            break;
+
+        memcpy(&_tx_buf[_tx_fill][_tx_len], buf + done, n);
+        _tx_len += n;
+        done += n;
+
+        // full packets go now if the bus is free, else on tx done
+        cdc_tx_submit(0);
+    }
+
+    return done;
+}
+//-----------------------------------------------------------------
+// usb_cdc_flush: send all written data, a short packet ends it
+//-----------------------------------------------------------------
+void usb_cdc_flush(void)
+{
+    if (_tx_busy)
+        _tx_flush = 1;
+    else
+        cdc_tx_submit(1);
+}
+//-----------------------------------------------------------------
+// usb_cdc_set_flush_frames: SOFs before the data of an unfilled
+// packet is sent, 0 for usb_cdc_flush only
+//-----------------------------------------------------------------
+void usb_cdc_set_flush_frames(uint16_t frames)
+{
+    _flush_frames = frames;
+}
+//-----------------------------------------------------------------
+// usb_cdc_dtr:
+//-----------------------------------------------------------------
+int usb_cdc_dtr(void)
+{
+    return _dtr;
 }
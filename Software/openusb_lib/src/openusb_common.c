@@ -1,17 +1,67 @@
 #include "openusb_common.h"
+#include "openusb_stream.h"
+#include "openusb_ep.h"
 
 //-----------------------------------------------------------------
 // Locals:
 //-----------------------------------------------------------------
 static int _endpoint_stalled[USB_FUNC_ENDPOINTS];
+static int _endpoint_auto_accept[USB_FUNC_ENDPOINTS];
+static int _endpoint_rx_accepted[USB_FUNC_ENDPOINTS];
+// INT_RX of the OUT / INT_TX of the IN endpoint before the loopback
+static uint8_t _loopback_int_rx[USB_FUNC_ENDPOINTS];
+static uint8_t _loopback_int_tx[USB_FUNC_ENDPOINTS];
 static int _addressed;
 static int _configured;
 static int _attached;
 static FUNC_PTR _func_bus_reset;
 static FUNC_PTR _func_setup;
 static FUNC_PTR _func_ctrl_out;
+static FUNC_PTR _func_ctrl_in;
 static unsigned int _usb_base;
-
+static OPEN_USB_TX_XFER_TypeDef _tx_xfer[USB_FUNC_ENDPOINTS];
+// bumped when the tx data of the endpoint is dropped, a tx complete
+// event of an older sequence is of a dropped packet
+static volatile uint8_t _tx_seq[USB_FUNC_ENDPOINTS];
+static volatile uint8_t _tx_pending[USB_FUNC_ENDPOINTS];
+static uint16_t _tx_min[USB_FUNC_ENDPOINTS];
+static const uint16_t _ep_max_packet[USB_FUNC_ENDPOINTS] = {
+    EP0_MAX_PACKET_SIZE, EP1_MAX_PACKET_SIZE, EP2_MAX_PACKET_SIZE, EP3_MAX_PACKET_SIZE
+};
+
+// pending events, single producer (openusb_isr_top) single consumer
+// (openusb_poll_events): the top half counts the events of each type
+// and endpoint in _ev_set, the bottom half the counts it dispatched in
+// _ev_taken. An event is pending while the two differ, so events of
+// one kind merge while pending and none is lost.
+static volatile uint8_t  _ev_set[OPENUSB_EV_NUM][USB_FUNC_ENDPOINTS];
+static uint8_t           _ev_taken[OPENUSB_EV_NUM][USB_FUNC_ENDPOINTS];
+static volatile uint16_t _ev_len[USB_FUNC_ENDPOINTS];   // RX_READY
+static volatile uint8_t  _ev_setup[USB_FUNC_ENDPOINTS]; // RX_READY
+static volatile uint8_t  _ev_seq[USB_FUNC_ENDPOINTS];   // TX_COMPLETE
+static volatile uint16_t _ev_frame;
+static volatile uint32_t _ev_merged;
+static OPEN_USB_EVENT_HANDLER _event_handler[OPENUSB_EV_NUM];
+
+// shadows of the firmware owned configuration registers, loaded from
+// hardware on first use, so a field update is one write
+#define SHADOW_FUNC_CTRL    0
+#define SHADOW_SOF_CTRL     1
+#define SHADOW_EP_CFG(i)    (2 + (i))
+#define SHADOW_NUM          (2 + USB_FUNC_ENDPOINTS)
+
+static uint32_t _shadow[SHADOW_NUM];
+static uint32_t _shadow_valid;
+static int _rst_clr_stall = 1;
+
+// last USB_EPi_STS read by openusb_get_ep_status
+static OPEN_USB_EPx_STS_TypeDef _ep_sts[USB_FUNC_ENDPOINTS];
+
+#ifdef OPENUSB_SIM
+void _delay_us(uint32_t us) { openusb_sim_delay_us(us); }
+
+void _delay_ms(uint32_t ms) { openusb_sim_delay_us(ms * 1000); }
+#else
 void _delay_us(uint32_t us)
 {
     uint32_t i = us;
@@ -35,11 +85,53 @@ void _delay_ms(uint32_t ms)
         }
     }
 }
+#endif
 
 void openusb_delay_us(uint32_t i) { _delay_us(i); }
 
 void openusb_delay_ms(uint32_t i) { _delay_ms(i); }
 
+//-----------------------------------------------------------------
+// shadow_get / shadow_set: register through its shadow
+//-----------------------------------------------------------------
+static uint32_t shadow_get(uint32_t idx, uint32_t addr)
+{
+    if (!(_shadow_valid & (1u << idx))) {
+        _shadow[idx] = OPEN_USB_READ_REG(addr);
+        _shadow_valid |= (1u << idx);
+    }
+
+    return _shadow[idx];
+}
+
+static void shadow_set(uint32_t idx, uint32_t addr, uint32_t d32)
+{
+    _shadow[idx] = d32;
+    _shadow_valid |= (1u << idx);
+    OPEN_USB_WRITE_REG(addr, d32);
+}
+
+//-----------------------------------------------------------------
+// shadow_clr_stall: STALL_EP cleared by hardware
+//-----------------------------------------------------------------
+static void shadow_clr_stall(uint8_t endpoint)
+{
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+
+    ep_cfg.d32 = _shadow[SHADOW_EP_CFG(endpoint)];
+    ep_cfg.b.stall_ep = 0;
+    _shadow[SHADOW_EP_CFG(endpoint)] = ep_cfg.d32;
+}
+
+//-----------------------------------------------------------------
+// openusb_shadow_sync: reload the register shadows from hardware, 
+// after the controller was reset or written around the library
+//-----------------------------------------------------------------
+void openusb_shadow_sync(void)
+{
+    _shadow_valid = 0;
+}
+
 //-----------------------------------------------------------------
 // openusb_attach: 0->detach; 1->attach;
 //-----------------------------------------------------------------
@@ -50,13 +142,13 @@ void openusb_attach(uint32_t state)
     if (state) {
         _attached = 1;
         // func_ctrl.d32 = 0;
-        func_ctrl.d32 = OPEN_USB_READ_REG(USB_FUNC_CTRL);
+        func_ctrl.d32 = shadow_get(SHADOW_FUNC_CTRL, USB_FUNC_CTRL);
         func_ctrl.b.phy_opmode = 0;
         func_ctrl.b.phy_xcvrselect = 1;
         func_ctrl.b.phy_termselect = 1;
         func_ctrl.b.phy_dppulldown = 0;
         func_ctrl.b.phy_dmpulldown = 0;
-        OPEN_USB_WRITE_REG(USB_FUNC_CTRL, func_ctrl.d32);
+        shadow_set(SHADOW_FUNC_CTRL, USB_FUNC_CTRL, func_ctrl.d32);
 
         func_stat.d32 = 0;
         func_stat.b.rst = 1;
@@ -68,13 +160,13 @@ void openusb_attach(uint32_t state)
         _attached = 0;
 
         // func_ctrl.d32 = 0;
-        func_ctrl.d32 = OPEN_USB_READ_REG(USB_FUNC_CTRL);
+        func_ctrl.d32 = shadow_get(SHADOW_FUNC_CTRL, USB_FUNC_CTRL);
         func_ctrl.b.phy_opmode = 1;
         func_ctrl.b.phy_xcvrselect = 0;
         func_ctrl.b.phy_termselect = 0;
         func_ctrl.b.phy_dppulldown = 0;
         func_ctrl.b.phy_dmpulldown = 0;
-        OPEN_USB_WRITE_REG(USB_FUNC_CTRL, func_ctrl.d32);
+        shadow_set(SHADOW_FUNC_CTRL, USB_FUNC_CTRL, func_ctrl.d32);
 
         // add
         func_stat.d32 = 0;
@@ -89,7 +181,7 @@ void openusb_attach(uint32_t state)
 // openusb_init
 //-----------------------------------------------------------------
 void openusb_init(unsigned int base, FUNC_PTR bus_reset, FUNC_PTR on_setup,
-                  FUNC_PTR on_out)
+                  FUNC_PTR on_out, FUNC_PTR on_in)
 {
     OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
     OPEN_USB_EPx_RX_CTRL_TypeDef ep_rx_ctrl;
@@ -119,6 +211,7 @@ void openusb_init(unsigned int base, FUNC_PTR bus_reset, FUNC_PTR on_setup,
     _func_bus_reset = bus_reset;
     _func_setup = on_setup;
     _func_ctrl_out = on_out;
+    _func_ctrl_in = on_in;
 }
 
 //-----------------------------------------------------------------
@@ -126,9 +219,7 @@ void openusb_init(unsigned int base, FUNC_PTR bus_reset, FUNC_PTR on_setup,
 //-----------------------------------------------------------------
 int openusb_is_rx_ready(uint8_t endpoint)
 {
-    OPEN_USB_EPx_STS_TypeDef ep_sts;
-    ep_sts.d32 = OPEN_USB_READ_REG(USB_EP_STS(endpoint));
-    return (ep_sts.b.rx_ready ? 1 : 0);
+    return (openusb_get_ep_status(endpoint).b.rx_ready ? 1 : 0);
 }
 
 //-----------------------------------------------------------------
@@ -136,9 +227,27 @@ int openusb_is_rx_ready(uint8_t endpoint)
 //-----------------------------------------------------------------
 int openusb_get_rx_count(uint8_t endpoint)
 {
-    OPEN_USB_EPx_STS_TypeDef ep_sts;
-    ep_sts.d32 = OPEN_USB_READ_REG(USB_EP_STS(endpoint));
-    return (ep_sts.b.rx_count);
+    return (openusb_get_ep_status(endpoint).b.rx_count);
+}
+
+//-----------------------------------------------------------------
+// openusb_get_ep_status: one read of USB_EPi_STS, kept as the 
+// snapshot of openusb_last_ep_status
+//-----------------------------------------------------------------
+OPEN_USB_EPx_STS_TypeDef openusb_get_ep_status(uint8_t endpoint)
+{
+    _ep_sts[endpoint].d32 = OPEN_USB_READ_REG(USB_EP_STS(endpoint));
+    return _ep_sts[endpoint];
+}
+
+//-----------------------------------------------------------------
+// openusb_last_ep_status: snapshot of the last openusb_get_ep_status,
+// no register access. The EP0 SETUP / OUT handlers get the status 
+// read by the service.
+//-----------------------------------------------------------------
+OPEN_USB_EPx_STS_TypeDef openusb_last_ep_status(uint8_t endpoint)
+{
+    return _ep_sts[endpoint];
 }
 
 //-----------------------------------------------------------------
@@ -155,56 +264,253 @@ uint8_t openusb_get_rx_data_byte(uint8_t endpoint)
 void openusb_clear_rx_ready_flag(uint8_t endpoint)
 {
     OPEN_USB_EPx_RX_CTRL_TypeDef ep_rx_ctrl;
+
+    // already accepted by hardware
+    if (_endpoint_rx_accepted[endpoint]) {
+        _endpoint_rx_accepted[endpoint] = 0;
+        return;
+    }
+
     ep_rx_ctrl.d32 = 0;
     ep_rx_ctrl.b.rx_accept = 1;
     OPEN_USB_WRITE_REG(USB_EP_RX_CTRL(endpoint), ep_rx_ctrl.d32);
 }
 
 //-----------------------------------------------------------------
-// openusb_tx_data tx_len<=64
+// tx_packet_start: send pkt_len bytes of the FIFO
 //-----------------------------------------------------------------
-void openusb_tx_data(uint8_t endpoint, uint8_t *tx_buffer, uint32_t tx_len)
+static void tx_packet_start(uint8_t endpoint, uint32_t pkt_len)
 {
-    OPEN_USB_EPx_STS_TypeDef ep_sts;
     OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
 
-    uint32_t len;
-    uint32_t time = 1000;
+    // set before the tx complete of the packet can clear it
+    _tx_pending[endpoint] = 1;
+    OPENUSB_BARRIER();
 
-    ep_sts.d32 = 0;
     ep_tx_ctrl.d32 = 0;
+    ep_tx_ctrl.b.tx_start = 1;
+    ep_tx_ctrl.b.tx_len = pkt_len;
+    ep_tx_ctrl.b.tx_min = _tx_min[endpoint];
+    OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(endpoint), ep_tx_ctrl.d32);
 
-    if (tx_len > 64)
-        tx_len = 64; // TODO
-
-    for (len = 0; len < tx_len; len++) {
-        // wait until space available
-        ep_sts.d32 = OPEN_USB_READ_REG(USB_EP_STS(endpoint));
-        while (ep_sts.b.tx_busy) {
-            ep_sts.d32 = OPEN_USB_READ_REG(USB_EP_STS(endpoint));
-            DEBUG_INFO("USB: Tx busy...\n");
-            time--;
-            if (time == 10) {
-                ep_tx_ctrl.d32 = 0;
-                ep_tx_ctrl.b.tx_flush = 1;
-                OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(endpoint), ep_tx_ctrl.d32);
-
-                break;
-            }
+    _tx_xfer[endpoint].inflight = pkt_len;
+}
+
+//-----------------------------------------------------------------
+// tx_packet_done: the packet started last is sent. Tx busy can not
+// tell, it rises a few clocks after the tx start (usb clock sync).
+// Without the tx interrupt, the latched tx complete is taken here.
+//-----------------------------------------------------------------
+static int tx_packet_done(uint8_t endpoint)
+{
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+    uint32_t bit = 1u << (16 + endpoint);
+
+    if (!_tx_pending[endpoint])
+        return 1;
+
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
+    if (!ep_cfg.b.int_tx && (OPEN_USB_READ_REG(USB_EP_INTSTS) & bit)) {
+        OPEN_USB_WRITE_REG(USB_EP_INTSTS, bit);
+        _tx_pending[endpoint] = 0;
+    }
+
+    return !_tx_pending[endpoint];
+}
+
+//-----------------------------------------------------------------
+// openusb_tx_begin: start a transfer of len bytes on the endpoint,
+// split into max packet size packets. A full last packet is followed
+// by a ZLP if zlp, len 0 sends one ZLP. Returns as
+// openusb_tx_continue, -1 if a transfer is still being loaded.
+//-----------------------------------------------------------------
+int openusb_tx_begin(uint8_t endpoint, uint8_t *tx_buffer, uint32_t tx_len, uint8_t zlp)
+{
+    OPEN_USB_TX_XFER_TypeDef *xfer = &_tx_xfer[endpoint];
+
+    if (xfer->active)
+        return -1;
+
+    xfer->buf    = tx_buffer;
+    xfer->len    = tx_len;
+    xfer->pos    = 0;
+    xfer->sent   = 0;
+    xfer->zlp    = zlp;
+    xfer->last   = 0;
+    xfer->unseen = 0;
+    xfer->active = 1;
+
+    return openusb_tx_continue(endpoint);
+}
+
+//-----------------------------------------------------------------
+// tx_fifo_write: write the next n bytes of the transfer to the FIFO
+//-----------------------------------------------------------------
+static void tx_fifo_write(uint8_t endpoint, OPEN_USB_TX_XFER_TypeDef *xfer, uint32_t n)
+{
+    // the level crosses the clock domains, it may not show these
+    // writes at the next step yet
+    xfer->unseen = n;
+
+    for (; n; n--)
+        OPEN_USB_WRITE_REG(USB_EP_DATA(endpoint), xfer->buf[xfer->pos++]);
+}
+
+//-----------------------------------------------------------------
+// openusb_tx_continue: non-blocking step of the transfer, at most one
+// packet of FIFO writes. While a packet is in flight, the next one
+// is loaded behind it as far as the FIFO has room, and started as
+// soon as its tx complete is seen. With a tx min, a packet is started
+// with what fits in the FIFO and the rest is written as the FIFO
+// drains. Returns 1 while in progress, 0 when the last packet is
+// started and written.
+//-----------------------------------------------------------------
+int openusb_tx_continue(uint8_t endpoint)
+{
+    OPEN_USB_TX_XFER_TypeDef *xfer = &_tx_xfer[endpoint];
+    uint32_t mps = _ep_max_packet[endpoint];
+    uint32_t pkt_len;
+    uint32_t used;
+    uint32_t n;
+    int busy;
+
+    if (!xfer->active)
+        return 0;
+
+    busy = !tx_packet_done(endpoint);
+
+    if (xfer->pos < xfer->sent) {
+        // the started packet went out before all of it was written
+        if (!busy) {
+            DEBUG_INFO("USB: Tx underrun, flush EP%d\n", endpoint);
+            openusb_flush_tx(endpoint);
+            return 0;
+        }
+
+        // the rest of the started packet, as far as the FIFO has room
+        used = openusb_get_tx_level(endpoint) + xfer->unseen;
+        n = (used < USB_FIFO_DEPTH) ? MIN(xfer->sent - xfer->pos, USB_FIFO_DEPTH - used) : 0;
+        tx_fifo_write(endpoint, xfer, n);
+    } else {
+        // length of the next packet, the FIFO already holds pos - sent
+        pkt_len = MIN(xfer->len - xfer->sent, mps);
+        n = xfer->sent + pkt_len - xfer->pos;
+
+        if (busy) {
+            used = xfer->inflight + (xfer->pos - xfer->sent);
+            n = (used < USB_FIFO_DEPTH) ? MIN(n, USB_FIFO_DEPTH - used) : 0;
+        } else if (_tx_min[endpoint]) {
+            n = MIN(n, USB_FIFO_DEPTH - (xfer->pos - xfer->sent));
         }
 
-        // load data to fifo
-        OPEN_USB_WRITE_REG(USB_EP_DATA(endpoint), *(tx_buffer + len));
+        tx_fifo_write(endpoint, xfer, n);
+
+        if (busy)
+            return 1;
+
+        tx_packet_start(endpoint, pkt_len);
+        xfer->sent += pkt_len;
+
+        // a short packet ends the transfer, a full one only without zlp
+        xfer->last = (pkt_len < mps || (xfer->sent == xfer->len && !xfer->zlp));
     }
 
-    // tx the data
-    ep_tx_ctrl.b.tx_start = 1;
-    ep_tx_ctrl.b.tx_len = tx_len;
+    if (xfer->last && xfer->pos == xfer->sent) {
+        xfer->active = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+//-----------------------------------------------------------------
+// openusb_set_tx_min: TX_MIN of the packets the library starts. The
+// IN tokens are NAKed until the FIFO holds min(packet, tx_min) bytes,
+// so a packet larger than the FIFO can be started before all of it
+// is written. tx_min must let the CPU write the rest before the SIE
+// runs out of data, 0 starts a packet once it is all in the FIFO.
+//-----------------------------------------------------------------
+void openusb_set_tx_min(uint8_t endpoint, uint16_t tx_min)
+{
+    _tx_min[endpoint] = MIN(tx_min, USB_FIFO_DEPTH);
+}
+
+//-----------------------------------------------------------------
+// openusb_tx_data: blocking transfer without ZLP, returns the number
+// of bytes handed to the hardware. If a packet is not sent within
+// USB_TX_TIMEOUT polls the endpoint is flushed and the rest dropped.
+//-----------------------------------------------------------------
+uint32_t openusb_tx_data(uint8_t endpoint, uint8_t *tx_buffer, uint32_t tx_len)
+{
+    OPEN_USB_TX_XFER_TypeDef *xfer = &_tx_xfer[endpoint];
+    uint32_t time = USB_TX_TIMEOUT;
+    uint32_t sent = 0;
+    uint32_t pos = 0;
+
+    // not mixed with a transfer of openusb_tx_begin
+    if (openusb_tx_begin(endpoint, tx_buffer, tx_len, 0) < 0)
+        return 0;
+
+    while (xfer->active) {
+        if (xfer->sent != sent || xfer->pos != pos) {
+            sent = xfer->sent;
+            pos = xfer->pos;
+            time = USB_TX_TIMEOUT;
+        }
+
+        if (!time--) {
+            DEBUG_INFO("USB: Tx timeout, flush EP%d\n", endpoint);
+            openusb_flush_tx(endpoint);
+            break;
+        }
+
+        openusb_tx_continue(endpoint);
+    }
+
+    return xfer->sent;
+}
+
+//-----------------------------------------------------------------
+// openusb_get_max_packet: max packet size of the endpoint
+//-----------------------------------------------------------------
+uint16_t openusb_get_max_packet(uint8_t endpoint)
+{
+    return _ep_max_packet[endpoint];
+}
+
+//-----------------------------------------------------------------
+// openusb_flush_tx: drop the tx data and the tx start of the endpoint.
+// A tx complete of the dropped packet latched before is cleared, one
+// already taken by the interrupt has the old tx sequence.
+//-----------------------------------------------------------------
+void openusb_flush_tx(uint8_t endpoint)
+{
+    OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
+
+    _tx_xfer[endpoint].active = 0;
+    _tx_xfer[endpoint].inflight = 0;
+    _tx_pending[endpoint] = 0;
+
+    ep_tx_ctrl.d32 = 0;
+    ep_tx_ctrl.b.tx_flush = 1;
     OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(endpoint), ep_tx_ctrl.d32);
+    OPEN_USB_WRITE_REG(USB_EP_INTSTS, 1u << (16 + endpoint));
+
+    OPENUSB_BARRIER();
+    _tx_seq[endpoint]++;
 }
 
 //-----------------------------------------------------------------
-// openusb_enable_int
+// openusb_get_tx_seq: tx sequence of the endpoint, the seq of the tx
+// complete events of the packets started since the last flush
+//-----------------------------------------------------------------
+uint8_t openusb_get_tx_seq(uint8_t endpoint)
+{
+    return _tx_seq[endpoint];
+}
+
+//-----------------------------------------------------------------
+// openusb_enable_int: ep0 tx complete drives the control transfers
 //-----------------------------------------------------------------
 void openusb_enable_int(uint8_t en_rst, uint8_t en_sof)
 {
@@ -214,21 +520,348 @@ void openusb_enable_int(uint8_t en_rst, uint8_t en_sof)
 
     // enable ep0-3 tx rx int
     for (i = 0; i < 4; i++) {
-        ep_cfg.d32 = OPEN_USB_READ_REG(USB_EP_CFG(i));
+        ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(i), USB_EP_CFG(i));
         ep_cfg.b.int_rx = 1;
         ep_cfg.b.int_tx = 1;
 
-        if (i == 0)
-            ep_cfg.b.int_tx = 0;
-
-        OPEN_USB_WRITE_REG(USB_EP_CFG(i), ep_cfg.d32);
+        shadow_set(SHADOW_EP_CFG(i), USB_EP_CFG(i), ep_cfg.d32);
     }
 
     // enable rst and sof int
-    func_ctrl.d32 = OPEN_USB_READ_REG(USB_FUNC_CTRL);
+    func_ctrl.d32 = shadow_get(SHADOW_FUNC_CTRL, USB_FUNC_CTRL);
     func_ctrl.b.int_en_rst = en_rst;
     func_ctrl.b.int_en_sof = en_sof;
-    OPEN_USB_WRITE_REG(USB_FUNC_CTRL, func_ctrl.d32);
+    shadow_set(SHADOW_FUNC_CTRL, USB_FUNC_CTRL, func_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_enable_nak_int: 
+// en_in : IN NAKed (no data armed) -> fill the endpoint on demand
+// en_out: OUT NAKed (rx busy)      -> drain the endpoint on demand
+//-----------------------------------------------------------------
+void openusb_enable_nak_int(uint8_t endpoint, uint8_t en_in, uint8_t en_out)
+{
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
+    ep_cfg.b.int_in_nak = en_in;
+    ep_cfg.b.int_out_nak = en_out;
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_set_fifo_thr: fifo level interrupts,
+// en_tx: tx level < tx_thr -> room for the next packet
+// en_rx: rx level > rx_thr -> data of the packet being received
+// A level status bit is latched on the crossing, write 1 to clear.
+// The thresholds are armed from ones that never hold, so a level
+// already beyond them is a crossing too.
+// A packet started with TX_MIN is held until min(TX_LEN, TX_MIN)
+// bytes are in the fifo, the SIE does not wait for data once it sends.
+// openusb_isr_top masks a level interrupt once it fired and marks an
+// OPENUSB_EV_TX_LVL / RX_LVL event, openusb_rearm_fifo_thr enables it
+// again.
+//-----------------------------------------------------------------
+static void fifo_thr_arm(uint8_t endpoint, OPEN_USB_EPx_THR_TypeDef ep_thr, uint8_t tx, uint8_t rx)
+{
+    OPEN_USB_EPx_THR_TypeDef never = ep_thr;
+
+    if (tx)
+        never.b.tx_thr = 0;
+    if (rx)
+        never.b.rx_thr = 0x7FF;
+    OPEN_USB_WRITE_REG(USB_EP_THR(endpoint), never.d32);
+    OPEN_USB_WRITE_REG(USB_EP_LVLSTS, (tx ? (1u << endpoint) : 0) | (rx ? (1u << (16 + endpoint)) : 0));
+    OPEN_USB_WRITE_REG(USB_EP_THR(endpoint), ep_thr.d32);
+}
+
+void openusb_set_fifo_thr(uint8_t endpoint, uint16_t tx_thr, uint16_t rx_thr, uint8_t en_tx, uint8_t en_rx)
+{
+    OPEN_USB_EPx_THR_TypeDef ep_thr;
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+
+    ep_thr.d32 = 0;
+    ep_thr.b.tx_thr = tx_thr;
+    ep_thr.b.rx_thr = rx_thr;
+    fifo_thr_arm(endpoint, ep_thr, 1, 1);
+
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
+    ep_cfg.b.int_tx_lvl = en_tx;
+    ep_cfg.b.int_rx_lvl = en_rx;
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_rearm_fifo_thr: enables the level interrupts masked by
+// openusb_isr_top again, with the thresholds of openusb_set_fifo_thr.
+// Called from the bottom half, e.g. the OPENUSB_EV_TX_LVL / RX_LVL
+// handler, once the fifo is served; a level still beyond the
+// threshold fires again.
+//-----------------------------------------------------------------
+void openusb_rearm_fifo_thr(uint8_t endpoint, uint8_t en_tx, uint8_t en_rx)
+{
+    OPEN_USB_EPx_THR_TypeDef ep_thr;
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+
+    ep_thr.d32 = OPEN_USB_READ_REG(USB_EP_THR(endpoint));
+    fifo_thr_arm(endpoint, ep_thr, en_tx, en_rx);
+
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
+    if (en_tx)
+        ep_cfg.b.int_tx_lvl = 1;
+    if (en_rx)
+        ep_cfg.b.int_rx_lvl = 1;
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_get_tx_level / openusb_get_rx_level: bytes in the fifo
+//-----------------------------------------------------------------
+int openusb_get_tx_level(uint8_t endpoint)
+{
+    OPEN_USB_EPx_LEVEL_TypeDef ep_level;
+
+    ep_level.d32 = OPEN_USB_READ_REG(USB_EP_LEVEL(endpoint));
+    return ep_level.b.tx_level;
+}
+
+int openusb_get_rx_level(uint8_t endpoint)
+{
+    OPEN_USB_EPx_LEVEL_TypeDef ep_level;
+
+    ep_level.d32 = OPEN_USB_READ_REG(USB_EP_LEVEL(endpoint));
+    return ep_level.b.rx_level;
+}
+
+//-----------------------------------------------------------------
+// openusb_crc_start: restart the CRC-32 of the data read from the 
+// endpoint, en=0 stops folding in
+//-----------------------------------------------------------------
+void openusb_crc_start(uint8_t endpoint, uint8_t en)
+{
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+
+    OPEN_USB_WRITE_REG(USB_EP_CRC(endpoint), 0xFFFFFFFF);
+
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
+    ep_cfg.b.crc_en = en;
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_crc_result: CRC-32 of the data read since openusb_crc_start
+//-----------------------------------------------------------------
+uint32_t openusb_crc_result(uint8_t endpoint)
+{
+    return ~OPEN_USB_READ_REG(USB_EP_CRC(endpoint));
+}
+
+//-----------------------------------------------------------------
+// openusb_set_nak_holdoff: min interval of NAK events in phy clocks
+//-----------------------------------------------------------------
+void openusb_set_nak_holdoff(uint16_t clocks)
+{
+    OPEN_USB_NAK_CTRL_TypeDef nak_ctrl;
+
+    nak_ctrl.d32 = 0;
+    nak_ctrl.b.holdoff = clocks;
+    OPEN_USB_WRITE_REG(USB_NAK_CTRL, nak_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_set_rst_ctrl: cleanup done by hardware on USB reset, all
+// enabled by default. openusb_service relies on all of them.
+//-----------------------------------------------------------------
+void openusb_set_rst_ctrl(uint8_t flush, uint8_t clr_stall, uint8_t clr_addr)
+{
+    OPEN_USB_RST_CTRL_TypeDef rst_ctrl;
+
+    rst_ctrl.d32 = 0;
+    rst_ctrl.b.flush = flush;
+    rst_ctrl.b.clr_stall = clr_stall;
+    rst_ctrl.b.clr_addr = clr_addr;
+    OPEN_USB_WRITE_REG(USB_RST_CTRL, rst_ctrl.d32);
+
+    _rst_clr_stall = clr_stall;
+}
+
+//-----------------------------------------------------------------
+// openusb_set_sof_int: 
+// sof_div    : sof int every (sof_div+1) frames
+// presof_lead: pre-sof int fires presof_lead phy clocks before the 
+//              next sof, once the frame timer is locked
+//-----------------------------------------------------------------
+void openusb_set_sof_int(uint8_t sof_div, uint16_t presof_lead, uint8_t en_presof)
+{
+    OPEN_USB_SOF_CTRL_TypeDef sof_ctrl;
+    OPEN_USB_FUNC_CTRL_TypeDef func_ctrl;
+
+    sof_ctrl.d32 = shadow_get(SHADOW_SOF_CTRL, USB_SOF_CTRL);
+    sof_ctrl.b.sof_div = sof_div;
+    sof_ctrl.b.presof_lead = presof_lead;
+    shadow_set(SHADOW_SOF_CTRL, USB_SOF_CTRL, sof_ctrl.d32);
+
+    func_ctrl.d32 = shadow_get(SHADOW_FUNC_CTRL, USB_FUNC_CTRL);
+    func_ctrl.b.int_en_presof = en_presof;
+    shadow_set(SHADOW_FUNC_CTRL, USB_FUNC_CTRL, func_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_set_sof_meas_win: average sof period over 2^win frames
+//-----------------------------------------------------------------
+void openusb_set_sof_meas_win(uint8_t win)
+{
+    OPEN_USB_SOF_CTRL_TypeDef sof_ctrl;
+
+    sof_ctrl.d32 = shadow_get(SHADOW_SOF_CTRL, USB_SOF_CTRL);
+    sof_ctrl.b.meas_win = win;
+    shadow_set(SHADOW_SOF_CTRL, USB_SOF_CTRL, sof_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_get_sof_period: average sof period in phy clocks, 16.16 
+// fixed point, 0 if not measured yet
+//-----------------------------------------------------------------
+uint32_t openusb_get_sof_period(void)
+{
+    return OPEN_USB_READ_REG(USB_SOF_PERIOD);
+}
+
+//-----------------------------------------------------------------
+// openusb_set_loopback: OUT packets of out_ep are sent on in_ep by
+// hardware. The rx int of out_ep and the tx int of in_ep are turned
+// off, software must not access the data of these endpoints.
+// Disabling restores both interrupt enables.
+//-----------------------------------------------------------------
+void openusb_set_loopback(uint8_t out_ep, uint8_t in_ep, uint8_t en)
+{
+    OPEN_USB_EPx_CFG_TypeDef out_cfg;
+    OPEN_USB_EPx_CFG_TypeDef in_cfg;
+    uint8_t lb_ep;
+
+    out_cfg.d32 = shadow_get(SHADOW_EP_CFG(out_ep), USB_EP_CFG(out_ep));
+    lb_ep = out_cfg.b.loopback_ep;
+
+    if (out_cfg.b.loopback_en) {
+        if (en && lb_ep == in_ep)
+            return;
+
+        // restore the enables saved for the loopback being removed
+        in_cfg.d32 = shadow_get(SHADOW_EP_CFG(lb_ep), USB_EP_CFG(lb_ep));
+        in_cfg.b.int_tx = _loopback_int_tx[lb_ep];
+        shadow_set(SHADOW_EP_CFG(lb_ep), USB_EP_CFG(lb_ep), in_cfg.d32);
+
+        out_cfg.b.int_rx = _loopback_int_rx[out_ep];
+        out_cfg.b.loopback_en = 0;
+        shadow_set(SHADOW_EP_CFG(out_ep), USB_EP_CFG(out_ep), out_cfg.d32);
+    }
+
+    if (!en)
+        return;
+
+    in_cfg.d32 = shadow_get(SHADOW_EP_CFG(in_ep), USB_EP_CFG(in_ep));
+    _loopback_int_tx[in_ep] = in_cfg.b.int_tx;
+    in_cfg.b.int_tx = 0;
+    shadow_set(SHADOW_EP_CFG(in_ep), USB_EP_CFG(in_ep), in_cfg.d32);
+
+    _loopback_int_rx[out_ep] = out_cfg.b.int_rx;
+    out_cfg.b.int_rx = 0;
+    out_cfg.b.loopback_ep = in_ep;
+    out_cfg.b.loopback_en = 1;
+    shadow_set(SHADOW_EP_CFG(out_ep), USB_EP_CFG(out_ep), out_cfg.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_set_auto_accept: the rx buffer is released by hardware 
+// when the whole packet is read by openusb_get_rx_data, 
+// openusb_clear_rx_ready_flag then skips the RX_ACCEPT write.
+// Zero length packets still need openusb_clear_rx_ready_flag.
+//-----------------------------------------------------------------
+void openusb_set_auto_accept(uint8_t endpoint, uint8_t en)
+{
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
+    ep_cfg.b.auto_accept = en;
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
+
+    _endpoint_auto_accept[endpoint] = en;
+    _endpoint_rx_accepted[endpoint] = 0;
+}
+
+//-----------------------------------------------------------------
+// openusb_get_ep_summary: status of all endpoints in one pass, 
+// sum[USB_FUNC_ENDPOINTS]
+//-----------------------------------------------------------------
+void openusb_get_ep_summary(OPEN_USB_EP_SUMMARY_TypeDef *sum)
+{
+    uint32_t i;
+    uint32_t d32;
+
+    for (i=0; i<USB_FUNC_ENDPOINTS; i+=2) {
+        d32 = OPEN_USB_READ_REG(USB_EP_SUMMARY(i/2));
+        sum[i].d16 = (uint16_t)d32;
+        if (i+1 < USB_FUNC_ENDPOINTS)
+            sum[i+1].d16 = (uint16_t)(d32 >> 16);
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_trace_start: restart the protocol trace, stop post records
+// after the first trig_pid record if trig_en
+//-----------------------------------------------------------------
+void openusb_trace_start(uint16_t pid_mask, uint16_t ep_mask, uint8_t trig_en, uint8_t trig_pid, uint8_t post)
+{
+    OPEN_USB_TRACE_CTRL_TypeDef trace_ctrl;
+    OPEN_USB_TRACE_FILT_TypeDef trace_filt;
+
+    trace_ctrl.d32 = 0;
+    OPEN_USB_WRITE_REG(USB_TRACE_CTRL, trace_ctrl.d32);
+
+    trace_filt.b.pid_mask = pid_mask;
+    trace_filt.b.ep_mask = ep_mask;
+    OPEN_USB_WRITE_REG(USB_TRACE_FILT, trace_filt.d32);
+
+    trace_ctrl.b.trig_en = trig_en;
+    trace_ctrl.b.trig_pid = trig_pid;
+    trace_ctrl.b.post = post;
+    OPEN_USB_WRITE_REG(USB_TRACE_CTRL, trace_ctrl.d32);
+
+    trace_ctrl.b.en = 1;
+    OPEN_USB_WRITE_REG(USB_TRACE_CTRL, trace_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_trace_count: number of records, -1 if still capturing
+//-----------------------------------------------------------------
+int openusb_trace_count(void)
+{
+    OPEN_USB_TRACE_STS_TypeDef trace_sts;
+    trace_sts.d32 = OPEN_USB_READ_REG(USB_TRACE_STS);
+
+    if (!trace_sts.b.stopped)
+        return -1;
+
+    return trace_sts.b.wrap ? USB_TRACE_DEPTH : trace_sts.b.wptr;
+}
+
+//-----------------------------------------------------------------
+// openusb_trace_read: n-th oldest record (USB_TRACE_DATA0 format),
+// only valid when stopped
+//-----------------------------------------------------------------
+uint32_t openusb_trace_read(uint16_t n, uint32_t *timestamp)
+{
+    OPEN_USB_TRACE_STS_TypeDef trace_sts;
+    uint16_t idx = n;
+
+    trace_sts.d32 = OPEN_USB_READ_REG(USB_TRACE_STS);
+    if (trace_sts.b.wrap)
+        idx = (trace_sts.b.wptr + n) & (USB_TRACE_DEPTH - 1);
+
+    OPEN_USB_WRITE_REG(USB_TRACE_IDX, idx);
+    if (timestamp)
+        *timestamp = OPEN_USB_READ_REG(USB_TRACE_DATA1);
+    return OPEN_USB_READ_REG(USB_TRACE_DATA0);
 }
 
 //-----------------------------------------------------------------
@@ -248,9 +881,9 @@ void openusb_set_endpoint_stall(uint8_t endpoint)
 {
     OPEN_USB_EPx_CFG_TypeDef ep_cfg;
 
-    ep_cfg.d32 = OPEN_USB_READ_REG(USB_EP_CFG(endpoint));
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
     ep_cfg.b.stall_ep = 1;
-    OPEN_USB_WRITE_REG(USB_EP_CFG(endpoint), ep_cfg.d32);
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
 
     _endpoint_stalled[endpoint] = 1;
 }
@@ -279,9 +912,9 @@ void openusb_clear_endpoint_stall(uint8_t endpoint)
 {
     OPEN_USB_EPx_CFG_TypeDef ep_cfg;
 
-    ep_cfg.d32 = OPEN_USB_READ_REG(USB_EP_CFG(endpoint));
+    ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint));
     ep_cfg.b.stall_ep = 0;
-    OPEN_USB_WRITE_REG(USB_EP_CFG(endpoint), ep_cfg.d32);
+    shadow_set(SHADOW_EP_CFG(endpoint), USB_EP_CFG(endpoint), ep_cfg.d32);
 
     _endpoint_stalled[endpoint] = 0;
 }
@@ -291,33 +924,63 @@ void openusb_clear_endpoint_stall(uint8_t endpoint)
 //-----------------------------------------------------------------
 uint32_t openusb_get_rx_data(uint8_t endpoint, uint8_t *rdata_buf,
                              uint32_t max_len)
+{
+    return openusb_get_rx_packet(endpoint, openusb_get_ep_status(endpoint),
+                                 rdata_buf, max_len);
+}
+
+//-----------------------------------------------------------------
+// openusb_get_rx_packet: openusb_get_rx_data with the rx count of a
+// status snapshot, no USB_EPi_STS read
+//-----------------------------------------------------------------
+uint32_t openusb_get_rx_packet(uint8_t endpoint, OPEN_USB_EPx_STS_TypeDef ep_sts,
+                               uint8_t *rdata_buf, uint32_t max_len)
 {
     uint32_t i;
     uint32_t bytes_ready;
     uint32_t bytes_read = 0;
 
-    bytes_ready = openusb_get_rx_count(endpoint);
+    bytes_ready = ep_sts.b.rx_count;
 
     bytes_read = MIN(bytes_ready, max_len);
 
     for (i = 0; i < bytes_read; i++)
         *rdata_buf++ = openusb_get_rx_data_byte(endpoint);
 
+    if (_endpoint_auto_accept[endpoint] && bytes_read && bytes_read == bytes_ready)
+        _endpoint_rx_accepted[endpoint] = 1;
+
     // Return number of bytes read
     return bytes_read;
 }
 
 //-----------------------------------------------------------------
-// openusb_control_endpoint_send_status : Send ZLP on EP0
+// openusb_control_endpoint_send: start one EP0 packet of up to 64
+// bytes with openusb_tx_begin, without waiting. EP0 is idle after the
+// SETUP flush and at the tx complete that asks for the next packet;
+// if it is not, EP0 is flushed and stalled and -1 returned.
+//-----------------------------------------------------------------
+int openusb_control_endpoint_send(uint8_t *tx_buffer, uint32_t tx_len)
+{
+    if (openusb_tx_begin(ENDPOINT_CONTROL, tx_buffer, tx_len, 0) != 0) {
+        DEBUG_INFO("USB: EP0 busy, packet not sent\n");
+        openusb_flush_tx(ENDPOINT_CONTROL);
+        openusb_control_endpoint_stall();
+        return -1;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// openusb_control_endpoint_send_status : Send ZLP on EP0, the ACK of
+// host comes as EP0 tx complete
 //-----------------------------------------------------------------
 void openusb_control_endpoint_send_status()
 {
     DEBUG_INFO("Send ZLP\n");
 
-    openusb_tx_data(0, NULL, 0); // send status
-
-    while (!openusb_has_tx_space(0))
-        ;
+    openusb_control_endpoint_send(NULL, 0); // send status
 }
 
 //-----------------------------------------------------------------
@@ -350,6 +1013,69 @@ int openusb_is_attached() { return _attached; }
 //-----------------------------------------------------------------
 void openusb_set_configured(int configured) { _configured = configured; }
 
+//-----------------------------------------------------------------
+// service_bus_reset: software state of a bus reset
+//-----------------------------------------------------------------
+static void service_bus_reset(void)
+{
+    uint32_t i;
+
+    _configured = 0;
+    _addressed  = 0;
+
+    for (i=0;i<USB_FUNC_ENDPOINTS;i++)
+    {
+        _endpoint_stalled[i] = 0;
+        _endpoint_rx_accepted[i] = 0;
+        _tx_xfer[i].active = 0;
+        _tx_xfer[i].inflight = 0;
+        // the fifos are flushed, so are the packets in flight
+        _tx_pending[i] = 0;
+        _tx_seq[i]++;
+
+        if (_rst_clr_stall)
+            shadow_clr_stall(i);
+    }
+
+    // fifos, stall and address are cleared by hardware (USB_RST_CTRL)
+    openusb_stream_reset();
+    openusb_ep_reset();
+
+    if (_func_bus_reset)
+        _func_bus_reset();
+}
+
+//-----------------------------------------------------------------
+// service_ep0_rx: SETUP or OUT packet on EP0
+//-----------------------------------------------------------------
+static void service_ep0_rx(void)
+{
+    OPEN_USB_EPx_STS_TypeDef ep_sts;
+
+    ep_sts = openusb_get_ep_status(0);
+
+    // the packet of the event was taken in an earlier service
+    if (!ep_sts.b.rx_ready) {
+        DEBUG_INFO("EP0 rx event already serviced\n");
+    } else if (ep_sts.b.rx_setup) {
+        DEBUG_INFO("SETUP packet received\n");
+
+        // a SETUP clears the stall of EP0 in hardware
+        shadow_clr_stall(0);
+        _endpoint_stalled[0] = 0;
+
+        if (_func_setup)
+            _func_setup();
+
+        DEBUG_INFO("SETUP packet processed\n");
+    } else {
+        DEBUG_INFO("OUT packet received on EP0\n");
+
+        if (_func_ctrl_out)
+            _func_ctrl_out();
+    }
+}
+
 //-----------------------------------------------------------------
 // openusb_service:
 //-----------------------------------------------------------------
@@ -357,44 +1083,17 @@ void openusb_service(OPEN_USB_FUNC_STAT_TypeDef func_stat,
                      OPEN_USB_EP_INTSTS_TypeDef ep_intsts,
                      uint8_t is_process_rst)
 {
-    OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
-    OPEN_USB_EPx_RX_CTRL_TypeDef ep_rx_ctrl;
-    OPEN_USB_EPx_STS_TypeDef ep_sts;
+    uint8_t i;
 
-    uint32_t i;
-    static uint32_t _initial = 1;
-    static uint32_t _reset_count = 0;
+    for (i = 0; i < USB_FUNC_ENDPOINTS; i++)
+        if (ep_intsts.d32 & (1u << (16 + i)))
+            _tx_pending[i] = 0;
 
     //----------------------
     // Bus reset event
     //----------------------
     if (func_stat.b.rst && is_process_rst) {
-        _configured = 0;
-        _addressed  = 0;
-
-        // if(_initial){
-        //     _initial = 0;
-        //     return;
-        // }
-
-        for (i=0;i<USB_FUNC_ENDPOINTS;i++)
-        {
-            _endpoint_stalled[i] = 0;
-        }
-
-        for(i=0; i<4; i++){
-            ep_tx_ctrl.d32 = OPEN_USB_READ_REG(USB_EP_TX_CTRL(i));
-            ep_rx_ctrl.d32 = OPEN_USB_READ_REG(USB_EP_RX_CTRL(i));
-
-            ep_tx_ctrl.b.tx_flush = 1;
-            ep_rx_ctrl.b.rx_flush = 1;
-
-            OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(i), ep_tx_ctrl.d32);
-            OPEN_USB_WRITE_REG(USB_EP_RX_CTRL(i), ep_rx_ctrl.d32);
-        }
-
-        if (_func_bus_reset)
-            _func_bus_reset();
+        service_bus_reset();
 
         OPEN_USB_WRITE_REG(USB_FUNC_STAT, func_stat.d32);
         printf("DEVICE: BUS RESET\n");
@@ -407,28 +1106,234 @@ void openusb_service(OPEN_USB_FUNC_STAT_TypeDef func_stat,
         DEBUG_INFO("DEVICE: SOF\n");
     }
 
+    //----------------------
+    // Bus pre-sof event
+    //----------------------
+    if (func_stat.b.presof) {
+        DEBUG_INFO("DEVICE: PRE-SOF\n");
+    }
+
+    //----------------------
+    // IN TRANSFER (EP0 tx complete)
+    //----------------------
+    if (ep_intsts.b.ep0_tx_complete) {
+        if (_func_ctrl_in)
+            _func_ctrl_in();
+    }
+
     //----------------------
     // SETPUP TRANSFER
     //----------------------
-    if (ep_intsts.b.ep0_rx_ready) {
+    if (ep_intsts.b.ep0_rx_ready)
+        service_ep0_rx();
+}
 
-        ep_sts.d32 = OPEN_USB_READ_REG(USB_EP_STS(0));
+//-----------------------------------------------------------------
+// event_push: top half only, marks the event pending. One still
+// pending from an earlier interrupt takes it in.
+//-----------------------------------------------------------------
+static void event_push(uint8_t type, uint8_t ep)
+{
+    uint8_t set = _ev_set[type][ep];
 
-        if (ep_sts.b.rx_setup) {
-            DEBUG_INFO("SETUP packet received\n");
+    if (set != _ev_taken[type][ep])
+        _ev_merged++;
 
-            if (_func_setup)
-                _func_setup();
+    // the data of the event is written before the consumer can see it
+    OPENUSB_BARRIER();
+    _ev_set[type][ep] = set + 1;
+}
 
-            DEBUG_INFO("SETUP packet processed\n");
-        } else {
-            DEBUG_INFO("OUT packet received on EP0\n");
+//-----------------------------------------------------------------
+// event_take: bottom half only, the pending event of type and ep
+// into ev, 0 if none
+//-----------------------------------------------------------------
+static int event_take(uint8_t type, uint8_t ep, OPEN_USB_EVENT_TypeDef *ev)
+{
+    uint8_t set = _ev_set[type][ep];
+
+    if (set == _ev_taken[type][ep])
+        return 0;
+
+    OPENUSB_BARRIER();
+    ev->type     = type;
+    ev->ep       = ep;
+    ev->setup = _ev_setup[ep];
+    ev->seq   = _ev_seq[ep];
+    ev->len   = _ev_len[ep];
+    ev->frame = _ev_frame;
+
+    // an event pushed from here on is pending again
+    OPENUSB_BARRIER();
+    _ev_taken[type][ep] = set;
+    return 1;
+}
 
-            if (_func_ctrl_out)
-                _func_ctrl_out();
+//-----------------------------------------------------------------
+// openusb_isr_top: interrupt top half, reads and clears the status
+// once and marks the events pending for openusb_poll_events. The
+// packets of stream endpoints are moved to / from their rings here.
+// A fired fifo level interrupt is masked in the USB_EPi_CFG shadow
+// until openusb_rearm_fifo_thr, so a level the bottom half has not
+// served yet does not interrupt again. A bottom half shadow write
+// racing the mask enables it again, which costs one more interrupt
+// on the next crossing as the level status is latched.
+//-----------------------------------------------------------------
+void openusb_isr_top(void)
+{
+    OPEN_USB_FUNC_STAT_TypeDef func_stat;
+    OPEN_USB_EP_SUMMARY_TypeDef sum;
+    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
+    uint32_t ep_intsts;
+    uint32_t ep_naksts;
+    uint32_t ep_lvlsts;
+    uint32_t d32 = 0;
+    uint8_t tx_lvl, rx_lvl;
+    uint8_t i;
+
+    func_stat.d32 = OPEN_USB_READ_REG(USB_FUNC_STAT);
+    ep_intsts = OPEN_USB_READ_REG(USB_EP_INTSTS);
+    ep_naksts = OPEN_USB_READ_REG(USB_EP_NAKSTS);
+    ep_lvlsts = OPEN_USB_READ_REG(USB_EP_LVLSTS);
+
+    // clear first, events from now on raise the int again
+    OPEN_USB_WRITE_REG(USB_EP_INTSTS, ep_intsts);
+    OPEN_USB_WRITE_REG(USB_EP_NAKSTS, ep_naksts);
+    OPEN_USB_WRITE_REG(USB_EP_LVLSTS, ep_lvlsts);
+    OPEN_USB_WRITE_REG(USB_FUNC_STAT, func_stat.d32);
+
+    _ev_frame = func_stat.b.frame;
+
+    if (func_stat.b.rst)
+        event_push(OPENUSB_EV_RESET, 0);
+    if (func_stat.b.sof)
+        event_push(OPENUSB_EV_SOF, 0);
+    if (func_stat.b.presof)
+        event_push(OPENUSB_EV_PRESOF, 0);
+
+    for (i = 0; i < USB_FUNC_ENDPOINTS; i++) {
+        if (ep_intsts & (1u << (16 + i))) {
+            _tx_pending[i] = 0;
+            openusb_stream_isr_tx(i);
+            _ev_seq[i] = _tx_seq[i];
+            event_push(OPENUSB_EV_TX_COMPLETE, i);
+        }
+
+        if (ep_intsts & (1u << i)) {
+            // rx count and setup of two endpoints in one read
+            if (!(i & 1) || !(ep_intsts & (1u << (i - 1))))
+                d32 = OPEN_USB_READ_REG(USB_EP_SUMMARY(i / 2));
+            sum.d16 = (uint16_t)(d32 >> ((i & 1) * 16));
+            openusb_stream_isr_rx(i, sum.b.rx_count);
+            _ev_len[i] = sum.b.rx_count;
+            _ev_setup[i] = sum.b.rx_setup;
+            event_push(OPENUSB_EV_RX_READY, i);
+        }
+
+        if (ep_naksts & (1u << i))
+            event_push(OPENUSB_EV_IN_NAK, i);
+        if (ep_naksts & (1u << (16 + i)))
+            event_push(OPENUSB_EV_OUT_NAK, i);
+
+        // the status is set with the interrupt disabled too
+        if (ep_lvlsts & ((1u << i) | (1u << (16 + i)))) {
+            ep_cfg.d32 = shadow_get(SHADOW_EP_CFG(i), USB_EP_CFG(i));
+            tx_lvl = (ep_lvlsts & (1u << i)) && ep_cfg.b.int_tx_lvl;
+            rx_lvl = (ep_lvlsts & (1u << (16 + i))) && ep_cfg.b.int_rx_lvl;
+            if (tx_lvl || rx_lvl) {
+                if (tx_lvl)
+                    ep_cfg.b.int_tx_lvl = 0;
+                if (rx_lvl)
+                    ep_cfg.b.int_rx_lvl = 0;
+                shadow_set(SHADOW_EP_CFG(i), USB_EP_CFG(i), ep_cfg.d32);
+            }
+            if (tx_lvl)
+                event_push(OPENUSB_EV_TX_LVL, i);
+            if (rx_lvl)
+                event_push(OPENUSB_EV_RX_LVL, i);
+        }
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_set_event_handler: handler of one OPENUSB_EV_* type, called
+// by openusb_poll_events after the library handled the event
+//-----------------------------------------------------------------
+void openusb_set_event_handler(uint8_t type, OPEN_USB_EVENT_HANDLER handler)
+{
+    if (type < OPENUSB_EV_NUM)
+        _event_handler[type] = handler;
+}
+
+//-----------------------------------------------------------------
+// event_dispatch: bus reset and EP0 events drive the device state and
+// the control transfers, as openusb_service does, the others advance
+// the requests of openusb_ep_queue
+//-----------------------------------------------------------------
+static void event_dispatch(OPEN_USB_EVENT_TypeDef *ev)
+{
+    if (ev->type == OPENUSB_EV_RESET) {
+        service_bus_reset();
+        printf("DEVICE: BUS RESET\n");
+    } else if (ev->type == OPENUSB_EV_SOF) {
+        usbf_sof(ev->frame);
+    } else if (ev->ep == ENDPOINT_CONTROL) {
+        if (ev->type == OPENUSB_EV_TX_COMPLETE && _func_ctrl_in)
+            _func_ctrl_in();
+        else if (ev->type == OPENUSB_EV_RX_READY)
+            service_ep0_rx();
+    } else if (ev->type == OPENUSB_EV_TX_COMPLETE) {
+        openusb_ep_tx_complete(ev->ep, ev->seq);
+    } else if (ev->type == OPENUSB_EV_RX_READY) {
+        openusb_ep_rx_ready(ev->ep);
+    }
+
+    if (ev->ep != ENDPOINT_CONTROL)
+        usbf_ep_event(ev);
+
+    if (_event_handler[ev->type])
+        _event_handler[ev->type](ev);
+}
+
+//-----------------------------------------------------------------
+// openusb_poll_events: bottom half, dispatches up to max pending
+// events, returns the number of events dispatched. The bus events
+// go first, then the endpoints in order, the tx complete of an
+// endpoint before its rx ready.
+//-----------------------------------------------------------------
+int openusb_poll_events(int max)
+{
+    OPEN_USB_EVENT_TypeDef ev;
+    uint8_t type;
+    uint8_t i;
+    int n = 0;
+
+    for (type = OPENUSB_EV_RESET; type <= OPENUSB_EV_PRESOF && n < max; type++) {
+        if (event_take(type, 0, &ev)) {
+            event_dispatch(&ev);
+            n++;
+        }
+    }
+
+    for (i = 0; i < USB_FUNC_ENDPOINTS && n < max; i++) {
+        for (type = OPENUSB_EV_TX_COMPLETE; type < OPENUSB_EV_NUM && n < max; type++) {
+            if (event_take(type, i, &ev)) {
+                event_dispatch(&ev);
+                n++;
+            }
         }
     }
 
+    return n;
+}
+
+//-----------------------------------------------------------------
+// openusb_get_event_merged: events taken in by one of the same type
+// and endpoint still pending
+//-----------------------------------------------------------------
+uint32_t openusb_get_event_merged(void)
+{
+    return _ev_merged;
 }
 
 //-----------------------------------------------------------------
@@ -444,8 +1349,8 @@ void openusb_scaledown_enable(uint8_t mode)
     uint32_t rdata;
     // Device Control 0 Register
     // OTG_SCALEDOWN
-    rdata = *(reg32_t *)(0x10030000);
-    *(reg32_t *)(0x10030000) = rdata | (mode << 0);
+    rdata = OPEN_USB_READ_REG(SOC_DEV_CTRL0);
+    OPEN_USB_WRITE_REG(SOC_DEV_CTRL0, rdata | (mode << 0));
 }
 
 //-----------------------------------------------------------------
@@ -456,9 +1361,9 @@ void openusb_ulpi_reset(uint32_t ms)
     uint32_t rdata;
     // SFT_RESET_REG
     // ULPI_SW_RSTN
-    rdata = *(reg32_t *)(0x10000010);
+    rdata = OPEN_USB_READ_REG(SOC_SFT_RESET);
 
-    *(reg32_t *)(0x10000010) = rdata | (0x1 << 3);
+    OPEN_USB_WRITE_REG(SOC_SFT_RESET, rdata | (0x1 << 3));
     openusb_delay_ms(ms);
-    *(reg32_t *)(0x10000010) = rdata & (~(0x1 << 3));
+    OPEN_USB_WRITE_REG(SOC_SFT_RESET, rdata & (~(0x1 << 3)));
 }
@@ -3,26 +3,26 @@
 
 
 //-----------------------------------------------------------------
-// Types
+// Defines
 //-----------------------------------------------------------------
+// control transfer state, advanced by the EP0 events
+#define CTRL_STATE_IDLE         0   // waiting SETUP
+#define CTRL_STATE_DATA_IN      1   // DATA(IN) packet armed
+#define CTRL_STATE_DATA_OUT     2   // waiting DATA(OUT) packets
+#define CTRL_STATE_STATUS_OUT   3   // waiting ZLP from host
+#define CTRL_STATE_STATUS_IN    4   // ZLP armed
 
-// SETUP packet data format
-typedef struct _DEVICE_REQUEST_TypeDef
-{
-    uint8_t  bmRequestType;
-    uint8_t  bRequest;
-    uint16_t wValue;
-    uint16_t wIndex;
-    uint16_t wLength;
-} DEVICE_REQUEST_TypeDef;
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
 
 typedef struct _CONTROL_TRANSFER_TypeDef
 {
     // SETUP packet
     DEVICE_REQUEST_TypeDef  request;
 
-    // DATA(OUT) stage expected?
-    int                     data_expected;
+    // CTRL_STATE_*
+    int                     state;
 
     // Data buffer
     uint8_t                 data_buffer[MAX_CTRL_DATA_LENGTH];
@@ -30,6 +30,11 @@ typedef struct _CONTROL_TRANSFER_TypeDef
     // Data received index
     int                     data_idx;
 
+    // DATA(IN) stage: next data, bytes left, ZLP to end the transfer
+    uint8_t                *tx_ptr;
+    int                     tx_remain;
+    int                     tx_zlp;
+
 } CONTROL_TRANSFER_TypeDef;
 
 
@@ -39,80 +44,65 @@ typedef struct _CONTROL_TRANSFER_TypeDef
 static CONTROL_TRANSFER_TypeDef _ctrl_xfer;
 static int                      _remote_wake_enabled;
 static FP_CLASS_REQUEST         _class_request;
+static FP_BUS_RESET             _bus_reset;
+
+// class drivers, and the driver of each interface / endpoint number
+static const USB_CLASS_DRIVER_TypeDef *_class_drivers[USB_MAX_CLASS_DRIVERS];
+static int                             _class_driver_num;
+static const USB_CLASS_DRIVER_TypeDef *_if_driver[USB_MAX_INTERFACES];
+static const USB_CLASS_DRIVER_TypeDef *_ep_driver[USB_FUNC_ENDPOINTS];
+static uint8_t                         _if_alt[USB_MAX_INTERFACES];
 
 //-----------------------------------------------------------------
-// usb_control_send: Perform a transfer via IN
+// usb_control_send_next: Arm the next DATA(IN) packet
 //-----------------------------------------------------------------
-int usb_control_send(uint8_t *buf, int size, int requested_size){
-    int send;
-    int remain;
-    int count = 0;
-    int err = 0;
-
-    OPEN_USB_EPx_CFG_TypeDef ep_cfg;
-
-    // Mask the ep 0 rx_ready intr
-    ep_cfg.d32 = OPEN_USB_READ_REG(USB_EP_CFG(ENDPOINT_CONTROL));
-    ep_cfg.b.int_rx = 0;
-    OPEN_USB_WRITE_REG(USB_EP_CFG(ENDPOINT_CONTROL), ep_cfg.d32);
-
-    DEBUG_INFO("USB: usb_control_send %d\n", size);
+static void usb_control_send_next(void)
+{
+    int send = MIN(_ctrl_xfer.tx_remain, EP0_MAX_PACKET_SIZE);
 
-    // Loop until partial packet sent
-    do
-    {
-        remain = size - count;
-        send = MIN(remain, EP0_MAX_PACKET_SIZE);
+    DEBUG_INFO(" Remain %d, Send %d\n", _ctrl_xfer.tx_remain, send);
 
-        DEBUG_INFO(" Remain %d, Send %d\n", remain, send);
+    if (openusb_control_endpoint_send(_ctrl_xfer.tx_ptr, send) != 0) {
+        _ctrl_xfer.state = CTRL_STATE_IDLE;
+        return;
+    }
 
-        // Do not send ZLP if requested size was size transferred
-        if (remain == 0 && size == requested_size)
-            break;
+    _ctrl_xfer.tx_ptr    += send;
+    _ctrl_xfer.tx_remain -= send;
 
-        openusb_tx_data(ENDPOINT_CONTROL, buf, send);
+    // A short packet ends the transfer
+    if (send < EP0_MAX_PACKET_SIZE)
+        _ctrl_xfer.tx_zlp = 0;
+}
 
-        buf += send;
-        count += send;
+//-----------------------------------------------------------------
+// usb_control_send: Start a transfer via IN, the next packets are
+// sent on EP0 tx complete. Up to MAX_CTRL_DATA_LENGTH bytes are 
+// copied, a larger buf must stay valid until the transfer ends.
+// No more than requested_size (wLength) bytes are sent.
+//-----------------------------------------------------------------
+int usb_control_send(uint8_t *buf, int size, int requested_size){
 
-        DEBUG_INFO(" Sent %d, Remain %d\n", send, (size - count));
+    size = MIN(size, requested_size);
 
-        while ( !openusb_has_tx_space( ENDPOINT_CONTROL ) )
-        {
-            // Give up on early OUT (STATUS stage)
-            if (openusb_is_rx_ready(ENDPOINT_CONTROL))
-            {
-                DEBUG_INFO("USB: Early ACK received...\n");
-                break;
-            }
-        }
-    }
-    while (send >= EP0_MAX_PACKET_SIZE);
+    DEBUG_INFO("USB: usb_control_send %d\n", size);
 
-    if (!err)
+    if (size <= MAX_CTRL_DATA_LENGTH)
     {
-        DEBUG_INFO("USB: Sent total %d\n", count);
-
-        // Wait for ACK from host
-        do
-        {
-            
-        } 
-        while (!openusb_is_rx_ready(ENDPOINT_CONTROL));
+        memcpy(_ctrl_xfer.data_buffer, buf, size);
+        buf = _ctrl_xfer.data_buffer;
+    }
 
-        openusb_clear_rx_ready_flag(ENDPOINT_CONTROL);
+    _ctrl_xfer.tx_ptr    = buf;
+    _ctrl_xfer.tx_remain = size;
 
-        if (!err)
-        {
-            DEBUG_INFO("USB: ACK received\n");
-        }
-    }
+    // ZLP if the transfer ends on a full packet before requested size
+    _ctrl_xfer.tx_zlp    = (size < requested_size);
+    _ctrl_xfer.state     = CTRL_STATE_DATA_IN;
 
-    // Unmask the ep 0 rx_ready intr
-    ep_cfg.b.int_rx = 1;
-    OPEN_USB_WRITE_REG(USB_EP_CFG(ENDPOINT_CONTROL), ep_cfg.d32);
+    usb_control_send_next();
 
-    return !err;
+    return 1;
 }
 
 //-----------------------------------------------------------------
@@ -242,13 +232,13 @@ static void get_descriptor(DEVICE_REQUEST_TypeDef *request)
     unsigned char  bDescriptorType = HI_BYTE(request->wValue);
     unsigned char  bDescriptorIndex = LO_BYTE( request->wValue );
     unsigned short wLength = request->wLength;
-    unsigned char  bCount = 0;
+    unsigned short wCount = 0;
     unsigned char *desc_ptr;
 
-    desc_ptr = usb_get_descriptor(bDescriptorType, bDescriptorIndex, wLength, &bCount);
+    desc_ptr = usb_get_descriptor(bDescriptorType, bDescriptorIndex, wLength, &wCount);
 
     unsigned short i, actual_len;
-    actual_len = MIN(wLength, 18);
+    actual_len = desc_ptr ? MIN(wCount, 18) : 0;
     DEBUG_INFO("USB: Descriptor:\n");
     for(i=0; i<(actual_len); i++){
         DEBUG_INFO("%x ", desc_ptr[i]);
@@ -256,7 +246,7 @@ static void get_descriptor(DEVICE_REQUEST_TypeDef *request)
     DEBUG_INFO("\n");
 
     if (desc_ptr)
-        usb_control_send(desc_ptr, bCount, request->wLength);
+        usb_control_send(desc_ptr, wCount, request->wLength);
     else
         openusb_control_endpoint_stall();
 }
@@ -280,19 +270,24 @@ static void set_configuration(DEVICE_REQUEST_TypeDef *request)
 {
     DEBUG_INFO("USB: set_configuration %x\n", request->wValue);
 
-    if ( request->wValue == 0 )
-    {
-        openusb_control_endpoint_send_status();
-        openusb_set_configured(0);
-    }
+    int i;
+
     // Only support one configuration for now
-    else if ( request->wValue == 1 )
+    if ( request->wValue > 1 )
     {
-        openusb_control_endpoint_send_status();
-        openusb_set_configured(1);
-    }
-    else
         openusb_control_endpoint_stall();
+        return;
+    }
+
+    openusb_control_endpoint_send_status();
+    openusb_set_configured(request->wValue);
+
+    for (i = 0; i < USB_MAX_INTERFACES; i++)
+        _if_alt[i] = 0;
+
+    for (i = 0; i < _class_driver_num; i++)
+        if (_class_drivers[i]->set_config)
+            _class_drivers[i]->set_config(request->wValue);
 }
 
 //-----------------------------------------------------------------
@@ -300,8 +295,14 @@ static void set_configuration(DEVICE_REQUEST_TypeDef *request)
 //-----------------------------------------------------------------
 static void get_interface(DEVICE_REQUEST_TypeDef *request)
 {
-    DEBUG_INFO("USB: Get interface\n");
-    openusb_control_endpoint_stall();
+    uint8_t if_num = LO_BYTE(request->wIndex);
+
+    DEBUG_INFO("USB: Get interface %x\n", if_num);
+
+    if ( if_num < USB_MAX_INTERFACES && (if_num == 0 || _if_driver[if_num]) )
+        usb_control_send( &_if_alt[if_num], 1, request->wLength );
+    else
+        openusb_control_endpoint_stall();
 }
 
 //-----------------------------------------------------------------
@@ -309,12 +310,34 @@ static void get_interface(DEVICE_REQUEST_TypeDef *request)
 //-----------------------------------------------------------------
 static void set_interface(DEVICE_REQUEST_TypeDef *request)
 {
+    const USB_CLASS_DRIVER_TypeDef *driver;
+    uint8_t if_num = LO_BYTE(request->wIndex);
+    uint8_t alt = LO_BYTE(request->wValue);
+    int ok;
+
     DEBUG_INFO("USB: set_interface %x %x\n", request->wValue, request->wIndex);
 
-    if ( request->wValue == 0 && request->wIndex == 0 )
-        openusb_control_endpoint_send_status();
+    if ( if_num >= USB_MAX_INTERFACES || (if_num && !_if_driver[if_num]) )
+    {
+        openusb_control_endpoint_stall();
+        return;
+    }
+
+    // the driver selects the endpoints of the setting
+    driver = _if_driver[if_num];
+    if ( driver && driver->set_interface )
+        ok = driver->set_interface(if_num, alt) == 0;
     else
+        ok = (alt == 0);
+
+    if ( !ok )
+    {
         openusb_control_endpoint_stall();
+        return;
+    }
+
+    _if_alt[if_num] = alt;
+    openusb_control_endpoint_send_status();
 }
 
 //-----------------------------------------------------------------
@@ -333,10 +356,35 @@ static void set_descriptor(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
 }
 
 //-----------------------------------------------------------------
-// usb_process_request:
+// class_driver: driver of the interface / endpoint of the request
 //-----------------------------------------------------------------
-static void usb_process_request(DEVICE_REQUEST_TypeDef *request, unsigned char type, unsigned char req, unsigned char *data)
+static const USB_CLASS_DRIVER_TypeDef *class_driver(DEVICE_REQUEST_TypeDef *request)
 {
+    uint8_t bRecipient = request->bmRequestType & USB_RECIPIENT_MASK;
+    uint8_t index = LO_BYTE(request->wIndex);
+
+    if ( bRecipient == USB_RECIPIENT_INTERFACE && index < USB_MAX_INTERFACES )
+        return _if_driver[index];
+    else if ( bRecipient == USB_RECIPIENT_ENDPOINT && (index & ENDPOINT_ADDR_MASK) < USB_FUNC_ENDPOINTS )
+        return _ep_driver[index & ENDPOINT_ADDR_MASK];
+    else
+        return NULL;
+}
+
+//-----------------------------------------------------------------
+// usb_process_request: data_stage is set after the DATA(OUT) stage
+//-----------------------------------------------------------------
+static void usb_process_request(DEVICE_REQUEST_TypeDef *request, unsigned char type, unsigned char req, unsigned char *data, int data_stage)
+{
+    const USB_CLASS_DRIVER_TypeDef *driver = NULL;
+
+    if ( type != USB_STANDARD_REQUEST )
+        driver = class_driver(request);
+
+    // Send ZLP (ACK for Status stage), a class data hook decides first
+    if ( data_stage && !(driver && driver->data) )
+        openusb_control_endpoint_send_status();
+
     if ( type == USB_STANDARD_REQUEST )
     {
         // Standard requests
@@ -378,6 +426,17 @@ static void usb_process_request(DEVICE_REQUEST_TypeDef *request, unsigned char t
             break;
         }
     }
+    else if ( driver && data_stage && driver->data )
+    {
+        if ( driver->data(request, data) == 0 )
+            openusb_control_endpoint_send_status();
+        else
+            openusb_control_endpoint_stall();
+    }
+    else if ( driver && driver->setup )
+    {
+        driver->setup(request, data);
+    }
     else if ( type == USB_VENDOR_REQUEST )
     {
         DEBUG_INFO("Vendor: Unknown command\n");
@@ -402,7 +461,9 @@ static void usb_process_setup(void)
     uint8_t setup_pkt[EP0_MAX_PACKET_SIZE];
     uint16_t len;
 
-    len=openusb_get_rx_data(ENDPOINT_CONTROL, setup_pkt, EP0_MAX_PACKET_SIZE);
+    // status read by the service
+    len=openusb_get_rx_packet(ENDPOINT_CONTROL, openusb_last_ep_status(ENDPOINT_CONTROL),
+                              setup_pkt, EP0_MAX_PACKET_SIZE);
     openusb_clear_rx_ready_flag(ENDPOINT_CONTROL);
 
     #if (LOG_SETUP_PACKET)
@@ -432,7 +493,10 @@ static void usb_process_setup(void)
     _ctrl_xfer.request.wLength      |= setup_pkt[6];
 
     _ctrl_xfer.data_idx      = 0;
-    _ctrl_xfer.data_expected = 0;
+    _ctrl_xfer.state         = CTRL_STATE_IDLE;
+
+    // A SETUP aborts the data of the previous transfer
+    openusb_flush_tx(ENDPOINT_CONTROL);
 
     type = _ctrl_xfer.request.bmRequestType & USB_REQUEST_TYPE_MASK;
     req  = _ctrl_xfer.request.bRequest;
@@ -445,7 +509,7 @@ static void usb_process_setup(void)
                     _ctrl_xfer.request.wIndex,
                     _ctrl_xfer.request.wLength);
 
-        usb_process_request(&_ctrl_xfer.request, type, req, _ctrl_xfer.data_buffer);           
+        usb_process_request(&_ctrl_xfer.request, type, req, _ctrl_xfer.data_buffer, 0);           
     }
     // SETUP - SET
     else
@@ -457,7 +521,8 @@ static void usb_process_setup(void)
                                         _ctrl_xfer.request.wValue,
                                         _ctrl_xfer.request.wIndex,
                                         _ctrl_xfer.request.wLength);
-            usb_process_request(&_ctrl_xfer.request, type, req, _ctrl_xfer.data_buffer);
+            _ctrl_xfer.state = CTRL_STATE_STATUS_IN;
+            usb_process_request(&_ctrl_xfer.request, type, req, _ctrl_xfer.data_buffer, 0);
         }
         // Data expected
         else
@@ -470,7 +535,7 @@ static void usb_process_setup(void)
             if ( _ctrl_xfer.request.wLength <= MAX_CTRL_DATA_LENGTH )
             {
                 // OUT packets expected to follow containing data
-                _ctrl_xfer.data_expected = 1;
+                _ctrl_xfer.state = CTRL_STATE_DATA_OUT;
             }
             // Error: Too much data!
             else
@@ -487,19 +552,32 @@ static void usb_process_setup(void)
 //-----------------------------------------------------------------
 static void usb_process_out(void)
 {
+    OPEN_USB_EPx_STS_TypeDef ep_sts;
     unsigned short received;
     unsigned char type;
     unsigned char req;
 
+    // STATUS stage (or early STATUS during DATA(IN))
+    if (_ctrl_xfer.state == CTRL_STATE_STATUS_OUT || _ctrl_xfer.state == CTRL_STATE_DATA_IN)
+    {
+        DEBUG_INFO("USB: ACK received\n");
+        openusb_clear_rx_ready_flag(ENDPOINT_CONTROL);
+
+        if (_ctrl_xfer.state == CTRL_STATE_DATA_IN)
+            openusb_flush_tx(ENDPOINT_CONTROL);
+
+        _ctrl_xfer.state = CTRL_STATE_IDLE;
+    }
     // Error: Not expecting DATA-OUT!
-    if (!_ctrl_xfer.data_expected)
+    else if (_ctrl_xfer.state != CTRL_STATE_DATA_OUT)
     {
         DEBUG_INFO("USB: (EP0) OUT received but not expected, STALL\n");
         openusb_control_endpoint_stall();
     }
     else
     {
-        received = openusb_get_rx_count( ENDPOINT_CONTROL );
+        ep_sts = openusb_last_ep_status(ENDPOINT_CONTROL);
+        received = ep_sts.b.rx_count;
 
         DEBUG_INFO("USB: OUT received (%d bytes)\n", received);
 
@@ -510,7 +588,7 @@ static void usb_process_out(void)
         }
         else
         {
-            openusb_get_rx_data(ENDPOINT_CONTROL, &_ctrl_xfer.data_buffer[_ctrl_xfer.data_idx], received);
+            openusb_get_rx_packet(ENDPOINT_CONTROL, ep_sts, &_ctrl_xfer.data_buffer[_ctrl_xfer.data_idx], received);
             openusb_clear_rx_ready_flag(ENDPOINT_CONTROL);
             _ctrl_xfer.data_idx += received;
 
@@ -519,17 +597,14 @@ static void usb_process_out(void)
             // End of transfer (short transfer received?)
             if (received < EP0_MAX_PACKET_SIZE || _ctrl_xfer.data_idx >= _ctrl_xfer.request.wLength)
             {
-                // Send ZLP (ACK for Status stage)
                 DEBUG_INFO("USB: Send ZLP status stage %d %d\n", _ctrl_xfer.data_idx, _ctrl_xfer.request.wLength);
 
-                openusb_control_endpoint_send_status();
-
-                _ctrl_xfer.data_expected = 0;
+                _ctrl_xfer.state = CTRL_STATE_STATUS_IN;
 
                 type = _ctrl_xfer.request.bmRequestType & USB_REQUEST_TYPE_MASK;
                 req  = _ctrl_xfer.request.bRequest;
 
-                usb_process_request(&_ctrl_xfer.request, type, req, _ctrl_xfer.data_buffer);
+                usb_process_request(&_ctrl_xfer.request, type, req, _ctrl_xfer.data_buffer, 1);
             }
             else
                 DEBUG_INFO("DEV: More data expected!\n");
@@ -537,11 +612,115 @@ static void usb_process_out(void)
     }
 }
 
+//-----------------------------------------------------------------
+// usb_process_in: Process tx complete (on control EP0)
+//-----------------------------------------------------------------
+static void usb_process_in(void)
+{
+    if (_ctrl_xfer.state == CTRL_STATE_DATA_IN)
+    {
+        if (_ctrl_xfer.tx_remain || _ctrl_xfer.tx_zlp)
+            usb_control_send_next();
+        else
+        {
+            DEBUG_INFO("USB: Sent total, wait ACK\n");
+            _ctrl_xfer.state = CTRL_STATE_STATUS_OUT;
+        }
+    }
+    else if (_ctrl_xfer.state == CTRL_STATE_STATUS_IN)
+    {
+        DEBUG_INFO("USB: Status stage done\n");
+        _ctrl_xfer.state = CTRL_STATE_IDLE;
+    }
+}
+
+//-----------------------------------------------------------------
+// usb_process_bus_reset:
+//-----------------------------------------------------------------
+static void usb_process_bus_reset(void)
+{
+    int i;
+
+    _ctrl_xfer.state = CTRL_STATE_IDLE;
+
+    for (i = 0; i < USB_MAX_INTERFACES; i++)
+        _if_alt[i] = 0;
+
+    for (i = 0; i < _class_driver_num; i++)
+        if (_class_drivers[i]->init)
+            _class_drivers[i]->init();
+
+    if (_bus_reset)
+        _bus_reset();
+}
+
 //-----------------------------------------------------------------
 // usbf_init:
 //-----------------------------------------------------------------
 void usbf_init(unsigned int base, FP_BUS_RESET bus_reset, FP_CLASS_REQUEST class_request)
 {
     _class_request = class_request;
-    openusb_init(base, bus_reset, usb_process_setup, usb_process_out);
+    _bus_reset = bus_reset;
+    openusb_init(base, usb_process_bus_reset, usb_process_setup, usb_process_out, usb_process_in);
+}
+
+//-----------------------------------------------------------------
+// usbf_register_class: driver of the interfaces first_if..+num_ifs
+// and the endpoints of ep_mask (bit n: endpoint n, both directions).
+// 0 on success, -1 if the tables are full or a slot is taken.
+//-----------------------------------------------------------------
+int usbf_register_class(const USB_CLASS_DRIVER_TypeDef *driver, uint8_t first_if, uint8_t num_ifs, uint16_t ep_mask)
+{
+    uint8_t i;
+
+    if ( !driver || _class_driver_num >= USB_MAX_CLASS_DRIVERS ||
+         first_if + num_ifs > USB_MAX_INTERFACES ||
+         (ep_mask >> USB_FUNC_ENDPOINTS) || (ep_mask & (1 << ENDPOINT_CONTROL)) )
+        return -1;
+
+    for (i = first_if; i < first_if + num_ifs; i++)
+        if (_if_driver[i])
+            return -1;
+
+    for (i = 0; i < USB_FUNC_ENDPOINTS; i++)
+        if ((ep_mask & (1 << i)) && _ep_driver[i])
+            return -1;
+
+    for (i = first_if; i < first_if + num_ifs; i++)
+        _if_driver[i] = driver;
+
+    for (i = 0; i < USB_FUNC_ENDPOINTS; i++)
+        if (ep_mask & (1 << i))
+            _ep_driver[i] = driver;
+
+    _class_drivers[_class_driver_num++] = driver;
+
+    if (driver->init)
+        driver->init();
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// usbf_ep_event: event of a non-control endpoint to its driver,
+// called by openusb_poll_events
+//-----------------------------------------------------------------
+void usbf_ep_event(OPEN_USB_EVENT_TypeDef *ev)
+{
+    const USB_CLASS_DRIVER_TypeDef *driver = _ep_driver[ev->ep];
+
+    if (driver && driver->ep_event)
+        driver->ep_event(ev);
+}
+
+//-----------------------------------------------------------------
+// usbf_sof: SOF event to all drivers, called by openusb_poll_events
+//-----------------------------------------------------------------
+void usbf_sof(uint16_t frame)
+{
+    int i;
+
+    for (i = 0; i < _class_driver_num; i++)
+        if (_class_drivers[i]->sof)
+            _class_drivers[i]->sof(frame);
 }
@@ -0,0 +1,269 @@
+//=================================================================
+//
+// Transfer request queues of the non-control endpoints
+// A request is split into max packet size packets, one packet of
+// an endpoint is in the FIFO at a time. The requests advance on the
+// tx complete / rx ready events of openusb_poll_events, so the queues
+// and the callbacks are only touched from the main loop.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include "openusb_common.h"
+#include "openusb_ep.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static OPEN_USB_REQ_TypeDef *_in_head[USB_FUNC_ENDPOINTS];
+static OPEN_USB_REQ_TypeDef *_in_tail[USB_FUNC_ENDPOINTS];
+static OPEN_USB_REQ_TypeDef *_out_head[USB_FUNC_ENDPOINTS];
+static OPEN_USB_REQ_TypeDef *_out_tail[USB_FUNC_ENDPOINTS];
+
+// IN packet in the FIFO and its length
+static uint8_t  _in_busy[USB_FUNC_ENDPOINTS];
+static uint16_t _in_len[USB_FUNC_ENDPOINTS];
+
+//-----------------------------------------------------------------
+// req_add / req_remove: singly linked request list
+//-----------------------------------------------------------------
+static void req_add(OPEN_USB_REQ_TypeDef **head, OPEN_USB_REQ_TypeDef **tail,
+                    OPEN_USB_REQ_TypeDef *req)
+{
+    req->next = 0;
+    if (*head)
+        (*tail)->next = req;
+    else
+        *head = req;
+    *tail = req;
+}
+
+static int req_remove(OPEN_USB_REQ_TypeDef **head, OPEN_USB_REQ_TypeDef **tail,
+                      OPEN_USB_REQ_TypeDef *req)
+{
+    OPEN_USB_REQ_TypeDef *prev = 0;
+    OPEN_USB_REQ_TypeDef *cur = *head;
+
+    while (cur && cur != req) {
+        prev = cur;
+        cur = cur->next;
+    }
+
+    if (!cur)
+        return -1;
+
+    if (prev)
+        prev->next = cur->next;
+    else
+        *head = cur->next;
+
+    if (*tail == cur)
+        *tail = prev;
+
+    cur->next = 0;
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// req_done: hand the request back to its owner
+//-----------------------------------------------------------------
+static void req_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req, uint8_t status)
+{
+    req->status = status;
+
+    if (req->complete)
+        req->complete(ep_addr, req);
+}
+
+//-----------------------------------------------------------------
+// req_in_load: load the next packet of the first IN request and
+// start it, the endpoint is idle
+//-----------------------------------------------------------------
+static void req_in_load(uint8_t endpoint)
+{
+    OPEN_USB_REQ_TypeDef *req = _in_head[endpoint];
+    OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
+    uint32_t len;
+    uint32_t i;
+
+    if (!req) {
+        _in_busy[endpoint] = 0;
+        return;
+    }
+
+    len = MIN(req->len - req->actual, openusb_get_max_packet(endpoint));
+
+    for (i = 0; i < len; i++)
+        OPEN_USB_WRITE_REG(USB_EP_DATA(endpoint), req->buf[req->actual + i]);
+
+    _in_len[endpoint] = len;
+    _in_busy[endpoint] = 1;
+
+    ep_tx_ctrl.d32 = 0;
+    ep_tx_ctrl.b.tx_start = 1;
+    ep_tx_ctrl.b.tx_len = len;
+    OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(endpoint), ep_tx_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_ep_queue: submit a request, 0 on success. The request and
+// its buffer must stay valid until the complete callback.
+//-----------------------------------------------------------------
+int openusb_ep_queue(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    uint8_t endpoint = ep_addr & ENDPOINT_ADDR_MASK;
+
+    if (!req || endpoint == ENDPOINT_CONTROL || endpoint >= USB_FUNC_ENDPOINTS)
+        return -1;
+
+    req->actual = 0;
+    req->status = OPENUSB_REQ_PENDING;
+
+    if (ep_addr & ENDPOINT_DIR_IN) {
+        req_add(&_in_head[endpoint], &_in_tail[endpoint], req);
+        if (!_in_busy[endpoint])
+            req_in_load(endpoint);
+    } else {
+        req_add(&_out_head[endpoint], &_out_tail[endpoint], req);
+        // a packet may be waiting for a request
+        if (_out_head[endpoint] == req)
+            openusb_ep_rx_ready(endpoint);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// openusb_ep_dequeue: cancel a request, the complete callback is
+// called with OPENUSB_REQ_CANCELLED. -1 if it is not queued.
+//-----------------------------------------------------------------
+int openusb_ep_dequeue(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    uint8_t endpoint = ep_addr & ENDPOINT_ADDR_MASK;
+    uint8_t in_flight;
+
+    if (!req || endpoint == ENDPOINT_CONTROL || endpoint >= USB_FUNC_ENDPOINTS)
+        return -1;
+
+    if (ep_addr & ENDPOINT_DIR_IN) {
+        in_flight = (_in_head[endpoint] == req) && _in_busy[endpoint];
+
+        if (req_remove(&_in_head[endpoint], &_in_tail[endpoint], req))
+            return -1;
+
+        if (in_flight) {
+            openusb_flush_tx(endpoint);
+            _in_busy[endpoint] = 0;
+        }
+
+        req_done(ep_addr, req, OPENUSB_REQ_CANCELLED);
+
+        if (!_in_busy[endpoint])
+            req_in_load(endpoint);
+    } else {
+        if (req_remove(&_out_head[endpoint], &_out_tail[endpoint], req))
+            return -1;
+
+        req_done(ep_addr, req, OPENUSB_REQ_CANCELLED);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// openusb_ep_tx_complete: the IN packet is sent, complete the request
+// on a short packet (or ZLP) or on its last full packet without zlp.
+// seq is the tx sequence of the event.
+//-----------------------------------------------------------------
+void openusb_ep_tx_complete(uint8_t endpoint, uint8_t seq)
+{
+    OPEN_USB_REQ_TypeDef *req = _in_head[endpoint];
+
+    if (!_in_busy[endpoint] || !req)
+        return;
+
+    // the event of a packet dropped by openusb_ep_dequeue
+    if (seq != openusb_get_tx_seq(endpoint))
+        return;
+
+    req->actual += _in_len[endpoint];
+
+    if (_in_len[endpoint] < openusb_get_max_packet(endpoint) ||
+        (req->actual == req->len && !req->zlp)) {
+        req_remove(&_in_head[endpoint], &_in_tail[endpoint], req);
+        _in_busy[endpoint] = 0;
+        req_done(endpoint | ENDPOINT_DIR_IN, req, OPENUSB_REQ_DONE);
+
+        // the callback may have queued and started the next one
+        if (_in_busy[endpoint])
+            return;
+    }
+
+    req_in_load(endpoint);
+}
+
+//-----------------------------------------------------------------
+// openusb_ep_rx_ready: read the OUT packet into the first request,
+// the packet stays in the FIFO (NAKing the host) if none is queued
+//-----------------------------------------------------------------
+void openusb_ep_rx_ready(uint8_t endpoint)
+{
+    OPEN_USB_REQ_TypeDef *req = _out_head[endpoint];
+    OPEN_USB_EPx_STS_TypeDef ep_sts;
+    uint32_t count;
+    uint32_t space;
+
+    if (!req)
+        return;
+
+    ep_sts = openusb_get_ep_status(endpoint);
+    if (!ep_sts.b.rx_ready)
+        return;
+
+    count = ep_sts.b.rx_count;
+    space = req->len - req->actual;
+
+    req->actual += openusb_get_rx_packet(endpoint, ep_sts, req->buf + req->actual, space);
+    openusb_clear_rx_ready_flag(endpoint);
+
+    if (count > space || count < openusb_get_max_packet(endpoint) ||
+        req->actual == req->len) {
+        req_remove(&_out_head[endpoint], &_out_tail[endpoint], req);
+        req_done(endpoint, req, count > space ? OPENUSB_REQ_OVERFLOW : OPENUSB_REQ_DONE);
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_ep_reset: the FIFOs are flushed by the bus reset, all
+// requests complete with OPENUSB_REQ_RESET
+//-----------------------------------------------------------------
+void openusb_ep_reset(void)
+{
+    OPEN_USB_REQ_TypeDef *req;
+    OPEN_USB_REQ_TypeDef *next;
+    uint8_t i;
+
+    for (i = 1; i < USB_FUNC_ENDPOINTS; i++) {
+        req = _in_head[i];
+        _in_head[i] = 0;
+        _in_tail[i] = 0;
+        _in_busy[i] = 0;
+
+        for (; req; req = next) {
+            next = req->next;
+            req->next = 0;
+            req_done(i | ENDPOINT_DIR_IN, req, OPENUSB_REQ_RESET);
+        }
+
+        req = _out_head[i];
+        _out_head[i] = 0;
+        _out_tail[i] = 0;
+
+        for (; req; req = next) {
+            next = req->next;
+            req->next = 0;
+            req_done(i, req, OPENUSB_REQ_RESET);
+        }
+    }
+}
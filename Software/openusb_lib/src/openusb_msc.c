@@ -0,0 +1,554 @@
+//=================================================================
+//
+// Mass storage class, Bulk-Only Transport / SCSI transparent
+// Every stage is a transfer request, so a command runs from the
+// completion callbacks of openusb_poll_events: CBW -> data -> CSW,
+// with the CSW and the next CBW queued as soon as they are known.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include "openusb_msc.h"
+#include "openusb_ep.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define MSC_CBW_SIGNATURE       0x43425355      // "USBC"
+#define MSC_CSW_SIGNATURE       0x53425355      // "USBS"
+#define MSC_CBW_LEN             31
+#define MSC_CSW_LEN             13
+
+// bCSWStatus
+#define MSC_CSW_PASSED          0
+#define MSC_CSW_FAILED          1
+#define MSC_CSW_PHASE_ERROR     2
+
+// sense keys
+#define SENSE_NONE              0x00
+#define SENSE_NOT_READY         0x02
+#define SENSE_MEDIUM_ERROR      0x03
+#define SENSE_ILLEGAL_REQUEST   0x05
+
+// driver state
+#define MSC_STATE_IDLE          0   // not configured
+#define MSC_STATE_CBW           1   // CBW request queued
+#define MSC_STATE_DATA          2   // data stage of a command
+#define MSC_STATE_ERROR         3   // invalid CBW, stalled until BOT reset
+
+#define MSC_EP_OUT              (MSC_ENDPOINT_BULK_OUT)
+#define MSC_EP_IN               (MSC_ENDPOINT_BULK_IN | ENDPOINT_DIR_IN)
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static const USB_MSC_BLOCKDEV_TypeDef *_dev;
+static uint8_t _state;
+
+static uint8_t _cbw[MSC_CBW_LEN];
+static uint8_t _csw[MSC_CSW_LEN];
+static uint8_t _resp[36];           // INQUIRY is the longest response
+static uint8_t _buf[2][MSC_BUF_BLOCKS * MSC_BLOCK_SIZE];
+
+static OPEN_USB_REQ_TypeDef _req_cbw;
+static OPEN_USB_REQ_TypeDef _req_csw;
+static OPEN_USB_REQ_TypeDef _req_resp;
+static OPEN_USB_REQ_TypeDef _req_zlp;
+static OPEN_USB_REQ_TypeDef _req_data[2];
+static uint8_t _data_busy;          // bit i: _req_data[i] queued
+static uint8_t _csw_busy;           // _req_csw queued
+
+// command in progress
+static uint32_t _tag;
+static uint32_t _data_len;          // dCBWDataTransferLength
+static uint32_t _xfer_len;          // bytes queued (IN) / received (OUT)
+static uint8_t  _dir_in;            // direction of the host
+static uint8_t  _status;            // MSC_CSW_*
+static uint32_t _lba;               // next block to queue
+static uint32_t _wr_lba;            // next block to write to the device
+static uint32_t _blocks;            // blocks left to queue
+
+// sense of the last failed command
+static uint8_t  _sense_key;
+static uint8_t  _sense_asc;
+
+//-----------------------------------------------------------------
+// get_le32 / get_be32 / put_le32 / put_be32:
+//-----------------------------------------------------------------
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint32_t get_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void put_be32(uint8_t *p, uint32_t v)
+{
+    p[0] = v >> 24;
+    p[1] = v >> 16;
+    p[2] = v >> 8;
+    p[3] = v;
+}
+
+//-----------------------------------------------------------------
+// msc_fail: the command fails with the sense key / code
+//-----------------------------------------------------------------
+static void msc_fail(uint8_t key, uint8_t asc)
+{
+    _status = MSC_CSW_FAILED;
+    _sense_key = key;
+    _sense_asc = asc;
+}
+
+//-----------------------------------------------------------------
+// msc_queue: (re)submit a request of the driver
+//-----------------------------------------------------------------
+static void msc_queue(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req, uint8_t *buf, uint32_t len,
+                      OPEN_USB_REQ_COMPLETE complete)
+{
+    req->buf = buf;
+    req->len = len;
+    req->zlp = 0;
+    req->complete = complete;
+    openusb_ep_queue(ep_addr, req);
+}
+
+static void msc_cbw_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+static void msc_csw_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+
+//-----------------------------------------------------------------
+// msc_finish: end the data stage and queue the CSW and the next CBW
+//-----------------------------------------------------------------
+static void msc_finish(void)
+{
+    if (_dir_in) {
+        // a short packet ends the data stage early, or a ZLP if the
+        // data is a multiple of the packet size
+        if (_xfer_len < _data_len &&
+            !(_xfer_len % openusb_get_max_packet(MSC_ENDPOINT_BULK_IN)))
+            msc_queue(MSC_EP_IN, &_req_zlp, _csw, 0, 0);
+    } else if (_xfer_len < _data_len) {
+        // the rest of the OUT data is refused
+        openusb_set_endpoint_stall(MSC_ENDPOINT_BULK_OUT);
+    }
+
+    put_le32(&_csw[0], MSC_CSW_SIGNATURE);
+    put_le32(&_csw[4], _tag);
+    put_le32(&_csw[8], _data_len - _xfer_len);
+    _csw[12] = _status;
+
+    _state = MSC_STATE_CBW;
+    _csw_busy = 1;
+    msc_queue(MSC_EP_IN, &_req_csw, _csw, MSC_CSW_LEN, msc_csw_done);
+    msc_queue(MSC_EP_OUT, &_req_cbw, _cbw, MSC_CBW_LEN, msc_cbw_done);
+}
+
+//-----------------------------------------------------------------
+// msc_abort_data: cancel the queued data requests
+//-----------------------------------------------------------------
+static void msc_abort_data(void)
+{
+    _blocks = 0;
+    openusb_ep_dequeue(_dir_in ? MSC_EP_IN : MSC_EP_OUT, &_req_data[0]);
+    openusb_ep_dequeue(_dir_in ? MSC_EP_IN : MSC_EP_OUT, &_req_data[1]);
+}
+
+static void msc_data_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+
+//-----------------------------------------------------------------
+// msc_data_next: queue the next blocks on the free data requests.
+// A mapped device takes one request for the whole transfer, else
+// the two buffers take turns, one is filled while the other is on
+// the bus.
+//-----------------------------------------------------------------
+static void msc_data_next(void)
+{
+    OPEN_USB_REQ_TypeDef *req;
+    uint32_t blocks;
+    uint8_t *buf;
+    int i;
+
+    for (i = 0; i < 2 && _blocks; i++) {
+        req = &_req_data[i];
+
+        if (_data_busy & (1 << i))
+            continue;
+
+        if (_dev->map) {
+            blocks = _blocks;
+            buf = _dev->map(_lba);
+        } else {
+            blocks = MIN(_blocks, MSC_BUF_BLOCKS);
+            buf = _buf[i];
+
+            if (_dir_in && _dev->read(_lba, buf, blocks)) {
+                msc_fail(SENSE_MEDIUM_ERROR, 0x11);     // unrecovered read error
+                _blocks = 0;
+                break;
+            }
+        }
+
+        _lba += blocks;
+        _blocks -= blocks;
+        _data_busy |= (1 << i);
+
+        if (_dir_in)
+            _xfer_len += blocks * MSC_BLOCK_SIZE;
+
+        msc_queue(_dir_in ? MSC_EP_IN : MSC_EP_OUT, req, buf, blocks * MSC_BLOCK_SIZE, msc_data_done);
+    }
+
+    // the CSW follows the last IN data in the queue
+    if (_dir_in && !_blocks)
+        msc_finish();
+}
+
+//-----------------------------------------------------------------
+// msc_data_done: a data request of READ(10) / WRITE(10) completed
+//-----------------------------------------------------------------
+static void msc_data_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    uint32_t blocks;
+
+    _data_busy &= ~(1 << (req - _req_data));
+
+    // no refill once the CSW is queued
+    if (req->status != OPENUSB_REQ_DONE || _state != MSC_STATE_DATA)
+        return;
+
+    if (_dir_in) {
+        msc_data_next();
+        return;
+    }
+
+    _xfer_len += req->actual;
+    blocks = req->actual / MSC_BLOCK_SIZE;
+
+    if (req->actual < req->len) {
+        // the host sent less than the command
+        _status = MSC_CSW_PHASE_ERROR;
+        msc_abort_data();
+    } else if (!_dev->map && _dev->write(_wr_lba, req->buf, blocks)) {
+        msc_fail(SENSE_MEDIUM_ERROR, 0x0C);             // write error
+        msc_abort_data();
+    } else {
+        _wr_lba += blocks;
+        msc_data_next();
+    }
+
+    if (!_blocks && !_data_busy)
+        msc_finish();
+}
+
+//-----------------------------------------------------------------
+// msc_rw: READ(10) / WRITE(10)
+//-----------------------------------------------------------------
+static void msc_rw(const uint8_t *cb)
+{
+    uint32_t lba = get_be32(&cb[2]);
+    uint32_t count = (cb[7] << 8) | cb[8];
+    uint8_t  cmd_in = (cb[0] == SCSI_READ10);
+
+    if (count && (!_data_len || _dir_in != cmd_in || _data_len < count * MSC_BLOCK_SIZE)) {
+        // the host expects less or other data than the command
+        _status = MSC_CSW_PHASE_ERROR;
+        msc_finish();
+        return;
+    }
+
+    if (lba + count > _dev->block_count || lba + count < lba) {
+        msc_fail(SENSE_ILLEGAL_REQUEST, 0x21);          // lba out of range
+        msc_finish();
+        return;
+    }
+
+    _lba = lba;
+    _wr_lba = lba;
+    _blocks = count;
+
+    if (count)
+        msc_data_next();
+    else
+        msc_finish();
+}
+
+//-----------------------------------------------------------------
+// msc_send: queue the response of a command, up to the host length
+//-----------------------------------------------------------------
+static void msc_send(uint32_t len)
+{
+    if (!_data_len)
+        return;
+
+    if (!_dir_in) {
+        _status = MSC_CSW_PHASE_ERROR;
+        return;
+    }
+
+    _xfer_len = MIN(len, _data_len);
+    msc_queue(MSC_EP_IN, &_req_resp, _resp, _xfer_len, 0);
+}
+
+//-----------------------------------------------------------------
+// msc_command: run the SCSI command of the CBW
+//-----------------------------------------------------------------
+static void msc_command(void)
+{
+    const uint8_t *cb = &_cbw[15];
+    uint32_t len = 0;
+
+    _tag      = get_le32(&_cbw[4]);
+    _data_len = get_le32(&_cbw[8]);
+    _dir_in   = (_cbw[12] & ENDPOINT_DIR_IN) ? 1 : 0;
+    _xfer_len = 0;
+    _status   = MSC_CSW_PASSED;
+
+    DEBUG_INFO("MSC: CBW %x, %d bytes\n", cb[0], _data_len);
+
+    if (!_dev && cb[0] != SCSI_INQUIRY && cb[0] != SCSI_REQUEST_SENSE) {
+        msc_fail(SENSE_NOT_READY, 0x3A);                // medium not present
+        msc_finish();
+        return;
+    }
+
+    switch (cb[0]) {
+    case SCSI_TEST_UNIT_READY:
+    case SCSI_PREVENT_ALLOW_REMOVAL:
+    case SCSI_START_STOP_UNIT:
+    case SCSI_VERIFY10:
+        break;
+
+    case SCSI_INQUIRY:
+        memset(_resp, 0, 36);
+        _resp[1] = 0x80;                                // removable
+        _resp[2] = 0x04;                                // SPC-2
+        _resp[3] = 0x02;                                // response data format
+        _resp[4] = 36 - 5;
+        memcpy(&_resp[8], "OpenUSB Mass Storage    1.0 ", 28);
+        len = 36;
+        break;
+
+    case SCSI_REQUEST_SENSE:
+        memset(_resp, 0, 18);
+        _resp[0] = 0x70;                                // current errors
+        _resp[2] = _sense_key;
+        _resp[7] = 18 - 8;
+        _resp[12] = _sense_asc;
+        _sense_key = SENSE_NONE;
+        _sense_asc = 0;
+        len = 18;
+        break;
+
+    case SCSI_READ_CAPACITY10:
+        put_be32(&_resp[0], _dev->block_count - 1);
+        put_be32(&_resp[4], MSC_BLOCK_SIZE);
+        len = 8;
+        break;
+
+    case SCSI_READ_FORMAT_CAPACITIES:
+        put_be32(&_resp[0], 8);                         // capacity list length
+        put_be32(&_resp[4], _dev->block_count);
+        put_be32(&_resp[8], MSC_BLOCK_SIZE);
+        _resp[8] = 0x02;                                // formatted media
+        len = 12;
+        break;
+
+    case SCSI_MODE_SENSE6:
+        memset(_resp, 0, 4);
+        _resp[0] = 4 - 1;                               // no write protect, no pages
+        len = 4;
+        break;
+
+    case SCSI_READ10:
+    case SCSI_WRITE10:
+        msc_rw(cb);
+        return;
+
+    default:
+        DEBUG_INFO("MSC: Unknown command %x\n", cb[0]);
+        msc_fail(SENSE_ILLEGAL_REQUEST, 0x20);          // invalid command
+        break;
+    }
+
+    if (len)
+        msc_send(len);
+
+    msc_finish();
+}
+
+//-----------------------------------------------------------------
+// msc_cbw_done: a CBW arrived, an invalid one stalls both endpoints
+// until the reset recovery of the host
+//-----------------------------------------------------------------
+static void msc_cbw_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    if (req->status == OPENUSB_REQ_CANCELLED || req->status == OPENUSB_REQ_RESET)
+        return;
+
+    if (req->status != OPENUSB_REQ_DONE || req->actual != MSC_CBW_LEN ||
+        get_le32(_cbw) != MSC_CBW_SIGNATURE || _cbw[13] != 0) {
+        DEBUG_INFO("MSC: Invalid CBW, STALL\n");
+        _state = MSC_STATE_ERROR;
+        openusb_set_endpoint_stall(MSC_ENDPOINT_BULK_IN);
+        openusb_set_endpoint_stall(MSC_ENDPOINT_BULK_OUT);
+        return;
+    }
+
+    // the host may send the next CBW before the tx complete event of
+    // the CSW is seen, the command waits for it
+    _state = MSC_STATE_DATA;
+    if (!_csw_busy)
+        msc_command();
+}
+
+//-----------------------------------------------------------------
+// msc_csw_done: the CSW is sent, run the CBW that waited for it
+//-----------------------------------------------------------------
+static void msc_csw_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    _csw_busy = 0;
+
+    if (req->status == OPENUSB_REQ_DONE && _state == MSC_STATE_DATA)
+        msc_command();
+}
+
+//-----------------------------------------------------------------
+// msc_abort: cancel all requests, the callbacks see CANCELLED
+//-----------------------------------------------------------------
+static void msc_abort(void)
+{
+    _state = MSC_STATE_IDLE;
+    _blocks = 0;
+
+    openusb_ep_dequeue(MSC_EP_OUT, &_req_cbw);
+    openusb_ep_dequeue(MSC_EP_IN, &_req_csw);
+    openusb_ep_dequeue(MSC_EP_IN, &_req_resp);
+    openusb_ep_dequeue(MSC_EP_IN, &_req_zlp);
+    openusb_ep_dequeue(MSC_EP_IN, &_req_data[0]);
+    openusb_ep_dequeue(MSC_EP_IN, &_req_data[1]);
+    openusb_ep_dequeue(MSC_EP_OUT, &_req_data[0]);
+    openusb_ep_dequeue(MSC_EP_OUT, &_req_data[1]);
+}
+
+//-----------------------------------------------------------------
+// msc_restart: wait for a CBW
+//-----------------------------------------------------------------
+static void msc_restart(void)
+{
+    msc_abort();
+
+    _state = MSC_STATE_CBW;
+    msc_queue(MSC_EP_OUT, &_req_cbw, _cbw, MSC_CBW_LEN, msc_cbw_done);
+}
+
+//-----------------------------------------------------------------
+// msc_setup: class requests of the interface
+//-----------------------------------------------------------------
+static void msc_setup(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
+{
+    uint8_t max_lun = 0;
+
+    if ( (request->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_CLASS_REQUEST )
+    {
+        openusb_control_endpoint_stall();
+        return;
+    }
+
+    switch ( request->bRequest )
+    {
+    case MSC_REQ_GET_MAX_LUN:
+        DEBUG_INFO("MSC: Get max LUN\n");
+        usb_control_send( &max_lun, 1, request->wLength );
+        break;
+    case MSC_REQ_BOT_RESET:
+        // the host clears the endpoint halts next
+        DEBUG_INFO("MSC: BOT reset\n");
+        openusb_control_endpoint_send_status();
+        msc_restart();
+        break;
+    default:
+        DEBUG_INFO("MSC: Unknown request %x\n", request->bRequest);
+        openusb_control_endpoint_stall();
+        break;
+    }
+}
+
+//-----------------------------------------------------------------
+// msc_init: the bus reset completed the requests
+//-----------------------------------------------------------------
+static void msc_init(void)
+{
+    _state = MSC_STATE_IDLE;
+    _blocks = 0;
+    _data_busy = 0;
+    _csw_busy = 0;
+    _sense_key = SENSE_NONE;
+    _sense_asc = 0;
+}
+
+//-----------------------------------------------------------------
+// msc_set_config:
+//-----------------------------------------------------------------
+static void msc_set_config(unsigned char config)
+{
+    if (config)
+        msc_restart();
+    else
+        msc_abort();
+}
+
+//-----------------------------------------------------------------
+// usb_msc_set_blockdev: media of the LUN, 0 for no media
+//-----------------------------------------------------------------
+void usb_msc_set_blockdev(const USB_MSC_BLOCKDEV_TypeDef *dev)
+{
+    _dev = dev;
+}
+
+//-----------------------------------------------------------------
+// usb_msc_driver:
+//-----------------------------------------------------------------
+const USB_CLASS_DRIVER_TypeDef usb_msc_driver =
+{
+    msc_init,           // init
+    msc_setup,          // setup
+    0,                  // data
+    msc_set_config,     // set_config
+    0,                  // set_interface
+    0,                  // ep_event
+    0                   // sof
+};
+
+//-----------------------------------------------------------------
+// RAM disk, memory mapped
+//-----------------------------------------------------------------
+static uint8_t *_ramdisk_mem;
+
+static uint8_t *ramdisk_map(uint32_t lba)
+{
+    return _ramdisk_mem + lba * MSC_BLOCK_SIZE;
+}
+
+static USB_MSC_BLOCKDEV_TypeDef _ramdisk = { 0, ramdisk_map, 0, 0 };
+
+//-----------------------------------------------------------------
+// usb_msc_ramdisk:
+//-----------------------------------------------------------------
+const USB_MSC_BLOCKDEV_TypeDef *usb_msc_ramdisk(uint8_t *mem, uint32_t blocks)
+{
+    _ramdisk_mem = mem;
+    _ramdisk.block_count = blocks;
+    return &_ramdisk;
+}
@@ -0,0 +1,558 @@
+//=================================================================
+//
+// CDC Network Control Model, NTB16
+// IN : NTH16 | datagrams (4 byte aligned) | NDP16, the NDP is
+//      written behind the last datagram when the NTB is flushed
+// OUT: the NDP16 chain of a received NTB is walked and each
+//      datagram handed to the rx callback in place
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include "openusb_ncm.h"
+#include "openusb_ep.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define NCM_NTH16_SIGNATURE     0x484D434E      // "NCMH"
+#define NCM_NDP16_SIGNATURE     0x304D434E      // "NCM0", no CRC
+#define NCM_NTH16_LEN           12
+#define NCM_NDP16_LEN(n)        (8 + ((n) + 1) * 4)     // n datagrams and the terminator
+#define NCM_ALIGN               4               // datagram divisor and NDP alignment
+#define NCM_MAX_NDPS            8               // NDPs walked per OUT NTB
+
+#define NCM_ALIGN_UP(x)         (((x) + NCM_ALIGN - 1) & ~(NCM_ALIGN - 1))
+
+#ifdef USB_SPEED_HS
+    #define NCM_LINK_SPEED      480000000
+#else
+    #define NCM_LINK_SPEED      12000000
+#endif
+
+#define NCM_EP_OUT              (NCM_ENDPOINT_BULK_OUT)
+#define NCM_EP_IN               (NCM_ENDPOINT_BULK_IN | ENDPOINT_DIR_IN)
+#define NCM_EP_NOTIFY           (NCM_ENDPOINT_INTR_IN | ENDPOINT_DIR_IN)
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static USB_NCM_RX _rx;
+static uint8_t  _active;            // data interface in alternate setting 1
+
+// negotiated with the host
+static uint32_t _in_max;            // dwNtbInMaxSize
+static uint16_t _in_max_dgrams;     // wNtbInMaxDatagrams
+static uint16_t _max_dgram;         // wMaxDatagramSize
+
+// flush points of the IN NTB
+static uint32_t _flush_bytes  = NCM_NTB_IN_SIZE;
+static uint16_t _flush_dgrams = NCM_IN_MAX_DATAGRAMS;
+static uint8_t  _flush_idle   = 1;  // flush when no NTB is on the bus
+static uint8_t  _flush_pending;     // usb_ncm_flush with all NTBs queued
+
+// IN NTBs, _in_fill is filled, the _in_queued before it are queued
+static uint8_t  _ntb_in[NCM_IN_NTBS][NCM_NTB_IN_SIZE];
+static OPEN_USB_REQ_TypeDef _req_in[NCM_IN_NTBS];
+static uint8_t  _in_fill;
+static uint8_t  _in_queued;
+static uint32_t _in_off;            // end of the datagrams
+static uint16_t _in_count;
+static uint16_t _in_dgram[NCM_IN_MAX_DATAGRAMS][2];     // wDatagramIndex, wDatagramLength
+static uint16_t _in_seq;
+
+static uint8_t  _ntb_out[NCM_NTB_OUT_SIZE];
+static OPEN_USB_REQ_TypeDef _req_out;
+
+static uint8_t  _notify_speed[16];
+static uint8_t  _notify_connect[8];
+static OPEN_USB_REQ_TypeDef _req_speed;
+static OPEN_USB_REQ_TypeDef _req_connect;
+
+static uint8_t  _resp[NCM_NTB_PARAMETERS_LEN];
+
+//-----------------------------------------------------------------
+// get_le16 / get_le32 / put_le16 / put_le32:
+//-----------------------------------------------------------------
+static uint16_t get_le16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+//-----------------------------------------------------------------
+// ncm_queue: (re)submit a request of the driver
+//-----------------------------------------------------------------
+static void ncm_queue(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req, uint8_t *buf, uint32_t len, uint8_t zlp,
+                      OPEN_USB_REQ_COMPLETE complete)
+{
+    req->buf = buf;
+    req->len = len;
+    req->zlp = zlp;
+    req->complete = complete;
+    openusb_ep_queue(ep_addr, req);
+}
+
+static void ncm_in_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+static void ncm_out_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+
+//-----------------------------------------------------------------
+// ncm_flush_in: close the NTB being filled with its NDP and queue it
+//-----------------------------------------------------------------
+static void ncm_flush_in(void)
+{
+    uint8_t *ntb = _ntb_in[_in_fill];
+    uint32_t ndp = NCM_ALIGN_UP(_in_off);
+    uint32_t ndp_len = NCM_NDP16_LEN(_in_count);
+    uint32_t block_len = ndp + ndp_len;
+    uint16_t i;
+
+    if (!_in_count)
+        return;
+
+    if (_in_queued == NCM_IN_NTBS) {
+        _flush_pending = 1;
+        return;
+    }
+
+    put_le32(&ntb[ndp], NCM_NDP16_SIGNATURE);
+    put_le16(&ntb[ndp + 4], ndp_len);
+    put_le16(&ntb[ndp + 6], 0);                 // wNextNdpIndex
+    for (i = 0; i < _in_count; i++) {
+        put_le16(&ntb[ndp + 8 + i * 4], _in_dgram[i][0]);
+        put_le16(&ntb[ndp + 10 + i * 4], _in_dgram[i][1]);
+    }
+    put_le32(&ntb[ndp + 8 + i * 4], 0);
+
+    put_le32(&ntb[0], NCM_NTH16_SIGNATURE);
+    put_le16(&ntb[4], NCM_NTH16_LEN);
+    put_le16(&ntb[6], _in_seq++);
+    put_le16(&ntb[8], block_len);
+    put_le16(&ntb[10], ndp);
+
+    // a ZLP ends an NTB shorter than dwNtbInMaxSize if it is a
+    // multiple of the packet size
+    _in_queued++;
+    ncm_queue(NCM_EP_IN, &_req_in[_in_fill], ntb, block_len, block_len < _in_max, ncm_in_done);
+
+    _in_fill = (_in_fill + 1) % NCM_IN_NTBS;
+    _in_off = NCM_NTH16_LEN;
+    _in_count = 0;
+    _flush_pending = 0;
+}
+
+//-----------------------------------------------------------------
+// ncm_in_done: an NTB is on the host, its buffer is free
+//-----------------------------------------------------------------
+static void ncm_in_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    _in_queued--;
+
+    if (req->status == OPENUSB_REQ_DONE && (_flush_pending || (_flush_idle && !_in_queued)))
+        ncm_flush_in();
+}
+
+//-----------------------------------------------------------------
+// ncm_unpack: hand the datagrams of a received NTB to the rx callback
+//-----------------------------------------------------------------
+static void ncm_unpack(const uint8_t *ntb, uint32_t len)
+{
+    uint32_t block_len, ndp, ndp_len, index, dgram_len, i;
+    int n;
+
+    if (len < NCM_NTH16_LEN || get_le32(ntb) != NCM_NTH16_SIGNATURE ||
+        get_le16(&ntb[4]) != NCM_NTH16_LEN) {
+        DEBUG_INFO("NCM: Invalid NTH16\n");
+        return;
+    }
+
+    // 0: the NTB ends with the transfer
+    block_len = get_le16(&ntb[8]);
+    if (!block_len)
+        block_len = len;
+    if (block_len > len) {
+        DEBUG_INFO("NCM: NTB block length %d > %d\n", block_len, len);
+        return;
+    }
+
+    ndp = get_le16(&ntb[10]);
+    for (n = 0; ndp && n < NCM_MAX_NDPS; n++) {
+        if ((ndp & (NCM_ALIGN - 1)) || ndp + NCM_NDP16_LEN(1) > block_len ||
+            get_le32(&ntb[ndp]) != NCM_NDP16_SIGNATURE) {
+            DEBUG_INFO("NCM: Invalid NDP16 at %d\n", ndp);
+            return;
+        }
+
+        ndp_len = get_le16(&ntb[ndp + 4]);
+        if (ndp_len < NCM_NDP16_LEN(1) || ndp + ndp_len > block_len) {
+            DEBUG_INFO("NCM: Invalid NDP16 length %d\n", ndp_len);
+            return;
+        }
+
+        for (i = ndp + 8; i + 4 <= ndp + ndp_len; i += 4) {
+            index = get_le16(&ntb[i]);
+            dgram_len = get_le16(&ntb[i + 2]);
+
+            if (!index || !dgram_len)
+                break;
+
+            if (index + dgram_len > block_len) {
+                DEBUG_INFO("NCM: Datagram %d+%d out of the NTB\n", index, dgram_len);
+                continue;
+            }
+
+            if (_rx)
+                _rx(&ntb[index], dgram_len);
+        }
+
+        ndp = get_le16(&ntb[ndp + 6]);
+    }
+}
+
+//-----------------------------------------------------------------
+// ncm_out_done: an NTB arrived
+//-----------------------------------------------------------------
+static void ncm_out_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    if (req->status == OPENUSB_REQ_CANCELLED || req->status == OPENUSB_REQ_RESET)
+        return;
+
+    if (req->status == OPENUSB_REQ_DONE)
+        ncm_unpack(req->buf, req->actual);
+    else
+        DEBUG_INFO("NCM: NTB larger than %d, dropped\n", NCM_NTB_OUT_SIZE);
+
+    ncm_queue(NCM_EP_OUT, &_req_out, _ntb_out, sizeof(_ntb_out), 0, ncm_out_done);
+}
+
+//-----------------------------------------------------------------
+// ncm_notify: link speed and connection on the interrupt endpoint
+//-----------------------------------------------------------------
+static void ncm_notify(void)
+{
+    _notify_speed[0] = 0xA1;
+    _notify_speed[1] = NCM_NOTIFY_SPEED_CHANGE;
+    put_le16(&_notify_speed[2], 0);
+    put_le16(&_notify_speed[4], NCM_INTERFACE_COMM);
+    put_le16(&_notify_speed[6], 8);
+    put_le32(&_notify_speed[8], NCM_LINK_SPEED);        // DLBitRate
+    put_le32(&_notify_speed[12], NCM_LINK_SPEED);       // ULBitRate
+
+    _notify_connect[0] = 0xA1;
+    _notify_connect[1] = NCM_NOTIFY_NETWORK_CONNECTION;
+    put_le16(&_notify_connect[2], 1);                   // connected
+    put_le16(&_notify_connect[4], NCM_INTERFACE_COMM);
+    put_le16(&_notify_connect[6], 0);
+
+    ncm_queue(NCM_EP_NOTIFY, &_req_speed, _notify_speed, sizeof(_notify_speed), 0, 0);
+    ncm_queue(NCM_EP_NOTIFY, &_req_connect, _notify_connect, sizeof(_notify_connect), 0, 0);
+}
+
+//-----------------------------------------------------------------
+// ncm_stop: cancel all requests and drop the IN datagrams
+//-----------------------------------------------------------------
+static void ncm_stop(void)
+{
+    int i;
+
+    _active = 0;
+
+    for (i = 0; i < NCM_IN_NTBS; i++)
+        openusb_ep_dequeue(NCM_EP_IN, &_req_in[i]);
+    openusb_ep_dequeue(NCM_EP_OUT, &_req_out);
+    openusb_ep_dequeue(NCM_EP_NOTIFY, &_req_speed);
+    openusb_ep_dequeue(NCM_EP_NOTIFY, &_req_connect);
+
+    _in_fill = 0;
+    _in_queued = 0;
+    _in_off = NCM_NTH16_LEN;
+    _in_count = 0;
+    _in_seq = 0;
+    _flush_pending = 0;
+}
+
+//-----------------------------------------------------------------
+// ncm_ntb_defaults: NTB parameters before the host sets them
+//-----------------------------------------------------------------
+static void ncm_ntb_defaults(void)
+{
+    _in_max = NCM_NTB_IN_SIZE;
+    _in_max_dgrams = NCM_IN_MAX_DATAGRAMS;
+    _max_dgram = NCM_MAX_DATAGRAM;
+}
+
+//-----------------------------------------------------------------
+// ncm_get_ntb_parameters:
+//-----------------------------------------------------------------
+static void ncm_get_ntb_parameters(unsigned short wLength)
+{
+    put_le16(&_resp[0], NCM_NTB_PARAMETERS_LEN);
+    put_le16(&_resp[2], 0x0001);                        // NTB16 only
+    put_le32(&_resp[4], NCM_NTB_IN_SIZE);
+    put_le16(&_resp[8], NCM_ALIGN);                     // wNdpInDivisor
+    put_le16(&_resp[10], 0);                            // wNdpInPayloadRemainder
+    put_le16(&_resp[12], NCM_ALIGN);                    // wNdpInAlignment
+    put_le16(&_resp[14], 0);
+    put_le32(&_resp[16], NCM_NTB_OUT_SIZE);
+    put_le16(&_resp[20], NCM_ALIGN);                    // wNdpOutDivisor
+    put_le16(&_resp[22], 0);                            // wNdpOutPayloadRemainder
+    put_le16(&_resp[24], NCM_ALIGN);                    // wNdpOutAlignment
+    put_le16(&_resp[26], 0);                            // wNtbOutMaxDatagrams, no limit
+
+    usb_control_send( _resp, NCM_NTB_PARAMETERS_LEN, wLength );
+}
+
+//-----------------------------------------------------------------
+// ncm_setup: class requests of the NCM interfaces
+//-----------------------------------------------------------------
+static void ncm_setup(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
+{
+    if ( (request->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_CLASS_REQUEST )
+    {
+        openusb_control_endpoint_stall();
+        return;
+    }
+
+    switch ( request->bRequest )
+    {
+    case NCM_GET_NTB_PARAMETERS:
+        DEBUG_INFO("NCM: Get NTB parameters\n");
+        ncm_get_ntb_parameters(request->wLength);
+        break;
+    case NCM_GET_NTB_INPUT_SIZE:
+        DEBUG_INFO("NCM: Get NTB input size\n");
+        put_le32(&_resp[0], _in_max);
+        put_le16(&_resp[4], _in_max_dgrams);
+        put_le16(&_resp[6], 0);
+        usb_control_send( _resp, 8, request->wLength );
+        break;
+    case NCM_GET_NTB_FORMAT:
+        put_le16(&_resp[0], 0);                         // NTB16
+        usb_control_send( _resp, 2, request->wLength );
+        break;
+    case NCM_SET_NTB_FORMAT:
+        if ( request->wValue == 0 )
+            openusb_control_endpoint_send_status();
+        else
+            openusb_control_endpoint_stall();
+        break;
+    case NCM_GET_MAX_DATAGRAM_SIZE:
+        put_le16(&_resp[0], _max_dgram);
+        usb_control_send( _resp, 2, request->wLength );
+        break;
+    case NCM_SET_ETHERNET_PACKET_FILTER:
+        // all frames are passed, the host filters
+        DEBUG_INFO("NCM: Packet filter %x\n", request->wValue);
+        openusb_control_endpoint_send_status();
+        break;
+    default:
+        DEBUG_INFO("NCM: Unknown request %x\n", request->bRequest);
+        openusb_control_endpoint_stall();
+        break;
+    }
+}
+
+//-----------------------------------------------------------------
+// ncm_data: requests with an OUT data stage, -1 to STALL
+//-----------------------------------------------------------------
+static int ncm_data(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
+{
+    uint32_t size;
+
+    if ( (request->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_CLASS_REQUEST )
+        return -1;
+
+    switch ( request->bRequest )
+    {
+    case NCM_SET_NTB_INPUT_SIZE:
+        // dwNtbInMaxSize, and wNtbInMaxDatagrams in the 8 byte form
+        if ( request->wLength != 4 && request->wLength != 8 )
+            return -1;
+
+        size = get_le32(data);
+        if ( size < NCM_NTH16_LEN + NCM_NDP16_LEN(1) + NCM_MAX_DATAGRAM || size > NCM_NTB_IN_SIZE )
+        {
+            DEBUG_INFO("NCM: NTB input size %d not supported\n", size);
+            return -1;
+        }
+
+        _in_max = size;
+        _in_max_dgrams = NCM_IN_MAX_DATAGRAMS;
+        if ( request->wLength >= 8 && get_le16(&data[4]) )
+            _in_max_dgrams = MIN(get_le16(&data[4]), NCM_IN_MAX_DATAGRAMS);
+
+        DEBUG_INFO("NCM: Set NTB input size %d, %d datagrams\n", _in_max, _in_max_dgrams);
+        break;
+    case NCM_SET_MAX_DATAGRAM_SIZE:
+        if ( request->wLength < 2 || !get_le16(data) )
+            return -1;
+
+        _max_dgram = MIN(get_le16(data), NCM_MAX_DATAGRAM);
+        DEBUG_INFO("NCM: Set max datagram size %d\n", _max_dgram);
+        break;
+    default:
+        DEBUG_INFO("NCM: Unknown request %x\n", request->bRequest);
+        return -1;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// ncm_set_interface: alternate setting 1 of the data interface has
+// the bulk endpoints, selecting it starts the NTB streams
+//-----------------------------------------------------------------
+static int ncm_set_interface(uint8_t if_num, uint8_t alt)
+{
+    if ( if_num == NCM_INTERFACE_COMM || alt > 1 )
+        return alt ? -1 : 0;
+
+    DEBUG_INFO("NCM: Data interface alt %d\n", alt);
+
+    ncm_stop();
+
+    if ( alt )
+    {
+        _active = 1;
+        ncm_queue(NCM_EP_OUT, &_req_out, _ntb_out, sizeof(_ntb_out), 0, ncm_out_done);
+        ncm_notify();
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// ncm_init: the bus reset completed the requests
+//-----------------------------------------------------------------
+static void ncm_init(void)
+{
+    _active = 0;
+    _in_fill = 0;
+    _in_queued = 0;
+    _in_off = NCM_NTH16_LEN;
+    _in_count = 0;
+    _in_seq = 0;
+    _flush_pending = 0;
+    ncm_ntb_defaults();
+}
+
+//-----------------------------------------------------------------
+// ncm_set_config: the data interface is back in alternate setting 0
+//-----------------------------------------------------------------
+static void ncm_set_config(unsigned char config)
+{
+    ncm_stop();
+    ncm_ntb_defaults();
+}
+
+//-----------------------------------------------------------------
+// usb_ncm_driver:
+//-----------------------------------------------------------------
+const USB_CLASS_DRIVER_TypeDef usb_ncm_driver =
+{
+    ncm_init,           // init
+    ncm_setup,          // setup
+    ncm_data,           // data
+    ncm_set_config,     // set_config
+    ncm_set_interface,  // set_interface
+    0,                  // ep_event
+    0                   // sof
+};
+
+//-----------------------------------------------------------------
+// usb_ncm_set_rx: callback of the received frames
+//-----------------------------------------------------------------
+void usb_ncm_set_rx(USB_NCM_RX rx)
+{
+    _rx = rx;
+}
+
+//-----------------------------------------------------------------
+// usb_ncm_set_flush: flush points of the IN NTB. It is queued when
+// it holds bytes (NTB header included) or datagrams, and with idle
+// as soon as no other NTB is on the bus. A full NTB is always
+// queued. Defaults: full NTB, NCM_IN_MAX_DATAGRAMS, idle.
+//-----------------------------------------------------------------
+void usb_ncm_set_flush(uint32_t bytes, uint16_t datagrams, uint8_t idle)
+{
+    _flush_bytes = bytes;
+    _flush_dgrams = datagrams;
+    _flush_idle = idle;
+}
+
+//-----------------------------------------------------------------
+// usb_ncm_send: add a frame to the IN NTB, -1 if the link is down,
+// the frame too long or all NTBs are queued (try again later)
+//-----------------------------------------------------------------
+int usb_ncm_send(const uint8_t *frame, uint16_t len)
+{
+    uint32_t off;
+
+    if (!_active || !len || len > _max_dgram)
+        return -1;
+
+    if (_in_queued == NCM_IN_NTBS)
+        return -1;
+
+    // the datagram and the NDP grown by one entry must fit
+    off = NCM_ALIGN_UP(_in_off);
+    if (_in_count && (_in_count == _in_max_dgrams ||
+        NCM_ALIGN_UP(off + len) + NCM_NDP16_LEN(_in_count + 1) > _in_max)) {
+        ncm_flush_in();
+
+        if (_in_queued == NCM_IN_NTBS)
+            return -1;
+
+        off = NCM_NTH16_LEN;
+    }
+
+    if (NCM_ALIGN_UP(off + len) + NCM_NDP16_LEN(_in_count + 1) > _in_max)
+        return -1;
+
+    memcpy(&_ntb_in[_in_fill][off], frame, len);
+    _in_dgram[_in_count][0] = off;
+    _in_dgram[_in_count][1] = len;
+    _in_count++;
+    _in_off = off + len;
+
+    if (_in_count >= _flush_dgrams || _in_off >= _flush_bytes || (_flush_idle && !_in_queued))
+        ncm_flush_in();
+
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// usb_ncm_flush: queue the IN NTB now, or when an NTB completes if
+// all are queued
+//-----------------------------------------------------------------
+void usb_ncm_flush(void)
+{
+    ncm_flush_in();
+}
+
+//-----------------------------------------------------------------
+// usb_ncm_link_up: the host selected the data interface
+//-----------------------------------------------------------------
+int usb_ncm_link_up(void)
+{
+    return _active;
+}
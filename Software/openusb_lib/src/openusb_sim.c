@@ -0,0 +1,643 @@
+//=================================================================
+//
+// Register level simulator of the controller
+// Models the registers, the endpoint FIFOs, the STS / INTSTS /
+// NAKSTS semantics and the interrupt line of the hardware, and a
+// scripted host issuing SETUP / OUT / IN transactions, so the stack
+// can be built and run on a workstation.
+// Data toggles, addressing and bus timing are not modelled.
+//
+// Only compiled with OPENUSB_SIM.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <string.h>
+#include "openusb_common.h"
+
+#ifdef OPENUSB_SIM
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define SIM_EP_NUM          USB_FUNC_ENDPOINTS
+#define SIM_FIFO_DEPTH      USB_FIFO_DEPTH
+#define SIM_MAX_PACKET      64
+#define SIM_REG_SPACE       0x1000
+
+//-----------------------------------------------------------------
+// Types
+//-----------------------------------------------------------------
+typedef struct _SIM_FIFO_TypeDef
+{
+    uint8_t     data[SIM_FIFO_DEPTH];
+    uint16_t    rd;
+    uint16_t    count;
+} SIM_FIFO_TypeDef;
+
+typedef struct _SIM_EP_TypeDef
+{
+    OPEN_USB_EPx_CFG_TypeDef    cfg;
+    OPEN_USB_EPx_THR_TypeDef    thr;
+    OPEN_USB_EPx_STS_TypeDef    sts;
+    uint32_t                    crc;
+    uint16_t                    tx_len;
+    uint16_t                    tx_min;     // bytes held back for, min(TX_LEN, TX_MIN)
+    uint32_t                    tx_tick;    // tx start seen by the SIE
+    uint8_t                     tx_active;  // tx busy of the SIE
+    uint32_t                    busy_pipe;  // tx_active of the last ticks, bit 0 the latest
+    uint16_t                    rx_rd;      // bytes of the packet read
+    SIM_FIFO_TypeDef            tx;
+    SIM_FIFO_TypeDef            rx;
+} SIM_EP_TypeDef;
+
+typedef struct _SIM_DEVICE_TypeDef
+{
+    OPEN_USB_FUNC_CTRL_TypeDef  func_ctrl;
+    OPEN_USB_FUNC_STAT_TypeDef  func_stat;
+    OPEN_USB_RST_CTRL_TypeDef   rst_ctrl;
+    uint32_t                    func_addr;
+    uint32_t                    intsts;
+    uint32_t                    naksts;
+    uint32_t                    lvlsts;
+    uint32_t                    lvl_cond;   // threshold conditions of the last tick
+    uint32_t                    nak_ctrl;
+    uint32_t                    sof_ctrl;
+    SIM_EP_TypeDef              ep[SIM_EP_NUM];
+} SIM_DEVICE_TypeDef;
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static SIM_DEVICE_TypeDef          _dev;
+static OPEN_USB_SIM_STATS_TypeDef  _stats;
+static void                      (*_isr)(void);
+static int                         _in_isr;
+static OPEN_USB_SIM_XFER_TypeDef  *_xfer_head;
+static OPEN_USB_SIM_XFER_TypeDef  *_xfer_tail;
+static uint32_t                    _host_next_tick;
+static uint32_t                    _sof_ticks;
+
+//-----------------------------------------------------------------
+// fifo
+//-----------------------------------------------------------------
+static void fifo_flush(SIM_FIFO_TypeDef *fifo)
+{
+    fifo->rd = 0;
+    fifo->count = 0;
+}
+
+static int fifo_push(SIM_FIFO_TypeDef *fifo, uint8_t data)
+{
+    if (fifo->count >= SIM_FIFO_DEPTH)
+        return 0;
+
+    fifo->data[(fifo->rd + fifo->count) % SIM_FIFO_DEPTH] = data;
+    fifo->count++;
+    return 1;
+}
+
+static uint8_t fifo_pop(SIM_FIFO_TypeDef *fifo)
+{
+    uint8_t data;
+
+    if (fifo->count == 0)
+        return 0;
+
+    data = fifo->data[fifo->rd];
+    fifo->rd = (fifo->rd + 1) % SIM_FIFO_DEPTH;
+    fifo->count--;
+    return data;
+}
+
+//-----------------------------------------------------------------
+// crc32_byte: same as usbf_crc32
+//-----------------------------------------------------------------
+static uint32_t crc32_byte(uint32_t crc, uint8_t data)
+{
+    int i;
+
+    crc ^= data;
+    for (i = 0; i < 8; i++)
+        crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320 : 0);
+    return crc;
+}
+
+//-----------------------------------------------------------------
+// tx busy: set / cleared in the SIE, the register sees it
+// SIM_SYNC_TICKS later as through the level sync of the hardware.
+// The sync delays the level, a busy shorter than that is not lost.
+//-----------------------------------------------------------------
+static void ep_tx_active(SIM_EP_TypeDef *ep, uint8_t active)
+{
+    ep->tx_active = active;
+}
+
+static void ep_sts_sync(SIM_EP_TypeDef *ep)
+{
+    ep->sts.b.tx_busy = (ep->busy_pipe >> (SIM_SYNC_TICKS - 1)) & 1;
+}
+
+//-----------------------------------------------------------------
+// ep_flush / bus_reset
+//-----------------------------------------------------------------
+static void ep_flush_tx(SIM_EP_TypeDef *ep)
+{
+    fifo_flush(&ep->tx);
+    ep->tx_min = 0;
+    ep_tx_active(ep, 0);
+    ep->sts.b.tx_err = 0;
+}
+
+static void ep_flush_rx(SIM_EP_TypeDef *ep)
+{
+    fifo_flush(&ep->rx);
+    ep->sts.b.rx_ready = 0;
+    ep->sts.b.rx_setup = 0;
+    ep->sts.b.rx_err = 0;
+    ep->sts.b.rx_count = 0;
+    ep->rx_rd = 0;
+}
+
+static void bus_reset(void)
+{
+    int i;
+
+    for (i = 0; i < SIM_EP_NUM; i++) {
+        if (_dev.rst_ctrl.b.flush) {
+            ep_flush_tx(&_dev.ep[i]);
+            ep_flush_rx(&_dev.ep[i]);
+        }
+        if (_dev.rst_ctrl.b.clr_stall)
+            _dev.ep[i].cfg.b.stall_ep = 0;
+    }
+
+    if (_dev.rst_ctrl.b.clr_addr)
+        _dev.func_addr = 0;
+
+    _dev.func_stat.b.rst = 1;
+}
+
+//-----------------------------------------------------------------
+// lvl_update: a level status bit is set when its threshold condition
+// starts to hold, as USB_EP_LVLSTS of usbf_csr
+//-----------------------------------------------------------------
+static void lvl_update(void)
+{
+    SIM_EP_TypeDef *ep;
+    uint32_t cond = 0;
+    int i;
+
+    for (i = 0; i < SIM_EP_NUM; i++) {
+        ep = &_dev.ep[i];
+        if (ep->tx.count < ep->thr.b.tx_thr)
+            cond |= (1u << i);
+        if (ep->rx.count > ep->thr.b.rx_thr)
+            cond |= (1u << (16 + i));
+    }
+
+    _dev.lvlsts |= cond & ~_dev.lvl_cond;
+    _dev.lvl_cond = cond;
+}
+
+//-----------------------------------------------------------------
+// irq: same as intr_o of usbf_csr
+//-----------------------------------------------------------------
+static int sim_irq(void)
+{
+    SIM_EP_TypeDef *ep;
+    int i;
+
+    for (i = 0; i < SIM_EP_NUM; i++) {
+        ep = &_dev.ep[i];
+
+        if ((_dev.intsts & (1u << i)) && ep->cfg.b.int_rx)
+            return 1;
+        if ((_dev.intsts & (1u << (16 + i))) && ep->cfg.b.int_tx)
+            return 1;
+        if ((_dev.naksts & (1u << i)) && ep->cfg.b.int_in_nak)
+            return 1;
+        if ((_dev.naksts & (1u << (16 + i))) && ep->cfg.b.int_out_nak)
+            return 1;
+        if ((_dev.lvlsts & (1u << (16 + i))) && ep->cfg.b.int_rx_lvl)
+            return 1;
+        if ((_dev.lvlsts & (1u << i)) && ep->cfg.b.int_tx_lvl)
+            return 1;
+    }
+
+    return (_dev.func_stat.b.rst && _dev.func_ctrl.b.int_en_rst) ||
+           (_dev.func_stat.b.sof && _dev.func_ctrl.b.int_en_sof) ||
+           (_dev.func_stat.b.presof && _dev.func_ctrl.b.int_en_presof);
+}
+
+//-----------------------------------------------------------------
+// host_out: one OUT transaction, 0 if NAKed
+//-----------------------------------------------------------------
+static int host_out(OPEN_USB_SIM_XFER_TypeDef *xfer, uint16_t len)
+{
+    SIM_EP_TypeDef *ep = &_dev.ep[xfer->ep];
+    SIM_EP_TypeDef *lb;
+    uint16_t i;
+
+    // hardware loopback to the IN endpoint
+    if (ep->cfg.b.loopback_en) {
+        lb = &_dev.ep[ep->cfg.b.loopback_ep % SIM_EP_NUM];
+        if (lb->tx_active)
+            return 0;
+
+        for (i = 0; i < len; i++)
+            fifo_push(&lb->tx, xfer->buf[xfer->actual + i]);
+        lb->tx_len = len;
+        lb->tx_min = 0;
+        lb->tx_tick = _stats.ticks + SIM_SYNC_TICKS;
+        ep_tx_active(lb, 1);
+        return 1;
+    }
+
+    if (ep->sts.b.rx_ready) {
+        _dev.naksts |= (1u << (16 + xfer->ep));
+        return 0;
+    }
+
+    for (i = 0; i < len; i++)
+        if (!fifo_push(&ep->rx, xfer->buf[xfer->actual + i]))
+            ep->sts.b.rx_err = 1;
+
+    ep->sts.b.rx_count = len;
+    ep->sts.b.rx_ready = 1;
+    ep->sts.b.rx_setup = (xfer->type == SIM_XFER_SETUP);
+    ep->rx_rd = 0;
+    _dev.intsts |= (1u << xfer->ep);
+    return 1;
+}
+
+//-----------------------------------------------------------------
+// host_in: one IN transaction, -1 if NAKed, else the packet length
+//-----------------------------------------------------------------
+static int host_in(OPEN_USB_SIM_XFER_TypeDef *xfer)
+{
+    SIM_EP_TypeDef *ep = &_dev.ep[xfer->ep];
+    uint16_t i;
+    uint8_t data;
+
+    // not started, or held until tx_min bytes are in the FIFO
+    if (!ep->tx_active || _stats.ticks < ep->tx_tick || ep->tx.count < ep->tx_min) {
+        _dev.naksts |= (1u << xfer->ep);
+        return -1;
+    }
+
+    if (ep->tx.count < ep->tx_len)
+        ep->sts.b.tx_err = 1;
+
+    for (i = 0; i < ep->tx_len; i++) {
+        data = fifo_pop(&ep->tx);
+        if (xfer->actual + i < xfer->len)
+            xfer->buf[xfer->actual + i] = data;
+    }
+
+    ep_tx_active(ep, 0);
+    _dev.intsts |= (1u << (16 + xfer->ep));
+    return ep->tx_len;
+}
+
+//-----------------------------------------------------------------
+// host_step: next transaction of the current transfer
+//-----------------------------------------------------------------
+static void host_step(void)
+{
+    OPEN_USB_SIM_XFER_TypeDef *xfer = _xfer_head;
+    SIM_EP_TypeDef *ep;
+    uint16_t len;
+    int done = 0;
+    int pkt;
+
+    if (!xfer)
+        return;
+
+    ep = &_dev.ep[xfer->ep];
+
+    if (xfer->type == SIM_XFER_RESET) {
+        bus_reset();
+        done = 1;
+    } else if (xfer->type == SIM_XFER_SETUP) {
+        // SETUP is never NAKed, without rx space the SIE ignores it
+        // (no handshake) and the host retries
+        if (ep->sts.b.rx_ready) {
+            xfer->naks++;
+        } else {
+            ep_flush_rx(ep);
+            ep->cfg.b.stall_ep = 0;
+            host_out(xfer, 8);
+            xfer->actual = 8;
+            _stats.packets++;
+            done = 1;
+        }
+    } else if (ep->cfg.b.stall_ep) {
+        xfer->status = SIM_XFER_STALL;
+    } else if (xfer->type == SIM_XFER_OUT) {
+        len = MIN(xfer->len - xfer->actual, SIM_MAX_PACKET);
+        if (host_out(xfer, len)) {
+            xfer->actual += len;
+            _stats.packets++;
+            done = (xfer->actual >= xfer->len);
+        } else {
+            xfer->naks++;
+            _stats.naks++;
+        }
+    } else {
+        pkt = host_in(xfer);
+        if (pkt >= 0) {
+            xfer->actual = MIN(xfer->actual + pkt, xfer->len);
+            _stats.packets++;
+            done = (pkt < SIM_MAX_PACKET) || (xfer->actual >= xfer->len);
+        } else {
+            xfer->naks++;
+            _stats.naks++;
+        }
+    }
+
+    if (done)
+        xfer->status = SIM_XFER_DONE;
+    else if (xfer->naks >= SIM_HOST_NAK_LIMIT)
+        xfer->status = SIM_XFER_TIMEOUT;
+
+    if (xfer->status != SIM_XFER_PENDING) {
+        _xfer_head = xfer->next;
+        if (!_xfer_head)
+            _xfer_tail = NULL;
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_tick: one step of the simulated time
+//-----------------------------------------------------------------
+void openusb_sim_tick(void)
+{
+    uint8_t i;
+
+    _stats.ticks++;
+
+    for (i = 0; i < SIM_EP_NUM; i++)
+        _dev.ep[i].busy_pipe = (_dev.ep[i].busy_pipe << 1) | _dev.ep[i].tx_active;
+
+    // the next (micro)frame
+    if (_sof_ticks && !(_stats.ticks % _sof_ticks)) {
+        _dev.func_stat.b.frame++;
+        _dev.func_stat.b.sof = 1;
+    }
+
+    if (_stats.ticks >= _host_next_tick) {
+        host_step();
+        _host_next_tick = _stats.ticks + SIM_HOST_GAP;
+    }
+
+    lvl_update();
+
+    if (_isr && !_in_isr && sim_irq()) {
+        _in_isr = 1;
+        _stats.irqs++;
+        _isr();
+        _in_isr = 0;
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_read
+//-----------------------------------------------------------------
+uint32_t openusb_sim_read(uint32_t addr)
+{
+    uint32_t offset = addr - USB_BASE;
+    uint32_t rdata = 0;
+    SIM_EP_TypeDef *ep;
+    OPEN_USB_EPx_LEVEL_TypeDef level;
+    uint8_t data;
+    int i;
+
+    _stats.reads++;
+
+    // SoC registers are not modelled
+    if (offset >= SIM_REG_SPACE) {
+        openusb_sim_tick();
+        return 0;
+    }
+
+    if (offset >= 0x20 && offset < 0x20 + 0x20 * SIM_EP_NUM) {
+        ep = &_dev.ep[(offset - 0x20) / USB_EP_STRIDE];
+
+        switch (offset & (USB_EP_STRIDE - 1)) {
+        case 0x00: rdata = ep->cfg.d32; break;
+        case 0x04: rdata = ep->tx_len; break;
+        case 0x0C:
+            ep_sts_sync(ep);
+            rdata = ep->sts.d32;
+            break;
+        case 0x10:
+            _stats.data_reads++;
+            data = fifo_pop(&ep->rx);
+            if (ep->cfg.b.crc_en)
+                ep->crc = crc32_byte(ep->crc, data);
+            if (ep->sts.b.rx_ready && ++ep->rx_rd == ep->sts.b.rx_count && ep->cfg.b.auto_accept)
+                ep->sts.b.rx_ready = 0;
+            rdata = data;
+            break;
+        case 0x14:
+            level.d32 = 0;
+            level.b.rx_level = ep->rx.count;
+            level.b.tx_level = ep->tx.count;
+            rdata = level.d32;
+            break;
+        case 0x18: rdata = ep->thr.d32; break;
+        case 0x1C: rdata = ep->crc; break;
+        default: break;
+        }
+    } else if (offset >= 0x280 && offset < 0x280 + 2 * SIM_EP_NUM) {
+        for (i = 0; i < 2; i++) {
+            ep = &_dev.ep[((offset - 0x280) / 4) * 2 + i];
+            if (ep >= &_dev.ep[SIM_EP_NUM])
+                break;
+            ep_sts_sync(ep);
+            rdata |= ((ep->sts.d32 & 0x7FF) | ((ep->sts.d32 >> 5) & 0xF800)) << (16 * i);
+        }
+    } else {
+        switch (offset) {
+        case 0x00: rdata = _dev.func_ctrl.d32; break;
+        case 0x04: rdata = _dev.func_stat.d32; break;
+        case 0x08: rdata = _dev.func_addr; break;
+        case 0x0C: rdata = _dev.intsts; break;
+        case 0x10: rdata = _dev.naksts; break;
+        case 0x14: rdata = _dev.nak_ctrl; break;
+        case 0x18: rdata = _dev.sof_ctrl; break;
+        case 0x240: rdata = _dev.rst_ctrl.d32; break;
+        case 0x244: rdata = _dev.lvlsts; break;
+        default: break;
+        }
+    }
+
+    openusb_sim_tick();
+    return rdata;
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_write
+//-----------------------------------------------------------------
+void openusb_sim_write(uint32_t addr, uint32_t wdata)
+{
+    uint32_t offset = addr - USB_BASE;
+    SIM_EP_TypeDef *ep;
+    OPEN_USB_EPx_TX_CTRL_TypeDef tx_ctrl;
+    OPEN_USB_EPx_RX_CTRL_TypeDef rx_ctrl;
+    OPEN_USB_FUNC_STAT_TypeDef func_stat;
+
+    _stats.writes++;
+
+    if (offset >= SIM_REG_SPACE) {
+        openusb_sim_tick();
+        return;
+    }
+
+    if (offset >= 0x20 && offset < 0x20 + 0x20 * SIM_EP_NUM) {
+        ep = &_dev.ep[(offset - 0x20) / USB_EP_STRIDE];
+
+        switch (offset & (USB_EP_STRIDE - 1)) {
+        case 0x00: ep->cfg.d32 = wdata; break;
+        case 0x04:
+            tx_ctrl.d32 = wdata;
+            if (tx_ctrl.b.tx_flush)
+                ep_flush_tx(ep);
+            if (tx_ctrl.b.tx_start) {
+                ep->tx_len = tx_ctrl.b.tx_len;
+                ep->tx_min = MIN(tx_ctrl.b.tx_min, tx_ctrl.b.tx_len);
+                ep->tx_tick = _stats.ticks + SIM_SYNC_TICKS;
+                ep_tx_active(ep, 1);
+                ep->sts.b.tx_err = 0;
+            }
+            break;
+        case 0x08:
+            rx_ctrl.d32 = wdata;
+            if (rx_ctrl.b.rx_flush)
+                ep_flush_rx(ep);
+            if (rx_ctrl.b.rx_accept)
+                ep->sts.b.rx_ready = 0;
+            break;
+        case 0x10:
+            _stats.data_writes++;
+            fifo_push(&ep->tx, (uint8_t)wdata);
+            break;
+        case 0x18: ep->thr.d32 = wdata; break;
+        case 0x1C: ep->crc = wdata; break;
+        default: break;
+        }
+    } else {
+        switch (offset) {
+        case 0x00: _dev.func_ctrl.d32 = wdata; break;
+        case 0x04:
+            func_stat.d32 = wdata;
+            if (func_stat.b.rst)    _dev.func_stat.b.rst = 0;
+            if (func_stat.b.sof)    _dev.func_stat.b.sof = 0;
+            if (func_stat.b.presof) _dev.func_stat.b.presof = 0;
+            break;
+        case 0x08: _dev.func_addr = wdata & USB_ADDRESS_MASK; break;
+        case 0x0C: _dev.intsts &= ~wdata; break;
+        case 0x10: _dev.naksts &= ~wdata; break;
+        case 0x14: _dev.nak_ctrl = wdata; break;
+        case 0x18: _dev.sof_ctrl = wdata; break;
+        case 0x240: _dev.rst_ctrl.d32 = wdata; break;
+        case 0x244: _dev.lvlsts &= ~wdata; break;
+        default: break;
+        }
+    }
+
+    openusb_sim_tick();
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_delay_us: the simulated time goes on, one tick per us
+//-----------------------------------------------------------------
+void openusb_sim_delay_us(uint32_t us)
+{
+    while (us--)
+        openusb_sim_tick();
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_init: registers at the reset values
+//-----------------------------------------------------------------
+void openusb_sim_init(void)
+{
+    int i;
+
+    memset(&_dev, 0, sizeof(_dev));
+    memset(&_stats, 0, sizeof(_stats));
+
+    _dev.rst_ctrl.b.flush = 1;
+    _dev.rst_ctrl.b.clr_stall = 1;
+    _dev.rst_ctrl.b.clr_addr = 1;
+    _dev.nak_ctrl = 6000;
+    _dev.sof_ctrl = (3 << 8);
+
+    for (i = 0; i < SIM_EP_NUM; i++)
+        _dev.ep[i].crc = 0xFFFFFFFF;
+
+    _isr = NULL;
+    _in_isr = 0;
+    _xfer_head = NULL;
+    _xfer_tail = NULL;
+    _host_next_tick = 0;
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_set_isr: called when the interrupt line is high
+//-----------------------------------------------------------------
+void openusb_sim_set_isr(void (*isr)(void))
+{
+    _isr = isr;
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_set_sof: a SOF every ticks ticks, 0 for none
+//-----------------------------------------------------------------
+void openusb_sim_set_sof(uint32_t ticks)
+{
+    _sof_ticks = ticks;
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_get_stats
+//-----------------------------------------------------------------
+void openusb_sim_get_stats(OPEN_USB_SIM_STATS_TypeDef *stats)
+{
+    *stats = _stats;
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_host_submit: queue a transfer of the host, xfer must
+// stay valid until its status is not SIM_XFER_PENDING
+//-----------------------------------------------------------------
+void openusb_sim_host_submit(OPEN_USB_SIM_XFER_TypeDef *xfer, uint8_t type, uint8_t ep, uint8_t *buf, uint16_t len)
+{
+    xfer->type = type;
+    xfer->ep = ep % SIM_EP_NUM;
+    xfer->buf = buf;
+    xfer->len = len;
+    xfer->actual = 0;
+    xfer->status = SIM_XFER_PENDING;
+    xfer->naks = 0;
+    xfer->next = NULL;
+
+    if (_xfer_tail)
+        _xfer_tail->next = xfer;
+    else
+        _xfer_head = xfer;
+    _xfer_tail = xfer;
+}
+
+//-----------------------------------------------------------------
+// openusb_sim_host_idle: all the transfers are finished
+//-----------------------------------------------------------------
+int openusb_sim_host_idle(void)
+{
+    return (_xfer_head == NULL);
+}
+
+#endif
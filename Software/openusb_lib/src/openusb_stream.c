@@ -0,0 +1,253 @@
+//=================================================================
+//
+// Ring buffer streaming on bulk endpoints
+// The rx ring is filled from the endpoint FIFO and the tx ring is
+// drained to it by the interrupt top half, so the application copies
+// each byte once, into or out of the ring.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include "openusb_common.h"
+#include "openusb_stream.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static OPEN_USB_RING_TypeDef _rx_ring[USB_FUNC_ENDPOINTS];
+static OPEN_USB_RING_TypeDef _tx_ring[USB_FUNC_ENDPOINTS];
+
+// rx packet left in the FIFO for lack of ring space, the interrupt
+// hands it over to openusb_stream_rx_release
+static volatile uint8_t _rx_pending[USB_FUNC_ENDPOINTS];
+// tx packet in flight, a tx complete interrupt will follow
+static volatile uint8_t _tx_active[USB_FUNC_ENDPOINTS];
+
+//-----------------------------------------------------------------
+// ring_open: size must be a power of 2
+//-----------------------------------------------------------------
+static int ring_open(OPEN_USB_RING_TypeDef *ring, uint8_t *buf, uint32_t size)
+{
+    if (!buf || !size || (size & (size - 1)))
+        return -1;
+
+    ring->buf  = buf;
+    ring->size = size;
+    ring->head = 0;
+    ring->tail = 0;
+    return 0;
+}
+
+//-----------------------------------------------------------------
+// stream_rx_fill: move the rx packet of the FIFO to the ring and
+// accept it, the caller checked the space
+//-----------------------------------------------------------------
+static void stream_rx_fill(uint8_t endpoint, uint32_t len)
+{
+    OPEN_USB_RING_TypeDef *ring = &_rx_ring[endpoint];
+    OPEN_USB_EPx_RX_CTRL_TypeDef ep_rx_ctrl;
+    uint32_t mask = ring->size - 1;
+    uint32_t head = ring->head;
+    uint32_t i;
+
+    for (i = 0; i < len; i++)
+        ring->buf[(head + i) & mask] = OPEN_USB_READ_REG(USB_EP_DATA(endpoint));
+
+    // the data is in the ring before the consumer can see it
+    OPENUSB_BARRIER();
+    ring->head = head + len;
+
+    ep_rx_ctrl.d32 = 0;
+    ep_rx_ctrl.b.rx_accept = 1;
+    OPEN_USB_WRITE_REG(USB_EP_RX_CTRL(endpoint), ep_rx_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// stream_tx_load: load the next packet of the ring to the FIFO and
+// start it, or go idle if the ring is empty
+//-----------------------------------------------------------------
+static void stream_tx_load(uint8_t endpoint)
+{
+    OPEN_USB_RING_TypeDef *ring = &_tx_ring[endpoint];
+    OPEN_USB_EPx_TX_CTRL_TypeDef ep_tx_ctrl;
+    uint32_t mask = ring->size - 1;
+    uint32_t tail = ring->tail;
+    uint32_t len;
+    uint32_t i;
+
+    len = MIN(ring->head - tail, openusb_get_max_packet(endpoint));
+    if (len == 0) {
+        _tx_active[endpoint] = 0;
+        return;
+    }
+
+    for (i = 0; i < len; i++)
+        OPEN_USB_WRITE_REG(USB_EP_DATA(endpoint), ring->buf[(tail + i) & mask]);
+
+    // the data is read before the producer can reuse it
+    OPENUSB_BARRIER();
+    ring->tail = tail + len;
+
+    ep_tx_ctrl.d32 = 0;
+    ep_tx_ctrl.b.tx_start = 1;
+    ep_tx_ctrl.b.tx_len = len;
+    OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(endpoint), ep_tx_ctrl.d32);
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_rx_open: stream the OUT packets of endpoint into
+// buf, size a power of 2 and at least the max packet size.
+// Auto accept is turned off, the ring decides when to accept.
+//-----------------------------------------------------------------
+int openusb_stream_rx_open(uint8_t endpoint, uint8_t *buf, uint32_t size)
+{
+    if (endpoint == ENDPOINT_CONTROL || endpoint >= USB_FUNC_ENDPOINTS ||
+        size < openusb_get_max_packet(endpoint))
+        return -1;
+
+    openusb_set_auto_accept(endpoint, 0);
+    _rx_pending[endpoint] = 0;
+    return ring_open(&_rx_ring[endpoint], buf, size);
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_tx_open: stream buf to the IN endpoint, size a
+// power of 2. openusb_tx_data must not be used on the endpoint.
+//-----------------------------------------------------------------
+int openusb_stream_tx_open(uint8_t endpoint, uint8_t *buf, uint32_t size)
+{
+    if (endpoint == ENDPOINT_CONTROL || endpoint >= USB_FUNC_ENDPOINTS)
+        return -1;
+
+    _tx_active[endpoint] = 0;
+    return ring_open(&_tx_ring[endpoint], buf, size);
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_close: back to openusb_get_rx_data/openusb_tx_data
+//-----------------------------------------------------------------
+void openusb_stream_close(uint8_t endpoint)
+{
+    _rx_ring[endpoint].buf = 0;
+    _tx_ring[endpoint].buf = 0;
+    _rx_pending[endpoint] = 0;
+    _tx_active[endpoint] = 0;
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_rx_peek: received data in place, len is set to the
+// contiguous length (the rest follows after the wrap)
+//-----------------------------------------------------------------
+uint8_t *openusb_stream_rx_peek(uint8_t endpoint, uint32_t *len)
+{
+    OPEN_USB_RING_TypeDef *ring = &_rx_ring[endpoint];
+    uint32_t tail = ring->tail;
+    uint32_t off = tail & (ring->size - 1);
+
+    *len = MIN(ring->head - tail, ring->size - off);
+    return &ring->buf[off];
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_rx_release: len bytes of the peek are consumed, the
+// packet held back for lack of space is taken now if it fits
+//-----------------------------------------------------------------
+void openusb_stream_rx_release(uint8_t endpoint, uint32_t len)
+{
+    OPEN_USB_RING_TypeDef *ring = &_rx_ring[endpoint];
+    uint32_t count;
+
+    OPENUSB_BARRIER();
+    ring->tail += len;
+    OPENUSB_BARRIER();
+
+    // no rx interrupt of the endpoint until the pending packet is
+    // accepted, so the ring has one producer at a time
+    if (_rx_pending[endpoint]) {
+        count = openusb_get_rx_count(endpoint);
+        if (ring->size - (ring->head - ring->tail) >= count) {
+            _rx_pending[endpoint] = 0;
+            stream_rx_fill(endpoint, count);
+        }
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_tx_reserve: free space of the tx ring to write in
+// place, len is set to the contiguous length
+//-----------------------------------------------------------------
+uint8_t *openusb_stream_tx_reserve(uint8_t endpoint, uint32_t *len)
+{
+    OPEN_USB_RING_TypeDef *ring = &_tx_ring[endpoint];
+    uint32_t head = ring->head;
+    uint32_t off = head & (ring->size - 1);
+
+    *len = MIN(ring->size - (head - ring->tail), ring->size - off);
+    return &ring->buf[off];
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_tx_commit: len bytes of the reserve are written,
+// starts the endpoint if it is idle
+//-----------------------------------------------------------------
+void openusb_stream_tx_commit(uint8_t endpoint, uint32_t len)
+{
+    OPEN_USB_RING_TypeDef *ring = &_tx_ring[endpoint];
+
+    OPENUSB_BARRIER();
+    ring->head += len;
+    OPENUSB_BARRIER();
+
+    // an interrupt going idle after this point saw the new head
+    if (!_tx_active[endpoint]) {
+        _tx_active[endpoint] = 1;
+        stream_tx_load(endpoint);
+    }
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_isr_rx: rx ready of a stream endpoint, 0 if the
+// endpoint does not stream
+//-----------------------------------------------------------------
+int openusb_stream_isr_rx(uint8_t endpoint, uint16_t len)
+{
+    OPEN_USB_RING_TypeDef *ring = &_rx_ring[endpoint];
+
+    if (!ring->buf)
+        return 0;
+
+    if (ring->size - (ring->head - ring->tail) >= len)
+        stream_rx_fill(endpoint, len);
+    else
+        _rx_pending[endpoint] = 1;
+
+    return 1;
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_isr_tx: tx complete of a stream endpoint, 0 if the
+// endpoint does not stream
+//-----------------------------------------------------------------
+int openusb_stream_isr_tx(uint8_t endpoint)
+{
+    if (!_tx_ring[endpoint].buf)
+        return 0;
+
+    stream_tx_load(endpoint);
+    return 1;
+}
+
+//-----------------------------------------------------------------
+// openusb_stream_reset: the FIFOs are flushed by the bus reset, the
+// packets in flight are lost, the data in the rings is kept
+//-----------------------------------------------------------------
+void openusb_stream_reset(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < USB_FUNC_ENDPOINTS; i++) {
+        _rx_pending[i] = 0;
+        _tx_active[i] = 0;
+    }
+}
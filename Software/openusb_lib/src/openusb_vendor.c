@@ -0,0 +1,318 @@
+//=================================================================
+//
+// Vendor specific bulk streaming class
+// The IN pipe is kept busy with two transfer requests: the complete
+// callback of one refills its buffer from the producer and queues
+// it behind the other, so the endpoint never waits for the
+// application while data is available.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include "openusb_vendor.h"
+#include "openusb_ep.h"
+
+//-----------------------------------------------------------------
+// Defines:
+//-----------------------------------------------------------------
+#define VENDOR_EP_OUT           (VENDOR_ENDPOINT_BULK_OUT)
+#define VENDOR_EP_IN            (VENDOR_ENDPOINT_BULK_IN | ENDPOINT_DIR_IN)
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static USB_VENDOR_CONFIG_TypeDef _cfg;
+static USB_VENDOR_STATS_TypeDef _stats;
+static uint8_t _configured;
+static uint8_t _running;
+
+// transfer framing of the IN pipe
+static uint32_t _frame_len;
+static uint8_t  _frame_zlp;
+
+static OPEN_USB_REQ_TypeDef _req_in[2];
+static OPEN_USB_REQ_TypeDef _req_out;
+static uint8_t _in_busy;            // bit i: _req_in[i] queued
+
+static uint8_t _resp[VENDOR_STATS_LEN];
+
+//-----------------------------------------------------------------
+// get_le32 / put_le32:
+//-----------------------------------------------------------------
+static uint32_t get_le32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void put_le32(uint8_t *p, uint32_t v)
+{
+    p[0] = v;
+    p[1] = v >> 8;
+    p[2] = v >> 16;
+    p[3] = v >> 24;
+}
+
+static void vendor_in_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+static void vendor_out_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req);
+
+//-----------------------------------------------------------------
+// vendor_fill: produce into the free IN buffers and queue them
+//-----------------------------------------------------------------
+static void vendor_fill(void)
+{
+    OPEN_USB_REQ_TypeDef *req;
+    uint32_t len;
+    int i;
+
+    for (i = 0; i < 2 && _running && _configured; i++) {
+        req = &_req_in[i];
+
+        if (_in_busy & (1 << i))
+            continue;
+
+        len = _cfg.produce(_cfg.in_buf[i], _frame_len);
+        if (!len)
+            break;
+
+        req->buf = _cfg.in_buf[i];
+        req->len = MIN(len, _frame_len);
+        req->zlp = _frame_zlp;
+        req->complete = vendor_in_done;
+        _in_busy |= (1 << i);
+        openusb_ep_queue(VENDOR_EP_IN, req);
+    }
+}
+
+//-----------------------------------------------------------------
+// vendor_in_done: an IN transfer is on the host, refill it
+//-----------------------------------------------------------------
+static void vendor_in_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    _in_busy &= ~(1 << (req - _req_in));
+
+    if (req->status != OPENUSB_REQ_DONE)
+        return;
+
+    _stats.in_bytes += req->actual;
+    _stats.in_xfers++;
+
+    vendor_fill();
+
+    // the pipe ran dry, the host sees NAKs until usb_vendor_kick
+    if (_running && !_in_busy)
+        _stats.underruns++;
+}
+
+//-----------------------------------------------------------------
+// vendor_out_start: wait for the next OUT transfer
+//-----------------------------------------------------------------
+static void vendor_out_start(void)
+{
+    if (!_cfg.out_buf)
+        return;
+
+    _req_out.buf = _cfg.out_buf;
+    _req_out.len = _cfg.out_size;
+    _req_out.zlp = 0;
+    _req_out.complete = vendor_out_done;
+    openusb_ep_queue(VENDOR_EP_OUT, &_req_out);
+}
+
+//-----------------------------------------------------------------
+// vendor_out_done: an OUT transfer arrived
+//-----------------------------------------------------------------
+static void vendor_out_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req)
+{
+    if (req->status == OPENUSB_REQ_CANCELLED || req->status == OPENUSB_REQ_RESET)
+        return;
+
+    if (req->status == OPENUSB_REQ_DONE) {
+        _stats.out_bytes += req->actual;
+        _stats.out_xfers++;
+
+        if (_cfg.consume)
+            _cfg.consume(req->buf, req->actual);
+    } else {
+        DEBUG_INFO("Vendor: OUT overflow, %d bytes dropped\n", req->actual);
+    }
+
+    vendor_out_start();
+}
+
+//-----------------------------------------------------------------
+// vendor_setup: vendor requests of the interface
+//-----------------------------------------------------------------
+static void vendor_setup(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
+{
+    if ( (request->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_VENDOR_REQUEST )
+    {
+        openusb_control_endpoint_stall();
+        return;
+    }
+
+    switch ( request->bRequest )
+    {
+    case VENDOR_REQ_START:
+        DEBUG_INFO("Vendor: Start\n");
+        openusb_control_endpoint_send_status();
+        usb_vendor_start();
+        break;
+    case VENDOR_REQ_STOP:
+        DEBUG_INFO("Vendor: Stop\n");
+        openusb_control_endpoint_send_status();
+        usb_vendor_stop();
+        break;
+    case VENDOR_REQ_GET_STATS:
+        put_le32(&_resp[0], _stats.in_bytes);
+        put_le32(&_resp[4], _stats.in_xfers);
+        put_le32(&_resp[8], _stats.out_bytes);
+        put_le32(&_resp[12], _stats.out_xfers);
+        put_le32(&_resp[16], _stats.underruns);
+        usb_control_send( _resp, VENDOR_STATS_LEN, request->wLength );
+        break;
+    default:
+        DEBUG_INFO("Vendor: Unknown request %x\n", request->bRequest);
+        openusb_control_endpoint_stall();
+        break;
+    }
+}
+
+//-----------------------------------------------------------------
+// vendor_data: requests with an OUT data stage, -1 to STALL
+//-----------------------------------------------------------------
+static int vendor_data(DEVICE_REQUEST_TypeDef *request, unsigned char *data)
+{
+    if ( (request->bmRequestType & USB_REQUEST_TYPE_MASK) != USB_VENDOR_REQUEST )
+        return -1;
+
+    if ( request->bRequest == VENDOR_REQ_SET_FRAMING )
+    {
+        // the length and the ZLP flag, a shorter data stage is refused
+        if ( request->wLength < VENDOR_FRAMING_LEN )
+        {
+            DEBUG_INFO("Vendor: Framing of %d bytes too short\n", request->wLength);
+            return -1;
+        }
+
+        DEBUG_INFO("Vendor: Framing %d bytes, ZLP %d\n", get_le32(data), data[4]);
+        usb_vendor_set_framing(get_le32(data), data[4]);
+        return 0;
+    }
+
+    DEBUG_INFO("Vendor: Unknown request %x\n", request->bRequest);
+    return -1;
+}
+
+//-----------------------------------------------------------------
+// vendor_abort: cancel all requests, the callbacks see CANCELLED
+//-----------------------------------------------------------------
+static void vendor_abort(void)
+{
+    _running = 0;
+    openusb_ep_dequeue(VENDOR_EP_IN, &_req_in[0]);
+    openusb_ep_dequeue(VENDOR_EP_IN, &_req_in[1]);
+    openusb_ep_dequeue(VENDOR_EP_OUT, &_req_out);
+}
+
+//-----------------------------------------------------------------
+// vendor_init: the bus reset completed the requests
+//-----------------------------------------------------------------
+static void vendor_init(void)
+{
+    _configured = 0;
+    _running = 0;
+    _in_busy = 0;
+}
+
+//-----------------------------------------------------------------
+// vendor_set_config:
+//-----------------------------------------------------------------
+static void vendor_set_config(unsigned char config)
+{
+    vendor_abort();
+
+    _configured = config ? 1 : 0;
+    if (_configured)
+        vendor_out_start();
+}
+
+//-----------------------------------------------------------------
+// usb_vendor_driver:
+//-----------------------------------------------------------------
+const USB_CLASS_DRIVER_TypeDef usb_vendor_driver =
+{
+    vendor_init,        // init
+    vendor_setup,       // setup
+    vendor_data,        // data
+    vendor_set_config,  // set_config
+    0,                  // set_interface
+    0,                  // ep_event
+    0                   // sof
+};
+
+//-----------------------------------------------------------------
+// usb_vendor_config: buffers and callbacks, before the stream runs.
+// The framing is one in_size transfer without ZLP.
+//-----------------------------------------------------------------
+void usb_vendor_config(const USB_VENDOR_CONFIG_TypeDef *cfg)
+{
+    _cfg = *cfg;
+    _frame_len = cfg->in_size;
+    _frame_zlp = 0;
+}
+
+//-----------------------------------------------------------------
+// usb_vendor_set_framing: length of the IN transfers, up to in_size
+// (0 for in_size). With zlp a full length transfer ends with a ZLP,
+// so host reads larger than the framing still end per transfer.
+// Used from the next transfer on.
+//-----------------------------------------------------------------
+void usb_vendor_set_framing(uint32_t xfer_len, uint8_t zlp)
+{
+    _frame_len = (xfer_len && xfer_len < _cfg.in_size) ? xfer_len : _cfg.in_size;
+    _frame_zlp = zlp ? 1 : 0;
+}
+
+//-----------------------------------------------------------------
+// usb_vendor_start: clear the stats and stream the IN pipe of the
+// configured device, the configuration stops it
+//-----------------------------------------------------------------
+void usb_vendor_start(void)
+{
+    _stats.in_bytes = 0;
+    _stats.in_xfers = 0;
+    _stats.out_bytes = 0;
+    _stats.out_xfers = 0;
+    _stats.underruns = 0;
+
+    _running = 1;
+    vendor_fill();
+}
+
+//-----------------------------------------------------------------
+// usb_vendor_stop: cancel the queued IN transfers
+//-----------------------------------------------------------------
+void usb_vendor_stop(void)
+{
+    _running = 0;
+    openusb_ep_dequeue(VENDOR_EP_IN, &_req_in[0]);
+    openusb_ep_dequeue(VENDOR_EP_IN, &_req_in[1]);
+}
+
+//-----------------------------------------------------------------
+// usb_vendor_kick: the producer has data again after it returned 0,
+// from the main loop (not the interrupt)
+//-----------------------------------------------------------------
+void usb_vendor_kick(void)
+{
+    vendor_fill();
+}
+
+//-----------------------------------------------------------------
+// usb_vendor_get_stats:
+//-----------------------------------------------------------------
+void usb_vendor_get_stats(USB_VENDOR_STATS_TypeDef *stats)
+{
+    *stats = _stats;
+}
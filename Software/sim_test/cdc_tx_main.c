@@ -0,0 +1,159 @@
+//=================================================================
+//
+// CDC TX coalescing test on the register level simulator
+// cdc_tx_main.c
+// The device writes single bytes, which the host reads as full
+// packets and a short packet sent on the SOF timer; a flushed line;
+// a full packet ended by a ZLP on the timer; and output without DTR,
+// which is dropped.
+//
+// Build on the host:
+// gcc -DOPENUSB_SIM -I ../openusb_lib/inc ../openusb_lib/src/*.c sim_host.c cdc_tx_main.c -o cdc_tx_test
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openusb_defs.h"
+#include "openusb_regs.h"
+#include "openusb_common.h"
+#include "openusb_cdc.h"
+#include "sim_host.h"
+
+#define CHATTY_LEN      200
+#define SOF_TICKS       50
+
+//-----------------------------------------------------------------
+// Host side
+//-----------------------------------------------------------------
+static uint8_t _setup_set_address[8]  = {0x00, REQ_SET_ADDRESS, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_set_conf[8]     = {0x00, REQ_SET_CONFIGURATION, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_dtr_on[8]       = {0x21, CDC_SET_CONTROL_LINE_STATE, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_dtr_off[8]      = {0x21, CDC_SET_CONTROL_LINE_STATE, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+
+static uint8_t _chatty[CHATTY_LEN];
+static uint8_t _packet[64];
+static uint8_t _rd_chatty[256];
+static uint8_t _rd_line[64];
+static uint8_t _rd_packet[128];
+static uint8_t _rd_end[64];
+
+int main(){
+    OPEN_USB_SIM_XFER_TypeDef *x_addr, *x_set_conf, *x_dtr_on, *x_dtr_off, *x_dtr_on2;
+    OPEN_USB_SIM_XFER_TypeDef *x_rd_chatty, *x_rd_line, *x_rd_packet, *x_rd_end;
+    OPEN_USB_SIM_STATS_TypeDef stats;
+    uint32_t dropped = 0;
+    int phase = 0;
+    int err = 0;
+    int i;
+
+    printf("USB CDC TX coalescing test on simulator\r\n");
+
+    openusb_sim_init();
+    openusb_sim_set_sof(SOF_TICKS);
+
+    openusb_attach(0);
+    usbf_init(USB_BASE, 0, 0);
+    usbf_register_class(&usb_cdc_driver, CDC_INTERFACE_COMM, USB_DESC_CDC_ACM_IFS, CDC_ENDPOINT_MASK);
+    openusb_sim_set_isr(openusb_isr_top);
+
+    openusb_attach(1);
+    openusb_enable_int(1,1);
+
+    for(i=0; i<CHATTY_LEN; i++)
+        _chatty[i] = 'a' + i % 26;
+    for(i=0; i<sizeof(_packet); i++)
+        _packet[i] = i;
+
+    host_xfer(SIM_XFER_RESET, 0, NULL, 0);
+    x_addr      = host_control_write(_setup_set_address, NULL, 0);
+    x_set_conf  = host_control_write(_setup_set_conf, NULL, 0);
+    x_dtr_on    = host_control_write(_setup_dtr_on, NULL, 0);
+    // one read, a short packet before the end would end it early
+    x_rd_chatty = host_xfer(SIM_XFER_IN, CDC_ENDPOINT_BULK_IN, _rd_chatty, sizeof(_rd_chatty));
+    x_rd_line   = host_xfer(SIM_XFER_IN, CDC_ENDPOINT_BULK_IN, _rd_line, sizeof(_rd_line));
+    x_rd_packet = host_xfer(SIM_XFER_IN, CDC_ENDPOINT_BULK_IN, _rd_packet, sizeof(_rd_packet));
+    x_dtr_off   = host_control_write(_setup_dtr_off, NULL, 0);
+    x_dtr_on2   = NULL;
+    x_rd_end    = NULL;
+
+    // the main loop, the time goes on while it is idle; the host has
+    // no transfer queued while phase 3 waits for the device
+    while(!openusb_sim_host_idle() || phase == 3){
+        switch(phase){
+        case 0:
+            // a byte per write, the rest goes on the SOF timer
+            if(usb_cdc_dtr()){
+                for(i=0; i<CHATTY_LEN; i++)
+                    usb_cdc_write(&_chatty[i], 1);
+                phase++;
+            }
+            break;
+        case 1:
+            // no timer, the flush sends the line
+            if(x_rd_chatty->status == SIM_XFER_DONE){
+                usb_cdc_set_flush_frames(0);
+                usb_cdc_write((const uint8_t *)"hello\r\n", 7);
+                usb_cdc_flush();
+                phase++;
+            }
+            break;
+        case 2:
+            // a full packet, the timer ends the host read with a ZLP
+            if(x_rd_line->status == SIM_XFER_DONE){
+                usb_cdc_set_flush_frames(CDC_TX_FLUSH_FRAMES);
+                usb_cdc_write(_packet, sizeof(_packet));
+                phase++;
+            }
+            break;
+        case 3:
+            // no terminal, the DTR on comes after the write
+            if(x_dtr_off->status == SIM_XFER_DONE && !usb_cdc_dtr()){
+                dropped = usb_cdc_write(_chatty, CHATTY_LEN);
+                x_dtr_on2 = host_control_write(_setup_dtr_on, NULL, 0);
+                x_rd_end  = host_xfer(SIM_XFER_IN, CDC_ENDPOINT_BULK_IN, _rd_end, sizeof(_rd_end));
+                phase++;
+            }
+            break;
+        case 4:
+            if(usb_cdc_dtr()){
+                usb_cdc_write((const uint8_t *)"end", 3);
+                usb_cdc_flush();
+                phase++;
+            }
+            break;
+        default:
+            break;
+        }
+
+        if(!openusb_poll_events(8))
+            openusb_sim_tick();
+    }
+
+    err += check("SET_ADDRESS", x_addr, NULL, 0);
+    err += check("SET_CONFIGURATION", x_set_conf, NULL, 0);
+    err += check("DTR on", x_dtr_on, NULL, 0);
+    err += check("Single byte writes", x_rd_chatty, _chatty, CHATTY_LEN);
+    err += check("Flushed line", x_rd_line, (const uint8_t *)"hello\r\n", 7);
+    err += check("Full packet + ZLP", x_rd_packet, _packet, sizeof(_packet));
+    err += check("DTR off", x_dtr_off, NULL, 0);
+    if(x_rd_end){
+        err += check("DTR on again", x_dtr_on2, NULL, 0);
+        err += check("Output after DTR", x_rd_end, (const uint8_t *)"end", 3);
+    }
+
+    printf("%-24s %s (%u bytes)\n", "Dropped without DTR", dropped == CHATTY_LEN ? "PASS" : "FAIL", dropped);
+    err += (dropped != CHATTY_LEN);
+
+    openusb_sim_get_stats(&stats);
+    printf("ticks %u, reads %u (data %u), writes %u (data %u), irqs %u, packets %u, naks %u, events merged %u\n",
+           stats.ticks, stats.reads, stats.data_reads, stats.writes, stats.data_writes,
+           stats.irqs, stats.packets, stats.naks, openusb_get_event_merged());
+
+    printf(err ? "Failed!\r\n" : "Finish!\r\n");
+    return err ? 1 : 0;
+}
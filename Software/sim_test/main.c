@@ -0,0 +1,274 @@
+//=================================================================
+//
+// CDC class test on the register level simulator main.c
+// The scripted host enumerates the CDC device, sets the line coding,
+// and checks the echo of EP1 OUT data on EP2 IN.
+//
+// Build on the host:
+// gcc -DOPENUSB_SIM -I ../openusb_lib/inc ../openusb_lib/src/*.c sim_host.c main.c -o sim_test
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openusb_defs.h"
+#include "openusb_regs.h"
+#include "openusb_common.h"
+#include "openusb_cdc.h"
+#include "sim_host.h"
+#include "openusb_stream.h"
+#include "openusb_ep.h"
+
+// the rx ring holds two packets, the echo runs into backpressure
+uint8_t rx_ring_buf[128];
+uint8_t tx_ring_buf[256];
+
+//-----------------------------------------------------------------
+// Device side, same as cdc_test
+//-----------------------------------------------------------------
+void cdc_echo(){
+    uint8_t *src, *dst;
+    uint32_t len, space;
+
+    src = openusb_stream_rx_peek(CDC_ENDPOINT_BULK_OUT, &len);
+    if(len == 0)
+        return;
+
+    dst = openusb_stream_tx_reserve(CDC_ENDPOINT_BULK_IN, &space);
+    len = MIN(len, space);
+    if(len == 0)
+        return;
+
+    memcpy(dst, src, len);
+    openusb_stream_tx_commit(CDC_ENDPOINT_BULK_IN, len);
+    openusb_stream_rx_release(CDC_ENDPOINT_BULK_OUT, len);
+}
+
+// EP1 IN written on the register level by the TX_MIN and the level tests
+#define RAW_TX_EP           1
+
+// tx level events, each one until openusb_rearm_fifo_thr
+int tx_lvl_events;
+
+void on_tx_lvl(OPEN_USB_EVENT_TypeDef *ev){
+    if(ev->ep == RAW_TX_EP)
+        tx_lvl_events++;
+}
+
+// interrupts taken so far
+unsigned sim_irqs(){
+    OPEN_USB_SIM_STATS_TypeDef stats;
+
+    openusb_sim_get_stats(&stats);
+    return stats.irqs;
+}
+
+// runs the idle device for a while
+void sim_idle(int ticks){
+    while(ticks--){
+        openusb_poll_events(8);
+        openusb_sim_tick();
+    }
+}
+
+// EP3 OUT request -> EP3 IN request, the IN ends with a ZLP
+#define REQ_ECHO_EP         3
+
+uint8_t req_buf[128];
+OPEN_USB_REQ_TypeDef req_out, req_in;
+
+void on_req_out_done(uint8_t ep_addr, OPEN_USB_REQ_TypeDef *req){
+    if(req->status != OPENUSB_REQ_DONE)
+        return;
+
+    req_in.buf = req_buf;
+    req_in.len = req->actual;
+    req_in.zlp = 1;
+    req_in.complete = 0;
+    openusb_ep_queue(REQ_ECHO_EP | ENDPOINT_DIR_IN, &req_in);
+}
+
+// EP1 IN transfer of openusb_tx_begin, a multiple of the packet size.
+// The steps come back to back, before tx busy of the packet started
+// last is read back.
+#define BULK_TX_EP          1
+
+uint8_t bulk_tx_buf[256];
+int bulk_tx_state;
+
+void bulk_tx(){
+    if(bulk_tx_state == 0 && openusb_is_configured())
+        bulk_tx_state = openusb_tx_begin(BULK_TX_EP, bulk_tx_buf, sizeof(bulk_tx_buf), 1) ? 1 : 2;
+    else if(bulk_tx_state == 1 && (!openusb_tx_continue(BULK_TX_EP) || !openusb_tx_continue(BULK_TX_EP)))
+        bulk_tx_state = 2;
+}
+
+// the bus reset completes all requests, queue the OUT again
+void on_bus_reset(){
+    req_out.buf = req_buf;
+    req_out.len = sizeof(req_buf);
+    req_out.complete = on_req_out_done;
+    openusb_ep_queue(REQ_ECHO_EP, &req_out);
+}
+
+//-----------------------------------------------------------------
+// Host side
+//-----------------------------------------------------------------
+static uint8_t _setup_get_dev_desc[8]    = {0x80, REQ_GET_DESCRIPTOR, 0x00, DESC_DEVICE, 0x00, 0x00, 0x40, 0x00};
+static uint8_t _setup_set_address[8]     = {0x00, REQ_SET_ADDRESS, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_get_conf_desc[8]   = {0x80, REQ_GET_DESCRIPTOR, 0x00, DESC_CONFIGURATION, 0x00, 0x00, 0xFF, 0x00};
+static uint8_t _setup_set_conf[8]        = {0x00, REQ_SET_CONFIGURATION, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_set_line_coding[8] = {0x21, CDC_SET_LINE_CODING, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00};
+static uint8_t _setup_set_line_state[8]  = {0x21, CDC_SET_CONTROL_LINE_STATE, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_get_line_coding[8] = {0xA1, CDC_GET_LINE_CODING, 0x00, 0x00, 0x00, 0x00, 0x07, 0x00};
+
+static uint8_t _line_coding[7]           = {0x00, 0x96, 0x00, 0x00, 0x00, 0x00, 0x08}; // 38400 8N1
+static uint8_t _dev_desc[64];
+static uint8_t _conf_desc[255];
+static uint8_t _line_coding_rd[7];
+static uint8_t _echo_tx[300];
+static uint8_t _echo_rx[320];
+static uint8_t _hold_tx[64];
+static uint8_t _hold_rx[64];
+
+static uint8_t _req_tx[128];
+static uint8_t _req_rx[256];
+static uint8_t _bulk_rx[512];
+
+int main(){
+    OPEN_USB_SIM_XFER_TypeDef *x_dev, *x_addr, *x_conf, *x_set_conf;
+    OPEN_USB_SIM_XFER_TypeDef *x_set_lc, *x_state, *x_get_lc, *x_echo, *x_req, *x_bulk, *x_hold;
+    OPEN_USB_EPx_TX_CTRL_TypeDef tx_ctrl;
+    OPEN_USB_EPx_STS_TypeDef ep_sts;
+    OPEN_USB_SIM_STATS_TypeDef stats;
+    unsigned char *desc;
+    unsigned short dev_desc_len, conf_desc_len;
+    unsigned lvl_irqs[2];
+    int lvl_events[2];
+    int err = 0;
+    int i;
+
+    printf("USB CDC test on simulator\r\n");
+
+    openusb_sim_init();
+
+    openusb_attach(0);
+    usbf_init(USB_BASE, on_bus_reset, 0);
+    usbf_register_class(&usb_cdc_driver, CDC_INTERFACE_COMM, USB_DESC_CDC_ACM_IFS, CDC_ENDPOINT_MASK);
+    openusb_stream_rx_open(CDC_ENDPOINT_BULK_OUT, rx_ring_buf, sizeof(rx_ring_buf));
+    openusb_stream_tx_open(CDC_ENDPOINT_BULK_IN, tx_ring_buf, sizeof(tx_ring_buf));
+    openusb_set_event_handler(OPENUSB_EV_TX_LVL, on_tx_lvl);
+    openusb_sim_set_isr(openusb_isr_top);
+
+    openusb_attach(1);
+    openusb_enable_int(1,0);
+
+    for(i=0; i<sizeof(_echo_tx); i++)
+        _echo_tx[i] = i * 7 + 1;
+    for(i=0; i<sizeof(_hold_tx); i++)
+        _hold_tx[i] = i * 5 + 3;
+    for(i=0; i<sizeof(_req_tx); i++)
+        _req_tx[i] = i * 3 + 5;
+    for(i=0; i<sizeof(bulk_tx_buf); i++)
+        bulk_tx_buf[i] = i ^ 0x5A;
+
+    host_xfer(SIM_XFER_RESET, 0, NULL, 0);
+    x_dev      = host_control_read(_setup_get_dev_desc, _dev_desc, 0x40);
+    x_addr     = host_control_write(_setup_set_address, NULL, 0);
+    x_conf     = host_control_read(_setup_get_conf_desc, _conf_desc, 0xFF);
+    x_set_conf = host_control_write(_setup_set_conf, NULL, 0);
+    x_set_lc   = host_control_write(_setup_set_line_coding, _line_coding, 7);
+    x_state    = host_control_write(_setup_set_line_state, NULL, 0);
+    x_get_lc   = host_control_read(_setup_get_line_coding, _line_coding_rd, 7);
+    host_xfer(SIM_XFER_OUT, CDC_ENDPOINT_BULK_OUT, _echo_tx, sizeof(_echo_tx));
+    x_echo     = host_xfer(SIM_XFER_IN, CDC_ENDPOINT_BULK_IN, _echo_rx, sizeof(_echo_rx));
+    host_xfer(SIM_XFER_OUT, REQ_ECHO_EP, _req_tx, sizeof(_req_tx));
+    x_req      = host_xfer(SIM_XFER_IN, REQ_ECHO_EP, _req_rx, sizeof(_req_rx));
+    x_bulk     = host_xfer(SIM_XFER_IN, BULK_TX_EP, _bulk_rx, sizeof(_bulk_rx));
+
+    // the main loop, the time goes on while it is idle
+    while(!openusb_sim_host_idle()){
+        if(!openusb_poll_events(8))
+            openusb_sim_tick();
+        cdc_echo();
+        bulk_tx();
+    }
+
+    // TX_MIN: the packet is started before its data is written, the
+    // IN tokens are NAKed until all of it is in the FIFO
+    x_hold = host_xfer(SIM_XFER_IN, RAW_TX_EP, _hold_rx, sizeof(_hold_rx));
+    tx_ctrl.d32 = 0;
+    tx_ctrl.b.tx_start = 1;
+    tx_ctrl.b.tx_len = sizeof(_hold_tx);
+    tx_ctrl.b.tx_min = sizeof(_hold_tx);
+    OPEN_USB_WRITE_REG(USB_EP_TX_CTRL(RAW_TX_EP), tx_ctrl.d32);
+    for(i=0; i<sizeof(_hold_tx); i++){
+        OPEN_USB_WRITE_REG(USB_EP_DATA(RAW_TX_EP), _hold_tx[i]);
+        openusb_sim_delay_us(1);
+    }
+    while(!openusb_sim_host_idle()){
+        if(!openusb_poll_events(8))
+            openusb_sim_tick();
+    }
+
+    // the empty Tx FIFO is below the threshold: one event, the
+    // crossings after it are masked until it is re-armed
+    lvl_irqs[0] = sim_irqs();
+    openusb_set_fifo_thr(RAW_TX_EP, 16, 0x7FF, 1, 0);
+    sim_idle(200);
+    for(i=0; i<32; i++)
+        OPEN_USB_WRITE_REG(USB_EP_DATA(RAW_TX_EP), i);
+    sim_idle(200);
+    openusb_flush_tx(RAW_TX_EP);
+    sim_idle(200);
+    lvl_irqs[1] = sim_irqs();
+    lvl_events[0] = tx_lvl_events;
+    openusb_rearm_fifo_thr(RAW_TX_EP, 1, 0);
+    sim_idle(200);
+    lvl_irqs[0] = lvl_irqs[1] - lvl_irqs[0];
+    lvl_irqs[1] = sim_irqs() - lvl_irqs[1];
+    lvl_events[1] = tx_lvl_events - lvl_events[0];
+    openusb_set_fifo_thr(RAW_TX_EP, 0, 0x7FF, 0, 0);
+
+    desc = usb_get_descriptor(DESC_DEVICE, 0, 0x40, &dev_desc_len);
+    err += check("GET_DESCRIPTOR device", x_dev, desc, dev_desc_len);
+    err += check("SET_ADDRESS", x_addr, NULL, 0);
+    desc = usb_get_descriptor(DESC_CONFIGURATION, 0, 0xFF, &conf_desc_len);
+    err += check("GET_DESCRIPTOR config", x_conf, desc, conf_desc_len);
+    err += check("SET_CONFIGURATION", x_set_conf, NULL, 0);
+    err += check("SET_LINE_CODING", x_set_lc, NULL, 0);
+    err += check("SET_CONTROL_LINE_STATE", x_state, NULL, 0);
+    err += check("GET_LINE_CODING", x_get_lc, _line_coding, 7);
+    err += check("EP1 OUT -> EP2 IN echo", x_echo, _echo_tx, sizeof(_echo_tx));
+    err += check("EP3 request echo", x_req, _req_tx, sizeof(_req_tx));
+    err += check("EP1 IN multi-packet", x_bulk, bulk_tx_buf, sizeof(bulk_tx_buf));
+    err += check("EP1 IN held for TX_MIN", x_hold, _hold_tx, sizeof(_hold_tx));
+
+    ep_sts.d32 = OPEN_USB_READ_REG(USB_EP_STS(RAW_TX_EP));
+    if(!x_hold->naks || ep_sts.b.tx_err){
+        printf("TX_MIN hold FAIL\n");
+        err++;
+    }
+
+    if(lvl_irqs[0] != 1 || lvl_events[0] != 1 || lvl_irqs[1] != 1 || lvl_events[1] != 1){
+        printf("Tx level event FAIL: irqs %u %u, events %d %d\n", lvl_irqs[0], lvl_irqs[1], lvl_events[0], lvl_events[1]);
+        err++;
+    }
+
+    if(OPEN_USB_READ_REG(USB_FUNC_ADDR) != 5 || !openusb_is_configured()){
+        printf("Device state FAIL\n");
+        err++;
+    }
+
+    openusb_sim_get_stats(&stats);
+    printf("ticks %u, reads %u (data %u), writes %u (data %u), irqs %u, packets %u, naks %u, events merged %u\n",
+           stats.ticks, stats.reads, stats.data_reads, stats.writes, stats.data_writes,
+           stats.irqs, stats.packets, stats.naks, openusb_get_event_merged());
+
+    printf(err ? "Failed!\r\n" : "Finish!\r\n");
+    return err ? 1 : 0;
+}
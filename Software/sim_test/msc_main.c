@@ -0,0 +1,184 @@
+//=================================================================
+//
+// MSC class test on the register level simulator msc_main.c
+// The scripted host configures the device and runs Bulk-Only
+// Transport commands on the RAM disk: INQUIRY, READ CAPACITY,
+// WRITE(10) / READ(10) on the mapped disk and through the block
+// buffers, and an out of range READ(10) with its sense data.
+//
+// Build on the host:
+// gcc -DOPENUSB_SIM -I ../openusb_lib/inc ../openusb_lib/src/*.c sim_host.c msc_main.c -o msc_test
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openusb_defs.h"
+#include "openusb_regs.h"
+#include "openusb_common.h"
+#include "openusb_msc.h"
+#include "sim_host.h"
+
+#define DISK_BLOCKS     32
+
+//-----------------------------------------------------------------
+// Device side
+//-----------------------------------------------------------------
+uint8_t disk[DISK_BLOCKS * MSC_BLOCK_SIZE];
+
+// the same disk through read / write, for the buffered path
+int disk_read(uint32_t lba, uint8_t *buf, uint32_t blocks){
+    memcpy(buf, &disk[lba * MSC_BLOCK_SIZE], blocks * MSC_BLOCK_SIZE);
+    return 0;
+}
+
+int disk_write(uint32_t lba, const uint8_t *buf, uint32_t blocks){
+    memcpy(&disk[lba * MSC_BLOCK_SIZE], buf, blocks * MSC_BLOCK_SIZE);
+    return 0;
+}
+
+const USB_MSC_BLOCKDEV_TypeDef disk_copy = { DISK_BLOCKS, 0, disk_read, disk_write };
+
+//-----------------------------------------------------------------
+// Host side
+//-----------------------------------------------------------------
+#define MAX_CMDS    8
+
+static uint8_t _setup_set_address[8]     = {0x00, REQ_SET_ADDRESS, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_set_conf[8]        = {0x00, REQ_SET_CONFIGURATION, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_get_max_lun[8]     = {0xA1, MSC_REQ_GET_MAX_LUN, 0x00, 0x00, MSC_INTERFACE, 0x00, 0x01, 0x00};
+
+static OPEN_USB_SIM_XFER_TypeDef *_x_csw[MAX_CMDS];
+static uint8_t _cbw[MAX_CMDS][31];
+static uint8_t _csw[MAX_CMDS][13];
+static uint8_t _max_lun[1];
+static uint8_t _inquiry[36];
+static uint8_t _capacity[8];
+static uint8_t _sense[18];
+static uint8_t _none[MSC_BLOCK_SIZE];
+static uint8_t _wr_data[2][8 * MSC_BLOCK_SIZE];
+static uint8_t _rd_data[2][8 * MSC_BLOCK_SIZE];
+
+// BOT command n: CBW, data IN or OUT, CSW. Returns the data transfer.
+static OPEN_USB_SIM_XFER_TypeDef *host_command(int n, uint8_t dir_in, uint8_t *data, uint16_t len,
+                                               uint8_t op, uint32_t lba, uint16_t blocks, uint8_t alloc){
+    OPEN_USB_SIM_XFER_TypeDef *x_data = NULL;
+    uint8_t *cbw = _cbw[n];
+
+    memset(cbw, 0, 31);
+    cbw[0] = 'U'; cbw[1] = 'S'; cbw[2] = 'B'; cbw[3] = 'C';
+    cbw[4] = n + 1;                     // tag
+    cbw[8] = len; cbw[9] = len >> 8;
+    cbw[12] = dir_in ? 0x80 : 0x00;
+    cbw[14] = 10;
+    cbw[15] = op;
+    cbw[17] = lba >> 24; cbw[18] = lba >> 16; cbw[19] = lba >> 8; cbw[20] = lba;
+    cbw[22] = blocks >> 8; cbw[23] = blocks;
+    if(alloc)
+        cbw[19] = alloc;                // allocation length of the 6 byte commands
+
+    host_xfer(SIM_XFER_OUT, MSC_ENDPOINT_BULK_OUT, cbw, 31);
+    if(len)
+        x_data = host_xfer(dir_in ? SIM_XFER_IN : SIM_XFER_OUT, dir_in ? MSC_ENDPOINT_BULK_IN : MSC_ENDPOINT_BULK_OUT, data, len);
+    _x_csw[n] = host_xfer(SIM_XFER_IN, MSC_ENDPOINT_BULK_IN, _csw[n], 13);
+    return x_data;
+}
+
+// CSW of command n: tag, residue and status
+static int check_csw(const char *name, int n, uint32_t residue, uint8_t status){
+    uint8_t *csw = _csw[n];
+    uint32_t csw_residue = csw[8] | (csw[9] << 8) | (csw[10] << 16) | ((uint32_t)csw[11] << 24);
+    int ok = !memcmp(csw, "USBS", 4) && csw[4] == n + 1 && csw_residue == residue && csw[12] == status;
+
+    printf("%-24s %s (residue %u, status %d)\n", name, ok ? "PASS" : "FAIL", csw_residue, csw[12]);
+    return ok ? 0 : 1;
+}
+
+int main(){
+    OPEN_USB_SIM_XFER_TypeDef *x_addr, *x_set_conf, *x_lun, *x_inq, *x_cap;
+    OPEN_USB_SIM_XFER_TypeDef *x_rd_map, *x_rd_copy, *x_rd_bad, *x_sense;
+    OPEN_USB_SIM_STATS_TypeDef stats;
+    uint8_t zero = 0;
+    int copy = 0;
+    int err = 0;
+    int i;
+
+    printf("USB MSC test on simulator\r\n");
+
+    openusb_sim_init();
+
+    openusb_attach(0);
+    usbf_init(USB_BASE, 0, 0);
+    usbf_register_class(&usb_msc_driver, MSC_INTERFACE, 1, MSC_ENDPOINT_MASK);
+    usb_msc_set_blockdev(usb_msc_ramdisk(disk, DISK_BLOCKS));
+    openusb_sim_set_isr(openusb_isr_top);
+
+    openusb_attach(1);
+    openusb_enable_int(1,0);
+
+    for(i=0; i<sizeof(_wr_data[0]); i++){
+        _wr_data[0][i] = i * 7 + 1;
+        _wr_data[1][i] = i * 13 + 3;
+    }
+
+    host_xfer(SIM_XFER_RESET, 0, NULL, 0);
+    x_addr     = host_control_write(_setup_set_address, NULL, 0);
+    x_set_conf = host_control_write(_setup_set_conf, NULL, 0);
+    x_lun      = host_control_read(_setup_get_max_lun, _max_lun, 1);
+    x_inq      = host_command(0, 1, _inquiry, 36, SCSI_INQUIRY, 0, 0, 36);
+    x_cap      = host_command(1, 1, _capacity, 8, SCSI_READ_CAPACITY10, 0, 0, 0);
+    // mapped disk, one request per command
+    host_command(2, 0, _wr_data[0], sizeof(_wr_data[0]), SCSI_WRITE10, 2, 8, 0);
+    x_rd_map   = host_command(3, 1, _rd_data[0], sizeof(_rd_data[0]), SCSI_READ10, 2, 8, 0);
+    // block buffers, switched to after the CSW of command 3
+    host_command(4, 0, _wr_data[1], sizeof(_wr_data[1]), SCSI_WRITE10, 20, 8, 0);
+    x_rd_copy  = host_command(5, 1, _rd_data[1], sizeof(_rd_data[1]), SCSI_READ10, 20, 8, 0);
+    // out of range, no data but a ZLP
+    x_rd_bad   = host_command(6, 1, _none, MSC_BLOCK_SIZE, SCSI_READ10, DISK_BLOCKS, 1, 0);
+    x_sense    = host_command(7, 1, _sense, 18, SCSI_REQUEST_SENSE, 0, 0, 18);
+
+    // the main loop, the time goes on while it is idle
+    while(!openusb_sim_host_idle()){
+        if(!copy && _x_csw[3]->status == SIM_XFER_DONE){
+            usb_msc_set_blockdev(&disk_copy);
+            copy = 1;
+        }
+        if(!openusb_poll_events(8))
+            openusb_sim_tick();
+    }
+
+    err += check("SET_ADDRESS", x_addr, NULL, 0);
+    err += check("SET_CONFIGURATION", x_set_conf, NULL, 0);
+    err += check("GET_MAX_LUN", x_lun, &zero, 1);
+    err += check("INQUIRY", x_inq, NULL, 36);
+    err += check_csw("INQUIRY CSW", 0, 0, 0);
+    err += check("READ CAPACITY", x_cap, NULL, 8);
+    err += (_capacity[3] != DISK_BLOCKS - 1 || _capacity[6] != MSC_BLOCK_SIZE >> 8);
+    err += check_csw("WRITE(10) mapped CSW", 2, 0, 0);
+    err += check("READ(10) mapped", x_rd_map, _wr_data[0], sizeof(_wr_data[0]));
+    err += check_csw("READ(10) mapped CSW", 3, 0, 0);
+    err += check_csw("WRITE(10) buffered CSW", 4, 0, 0);
+    err += check("READ(10) buffered", x_rd_copy, _wr_data[1], sizeof(_wr_data[1]));
+    err += check_csw("READ(10) buffered CSW", 5, 0, 0);
+    err += check("READ(10) out of range", x_rd_bad, NULL, 0);
+    err += check_csw("READ(10) out of range CSW", 6, MSC_BLOCK_SIZE, 1);
+    err += check("REQUEST SENSE", x_sense, NULL, 18);
+    err += (_sense[2] != 0x05 || _sense[12] != 0x21);
+
+    if(memcmp(&disk[20 * MSC_BLOCK_SIZE], _wr_data[1], sizeof(_wr_data[1])) || !copy){
+        printf("Disk content FAIL\n");
+        err++;
+    }
+
+    openusb_sim_get_stats(&stats);
+    printf("ticks %u, reads %u (data %u), writes %u (data %u), irqs %u, packets %u, naks %u, events merged %u\n",
+           stats.ticks, stats.reads, stats.data_reads, stats.writes, stats.data_writes,
+           stats.irqs, stats.packets, stats.naks, openusb_get_event_merged());
+
+    printf(err ? "Failed!\r\n" : "Finish!\r\n");
+    return err ? 1 : 0;
+}
@@ -0,0 +1,255 @@
+//=================================================================
+//
+// CDC-NCM class test on the register level simulator ncm_main.c
+// The scripted host reads the NTB parameters, limits the IN NTBs to
+// 4 datagrams, selects the data interface and reads the link
+// notifications. The device sends 10 frames, which arrive in three
+// NTBs, and the host sends one NTB of 3 frames. An NTB input size
+// above the maximum and a max datagram size of 0 are STALLed, and the
+// 4 byte form of GET_NTB_INPUT_SIZE gets 4 bytes.
+//
+// Build on the host:
+// gcc -DOPENUSB_SIM -I ../openusb_lib/inc ../openusb_lib/src/*.c sim_host.c ncm_main.c -o ncm_test
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openusb_defs.h"
+#include "openusb_regs.h"
+#include "openusb_common.h"
+#include "openusb_ncm.h"
+#include "sim_host.h"
+
+#define FRAMES          10
+#define FRAME_MAX       400
+#define NTB_DGRAMS      4                   // wNtbInMaxDatagrams of the host
+#define IN_NTBS         ((FRAMES + NTB_DGRAMS - 1) / NTB_DGRAMS)
+#define RX_FRAMES       3
+
+//-----------------------------------------------------------------
+// Frames
+//-----------------------------------------------------------------
+static uint8_t _frames[FRAMES][FRAME_MAX];
+
+static uint16_t frame_len(int k){
+    return 60 + k * 37;
+}
+
+//-----------------------------------------------------------------
+// Device side
+//-----------------------------------------------------------------
+static int _sent;
+static int _flushed;
+static int _rx_num;
+static int _rx_ok;
+
+static void ncm_rx(const uint8_t *frame, uint16_t len){
+    int k = FRAMES - 1 - _rx_num;           // the host sends the frames backwards
+
+    if(_rx_num < RX_FRAMES && len == frame_len(k) && !memcmp(frame, _frames[k], len))
+        _rx_ok++;
+    _rx_num++;
+}
+
+//-----------------------------------------------------------------
+// Host side
+//-----------------------------------------------------------------
+static uint8_t _setup_set_address[8]   = {0x00, REQ_SET_ADDRESS, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_set_conf[8]      = {0x00, REQ_SET_CONFIGURATION, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_get_params[8]    = {0xA1, NCM_GET_NTB_PARAMETERS, 0x00, 0x00, NCM_INTERFACE_COMM, 0x00, NCM_NTB_PARAMETERS_LEN, 0x00};
+static uint8_t _setup_set_in_size[8]   = {0x21, NCM_SET_NTB_INPUT_SIZE, 0x00, 0x00, NCM_INTERFACE_COMM, 0x00, 0x08, 0x00};
+static uint8_t _setup_set_alt_comm[8]  = {0x01, REQ_SET_INTERFACE, 0x01, 0x00, NCM_INTERFACE_COMM, 0x00, 0x00, 0x00};
+static uint8_t _setup_set_alt_data[8]  = {0x01, REQ_SET_INTERFACE, 0x01, 0x00, NCM_INTERFACE_COMM + 1, 0x00, 0x00, 0x00};
+static uint8_t _setup_get_alt_data[8]  = {0x81, REQ_GET_INTERFACE, 0x00, 0x00, NCM_INTERFACE_COMM + 1, 0x00, 0x01, 0x00};
+static uint8_t _setup_get_in_size[8]   = {0xA1, NCM_GET_NTB_INPUT_SIZE, 0x00, 0x00, NCM_INTERFACE_COMM, 0x00, 0x08, 0x00};
+static uint8_t _setup_get_in_size4[8]  = {0xA1, NCM_GET_NTB_INPUT_SIZE, 0x00, 0x00, NCM_INTERFACE_COMM, 0x00, 0x04, 0x00};
+static uint8_t _setup_set_in_big[8]    = {0x21, NCM_SET_NTB_INPUT_SIZE, 0x00, 0x00, NCM_INTERFACE_COMM, 0x00, 0x04, 0x00};
+static uint8_t _setup_set_dgram[8]     = {0x21, NCM_SET_MAX_DATAGRAM_SIZE, 0x00, 0x00, NCM_INTERFACE_COMM, 0x00, 0x02, 0x00};
+
+static uint8_t _in_size[8] = {LO_BYTE(NCM_NTB_IN_SIZE), HI_BYTE(NCM_NTB_IN_SIZE), 0x00, 0x00, NTB_DGRAMS, 0x00, 0x00, 0x00};
+static uint8_t _in_size_rd[8];
+static uint8_t _in_size_rd4[8];
+static uint8_t _in_big[4] = {0x00, 0x00, 0x01, 0x00};
+static uint8_t _dgram_zero[2];
+static uint8_t _params[NCM_NTB_PARAMETERS_LEN];
+static uint8_t _alt[1];
+static uint8_t _notify_speed[16];
+static uint8_t _notify_connect[8];
+static uint8_t _ntb_in[IN_NTBS][NCM_NTB_IN_SIZE];
+static uint8_t _ntb_out[NCM_NTB_OUT_SIZE];
+
+static uint16_t le16(const uint8_t *p){
+    return p[0] | (p[1] << 8);
+}
+
+static void put16(uint8_t *p, uint16_t v){
+    p[0] = v;
+    p[1] = v >> 8;
+}
+
+// an NTB16 of the frames first, first-1, .. (num frames), with the
+// NDP behind the datagrams as the device builds it
+static uint16_t host_build_ntb(uint8_t *ntb, int first, int num){
+    uint16_t index[FRAMES];
+    uint16_t off = 12, ndp, ndp_len;
+    int i;
+
+    for(i=0; i<num; i++){
+        index[i] = off;
+        memcpy(&ntb[off], _frames[first - i], frame_len(first - i));
+        off = (off + frame_len(first - i) + 3) & ~3;
+    }
+
+    ndp = off;
+    ndp_len = 8 + (num + 1) * 4;
+    memcpy(&ntb[ndp], "NCM0", 4);
+    put16(&ntb[ndp + 4], ndp_len);
+    put16(&ntb[ndp + 6], 0);
+    for(i=0; i<num; i++){
+        put16(&ntb[ndp + 8 + i * 4], index[i]);
+        put16(&ntb[ndp + 10 + i * 4], frame_len(first - i));
+    }
+    put16(&ntb[ndp + 8 + num * 4], 0);
+    put16(&ntb[ndp + 10 + num * 4], 0);
+
+    memcpy(ntb, "NCMH", 4);
+    put16(&ntb[4], 12);
+    put16(&ntb[6], 0);
+    put16(&ntb[8], ndp + ndp_len);
+    put16(&ntb[10], ndp);
+    return ndp + ndp_len;
+}
+
+// IN NTB n holds the frames n * NTB_DGRAMS.. in order
+static int check_ntb(const char *name, int n, OPEN_USB_SIM_XFER_TypeDef *xfer){
+    uint8_t *ntb = _ntb_in[n];
+    uint16_t ndp = le16(&ntb[10]);
+    int first = n * NTB_DGRAMS;
+    int num = MIN(NTB_DGRAMS, FRAMES - first);
+    int ok = xfer->status == SIM_XFER_DONE && !memcmp(ntb, "NCMH", 4) &&
+             le16(&ntb[6]) == n && le16(&ntb[8]) == xfer->actual &&
+             !memcmp(&ntb[ndp], "NCM0", 4) && !(ndp & 3);
+    int i;
+
+    for(i=0; ok && i<num; i++){
+        uint16_t index = le16(&ntb[ndp + 8 + i * 4]);
+        uint16_t len = le16(&ntb[ndp + 10 + i * 4]);
+
+        ok = !(index & 3) && len == frame_len(first + i) && !memcmp(&ntb[index], _frames[first + i], len);
+    }
+    ok = ok && le16(&ntb[ndp + 8 + num * 4]) == 0;
+
+    printf("%-24s %s (status %d, %d bytes, %d datagrams)\n", name, ok ? "PASS" : "FAIL",
+           xfer->status, xfer->actual, num);
+    return ok ? 0 : 1;
+}
+
+int main(){
+    OPEN_USB_SIM_XFER_TypeDef *x_addr, *x_set_conf, *x_params, *x_in_size, *x_alt_comm, *x_alt_data, *x_get_alt;
+    OPEN_USB_SIM_XFER_TypeDef *x_speed, *x_connect, *x_ntb_in[IN_NTBS], *x_ntb_out, *x_get_size;
+    OPEN_USB_SIM_XFER_TypeDef *x_in_big, *x_dgram_zero, *x_get_size4;
+    OPEN_USB_SIM_STATS_TypeDef stats;
+    uint16_t out_len;
+    uint8_t one = 1;
+    int err = 0;
+    int i, k;
+
+    printf("USB CDC-NCM test on simulator\r\n");
+
+    openusb_sim_init();
+
+    openusb_attach(0);
+    usbf_init(USB_BASE, 0, 0);
+    usbf_register_class(&usb_ncm_driver, NCM_INTERFACE_COMM, USB_DESC_CDC_NCM_IFS, NCM_ENDPOINT_MASK);
+    usb_ncm_set_rx(ncm_rx);
+    usb_ncm_set_flush(NCM_NTB_IN_SIZE, NTB_DGRAMS, 0);
+    openusb_sim_set_isr(openusb_isr_top);
+
+    openusb_attach(1);
+    openusb_enable_int(1,0);
+
+    for(k=0; k<FRAMES; k++)
+        for(i=0; i<FRAME_MAX; i++)
+            _frames[k][i] = k * 31 + i;
+
+    out_len = host_build_ntb(_ntb_out, FRAMES - 1, RX_FRAMES);
+
+    host_xfer(SIM_XFER_RESET, 0, NULL, 0);
+    x_addr     = host_control_write(_setup_set_address, NULL, 0);
+    x_set_conf = host_control_write(_setup_set_conf, NULL, 0);
+    x_params   = host_control_read(_setup_get_params, _params, NCM_NTB_PARAMETERS_LEN);
+    x_in_size  = host_control_write(_setup_set_in_size, _in_size, sizeof(_in_size));
+    x_in_big   = host_control_write(_setup_set_in_big, _in_big, sizeof(_in_big));
+    x_dgram_zero = host_control_write(_setup_set_dgram, _dgram_zero, sizeof(_dgram_zero));
+    x_alt_comm = host_control_write(_setup_set_alt_comm, NULL, 0);
+    x_alt_data = host_control_write(_setup_set_alt_data, NULL, 0);
+    x_get_alt  = host_control_read(_setup_get_alt_data, _alt, 1);
+    x_speed    = host_xfer(SIM_XFER_IN, NCM_ENDPOINT_INTR_IN, _notify_speed, sizeof(_notify_speed));
+    x_connect  = host_xfer(SIM_XFER_IN, NCM_ENDPOINT_INTR_IN, _notify_connect, sizeof(_notify_connect));
+    for(i=0; i<IN_NTBS; i++)
+        x_ntb_in[i] = host_xfer(SIM_XFER_IN, NCM_ENDPOINT_BULK_IN, _ntb_in[i], NCM_NTB_IN_SIZE);
+    x_ntb_out  = host_xfer(SIM_XFER_OUT, NCM_ENDPOINT_BULK_OUT, _ntb_out, out_len);
+    // the device has seen the OUT NTB when it answers
+    x_get_size = host_control_read(_setup_get_in_size, _in_size_rd, sizeof(_in_size_rd));
+    // the buffer has room for more, the device must stop at wLength
+    x_get_size4 = host_control_read(_setup_get_in_size4, _in_size_rd4, sizeof(_in_size_rd4));
+
+    // the main loop, the time goes on while it is idle
+    while(!openusb_sim_host_idle()){
+        if(usb_ncm_link_up()){
+            // a full queue refuses the frame, it is sent again later
+            while(_sent < FRAMES && !usb_ncm_send(_frames[_sent], frame_len(_sent)))
+                _sent++;
+            if(_sent == FRAMES && !_flushed){
+                usb_ncm_flush();
+                _flushed = 1;
+            }
+        }
+        if(!openusb_poll_events(8))
+            openusb_sim_tick();
+    }
+
+    err += check("SET_ADDRESS", x_addr, NULL, 0);
+    err += check("SET_CONFIGURATION", x_set_conf, NULL, 0);
+    err += check("GET_NTB_PARAMETERS", x_params, NULL, NCM_NTB_PARAMETERS_LEN);
+    err += (le16(&_params[2]) != 1 || le16(&_params[4]) != NCM_NTB_IN_SIZE);
+    err += check("SET_NTB_INPUT_SIZE", x_in_size, NULL, 0);
+    err += (x_in_big->status != SIM_XFER_STALL);
+    printf("%-24s %s (status %d)\n", "NTB input size too big", x_in_big->status == SIM_XFER_STALL ? "PASS" : "FAIL",
+           x_in_big->status);
+    err += (x_dgram_zero->status != SIM_XFER_STALL);
+    printf("%-24s %s (status %d)\n", "Max datagram size 0", x_dgram_zero->status == SIM_XFER_STALL ? "PASS" : "FAIL",
+           x_dgram_zero->status);
+    err += (x_alt_comm->status != SIM_XFER_STALL);
+    printf("%-24s %s (status %d)\n", "SET_INTERFACE comm 1", x_alt_comm->status == SIM_XFER_STALL ? "PASS" : "FAIL",
+           x_alt_comm->status);
+    err += check("SET_INTERFACE data 1", x_alt_data, NULL, 0);
+    err += check("GET_INTERFACE data", x_get_alt, &one, 1);
+    err += check("SPEED_CHANGE", x_speed, NULL, sizeof(_notify_speed));
+    err += (_notify_speed[1] != NCM_NOTIFY_SPEED_CHANGE);
+    err += check("NETWORK_CONNECTION", x_connect, NULL, sizeof(_notify_connect));
+    err += (_notify_connect[1] != NCM_NOTIFY_NETWORK_CONNECTION || _notify_connect[2] != 1);
+    err += check_ntb("IN NTB 0", 0, x_ntb_in[0]);
+    err += check_ntb("IN NTB 1", 1, x_ntb_in[1]);
+    err += check_ntb("IN NTB 2", 2, x_ntb_in[2]);
+    err += check("OUT NTB", x_ntb_out, NULL, out_len);
+
+    printf("%-24s %s (%d of %d)\n", "OUT datagrams", _rx_ok == RX_FRAMES && _rx_num == RX_FRAMES ? "PASS" : "FAIL",
+           _rx_ok, RX_FRAMES);
+    err += (_rx_ok != RX_FRAMES || _rx_num != RX_FRAMES);
+    err += check("GET_NTB_INPUT_SIZE", x_get_size, _in_size, sizeof(_in_size));
+    err += check("GET_NTB_INPUT_SIZE 4", x_get_size4, _in_size, 4);
+
+    openusb_sim_get_stats(&stats);
+    printf("ticks %u, reads %u (data %u), writes %u (data %u), irqs %u, packets %u, naks %u, events merged %u\n",
+           stats.ticks, stats.reads, stats.data_reads, stats.writes, stats.data_writes,
+           stats.irqs, stats.packets, stats.naks, openusb_get_event_merged());
+
+    printf(err ? "Failed!\r\n" : "Finish!\r\n");
+    return err ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+//=================================================================
+//
+// Scripted host of the simulator tests sim_host.c
+// Queues the transfers of the control transactions on the host of
+// the register level simulator and checks the finished transfers.
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "sim_host.h"
+
+//-----------------------------------------------------------------
+// Locals:
+//-----------------------------------------------------------------
+static OPEN_USB_SIM_XFER_TypeDef _xfers[MAX_XFERS];
+static int _xfer_num;
+
+//-----------------------------------------------------------------
+// host_xfer: queue one transfer
+//-----------------------------------------------------------------
+OPEN_USB_SIM_XFER_TypeDef *host_xfer(uint8_t type, uint8_t ep, uint8_t *buf, uint16_t len){
+    OPEN_USB_SIM_XFER_TypeDef *xfer;
+
+    if(_xfer_num == MAX_XFERS){
+        printf("host: more than %d transfers\n", MAX_XFERS);
+        exit(1);
+    }
+
+    xfer = &_xfers[_xfer_num++];
+    openusb_sim_host_submit(xfer, type, ep, buf, len);
+    return xfer;
+}
+
+//-----------------------------------------------------------------
+// host_control_read: SETUP, DATA IN, STATUS OUT
+//-----------------------------------------------------------------
+OPEN_USB_SIM_XFER_TypeDef *host_control_read(uint8_t *setup, uint8_t *buf, uint16_t len){
+    OPEN_USB_SIM_XFER_TypeDef *data;
+
+    host_xfer(SIM_XFER_SETUP, 0, setup, 8);
+    data = host_xfer(SIM_XFER_IN, 0, buf, len);
+    host_xfer(SIM_XFER_OUT, 0, NULL, 0);
+    return data;
+}
+
+//-----------------------------------------------------------------
+// host_control_write: SETUP, DATA OUT if len, STATUS IN
+//-----------------------------------------------------------------
+OPEN_USB_SIM_XFER_TypeDef *host_control_write(uint8_t *setup, uint8_t *buf, uint16_t len){
+    host_xfer(SIM_XFER_SETUP, 0, setup, 8);
+    if(len)
+        host_xfer(SIM_XFER_OUT, 0, buf, len);
+    return host_xfer(SIM_XFER_IN, 0, NULL, 0);
+}
+
+//-----------------------------------------------------------------
+// check: the transfer is done with len bytes, and expect if set
+//-----------------------------------------------------------------
+int check(const char *name, OPEN_USB_SIM_XFER_TypeDef *xfer, const uint8_t *expect, uint16_t len){
+    int ok = (xfer->status == SIM_XFER_DONE) && (xfer->actual == len) &&
+             (!expect || !memcmp(xfer->buf, expect, len));
+
+    printf("%-24s %s (status %d, %d bytes, %u NAKs)\n", name, ok ? "PASS" : "FAIL",
+           xfer->status, xfer->actual, xfer->naks);
+    return ok ? 0 : 1;
+}
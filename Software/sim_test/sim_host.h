@@ -0,0 +1,28 @@
+#ifndef __SIM_HOST_H__
+#define __SIM_HOST_H__
+
+#include <stdint.h>
+#include "openusb_sim.h"
+
+//-----------------------------------------------------------------
+// Scripted host of the simulator tests: the transfers are queued on
+// openusb_sim_host_submit in order, and checked once the host is
+// idle.
+//-----------------------------------------------------------------
+
+//-----------------------------------------------------------------
+// Defines
+//-----------------------------------------------------------------
+#ifndef MAX_XFERS
+    #define MAX_XFERS   64      // transfers of one test
+#endif
+
+//-----------------------------------------------------------------
+// Prototypes
+//-----------------------------------------------------------------
+OPEN_USB_SIM_XFER_TypeDef *host_xfer(uint8_t type, uint8_t ep, uint8_t *buf, uint16_t len);
+OPEN_USB_SIM_XFER_TypeDef *host_control_read(uint8_t *setup, uint8_t *buf, uint16_t len);
+OPEN_USB_SIM_XFER_TypeDef *host_control_write(uint8_t *setup, uint8_t *buf, uint16_t len);
+int check(const char *name, OPEN_USB_SIM_XFER_TypeDef *xfer, const uint8_t *expect, uint16_t len);
+
+#endif
@@ -0,0 +1,170 @@
+//=================================================================
+//
+// Vendor streaming class test on the register level simulator
+// vendor_main.c
+// The scripted host configures the device, sets the framing with a
+// ZLP, starts the stream and reads the produced data in transfers
+// larger than the framing, sends an OUT transfer, stops the stream
+// and reads the stats. A SET_FRAMING without the ZLP flag byte is
+// STALLed, and a GET_STATS of 8 bytes gets 8 bytes.
+//
+// Build on the host:
+// gcc -DOPENUSB_SIM -I ../openusb_lib/inc ../openusb_lib/src/*.c sim_host.c vendor_main.c -o vendor_test
+//
+// Version: V1.0
+// Created by Zeba-Xie @github
+//
+//=================================================================
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "openusb_defs.h"
+#include "openusb_regs.h"
+#include "openusb_common.h"
+#include "openusb_vendor.h"
+#include "sim_host.h"
+
+#define FRAME_LEN       1024
+#define STREAM_LEN      (2 * FRAME_LEN + 952)   // the last transfer is short
+#define OUT_LEN         100
+
+//-----------------------------------------------------------------
+// Device side
+//-----------------------------------------------------------------
+static uint8_t _in_buf[2][4096];
+static uint8_t _out_buf[512];
+static uint32_t _produced;
+static uint8_t _consumed[OUT_LEN];
+static uint32_t _consumed_len;
+
+// a counter pattern, STREAM_LEN bytes in all
+static uint32_t produce(uint8_t *buf, uint32_t len){
+    uint32_t i;
+
+    len = MIN(len, STREAM_LEN - _produced);
+    for(i=0; i<len; i++)
+        buf[i] = (_produced + i) * 7;
+    _produced += len;
+    return len;
+}
+
+static void consume(uint8_t *buf, uint32_t len){
+    memcpy(_consumed, buf, MIN(len, OUT_LEN));
+    _consumed_len += len;
+}
+
+static const USB_VENDOR_CONFIG_TypeDef _vendor_cfg =
+{
+    { _in_buf[0], _in_buf[1] }, sizeof(_in_buf[0]),
+    _out_buf, sizeof(_out_buf),
+    produce, consume
+};
+
+//-----------------------------------------------------------------
+// Host side
+//-----------------------------------------------------------------
+static uint8_t _setup_set_address[8] = {0x00, REQ_SET_ADDRESS, 0x05, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_set_conf[8]    = {0x00, REQ_SET_CONFIGURATION, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00};
+static uint8_t _setup_framing[8]     = {0x41, VENDOR_REQ_SET_FRAMING, 0x00, 0x00, VENDOR_INTERFACE, 0x00, VENDOR_FRAMING_LEN, 0x00};
+static uint8_t _setup_start[8]       = {0x41, VENDOR_REQ_START, 0x00, 0x00, VENDOR_INTERFACE, 0x00, 0x00, 0x00};
+static uint8_t _setup_stop[8]        = {0x41, VENDOR_REQ_STOP, 0x00, 0x00, VENDOR_INTERFACE, 0x00, 0x00, 0x00};
+static uint8_t _setup_get_stats[8]   = {0xC1, VENDOR_REQ_GET_STATS, 0x00, 0x00, VENDOR_INTERFACE, 0x00, VENDOR_STATS_LEN, 0x00};
+static uint8_t _setup_framing4[8]    = {0x41, VENDOR_REQ_SET_FRAMING, 0x00, 0x00, VENDOR_INTERFACE, 0x00, 0x04, 0x00};
+static uint8_t _setup_get_stats8[8]  = {0xC1, VENDOR_REQ_GET_STATS, 0x00, 0x00, VENDOR_INTERFACE, 0x00, 0x08, 0x00};
+
+static uint8_t _framing[VENDOR_FRAMING_LEN] = {LO_BYTE(FRAME_LEN), HI_BYTE(FRAME_LEN), 0x00, 0x00, 0x01};
+static uint8_t _stats[VENDOR_STATS_LEN];
+static uint8_t _stats8[VENDOR_STATS_LEN];
+static uint8_t _framing4[4] = {0x10, 0x00, 0x00, 0x00};
+static uint8_t _rd_data[3][2 * FRAME_LEN];
+static uint8_t _wr_data[OUT_LEN];
+static uint8_t _expect[STREAM_LEN];
+
+static int check_stat(const char *name, int idx, uint32_t expect){
+    uint8_t *p = &_stats[idx * 4];
+    uint32_t value = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+
+    printf("%-24s %s (%u)\n", name, value == expect ? "PASS" : "FAIL", value);
+    return value == expect ? 0 : 1;
+}
+
+int main(){
+    OPEN_USB_SIM_XFER_TypeDef *x_addr, *x_set_conf, *x_framing, *x_start, *x_stop, *x_stats;
+    OPEN_USB_SIM_XFER_TypeDef *x_rd[3], *x_wr, *x_framing4, *x_stats8;
+    OPEN_USB_SIM_STATS_TypeDef stats;
+    int err = 0;
+    int i;
+
+    printf("USB vendor streaming test on simulator\r\n");
+
+    openusb_sim_init();
+
+    openusb_attach(0);
+    usbf_init(USB_BASE, 0, 0);
+    usbf_register_class(&usb_vendor_driver, VENDOR_INTERFACE, 1, VENDOR_ENDPOINT_MASK);
+    usb_vendor_config(&_vendor_cfg);
+    openusb_sim_set_isr(openusb_isr_top);
+
+    openusb_attach(1);
+    openusb_enable_int(1,0);
+
+    for(i=0; i<STREAM_LEN; i++)
+        _expect[i] = i * 7;
+    for(i=0; i<OUT_LEN; i++)
+        _wr_data[i] = i + 0x40;
+
+    host_xfer(SIM_XFER_RESET, 0, NULL, 0);
+    x_addr     = host_control_write(_setup_set_address, NULL, 0);
+    x_set_conf = host_control_write(_setup_set_conf, NULL, 0);
+    x_framing  = host_control_write(_setup_framing, _framing, VENDOR_FRAMING_LEN);
+    // refused, the framing above stays
+    x_framing4 = host_control_write(_setup_framing4, _framing4, sizeof(_framing4));
+    x_start    = host_control_write(_setup_start, NULL, 0);
+    // reads larger than the framing, the ZLP ends the full transfers
+    for(i=0; i<3; i++)
+        x_rd[i] = host_xfer(SIM_XFER_IN, VENDOR_ENDPOINT_BULK_IN, _rd_data[i], sizeof(_rd_data[i]));
+    x_wr       = host_xfer(SIM_XFER_OUT, VENDOR_ENDPOINT_BULK_OUT, _wr_data, OUT_LEN);
+    x_stop     = host_control_write(_setup_stop, NULL, 0);
+    x_stats    = host_control_read(_setup_get_stats, _stats, VENDOR_STATS_LEN);
+    x_stats8   = host_control_read(_setup_get_stats8, _stats8, sizeof(_stats8));
+
+    // the main loop, the time goes on while it is idle
+    while(!openusb_sim_host_idle()){
+        if(!openusb_poll_events(8))
+            openusb_sim_tick();
+    }
+
+    err += check("SET_ADDRESS", x_addr, NULL, 0);
+    err += check("SET_CONFIGURATION", x_set_conf, NULL, 0);
+    err += check("SET_FRAMING", x_framing, NULL, 0);
+    err += (x_framing4->status != SIM_XFER_STALL);
+    printf("%-24s %s (status %d)\n", "SET_FRAMING short", x_framing4->status == SIM_XFER_STALL ? "PASS" : "FAIL",
+           x_framing4->status);
+    err += check("START", x_start, NULL, 0);
+    err += check("Stream transfer 1", x_rd[0], &_expect[0], FRAME_LEN);
+    err += check("Stream transfer 2", x_rd[1], &_expect[FRAME_LEN], FRAME_LEN);
+    err += check("Stream transfer 3", x_rd[2], &_expect[2 * FRAME_LEN], STREAM_LEN - 2 * FRAME_LEN);
+    err += check("Bulk OUT", x_wr, NULL, OUT_LEN);
+    err += check("STOP", x_stop, NULL, 0);
+    err += check("GET_STATS", x_stats, NULL, VENDOR_STATS_LEN);
+    err += check("GET_STATS 8", x_stats8, _stats, 8);
+    err += check_stat("Stats IN bytes", 0, STREAM_LEN);
+    err += check_stat("Stats IN transfers", 1, 3);
+    err += check_stat("Stats OUT bytes", 2, OUT_LEN);
+    err += check_stat("Stats OUT transfers", 3, 1);
+    err += check_stat("Stats underruns", 4, 1);
+
+    if(_consumed_len != OUT_LEN || memcmp(_consumed, _wr_data, OUT_LEN)){
+        printf("Consumed data FAIL\n");
+        err++;
+    }
+
+    openusb_sim_get_stats(&stats);
+    printf("ticks %u, reads %u (data %u), writes %u (data %u), irqs %u, packets %u, naks %u, events merged %u\n",
+           stats.ticks, stats.reads, stats.data_reads, stats.writes, stats.data_writes,
+           stats.irqs, stats.packets, stats.naks, openusb_get_event_merged());
+
+    printf(err ? "Failed!\r\n" : "Finish!\r\n");
+    return err ? 1 : 0;
+}